@@ -0,0 +1,460 @@
+/**
+ * ARCHIVE.CPP - SESSION ARCHIVES WRITTEN BY THE RECEIVER
+ */
+#include "archive.h"
+#include "protocol.h"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define SEGMENT_MAGIC "RGMS"
+#define INDEX_MAGIC "RGMI"
+
+static bool makeDirectory(const std::string &path)
+{
+#ifdef _WIN32
+    return _mkdir(path.c_str()) == 0;
+#else
+    return mkdir(path.c_str(), 0755) == 0;
+#endif
+}
+
+static std::string segmentName(uint32_t segment)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "/segment-%06u.rgms", segment);
+    return name;
+}
+
+static void packFileHeader(uint8_t *out, const char *magic, int width, int height, int codec, uint32_t segment)
+{
+    memset(out, 0, ARCHIVE_HEADER_SIZE);
+    memcpy(out, magic, 4);
+    putU32(out + 4, ARCHIVE_VERSION);
+    putU32(out + 8, width);
+    putU32(out + 12, height);
+    putU32(out + 16, codec);
+    putU32(out + 20, segment);
+}
+
+// ============================================================================
+// RECORDER
+// ============================================================================
+
+ArchiveRecorder::ArchiveRecorder()
+    : frame_width(0), frame_height(0), codec_id(CODEC_RAW), running(false),
+      gap(false), last_key_us(0), have_key(false), queued_bytes(0), stopping(false),
+      segment_file(NULL), index_file(NULL), segment_number(0), segment_size(0), first_us(0),
+      entries(0), key_entry(0), frames_written(0), frames_dropped(0), bytes_written(0)
+{
+}
+
+ArchiveRecorder::~ArchiveRecorder()
+{
+    stop();
+}
+
+bool ArchiveRecorder::start(const std::string &root, int width, int height, int codec)
+{
+    if (!makeDirectory(root) && errno != EEXIST)
+    {
+        std::cerr << "❌ Could not create archive directory " << root << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // First free session-<n>; mkdir fails on existing ones, so concurrent receivers cannot collide
+    for (int n = 1;; n++)
+    {
+        session_dir = root + "/session-" + std::to_string(n);
+        if (makeDirectory(session_dir))
+            break;
+        if (errno != EEXIST)
+        {
+            std::cerr << "❌ Could not create " << session_dir << ": " << strerror(errno) << std::endl;
+            return false;
+        }
+    }
+
+    index_file = fopen((session_dir + "/index.rgmi").c_str(), "wb");
+    if (!index_file)
+    {
+        std::cerr << "❌ Could not create the archive index in " << session_dir << std::endl;
+        return false;
+    }
+    uint8_t header[ARCHIVE_HEADER_SIZE];
+    packFileHeader(header, INDEX_MAGIC, width, height, codec, 0);
+    fwrite(header, 1, sizeof(header), index_file);
+
+    frame_width = width;
+    frame_height = height;
+    codec_id = codec;
+    gap = false;
+    have_key = false;
+    stopping = false;
+    queued_bytes = 0;
+    segment_number = 0;
+    segment_size = 0;
+    entries = 0;
+    frames_written = frames_dropped = bytes_written = 0;
+    snapshot_encoder.reset(new FrameEncoder(codec == CODEC_RAW ? CODEC_RAW : CODEC_TILE, width, height, 1));
+
+    running = true;
+    io_thread = std::thread(&ArchiveRecorder::ioLoop, this);
+    std::cout << "🗄️  Archiving session to " << session_dir << std::endl;
+    return true;
+}
+
+bool ArchiveRecorder::wantsSnapshot(uint64_t capture_us) const
+{
+    return running && (gap || !have_key || capture_us - last_key_us >= ARCHIVE_KEYFRAME_INTERVAL_US);
+}
+
+bool ArchiveRecorder::submit(uint32_t frame_id, uint64_t capture_us, uint32_t flags, const uint8_t *payload, size_t size)
+{
+    if (!running)
+        return false;
+    bool keyframe = (flags & FRAME_FLAG_KEYFRAME) != 0;
+
+    // A delta is useless without its reference in the archive
+    if (!keyframe && (gap || !have_key))
+        return false;
+
+    if (!enqueue(frame_id, capture_us, flags, false, payload, size))
+    {
+        gap = true;
+        return false;
+    }
+    if (keyframe)
+    {
+        have_key = true;
+        gap = false;
+        last_key_us = capture_us;
+    }
+    return true;
+}
+
+bool ArchiveRecorder::submitSnapshot(uint32_t frame_id, uint64_t capture_us, const uint8_t *frame)
+{
+    if (!running)
+        return false;
+    size_t size = (size_t)frame_width * frame_height * BYTES_PER_PIXEL;
+    if (!enqueue(frame_id, capture_us, FRAME_FLAG_KEYFRAME | ARCHIVE_FLAG_SNAPSHOT, true, frame, size))
+    {
+        gap = true;
+        return false;
+    }
+    have_key = true;
+    gap = false;
+    last_key_us = capture_us;
+    return true;
+}
+
+bool ArchiveRecorder::enqueue(uint32_t frame_id, uint64_t capture_us, uint32_t flags, bool snapshot,
+                              const uint8_t *data, size_t size)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // An empty queue takes anything, so one oversized snapshot cannot block recovery forever
+    if (queued_bytes > 0 && queued_bytes + size > ARCHIVE_QUEUE_BYTES)
+    {
+        frames_dropped++;
+        return false;
+    }
+
+    Job job;
+    job.frame_id = frame_id;
+    job.capture_us = capture_us;
+    job.flags = flags;
+    job.snapshot = snapshot;
+    if (!spare.empty())
+    {
+        job.data.swap(spare.back());
+        spare.pop_back();
+    }
+    job.data.assign(data, data + size);
+    queued_bytes += size;
+    queue.push_back(std::move(job));
+    wake.notify_one();
+    return true;
+}
+
+void ArchiveRecorder::ioLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    bool failed = false;
+    while (true)
+    {
+        wake.wait(lock, [this]()
+                  { return stopping || !queue.empty(); });
+        if (queue.empty())
+            break; // Stopping and drained
+
+        Job job = std::move(queue.front());
+        queue.pop_front();
+        size_t size = job.data.size();
+
+        lock.unlock();
+        if (!failed && !writeJob(job))
+        {
+            std::cerr << "❌ Archive write failed in " << session_dir << ", recording stopped" << std::endl;
+            failed = true;
+        }
+        lock.lock();
+
+        queued_bytes -= size;
+        if (failed)
+            frames_dropped++;
+        spare.push_back(std::vector<uint8_t>());
+        spare.back().swap(job.data);
+
+        // Make what is written visible to readers once the backlog is gone
+        if (queue.empty() && !failed)
+        {
+            fflush(segment_file);
+            fflush(index_file);
+        }
+    }
+}
+
+bool ArchiveRecorder::openSegment()
+{
+    if (segment_file)
+        fclose(segment_file);
+    segment_number++;
+    segment_file = fopen((session_dir + segmentName(segment_number)).c_str(), "wb");
+    if (!segment_file)
+        return false;
+
+    uint8_t header[ARCHIVE_HEADER_SIZE];
+    packFileHeader(header, SEGMENT_MAGIC, frame_width, frame_height, codec_id, segment_number);
+    segment_size = fwrite(header, 1, sizeof(header), segment_file);
+    return segment_size == sizeof(header);
+}
+
+bool ArchiveRecorder::writeJob(Job &job)
+{
+    const uint8_t *payload = job.data.data();
+    size_t length = job.data.size();
+    if (job.snapshot)
+    {
+        EncodedFrame encoded;
+        snapshot_encoder->encode(job.data.data(), true, encoded);
+        payload = encoded.data;
+        length = encoded.size;
+    }
+
+    static const uint8_t padding[8] = {0};
+    size_t pad = (8 - length % 8) % 8;
+    if (!segment_file || (segment_size + ARCHIVE_RECORD_HEADER + length > ARCHIVE_SEGMENT_BYTES &&
+                          segment_size > ARCHIVE_HEADER_SIZE))
+    {
+        if (!openSegment())
+            return false;
+    }
+    if (entries == 0)
+        first_us = job.capture_us;
+    uint64_t time_us = job.capture_us >= first_us ? job.capture_us - first_us : 0;
+
+    uint8_t record[ARCHIVE_RECORD_HEADER] = {0};
+    putU32(record, job.flags);
+    putU32(record + 4, job.frame_id);
+    putU64(record + 8, time_us);
+    putU32(record + 16, (uint32_t)length);
+    uint64_t offset = segment_size + ARCHIVE_RECORD_HEADER;
+    if (fwrite(record, 1, sizeof(record), segment_file) != sizeof(record) ||
+        fwrite(payload, 1, length, segment_file) != length ||
+        fwrite(padding, 1, pad, segment_file) != pad)
+        return false;
+    segment_size = offset + length + pad;
+
+    if (job.flags & FRAME_FLAG_KEYFRAME)
+        key_entry = entries;
+    uint8_t entry[ARCHIVE_INDEX_ENTRY] = {0};
+    putU64(entry, time_us);
+    putU64(entry + 8, offset);
+    putU32(entry + 16, segment_number);
+    putU32(entry + 20, job.frame_id);
+    putU32(entry + 24, (uint32_t)length);
+    putU32(entry + 28, job.flags);
+    putU32(entry + 32, key_entry);
+    if (fwrite(entry, 1, sizeof(entry), index_file) != sizeof(entry))
+        return false;
+
+    entries++;
+    frames_written++;
+    bytes_written += ARCHIVE_RECORD_HEADER + length + pad;
+    return true;
+}
+
+void ArchiveRecorder::stop()
+{
+    if (!running)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    io_thread.join();
+    running = false;
+
+    if (segment_file)
+        fclose(segment_file);
+    if (index_file)
+        fclose(index_file);
+    segment_file = NULL;
+    index_file = NULL;
+    snapshot_encoder.reset();
+
+    std::cout << "🗄️  Archived " << frames_written << " frames (" << bytes_written / (1024 * 1024) << " MB, "
+              << segment_number << " segment" << (segment_number == 1 ? "" : "s") << ") to " << session_dir;
+    if (frames_dropped > 0)
+        std::cout << ", " << frames_dropped << " dropped";
+    std::cout << std::endl;
+}
+
+// ============================================================================
+// READER
+// ============================================================================
+
+ArchiveReader::ArchiveReader() : entry_count(0), frame_width(0), frame_height(0), codec_id(CODEC_RAW)
+{
+    index.data = NULL;
+    index.size = 0;
+}
+
+ArchiveReader::~ArchiveReader()
+{
+    unmap(index);
+    for (size_t i = 0; i < segments.size(); i++)
+        unmap(segments[i]);
+}
+
+const ArchiveReader::Mapping *ArchiveReader::mapFile(const std::string &path, Mapping &mapping)
+{
+#ifdef _WIN32
+    (void)path;
+    (void)mapping;
+    std::cerr << "❌ Reading archives is not supported on Windows yet" << std::endl;
+    return NULL;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    struct stat info;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+        data = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+    mapping.data = (const uint8_t *)data;
+    mapping.size = info.st_size;
+    return &mapping;
+#endif
+}
+
+void ArchiveReader::unmap(Mapping &mapping)
+{
+#ifndef _WIN32
+    if (mapping.data)
+        munmap((void *)mapping.data, mapping.size);
+#endif
+    mapping.data = NULL;
+    mapping.size = 0;
+}
+
+bool ArchiveReader::open(const std::string &session_dir)
+{
+    directory = session_dir;
+    if (!mapFile(directory + "/index.rgmi", index) || index.size < ARCHIVE_HEADER_SIZE ||
+        memcmp(index.data, INDEX_MAGIC, 4) != 0 || getU32(index.data + 4) != ARCHIVE_VERSION)
+    {
+        std::cerr << "❌ " << directory << " is not an RGM session archive" << std::endl;
+        return false;
+    }
+    frame_width = getU32(index.data + 8);
+    frame_height = getU32(index.data + 12);
+    codec_id = getU32(index.data + 16);
+
+    // A recorder still running (or killed) may have left half an entry
+    entry_count = (index.size - ARCHIVE_HEADER_SIZE) / ARCHIVE_INDEX_ENTRY;
+    if (codec_id >= CODEC_COUNT || frame_width <= 0 || frame_height <= 0 || entry_count == 0)
+    {
+        std::cerr << "❌ Archive " << directory << " is empty or unsupported" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+ArchiveEntry ArchiveReader::entry(size_t i) const
+{
+    const uint8_t *p = index.data + ARCHIVE_HEADER_SIZE + i * ARCHIVE_INDEX_ENTRY;
+    ArchiveEntry e;
+    e.time_us = getU64(p);
+    e.offset = getU64(p + 8);
+    e.segment = getU32(p + 16);
+    e.frame_id = getU32(p + 20);
+    e.length = getU32(p + 24);
+    e.flags = getU32(p + 28);
+    e.key_entry = getU32(p + 32);
+    return e;
+}
+
+size_t ArchiveReader::seekTarget(uint64_t time_us) const
+{
+    // Binary search straight over the mapped index
+    size_t low = 0, high = entry_count;
+    while (high - low > 1)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (getU64(index.data + ARCHIVE_HEADER_SIZE + middle * ARCHIVE_INDEX_ENTRY) <= time_us)
+            low = middle;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+size_t ArchiveReader::seek(uint64_t time_us) const
+{
+    size_t key = entry(seekTarget(time_us)).key_entry;
+    return key < entry_count ? key : 0;
+}
+
+const uint8_t *ArchiveReader::payload(const ArchiveEntry &e)
+{
+    if (e.segment == 0 || e.segment > 1000000)
+        return NULL;
+    if (segments.size() < e.segment)
+    {
+        size_t old = segments.size();
+        segments.resize(e.segment);
+        for (size_t i = old; i < segments.size(); i++)
+        {
+            segments[i].data = NULL;
+            segments[i].size = 0;
+        }
+    }
+
+    Mapping &segment = segments[e.segment - 1];
+    if (!segment.data && !mapFile(directory + segmentName(e.segment), segment))
+        return NULL;
+    if (e.offset + e.length > segment.size)
+        return NULL;
+    return segment.data + e.offset;
+}
+
+std::string ArchiveReader::segmentPath(uint32_t segment) const
+{
+    return directory + segmentName(segment);
+}
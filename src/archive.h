@@ -0,0 +1,186 @@
+/**
+ * ARCHIVE.H - SESSION ARCHIVES WRITTEN BY THE RECEIVER
+ *
+ * With --archive <dir> the receiver keeps the encoded stream of every session
+ * in <dir>/session-<n>/. Frames are appended as they arrived (keyframes and
+ * deltas, no re-encoding) to fixed-size segment files, and every frame gets
+ * a fixed-size entry in an index, so a reader can mmap the index and binary
+ * search it by time:
+ *
+ *   segment-<n>.rgms  header, then records: u32 flags, u32 frame_id,
+ *                     u64 time_us, u32 length, u32 reserved, payload padded
+ *                     to 8 bytes
+ *   index.rgmi        header, then ARCHIVE_INDEX_ENTRY-byte entries: u64 time_us,
+ *                     u64 offset, u32 segment, u32 frame_id, u32 length,
+ *                     u32 flags, u32 key_entry, u32 reserved
+ *
+ * All integers are in network byte order; time_us counts from the first
+ * frame on the sender's capture clock. key_entry is the index entry of the
+ * keyframe a frame depends on, so seeking is one lookup after the search.
+ *
+ * Recording runs on its own thread behind a bounded queue: when the disk
+ * falls behind, frames are dropped rather than stalling the display, and the
+ * receiver then supplies a snapshot of its decoded picture, stored as a
+ * keyframe (ARCHIVE_FLAG_SNAPSHOT), so the archive stays decodable. The same
+ * snapshots are taken every ARCHIVE_KEYFRAME_INTERVAL_US for fast seeking.
+ */
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include "codec.h"
+
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_HEADER_SIZE 32                // Segment and index file headers
+#define ARCHIVE_RECORD_HEADER 24              // Per-frame record header in a segment
+#define ARCHIVE_INDEX_ENTRY 40                // Per-frame index entry
+#define ARCHIVE_SEGMENT_BYTES (256u << 20)    // Segments roll over past this size
+#define ARCHIVE_QUEUE_BYTES (64u << 20)       // Frames waiting for the I/O thread
+#define ARCHIVE_KEYFRAME_INTERVAL_US 2000000  // Longest stretch without a keyframe
+#define ARCHIVE_FLAG_SNAPSHOT 2               // Keyframe made from the decoded picture
+
+/**
+ * One index entry, decoded
+ */
+struct ArchiveEntry
+{
+    uint64_t time_us;
+    uint64_t offset;    // Payload offset in the segment
+    uint32_t segment;
+    uint32_t frame_id;
+    uint32_t length;
+    uint32_t flags;     // FRAME_FLAG_KEYFRAME, ARCHIVE_FLAG_SNAPSHOT
+    uint32_t key_entry;
+};
+
+class ArchiveRecorder
+{
+public:
+    ArchiveRecorder();
+    ~ArchiveRecorder();
+
+    // Create the next free <root>/session-<n> directory and start the I/O thread
+    bool start(const std::string &root, int width, int height, int codec);
+
+    /**
+     * Queue a received frame (receiver thread, never blocks). When this
+     * returns false the frame was not taken and wantsSnapshot() is true.
+     */
+    bool submit(uint32_t frame_id, uint64_t capture_us, uint32_t flags, const uint8_t *payload, size_t size);
+
+    // True when the next frame should be passed to submitSnapshot() instead
+    bool wantsSnapshot(uint64_t capture_us) const;
+
+    // Queue the decoded picture after frame `frame_id` as a keyframe
+    bool submitSnapshot(uint32_t frame_id, uint64_t capture_us, const uint8_t *frame);
+
+    // Write out what is queued and close the files
+    void stop();
+
+    bool active() const { return running; }
+    const std::string &directory() const { return session_dir; }
+
+private:
+    struct Job
+    {
+        uint32_t frame_id;
+        uint64_t capture_us;
+        uint32_t flags;
+        bool snapshot;
+        std::vector<uint8_t> data;
+    };
+
+    bool enqueue(uint32_t frame_id, uint64_t capture_us, uint32_t flags, bool snapshot,
+                 const uint8_t *data, size_t size);
+    void ioLoop();
+    bool writeJob(Job &job);
+    bool openSegment();
+
+    std::string session_dir;
+    int frame_width, frame_height, codec_id;
+    bool running;
+
+    // Receiver thread side
+    bool gap;                   // Frames were dropped since the last keyframe
+    uint64_t last_key_us;
+    bool have_key;
+
+    // Shared queue
+    std::thread io_thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Job> queue;
+    std::vector<std::vector<uint8_t> > spare; // Recycled job buffers
+    size_t queued_bytes;
+    bool stopping;
+
+    // I/O thread side
+    std::unique_ptr<FrameEncoder> snapshot_encoder;
+    FILE *segment_file;
+    FILE *index_file;
+    uint32_t segment_number;
+    uint64_t segment_size;
+    uint64_t first_us;
+    uint32_t entries;
+    uint32_t key_entry;
+    uint64_t frames_written, frames_dropped, bytes_written;
+};
+
+/**
+ * Random access to an archived session through mmap (POSIX)
+ */
+class ArchiveReader
+{
+public:
+    ArchiveReader();
+    ~ArchiveReader();
+
+    bool open(const std::string &session_dir);
+    int width() const { return frame_width; }
+    int height() const { return frame_height; }
+    int codec() const { return codec_id; }
+
+    size_t count() const { return entry_count; }
+    ArchiveEntry entry(size_t index) const;
+
+    /**
+     * Index of the keyframe to start decoding from to show time_us, which
+     * counts from the start of the session; frames up to seekTarget() must
+     * then be decoded
+     */
+    size_t seek(uint64_t time_us) const;
+    size_t seekTarget(uint64_t time_us) const; // Last entry at or before time_us
+
+    // Payload of an entry inside the mapped segment, NULL if out of range
+    const uint8_t *payload(const ArchiveEntry &entry);
+
+    // File holding a segment, for readers that move payloads without mapping them
+    std::string segmentPath(uint32_t segment) const;
+
+private:
+    struct Mapping
+    {
+        const uint8_t *data;
+        size_t size;
+    };
+
+    const Mapping *mapFile(const std::string &path, Mapping &mapping);
+    void unmap(Mapping &mapping);
+
+    std::string directory;
+    Mapping index;
+    std::vector<Mapping> segments;
+    size_t entry_count;
+    int frame_width, frame_height, codec_id;
+};
+
+#endif
@@ -0,0 +1,641 @@
+/**
+ * BENCH.CPP - LOOPBACK END-TO-END BENCHMARK
+ *
+ * Runs the real sender and a headless receiver (--headless --once) over
+ * 127.0.0.1 for every combination of resolution, synthetic pattern (or
+ * recorded corpus), pixel format, codec, lossy quality and thread count, and
+ * writes one CSV row per run:
+ *
+ *   frames/s, MB/s on the wire, sender and receiver CPU per frame,
+ *   capture-to-decoded latency percentiles
+ *
+ * Throughput and latency come from the receiver's --stats-json dump (after
+ * its warmup frames); CPU time comes from wait4() rusage of each process and
+ * is averaged over all frames. POSIX only.
+ *
+ * --networks runs every case once more per impairment profile (or impair
+ * script), with the impair proxy between sender and receiver,
+ * --transports over TCP and/or the UDP transport, and --ios with each of
+ * the receiver's networking loops (--io threads, epoll or uring).
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <sys/stat.h>
+#include "stats.h"
+#include "codec.h"
+#include "corpus.h"
+
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+
+#define PIXEL_FORMAT_NAME "rgb24"    // The only wire pixel format so far
+
+/**
+ * One point of the sweep
+ */
+struct BenchCase
+{
+    int width;
+    int height;
+    std::string pattern; // Pattern name, or corpus file name
+    std::string source;  // Sender --source
+    std::string format;
+    int codec;
+    int quality; // Sender --quality, 0 = lossless
+    int threads;
+    std::string transport;
+    std::string network; // impair profile or script, "none" for a direct connection
+    std::string io;      // Receiver --io
+    int run;
+};
+
+/**
+ * Measurements of one run
+ */
+struct BenchResult
+{
+    bool ok;
+    double frames;              // Frames measured by the receiver (after warmup)
+    double dropped;             // Frames the receiver skipped or lost
+    double seconds;             // Receiver time for those frames
+    double wire_bytes;          // Headers + payloads of those frames
+    double sender_cpu_us;       // User + system time of the sender process
+    double receiver_cpu_us;     // User + system time of the receiver process
+    double latency_us[4];       // Capture -> decoded: p50, p95, p99, max
+};
+
+/**
+ * Command line configuration
+ */
+struct BenchConfig
+{
+    std::vector<std::pair<int, int> > resolutions;
+    std::vector<std::string> patterns;
+    std::vector<std::string> corpora;
+    std::vector<std::string> formats;
+    std::vector<int> codecs;
+    std::vector<int> qualities;
+    std::vector<int> threads;
+    std::vector<std::string> transports;
+    std::vector<std::string> networks;
+    std::vector<std::string> ios;
+    int frames;
+    int warmup;
+    int fps;
+    int repeat;
+    std::string sender_path;
+    std::string receiver_path;
+    std::string impair_path;
+    std::string output_path;
+    bool verbose;
+};
+
+static std::vector<std::string> splitList(const std::string &list)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        if (!item.empty())
+            items.push_back(item);
+    }
+    return items;
+}
+
+/**
+ * Find a free loopback port for the receiver to listen on
+ */
+static int pickPort()
+{
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0)
+        return -1;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+
+    int port = -1;
+    socklen_t len = sizeof(addr);
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0 &&
+        getsockname(sock, (struct sockaddr *)&addr, &len) == 0)
+        port = ntohs(addr.sin_port);
+    close(sock);
+    return port;
+}
+
+/**
+ * fork + exec; output goes to /dev/null unless verbose
+ */
+static pid_t spawn(const std::vector<std::string> &args, bool verbose)
+{
+    pid_t pid = fork();
+    if (pid != 0)
+        return pid;
+
+    if (!verbose)
+    {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+    }
+    std::vector<char *> argv;
+    for (size_t i = 0; i < args.size(); i++)
+        argv.push_back(const_cast<char *>(args[i].c_str()));
+    argv.push_back(NULL);
+    execv(argv[0], argv.data());
+    _exit(127);
+}
+
+/**
+ * Wait for a child; returns false unless it exited cleanly
+ */
+static bool reap(pid_t pid, double &cpu_us)
+{
+    int status = 0;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) != pid)
+        return false;
+    cpu_us = usage.ru_utime.tv_sec * 1e6 + usage.ru_utime.tv_usec +
+             usage.ru_stime.tv_sec * 1e6 + usage.ru_stime.tv_usec;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+ * Number following `"key": ` in a --stats-json dump, searched after `scope`
+ * (the dump is flat and generated by writeStatsJson, no general parser needed)
+ */
+static bool jsonNumber(const std::string &json, const std::string &scope, const std::string &key, double &value)
+{
+    size_t pos = json.find(scope);
+    if (pos == std::string::npos)
+        return false;
+    pos = json.find("\"" + key + "\": ", pos);
+    if (pos == std::string::npos)
+        return false;
+    value = atof(json.c_str() + pos + key.size() + 4);
+    return true;
+}
+
+static BenchResult runCase(const BenchConfig &config, const BenchCase &bench)
+{
+    BenchResult result;
+    memset(&result, 0, sizeof(result));
+
+    bool impaired = bench.network != "none";
+    int port = pickPort();
+    int proxy_port = impaired ? pickPort() : port;
+    if (port < 0 || proxy_port < 0)
+    {
+        std::cerr << "❌ No free loopback port: " << strerror(errno) << std::endl;
+        return result;
+    }
+    std::string stats_path = "/tmp/rgm-bench-" + std::to_string(getpid()) + ".json";
+    unlink(stats_path.c_str());
+
+    std::vector<std::string> receiver;
+    receiver.push_back(config.receiver_path);
+    receiver.push_back("--headless");
+    receiver.push_back("--once");
+    receiver.push_back("--no-ssdp");
+    receiver.push_back("--port");
+    receiver.push_back(std::to_string(port));
+    receiver.push_back("--threads");
+    receiver.push_back(std::to_string(bench.threads));
+    receiver.push_back("--warmup");
+    receiver.push_back(std::to_string(config.warmup));
+    receiver.push_back("--stats-json");
+    receiver.push_back(stats_path);
+    receiver.push_back("--io");
+    receiver.push_back(bench.io);
+
+    std::vector<std::string> sender;
+    sender.push_back(config.sender_path);
+    sender.push_back("--no-splash");
+    sender.push_back("--source");
+    sender.push_back(bench.source);
+    sender.push_back("--size");
+    sender.push_back(std::to_string(bench.width) + "x" + std::to_string(bench.height));
+    sender.push_back("--fps");
+    sender.push_back(std::to_string(config.fps));
+    sender.push_back("--codec");
+    sender.push_back(codecName(bench.codec));
+    sender.push_back("--quality");
+    sender.push_back(std::to_string(bench.quality));
+    sender.push_back("--threads");
+    sender.push_back(std::to_string(bench.threads));
+    sender.push_back("--frames");
+    sender.push_back(std::to_string(config.frames));
+    sender.push_back("--connect");
+    sender.push_back("127.0.0.1:" + std::to_string(proxy_port));
+    sender.push_back("--transport");
+    sender.push_back(bench.transport);
+
+    // A network that is a file is an impair script, anything else a profile
+    std::vector<std::string> proxy;
+    proxy.push_back(config.impair_path);
+    proxy.push_back("--listen");
+    proxy.push_back(std::to_string(proxy_port));
+    proxy.push_back("--target");
+    proxy.push_back("127.0.0.1:" + std::to_string(port));
+    struct stat script;
+    proxy.push_back(stat(bench.network.c_str(), &script) == 0 ? "--script" : "--profile");
+    proxy.push_back(bench.network);
+    proxy.push_back("--seed");
+    proxy.push_back(std::to_string(bench.run + 1));
+    proxy.push_back("--once");
+
+    // The sender retries --connect until the receiver (and proxy) listen
+    pid_t receiver_pid = spawn(receiver, config.verbose);
+    pid_t proxy_pid = impaired && receiver_pid > 0 ? spawn(proxy, config.verbose) : 0;
+    pid_t sender_pid = receiver_pid > 0 && proxy_pid >= 0 ? spawn(sender, config.verbose) : -1;
+    double proxy_cpu_us = 0;
+    if (sender_pid < 0)
+    {
+        if (proxy_pid > 0)
+        {
+            kill(proxy_pid, SIGTERM);
+            reap(proxy_pid, proxy_cpu_us);
+        }
+        if (receiver_pid > 0)
+        {
+            kill(receiver_pid, SIGTERM);
+            reap(receiver_pid, result.receiver_cpu_us);
+        }
+        return result;
+    }
+
+    bool sender_ok = reap(sender_pid, result.sender_cpu_us);
+    if (!sender_ok)
+    {
+        // Never connected; let the others exit
+        if (proxy_pid > 0)
+            kill(proxy_pid, SIGTERM);
+        kill(receiver_pid, SIGINT);
+    }
+    bool receiver_ok = reap(receiver_pid, result.receiver_cpu_us);
+    if (proxy_pid > 0)
+        reap(proxy_pid, proxy_cpu_us);
+
+    std::ifstream in(stats_path.c_str());
+    std::stringstream json;
+    json << in.rdbuf();
+    unlink(stats_path.c_str());
+
+    const std::string latency = "\"capture_to_present\"";
+    result.ok = sender_ok && receiver_ok &&
+                jsonNumber(json.str(), "\"role\"", "frames", result.frames) &&
+                jsonNumber(json.str(), "\"role\"", "bytes", result.wire_bytes) &&
+                jsonNumber(json.str(), "\"role\"", "duration_s", result.seconds) &&
+                jsonNumber(json.str(), "\"counters\"", "dropped", result.dropped) &&
+                jsonNumber(json.str(), latency, "p50_us", result.latency_us[0]) &&
+                jsonNumber(json.str(), latency, "p95_us", result.latency_us[1]) &&
+                jsonNumber(json.str(), latency, "p99_us", result.latency_us[2]) &&
+                jsonNumber(json.str(), latency, "max_us", result.latency_us[3]) &&
+                result.frames > 0;
+    if (!result.ok)
+        std::cerr << "❌ Run failed (sender " << (sender_ok ? "ok" : "failed") << ", receiver "
+                  << (receiver_ok ? "ok" : "failed") << "); rerun with --verbose" << std::endl;
+    return result;
+}
+
+static void writeHeader(std::ostream &out)
+{
+    out << "width,height,pattern,format,codec,quality,threads,transport,network,io,run,frames,frames_dropped,seconds,fps,wire_mb_s,"
+           "bytes_per_frame,sender_cpu_us_per_frame,receiver_cpu_us_per_frame,"
+           "latency_p50_us,latency_p95_us,latency_p99_us,latency_max_us\n";
+}
+
+static void writeRow(std::ostream &out, const BenchConfig &config, const BenchCase &bench, const BenchResult &result)
+{
+    double frames = config.frames; // CPU covers the whole process, warmup included
+    double seconds = result.seconds > 0 ? result.seconds : 1e-9;
+
+    out << bench.width << "," << bench.height << "," << bench.pattern << "," << bench.format << ","
+        << codecName(bench.codec) << "," << bench.quality << "," << bench.threads << "," << bench.transport << "," << bench.network << ","
+        << bench.io << "," << bench.run << "," << result.frames << "," << result.dropped << "," << std::fixed << std::setprecision(3) << result.seconds << ","
+        << std::setprecision(1) << (result.frames / seconds) << ","
+        << std::setprecision(2) << (result.wire_bytes / (1024.0 * 1024.0) / seconds) << ","
+        << std::setprecision(0) << (result.wire_bytes / result.frames) << ","
+        << std::setprecision(1) << (result.sender_cpu_us / frames) << ","
+        << (result.receiver_cpu_us / frames) << "," << std::setprecision(0)
+        << result.latency_us[0] << "," << result.latency_us[1] << ","
+        << result.latency_us[2] << "," << result.latency_us[3] << "\n";
+}
+
+static void usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --resolutions <WxH,...>  (default 1280x720,1920x1080)\n"
+              << "  --patterns <name,...>    synthetic patterns (default static,scroll,window,typing,noise,video)\n"
+              << "  --corpus <file,...>      also replay recorded sessions (sender --record) at full speed\n"
+              << "  --formats <name,...>     wire pixel formats (default " PIXEL_FORMAT_NAME ")\n"
+              << "  --codecs <name,...>      (default raw,tile)\n"
+              << "  --qualities <q,...>      tile codec lossy quality, 0 = lossless (default 0,75)\n"
+              << "  --threads <n,...>        encode/decode threads (default 1,4)\n"
+              << "  --transports <name,...>  tcp and/or udp (default tcp)\n"
+              << "  --networks <name,...>    impair profiles or scripts between sender and receiver\n"
+              << "                           (default none: direct loopback)\n"
+              << "  --ios <name,...>         receiver networking: threads, epoll and/or uring (default threads)\n"
+              << "  --frames <n>             frames per run (default 300)\n"
+              << "  --warmup <n>             leading frames left out of the figures (default 30)\n"
+              << "  --fps <n>                sender frame rate, 0 = unlimited (default 0)\n"
+              << "  --repeat <n>             runs per case (default 1)\n"
+              << "  --sender <path>          sender binary (default ./sender)\n"
+              << "  --receiver <path>        receiver binary (default ./receiver)\n"
+              << "  --impair <path>          impairment proxy binary (default ./impair)\n"
+              << "  --output <file>          CSV results (default bench_results.csv)\n"
+              << "  --verbose                show sender and receiver output\n";
+}
+
+/**
+ * Main function
+ * Parses the sweep, runs every case and writes the results table
+ */
+int main(int argc, char *argv[])
+{
+    BenchConfig config;
+    config.resolutions.push_back(std::make_pair(1280, 720));
+    config.resolutions.push_back(std::make_pair(1920, 1080));
+    config.patterns = splitList("static,scroll,window,typing,noise,video");
+    config.formats.push_back(PIXEL_FORMAT_NAME);
+    config.codecs.push_back(CODEC_RAW);
+    config.codecs.push_back(CODEC_TILE);
+    config.qualities.push_back(0);
+    config.qualities.push_back(75);
+    config.threads.push_back(1);
+    config.threads.push_back(4);
+    config.transports.push_back("tcp");
+    config.networks.push_back("none");
+    config.ios.push_back("threads");
+    config.frames = 300;
+    config.warmup = 30;
+    config.fps = 0;
+    config.repeat = 1;
+    config.sender_path = "./sender";
+    config.receiver_path = "./receiver";
+    config.impair_path = "./impair";
+    config.output_path = "bench_results.csv";
+    config.verbose = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--resolutions" && has_value)
+        {
+            config.resolutions.clear();
+            std::vector<std::string> items = splitList(argv[++i]);
+            for (size_t j = 0; j < items.size(); j++)
+            {
+                int w, h;
+                if (sscanf(items[j].c_str(), "%dx%d", &w, &h) != 2)
+                {
+                    std::cerr << "❌ Bad resolution: " << items[j] << std::endl;
+                    return 1;
+                }
+                config.resolutions.push_back(std::make_pair(w, h));
+            }
+        }
+        else if (arg == "--patterns" && has_value)
+            config.patterns = splitList(argv[++i]);
+        else if (arg == "--corpus" && has_value)
+            config.corpora = splitList(argv[++i]);
+        else if (arg == "--formats" && has_value)
+        {
+            config.formats = splitList(argv[++i]);
+            for (size_t j = 0; j < config.formats.size(); j++)
+            {
+                if (config.formats[j] != PIXEL_FORMAT_NAME)
+                {
+                    std::cerr << "❌ Unsupported pixel format: " << config.formats[j] << std::endl;
+                    return 1;
+                }
+            }
+        }
+        else if (arg == "--codecs" && has_value)
+        {
+            config.codecs.clear();
+            std::vector<std::string> items = splitList(argv[++i]);
+            for (size_t j = 0; j < items.size(); j++)
+            {
+                int codec = codecFromName(items[j]);
+                if (codec < 0)
+                {
+                    std::cerr << "❌ Unknown codec: " << items[j] << std::endl;
+                    return 1;
+                }
+                config.codecs.push_back(codec);
+            }
+        }
+        else if (arg == "--qualities" && has_value)
+        {
+            config.qualities.clear();
+            std::vector<std::string> items = splitList(argv[++i]);
+            for (size_t j = 0; j < items.size(); j++)
+            {
+                int quality = atoi(items[j].c_str());
+                if (quality < 0 || quality > 100)
+                {
+                    std::cerr << "❌ Bad quality: " << items[j] << std::endl;
+                    return 1;
+                }
+                config.qualities.push_back(quality);
+            }
+        }
+        else if (arg == "--threads" && has_value)
+        {
+            config.threads.clear();
+            std::vector<std::string> items = splitList(argv[++i]);
+            for (size_t j = 0; j < items.size(); j++)
+                config.threads.push_back(atoi(items[j].c_str()));
+        }
+        else if (arg == "--transports" && has_value)
+        {
+            config.transports = splitList(argv[++i]);
+            for (size_t j = 0; j < config.transports.size(); j++)
+            {
+                if (config.transports[j] != "tcp" && config.transports[j] != "udp")
+                {
+                    std::cerr << "❌ Unknown transport: " << config.transports[j] << std::endl;
+                    return 1;
+                }
+            }
+        }
+        else if (arg == "--networks" && has_value)
+            config.networks = splitList(argv[++i]);
+        else if (arg == "--ios" && has_value)
+        {
+            config.ios = splitList(argv[++i]);
+            for (size_t j = 0; j < config.ios.size(); j++)
+            {
+                if (config.ios[j] != "threads" && config.ios[j] != "epoll" && config.ios[j] != "uring")
+                {
+                    std::cerr << "❌ Unknown receiver I/O: " << config.ios[j] << std::endl;
+                    return 1;
+                }
+            }
+        }
+        else if (arg == "--frames" && has_value)
+            config.frames = atoi(argv[++i]);
+        else if (arg == "--warmup" && has_value)
+            config.warmup = atoi(argv[++i]);
+        else if (arg == "--fps" && has_value)
+            config.fps = atoi(argv[++i]);
+        else if (arg == "--repeat" && has_value)
+            config.repeat = atoi(argv[++i]);
+        else if (arg == "--sender" && has_value)
+            config.sender_path = argv[++i];
+        else if (arg == "--receiver" && has_value)
+            config.receiver_path = argv[++i];
+        else if (arg == "--impair" && has_value)
+            config.impair_path = argv[++i];
+        else if (arg == "--output" && has_value)
+            config.output_path = argv[++i];
+        else if (arg == "--verbose")
+            config.verbose = true;
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (config.warmup < 1 || config.warmup >= config.frames)
+    {
+        std::cerr << "❌ --warmup must be between 1 and --frames - 1" << std::endl;
+        return 1;
+    }
+
+    // A receiver going away mid-run must not kill the harness
+    signal(SIGPIPE, SIG_IGN);
+
+    // Inputs: every pattern at every resolution, then the corpora at their recorded size
+    std::vector<BenchCase> inputs;
+    for (size_t r = 0; r < config.resolutions.size(); r++)
+        for (size_t p = 0; p < config.patterns.size(); p++)
+        {
+            BenchCase input;
+            input.width = config.resolutions[r].first;
+            input.height = config.resolutions[r].second;
+            input.pattern = config.patterns[p];
+            input.source = "synthetic:" + config.patterns[p];
+            inputs.push_back(input);
+        }
+    for (size_t i = 0; i < config.corpora.size(); i++)
+    {
+        CorpusReader reader;
+        if (!reader.open(config.corpora[i]))
+            return 1;
+        BenchCase input;
+        input.width = reader.width();
+        input.height = reader.height();
+        input.pattern = config.corpora[i].substr(config.corpora[i].find_last_of('/') + 1);
+        input.source = "replay-max:" + config.corpora[i];
+        inputs.push_back(input);
+    }
+
+    // Raw ignores the quality and thread count, so it runs once per input
+    std::vector<BenchCase> cases;
+    for (size_t n = 0; n < inputs.size(); n++)
+        for (size_t f = 0; f < config.formats.size(); f++)
+            for (size_t c = 0; c < config.codecs.size(); c++)
+                for (size_t q = 0; q < config.qualities.size(); q++)
+                    for (size_t t = 0; t < config.threads.size(); t++)
+                        for (size_t x = 0; x < config.transports.size(); x++)
+                            for (size_t w = 0; w < config.networks.size(); w++)
+                                for (size_t o = 0; o < config.ios.size(); o++)
+                                {
+                                    bool raw = config.codecs[c] == CODEC_RAW;
+                                    if (raw && (q > 0 || t > 0))
+                                        continue;
+                                    for (int run = 0; run < config.repeat; run++)
+                                    {
+                                        BenchCase bench = inputs[n];
+                                        bench.format = config.formats[f];
+                                        bench.codec = config.codecs[c];
+                                        bench.quality = raw ? 0 : config.qualities[q];
+                                        bench.threads = raw ? 1 : config.threads[t];
+                                        bench.transport = config.transports[x];
+                                        bench.network = config.networks[w];
+                                        bench.io = config.ios[o];
+                                        bench.run = run;
+                                        cases.push_back(bench);
+                                    }
+                                }
+
+    std::ofstream out(config.output_path.c_str());
+    if (!out)
+    {
+        std::cerr << "❌ Could not write " << config.output_path << std::endl;
+        return 1;
+    }
+    writeHeader(out);
+
+    std::cout << "========================================" << std::endl;
+    std::cout << "🏁 RGM LOOPBACK BENCHMARK" << std::endl;
+    std::cout << "========================================" << std::endl;
+    std::cout << "Cases:   " << cases.size() << " x " << config.frames << " frames ("
+              << config.warmup << " warmup)" << std::endl;
+    std::cout << "Sender:  " << config.sender_path << " @ "
+              << (config.fps > 0 ? std::to_string(config.fps) + " FPS" : std::string("unlimited FPS")) << std::endl;
+    std::cout << "Receiver: " << config.receiver_path << " (headless)" << std::endl;
+    std::cout << "Results: " << config.output_path << std::endl;
+    std::cout << "========================================" << std::endl;
+
+    int failures = 0;
+    for (size_t i = 0; i < cases.size(); i++)
+    {
+        const BenchCase &bench = cases[i];
+        BenchResult result = runCase(config, bench);
+
+        std::cout << (result.ok ? "✅ " : "❌ ") << std::setw(4) << bench.width << "x"
+                  << std::left << std::setw(5) << bench.height << std::setw(8) << bench.pattern
+                  << std::setw(5) << codecName(bench.codec) << std::right << " q" << std::setw(3) << std::left
+                  << bench.quality << std::right << " t" << bench.threads;
+        if (config.transports.size() > 1 || config.networks.size() > 1)
+            std::cout << " " << bench.transport << "/" << bench.network;
+        if (config.ios.size() > 1)
+            std::cout << " " << bench.io;
+        if (config.repeat > 1)
+            std::cout << " #" << bench.run;
+        if (result.ok)
+        {
+            double seconds = result.seconds > 0 ? result.seconds : 1e-9;
+            std::cout << " | " << std::fixed << std::setprecision(1) << std::setw(7)
+                      << (result.frames / seconds) << " FPS | " << std::setw(8) << std::setprecision(2)
+                      << (result.wire_bytes / (1024.0 * 1024.0) / seconds) << " MB/s | "
+                      << "p50=" << formatMicros((uint64_t)result.latency_us[0])
+                      << " p95=" << formatMicros((uint64_t)result.latency_us[1])
+                      << " p99=" << formatMicros((uint64_t)result.latency_us[2])
+                      << " max=" << formatMicros((uint64_t)result.latency_us[3]);
+            writeRow(out, config, bench, result);
+        }
+        else
+            failures++;
+        std::cout << std::endl;
+    }
+
+    std::cout << "========================================" << std::endl;
+    std::cout << "📄 " << (cases.size() - failures) << " results written to " << config.output_path << std::endl;
+    if (failures > 0)
+        std::cerr << "⚠️  " << failures << " case(s) failed" << std::endl;
+    return failures > 0 ? 1 : 0;
+}
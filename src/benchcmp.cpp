@@ -0,0 +1,334 @@
+/**
+ * BENCHCMP.CPP - PERFORMANCE REGRESSION GATE
+ *
+ * Compares a candidate benchmark CSV against a baseline and exits non-zero
+ * when a metric got significantly worse. Works on the output of both
+ * `benchmark` (bench_results.csv) and `microbench --output`:
+ *
+ *   - Rows are grouped into cases by every column that is not a metric
+ *     (resolution, pattern, codec, threads, kernel, ...); repeated runs of a
+ *     case are summarized by their median.
+ *   - A metric regresses when the median moved in the bad direction by more
+ *     than its threshold AND by more than --noise-factor times the spread
+ *     seen between the repeats of either file (so noisy cases need a larger
+ *     move), AND by more than the absolute floor for latencies.
+ *
+ * Exit status: 0 no regressions, 1 regressions, 2 bad input.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+
+#define DEFAULT_NOISE_FACTOR 3.0     // Regression must exceed this many spreads
+#define DEFAULT_LATENCY_FLOOR_US 100 // Latency moves below this are never flagged
+
+/**
+ * A metric the gate knows how to judge
+ */
+struct MetricRule
+{
+    const char *column;
+    bool higher_is_better;
+    double threshold;  // Relative change that counts as significant
+    bool latency;      // Subject to the absolute latency floor
+};
+
+static const MetricRule METRIC_RULES[] = {
+    {"fps", true, 0.05, false},
+    {"bytes_per_frame", false, 0.01, false},
+    {"sender_cpu_us_per_frame", false, 0.10, false},
+    {"receiver_cpu_us_per_frame", false, 0.10, false},
+    {"latency_p50_us", false, 0.10, true},
+    {"latency_p95_us", false, 0.15, true},
+    {"latency_p99_us", false, 0.20, true},
+    {"latency_max_us", false, 0.50, true},
+    {"ns_per_call", false, 0.05, false},
+};
+static const int METRIC_RULE_COUNT = sizeof(METRIC_RULES) / sizeof(METRIC_RULES[0]);
+
+// Columns that are neither part of the case key nor judged
+static const char *const IGNORED_COLUMNS[] = {
+    "run", "frames", "frames_dropped", "seconds", "wire_mb_s", "cycles_per_pixel", "gb_s"};
+
+/**
+ * All runs of one case: metric column -> values
+ */
+typedef std::map<std::string, std::vector<double> > CaseRuns;
+
+struct ResultFile
+{
+    std::vector<std::string> metrics; // Judged columns present in the file
+    std::vector<std::string> order;   // Case keys in first-seen order
+    std::map<std::string, CaseRuns> cases;
+};
+
+static std::vector<std::string> splitCsv(const std::string &line)
+{
+    std::vector<std::string> fields;
+    std::stringstream stream(line);
+    std::string field;
+    while (std::getline(stream, field, ','))
+        fields.push_back(field);
+    return fields;
+}
+
+static const MetricRule *findRule(const std::string &column)
+{
+    for (int i = 0; i < METRIC_RULE_COUNT; i++)
+    {
+        if (column == METRIC_RULES[i].column)
+            return &METRIC_RULES[i];
+    }
+    return NULL;
+}
+
+static bool ignoredColumn(const std::string &column)
+{
+    for (size_t i = 0; i < sizeof(IGNORED_COLUMNS) / sizeof(IGNORED_COLUMNS[0]); i++)
+    {
+        if (column == IGNORED_COLUMNS[i])
+            return true;
+    }
+    return false;
+}
+
+static bool loadResults(const std::string &path, ResultFile &file)
+{
+    std::ifstream in(path.c_str());
+    std::string line;
+    if (!in || !std::getline(in, line))
+    {
+        std::cerr << "❌ Could not read " << path << std::endl;
+        return false;
+    }
+
+    std::vector<std::string> header = splitCsv(line);
+    for (size_t c = 0; c < header.size(); c++)
+    {
+        if (findRule(header[c]))
+            file.metrics.push_back(header[c]);
+    }
+    if (file.metrics.empty())
+    {
+        std::cerr << "❌ " << path << " has no known metric columns" << std::endl;
+        return false;
+    }
+
+    int line_number = 1;
+    while (std::getline(in, line))
+    {
+        line_number++;
+        if (line.empty())
+            continue;
+        std::vector<std::string> fields = splitCsv(line);
+        if (fields.size() != header.size())
+        {
+            std::cerr << "❌ " << path << ":" << line_number << ": expected " << header.size()
+                      << " fields, got " << fields.size() << std::endl;
+            return false;
+        }
+
+        std::string key;
+        for (size_t c = 0; c < header.size(); c++)
+        {
+            if (!findRule(header[c]) && !ignoredColumn(header[c]))
+                key += (key.empty() ? "" : " ") + header[c] + "=" + fields[c];
+        }
+        if (file.cases.find(key) == file.cases.end())
+            file.order.push_back(key);
+
+        CaseRuns &runs = file.cases[key];
+        for (size_t c = 0; c < header.size(); c++)
+        {
+            if (findRule(header[c]))
+                runs[header[c]].push_back(atof(fields[c].c_str()));
+        }
+    }
+    return true;
+}
+
+static double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+// Relative spread of the repeats: median absolute deviation / median
+static double spread(const std::vector<double> &values)
+{
+    if (values.size() < 2)
+        return 0;
+    double center = median(values);
+    if (center == 0)
+        return 0;
+    std::vector<double> deviations;
+    for (size_t i = 0; i < values.size(); i++)
+        deviations.push_back(std::fabs(values[i] - center));
+    return median(deviations) / std::fabs(center);
+}
+
+static void usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [options] <baseline.csv> <candidate.csv>\n"
+              << "  --noise-factor <x>       regressions must exceed x times the run-to-run spread (default "
+              << DEFAULT_NOISE_FACTOR << ")\n"
+              << "  --threshold <metric=pct> override a metric's threshold, e.g. fps=3 (repeatable)\n"
+              << "  --latency-floor-us <n>   ignore latency changes smaller than this (default "
+              << DEFAULT_LATENCY_FLOOR_US << ")\n"
+              << "  --strict                 also fail when a baseline case is missing\n"
+              << "  --verbose                print every comparison, not only changes\n";
+}
+
+/**
+ * Main function
+ * Loads both files, judges every metric of every common case and prints
+ * the verdicts
+ */
+int main(int argc, char *argv[])
+{
+    double noise_factor = DEFAULT_NOISE_FACTOR;
+    double latency_floor = DEFAULT_LATENCY_FLOOR_US;
+    std::map<std::string, double> thresholds;
+    bool strict = false;
+    bool verbose = false;
+    std::vector<std::string> paths;
+
+    for (int i = 0; i < METRIC_RULE_COUNT; i++)
+        thresholds[METRIC_RULES[i].column] = METRIC_RULES[i].threshold;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--noise-factor" && has_value)
+            noise_factor = atof(argv[++i]);
+        else if (arg == "--latency-floor-us" && has_value)
+            latency_floor = atof(argv[++i]);
+        else if (arg == "--threshold" && has_value)
+        {
+            std::string item = argv[++i];
+            size_t equals = item.find('=');
+            if (equals == std::string::npos || !findRule(item.substr(0, equals)))
+            {
+                std::cerr << "❌ Bad threshold '" << item << "' (metric=percent)" << std::endl;
+                return 2;
+            }
+            thresholds[item.substr(0, equals)] = atof(item.c_str() + equals + 1) / 100.0;
+        }
+        else if (arg == "--strict")
+            strict = true;
+        else if (arg == "--verbose")
+            verbose = true;
+        else if (!arg.empty() && arg[0] != '-')
+            paths.push_back(arg);
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (paths.size() != 2)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    ResultFile baseline, candidate;
+    if (!loadResults(paths[0], baseline) || !loadResults(paths[1], candidate))
+        return 2;
+
+    std::cout << "========================================" << std::endl;
+    std::cout << "⚖️  RGM BENCHMARK COMPARISON" << std::endl;
+    std::cout << "========================================" << std::endl;
+    std::cout << "Baseline:  " << paths[0] << " (" << baseline.cases.size() << " cases)" << std::endl;
+    std::cout << "Candidate: " << paths[1] << " (" << candidate.cases.size() << " cases)" << std::endl;
+    std::cout << "========================================" << std::endl;
+
+    int regressions = 0, improvements = 0, compared = 0, missing = 0;
+    for (size_t k = 0; k < baseline.order.size(); k++)
+    {
+        const std::string &key = baseline.order[k];
+        std::map<std::string, CaseRuns>::const_iterator found = candidate.cases.find(key);
+        if (found == candidate.cases.end())
+        {
+            std::cout << "⚠️  Missing in candidate: " << key << std::endl;
+            missing++;
+            continue;
+        }
+        const CaseRuns &base_runs = baseline.cases.find(key)->second;
+        const CaseRuns &cand_runs = found->second;
+
+        bool printed_key = false;
+        for (size_t m = 0; m < baseline.metrics.size(); m++)
+        {
+            const std::string &metric = baseline.metrics[m];
+            CaseRuns::const_iterator base_values = base_runs.find(metric);
+            CaseRuns::const_iterator cand_values = cand_runs.find(metric);
+            if (base_values == base_runs.end() || cand_values == cand_runs.end())
+                continue;
+
+            const MetricRule *rule = findRule(metric);
+            double base = median(base_values->second);
+            double cand = median(cand_values->second);
+            double noise = std::max(spread(base_values->second), spread(cand_values->second));
+            double limit = std::max(thresholds[metric], noise_factor * noise);
+
+            // Positive = worse, relative to the baseline
+            double worse = base != 0 ? (cand - base) / std::fabs(base) : (cand != base ? 1.0 : 0.0);
+            if (rule->higher_is_better)
+                worse = -worse;
+            bool below_floor = rule->latency && std::fabs(cand - base) < latency_floor;
+
+            const char *verdict = NULL;
+            if (worse > limit && !below_floor)
+            {
+                verdict = "❌ REGRESSION";
+                regressions++;
+            }
+            else if (-worse > limit && !below_floor)
+            {
+                verdict = "✅ improved";
+                improvements++;
+            }
+            compared++;
+
+            if (!verdict && !verbose)
+                continue;
+            if (!printed_key)
+            {
+                std::cout << key << std::endl;
+                printed_key = true;
+            }
+            std::cout << "   " << std::left << std::setw(26) << metric << std::right << std::fixed
+                      << std::setprecision(1) << std::setw(12) << base << " -> " << std::setw(12) << cand
+                      << std::showpos << std::setw(8) << (base != 0 ? (cand - base) / std::fabs(base) * 100 : 0)
+                      << "%" << std::noshowpos << " (limit " << std::setprecision(1) << limit * 100 << "%)  "
+                      << (verdict ? verdict : "ok") << std::endl;
+        }
+    }
+    for (size_t k = 0; k < candidate.order.size(); k++)
+    {
+        if (baseline.cases.find(candidate.order[k]) == baseline.cases.end())
+            std::cout << "ℹ️  New in candidate: " << candidate.order[k] << std::endl;
+    }
+
+    std::cout << "========================================" << std::endl;
+    std::cout << "📊 " << compared << " comparisons: " << regressions << " regression(s), "
+              << improvements << " improvement(s)";
+    if (missing > 0)
+        std::cout << ", " << missing << " missing case(s)";
+    std::cout << std::endl;
+
+    if (regressions > 0 || (strict && missing > 0))
+        return 1;
+    return 0;
+}
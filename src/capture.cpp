@@ -0,0 +1,857 @@
+/**
+ * CAPTURE.CPP - SCREEN AND SYNTHETIC FRAME SOURCES
+ */
+#include "capture.h"
+#include "protocol.h"
+#include "trace.h"
+#include "simd.h"
+#include "corpus.h"
+#include "archive.h"
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#endif
+
+#define SCREEN_CHECK_US 1000000 // How often the X11 source asks for the display size
+
+size_t CaptureSource::frameSize() const
+{
+    return (size_t)frame_width * frame_height * BYTES_PER_PIXEL;
+}
+
+// ============================================================================
+// SCREEN CAPTURE
+// ============================================================================
+
+#ifdef _WIN32
+/**
+ * Windows screen capture through GDI
+ */
+class ScreenCaptureSource : public CaptureSource
+{
+public:
+    bool open()
+    {
+        // Windows: Use GetSystemMetrics for primary monitor
+        frame_width = GetSystemMetrics(SM_CXSCREEN);
+        frame_height = GetSystemMetrics(SM_CYSCREEN);
+        std::cout << "🖥️  Detected Windows display: " << frame_width << "x" << frame_height << std::endl;
+        return frame_width > 0 && frame_height > 0;
+    }
+
+    bool grab(uint8_t *pixels)
+    {
+        // Get device context for the entire screen
+        HDC screen_dc = GetDC(NULL);
+        if (!screen_dc)
+        {
+            std::cerr << "❌ Failed to get screen DC" << std::endl;
+            return false;
+        }
+
+        // Create compatible DC and bitmap
+        HDC mem_dc = CreateCompatibleDC(screen_dc);
+        HBITMAP bitmap = CreateCompatibleBitmap(screen_dc, frame_width, frame_height);
+
+        if (!bitmap)
+        {
+            std::cerr << "❌ Failed to create bitmap" << std::endl;
+            ReleaseDC(NULL, screen_dc);
+            DeleteDC(mem_dc);
+            return false;
+        }
+
+        // Select bitmap into memory DC
+        SelectObject(mem_dc, bitmap);
+
+        // Capture screen with CAPTUREBLT to include layered windows
+        uint64_t capture_start = nowMicros();
+        BitBlt(mem_dc, 0, 0, frame_width, frame_height, screen_dc, 0, 0, SRCCOPY | CAPTUREBLT);
+
+        // Prepare bitmap info structure
+        BITMAPINFOHEADER bi = {0};
+        bi.biSize = sizeof(BITMAPINFOHEADER);
+        bi.biWidth = frame_width;
+        bi.biHeight = -frame_height; // Negative for top-down (no flipping needed)
+        bi.biPlanes = 1;
+        bi.biBitCount = 24; // 24-bit RGB
+        bi.biCompression = BI_RGB;
+
+        // Get the bitmap bits
+        int result = GetDIBits(mem_dc, bitmap, 0, frame_height,
+                               pixels, (BITMAPINFO *)&bi, DIB_RGB_COLORS);
+
+        if (!result)
+        {
+            std::cerr << "❌ Failed to get bitmap bits" << std::endl;
+        }
+        recordSpan(STAGE_CAPTURE, capture_start, nowMicros());
+
+        // Cleanup
+        DeleteObject(bitmap);
+        DeleteDC(mem_dc);
+        ReleaseDC(NULL, screen_dc);
+
+        return result != 0;
+    }
+
+    // The primary monitor's metrics are cheap to read every frame
+    bool resized()
+    {
+        int width = GetSystemMetrics(SM_CXSCREEN);
+        int height = GetSystemMetrics(SM_CYSCREEN);
+        if (width <= 0 || height <= 0 || (width == frame_width && height == frame_height))
+            return false;
+        frame_width = width;
+        frame_height = height;
+        std::cout << "🖥️  Display changed to " << frame_width << "x" << frame_height << std::endl;
+        return true;
+    }
+
+    std::string describe() const { return "screen (GDI)"; }
+};
+#else
+/**
+ * Linux X11 screen capture
+ *
+ * The display connection stays open for the life of the source instead of
+ * being reopened for every frame.
+ */
+class ScreenCaptureSource : public CaptureSource
+{
+public:
+    ScreenCaptureSource() : display(NULL), root(0), last_check_us(0) {}
+
+    ~ScreenCaptureSource()
+    {
+        if (display)
+            XCloseDisplay(display);
+    }
+
+    bool open()
+    {
+        display = XOpenDisplay(NULL);
+        if (!display)
+        {
+            std::cerr << "❌ Failed to open X display" << std::endl;
+            return false;
+        }
+
+        int screen_num = DefaultScreen(display);
+        root = RootWindow(display, screen_num);
+        frame_width = DisplayWidth(display, screen_num);
+        frame_height = DisplayHeight(display, screen_num);
+        std::cout << "🖥️  Detected X11 display: " << frame_width << "x" << frame_height << std::endl;
+        return true;
+    }
+
+    bool grab(uint8_t *pixels)
+    {
+        // Capture the screen
+        uint64_t capture_start = nowMicros();
+        XImage *image = XGetImage(display, root, 0, 0,
+                                  frame_width, frame_height,
+                                  AllPlanes, ZPixmap);
+
+        if (!image)
+        {
+            std::cerr << "❌ Failed to capture screen" << std::endl;
+            return false;
+        }
+
+        uint64_t convert_start = nowMicros();
+        recordSpan(STAGE_CAPTURE, capture_start, convert_start);
+
+#ifndef WORDS_BIGENDIAN
+        // Common case: little-endian 32-bit pixels, whose first three bytes
+        // are already the wire pixel, so rows are packed directly
+        if (image->bits_per_pixel == 32 && image->byte_order == LSBFirst)
+        {
+            for (int y = 0; y < frame_height; y++)
+                packPixels32((const uint8_t *)image->data + (size_t)y * image->bytes_per_line,
+                             pixels + (size_t)y * frame_width * BYTES_PER_PIXEL, frame_width);
+        }
+        else
+#endif
+        {
+            convertPixelwise(image, pixels);
+        }
+
+        recordSpan(STAGE_CONVERT, convert_start, nowMicros());
+
+        XDestroyImage(image);
+        return true;
+    }
+
+    // The root window follows xrandr; asking costs a round trip, so only every SCREEN_CHECK_US
+    bool resized()
+    {
+        uint64_t now_us = nowMicros();
+        if (now_us - last_check_us < SCREEN_CHECK_US)
+            return false;
+        last_check_us = now_us;
+
+        XWindowAttributes attributes;
+        if (!XGetWindowAttributes(display, root, &attributes) ||
+            (attributes.width == frame_width && attributes.height == frame_height))
+            return false;
+        frame_width = attributes.width;
+        frame_height = attributes.height;
+        std::cout << "🖥️  Display changed to " << frame_width << "x" << frame_height << std::endl;
+        return true;
+    }
+
+    std::string describe() const { return "screen (X11)"; }
+
+private:
+    /**
+     * Any other visual: go through XGetPixel
+     */
+    void convertPixelwise(XImage *image, uint8_t *pixels)
+    {
+        for (int y = 0; y < frame_height; y++)
+        {
+            for (int x = 0; x < frame_width; x++)
+            {
+                unsigned long pixel = XGetPixel(image, x, y);
+                size_t index = ((size_t)y * frame_width + x) * BYTES_PER_PIXEL;
+
+                // Convert from X11 format (depends on endianness)
+#ifdef WORDS_BIGENDIAN
+                pixels[index + 0] = (pixel >> 16) & 0xFF; // Red
+                pixels[index + 1] = (pixel >> 8) & 0xFF;  // Green
+                pixels[index + 2] = pixel & 0xFF;         // Blue
+#else
+                pixels[index + 0] = pixel & 0xFF;         // Blue
+                pixels[index + 1] = (pixel >> 8) & 0xFF;  // Green
+                pixels[index + 2] = (pixel >> 16) & 0xFF; // Red
+#endif
+            }
+        }
+    }
+
+    Display *display;
+    Window root;
+    uint64_t last_check_us;
+};
+#endif
+
+// ============================================================================
+// SYNTHETIC PATTERNS
+// ============================================================================
+
+#define GLYPH_CELL_W 8     // Character cell size in pixels
+#define GLYPH_CELL_H 14
+#define GLYPH_W 6          // Inked area inside a cell
+#define GLYPH_H 9
+#define SCROLL_PIXELS 4    // Scroll speed for the scroll pattern (pixels per frame)
+#define SCROLL_PAGES 4     // Scroll canvas height in screens before it wraps
+#define WINDOW_SPEED_X 7   // Moving window velocity (pixels per frame)
+#define WINDOW_SPEED_Y 5
+#define CURSOR_BLINK 30    // Typing cursor blink period in frames
+
+/**
+ * splitmix64 - cheap, well-mixed hash used for every "random" choice, so
+ * patterns are identical across runs and machines
+ */
+static uint64_t mix64(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+/**
+ * Simple RGB canvas with the drawing primitives the patterns need
+ */
+struct Canvas
+{
+    int width;
+    int height;
+    std::vector<uint8_t> pixels;
+
+    void resize(int w, int h)
+    {
+        width = w;
+        height = h;
+        pixels.assign((size_t)w * h * BYTES_PER_PIXEL, 0);
+    }
+
+    void fillRect(int x, int y, int w, int h, uint32_t rgb)
+    {
+        int x0 = x < 0 ? 0 : x, y0 = y < 0 ? 0 : y;
+        int x1 = x + w > width ? width : x + w;
+        int y1 = y + h > height ? height : y + h;
+        for (int row = y0; row < y1; row++)
+        {
+            uint8_t *p = &pixels[((size_t)row * width + x0) * BYTES_PER_PIXEL];
+            for (int col = x0; col < x1; col++, p += BYTES_PER_PIXEL)
+            {
+                p[0] = rgb >> 16;
+                p[1] = rgb >> 8;
+                p[2] = rgb;
+            }
+        }
+    }
+
+    /**
+     * Procedural "character": a 6x9 bit pattern derived from the code. Code
+     * 0 is a space. Good enough to give codecs text-like edges.
+     */
+    void drawGlyph(int x, int y, uint32_t code, uint32_t rgb)
+    {
+        if (code == 0)
+            return;
+        uint64_t bits = mix64(code);
+        for (int gy = 0; gy < GLYPH_H; gy++)
+        {
+            for (int gx = 0; gx < GLYPH_W; gx++)
+            {
+                if (bits & (1ULL << (gy * GLYPH_W + gx)))
+                    fillRect(x + 1 + gx, y + 2 + gy, 1, 1, rgb);
+            }
+        }
+    }
+
+    // Lines of pseudo-words; `seed` picks the text
+    void drawText(int x, int y, int w, int h, uint64_t seed, uint32_t rgb)
+    {
+        int columns = w / GLYPH_CELL_W;
+        int lines = h / GLYPH_CELL_H;
+        for (int line = 0; line < lines; line++)
+        {
+            uint64_t line_hash = mix64(seed * 1000003 + line);
+            int length = (int)(line_hash % (columns + 1));
+            for (int col = 0; col < length; col++)
+            {
+                uint64_t h = mix64(line_hash + col);
+                uint32_t code = (h % 6 == 0) ? 0 : (uint32_t)(1 + h % 64);
+                drawGlyph(x + col * GLYPH_CELL_W, y + line * GLYPH_CELL_H, code, rgb);
+            }
+        }
+    }
+
+    // Application window: title bar, border and a text body
+    void drawWindow(int x, int y, int w, int h, uint64_t seed)
+    {
+        fillRect(x, y, w, h, 0x505860);
+        fillRect(x + 1, y + 1, w - 2, 22, 0x2B5797);
+        drawText(x + 8, y + 4, w / 2, GLYPH_CELL_H, seed + 1, 0xFFFFFF);
+        fillRect(x + 1, y + 23, w - 2, h - 24, 0xFAFAFA);
+        drawText(x + 8, y + 28, w - 16, h - 32, seed, 0x202020);
+    }
+};
+
+/**
+ * Deterministic test pattern generator
+ *
+ *   static  - desktop with a text window, identical every frame
+ *   scroll  - full-screen text page scrolling up SCROLL_PIXELS per frame
+ *   window  - a window bouncing across a static desktop
+ *   noise   - new random pixels every frame (worst case for any codec)
+ *   typing  - one character typed per frame plus a blinking cursor
+ *   video   - a text window beside a window playing grainy video
+ */
+class SyntheticSource : public CaptureSource
+{
+public:
+    enum Pattern
+    {
+        PATTERN_STATIC,
+        PATTERN_SCROLL,
+        PATTERN_WINDOW,
+        PATTERN_NOISE,
+        PATTERN_TYPING,
+        PATTERN_VIDEO
+    };
+
+    SyntheticSource(Pattern pattern, const std::string &name, int width, int height)
+        : pattern(pattern), pattern_name(name), frame_number(0), noise_state(0x2545F4914F6CDD1DULL),
+          window_x(width / 8), window_y(height / 8), window_dx(WINDOW_SPEED_X), window_dy(WINDOW_SPEED_Y),
+          cursor_col(0), cursor_line(0)
+    {
+        frame_width = width;
+        frame_height = height;
+        prepare();
+    }
+
+    bool grab(uint8_t *pixels)
+    {
+        uint64_t capture_start = nowMicros();
+        switch (pattern)
+        {
+        case PATTERN_STATIC:
+            memcpy(pixels, background.pixels.data(), frameSize());
+            break;
+        case PATTERN_SCROLL:
+            grabScroll(pixels);
+            break;
+        case PATTERN_WINDOW:
+            grabWindow(pixels);
+            break;
+        case PATTERN_NOISE:
+            grabNoise(pixels);
+            break;
+        case PATTERN_TYPING:
+            grabTyping(pixels);
+            break;
+        case PATTERN_VIDEO:
+            grabVideo(pixels);
+            break;
+        }
+        frame_number++;
+        recordSpan(STAGE_CAPTURE, capture_start, nowMicros());
+        return true;
+    }
+
+    // Render the pattern at the new size, as if the display had been reconfigured
+    bool resize(int width, int height)
+    {
+        if (width < 64 || height < 64)
+            return false;
+        frame_width = width;
+        frame_height = height;
+        window_x = width / 8;
+        window_y = height / 8;
+        cursor_col = cursor_line = 0;
+        prepare();
+        return true;
+    }
+
+    std::string describe() const { return "synthetic:" + pattern_name; }
+
+private:
+    void drawDesktop(Canvas &canvas)
+    {
+        // Vertical gradient wallpaper, taskbar and a column of icons
+        for (int y = 0; y < canvas.height; y++)
+        {
+            uint32_t shade = 0x30 + (0x50 * y) / canvas.height;
+            canvas.fillRect(0, y, canvas.width, 1, (0x10 << 16) | (shade << 8) | (shade + 0x20));
+        }
+        canvas.fillRect(0, canvas.height - 40, canvas.width, 40, 0x202428);
+        for (int i = 0; i < 6; i++)
+        {
+            uint32_t color = (uint32_t)mix64(i) & 0xFFFFFF;
+            canvas.fillRect(24, 24 + i * 80, 48, 48, color);
+            canvas.drawText(16, 76 + i * 80, 64, GLYPH_CELL_H, 100 + i, 0xFFFFFF);
+        }
+    }
+
+    void prepare()
+    {
+        switch (pattern)
+        {
+        case PATTERN_STATIC:
+            background.resize(frame_width, frame_height);
+            drawDesktop(background);
+            background.drawWindow(frame_width / 6, frame_height / 8,
+                                  frame_width * 2 / 3, frame_height * 2 / 3, 1);
+            break;
+
+        case PATTERN_SCROLL:
+            // Tall text page rendered once, displayed through a moving viewport
+            background.resize(frame_width, frame_height * SCROLL_PAGES);
+            background.fillRect(0, 0, background.width, background.height, 0xFFFFFF);
+            background.drawText(16, 0, frame_width - 32, background.height, 7, 0x101010);
+            break;
+
+        case PATTERN_WINDOW:
+            background.resize(frame_width, frame_height);
+            drawDesktop(background);
+            overlay.resize(frame_width / 3, frame_height / 3);
+            overlay.drawWindow(0, 0, overlay.width, overlay.height, 3);
+            break;
+
+        case PATTERN_NOISE:
+            break;
+
+        case PATTERN_TYPING:
+            background.resize(frame_width, frame_height);
+            background.fillRect(0, 0, frame_width, frame_height, 0xFFFFFF);
+            break;
+
+        case PATTERN_VIDEO:
+            background.resize(frame_width, frame_height);
+            drawDesktop(background);
+            background.drawWindow(frame_width / 8, frame_height / 8, frame_width * 3 / 8, frame_height * 2 / 3, 5);
+            background.drawWindow(frame_width / 2, frame_height / 8, frame_width * 3 / 8, frame_height / 2, 6);
+            break;
+        }
+    }
+
+    void grabScroll(uint8_t *pixels)
+    {
+        size_t row_bytes = (size_t)frame_width * BYTES_PER_PIXEL;
+        int top = (int)((frame_number * SCROLL_PIXELS) % background.height);
+        int first_rows = background.height - top < frame_height ? background.height - top : frame_height;
+
+        memcpy(pixels, &background.pixels[top * row_bytes], first_rows * row_bytes);
+        if (first_rows < frame_height)
+            memcpy(pixels + first_rows * row_bytes, background.pixels.data(),
+                   (frame_height - first_rows) * row_bytes);
+    }
+
+    void grabWindow(uint8_t *pixels)
+    {
+        memcpy(pixels, background.pixels.data(), frameSize());
+
+        // Bounce off the edges
+        window_x += window_dx;
+        window_y += window_dy;
+        if (window_x < 0 || window_x + overlay.width > frame_width)
+        {
+            window_dx = -window_dx;
+            window_x += 2 * window_dx;
+        }
+        if (window_y < 0 || window_y + overlay.height > frame_height)
+        {
+            window_dy = -window_dy;
+            window_y += 2 * window_dy;
+        }
+
+        size_t overlay_row = (size_t)overlay.width * BYTES_PER_PIXEL;
+        for (int y = 0; y < overlay.height; y++)
+        {
+            memcpy(pixels + ((size_t)(window_y + y) * frame_width + window_x) * BYTES_PER_PIXEL,
+                   &overlay.pixels[y * overlay_row], overlay_row);
+        }
+    }
+
+    void grabNoise(uint8_t *pixels)
+    {
+        // xorshift64, eight bytes per step
+        size_t size = frameSize();
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8)
+        {
+            noise_state ^= noise_state << 13;
+            noise_state ^= noise_state >> 7;
+            noise_state ^= noise_state << 17;
+            memcpy(pixels + i, &noise_state, 8);
+        }
+        for (; i < size; i++)
+            pixels[i] = (uint8_t)(noise_state >> (i % 8 * 8));
+    }
+
+    /**
+     * Drifting colour waves with film grain in the second window's body:
+     * every pixel changes every frame, neighbours differ, nothing repeats.
+     * Triangle waves rather than sin() keep it integer, so exact everywhere.
+     */
+    void grabVideo(uint8_t *pixels)
+    {
+        memcpy(pixels, background.pixels.data(), frameSize());
+
+        int x0 = frame_width / 2 + 1, y0 = frame_height / 8 + 23;
+        int w = frame_width * 3 / 8 - 2, h = frame_height / 2 - 24;
+        int t = (int)frame_number;
+        for (int y = 0; y < h; y++)
+        {
+            uint8_t *p = pixels + ((size_t)(y0 + y) * frame_width + x0) * BYTES_PER_PIXEL;
+            for (int x = 0; x < w; x++, p += BYTES_PER_PIXEL)
+            {
+                noise_state ^= noise_state << 13;
+                noise_state ^= noise_state >> 7;
+                noise_state ^= noise_state << 17;
+                int grain = (int)(noise_state & 15) - 8;
+                int r = triangle(x + t * 3) / 2 + triangle(y * 2 - t) / 2 + grain;
+                int g = triangle(x - y + t * 2) / 2 + triangle(y + t) / 3 + grain;
+                int b = triangle(x * 2 + y - t * 4) / 3 + 60 + grain;
+                p[0] = (uint8_t)(r < 0 ? 0 : r > 255 ? 255 : r);
+                p[1] = (uint8_t)(g < 0 ? 0 : g > 255 ? 255 : g);
+                p[2] = (uint8_t)(b < 0 ? 0 : b > 255 ? 255 : b);
+            }
+        }
+    }
+
+    // 0..255..0 over 512 steps
+    static int triangle(int phase)
+    {
+        phase &= 511;
+        return phase < 256 ? phase : 511 - phase;
+    }
+
+    void grabTyping(uint8_t *pixels)
+    {
+        int columns = (frame_width - 32) / GLYPH_CELL_W;
+        int lines = (frame_height - 32) / GLYPH_CELL_H;
+        if (columns < 1 || lines < 1)
+        {
+            memcpy(pixels, background.pixels.data(), frameSize());
+            return;
+        }
+
+        // Type one character; words end with a space, lines wrap, pages clear
+        uint64_t h = mix64(frame_number);
+        uint32_t code = (h % 6 == 0) ? 0 : (uint32_t)(1 + h % 64);
+        background.drawGlyph(16 + cursor_col * GLYPH_CELL_W, 16 + cursor_line * GLYPH_CELL_H, code, 0x101010);
+        if (++cursor_col >= columns || h % 97 == 0)
+        {
+            cursor_col = 0;
+            if (++cursor_line >= lines)
+            {
+                cursor_line = 0;
+                background.fillRect(0, 0, frame_width, frame_height, 0xFFFFFF);
+            }
+        }
+
+        memcpy(pixels, background.pixels.data(), frameSize());
+
+        // Cursor goes on the output only, the page keeps the typed text
+        if ((frame_number / CURSOR_BLINK) % 2 == 0)
+        {
+            int x = 16 + cursor_col * GLYPH_CELL_W;
+            int y = 16 + cursor_line * GLYPH_CELL_H;
+            for (int row = y + 2; row < y + GLYPH_CELL_H && row < frame_height; row++)
+            {
+                for (int col = x; col < x + 2 && col < frame_width; col++)
+                {
+                    uint8_t *p = pixels + ((size_t)row * frame_width + col) * BYTES_PER_PIXEL;
+                    p[0] = p[1] = p[2] = 0x10;
+                }
+            }
+        }
+    }
+
+    Pattern pattern;
+    std::string pattern_name;
+    uint64_t frame_number;
+    uint64_t noise_state;
+    Canvas background;
+    Canvas overlay;
+    int window_x, window_y, window_dx, window_dy;
+    int cursor_col, cursor_line;
+};
+
+// ============================================================================
+// REPLAY
+// ============================================================================
+
+/**
+ * Frames of a recorded corpus (see corpus.h), looping at the end. Paced by
+ * the recorded capture times, or as fast as the pipeline takes them.
+ */
+class ReplaySource : public CaptureSource
+{
+public:
+    explicit ReplaySource(bool paced) : paced(paced), loops(0), start_us(0) {}
+
+    bool open(const std::string &path)
+    {
+        corpus_path = path;
+        if (!reader.open(path))
+            return false;
+        frame_width = reader.width();
+        frame_height = reader.height();
+        picture.assign(frameSize(), 0);
+        return true;
+    }
+
+    bool grab(uint8_t *pixels)
+    {
+        uint64_t time_us = 0;
+        uint64_t capture_start = nowMicros();
+        if (!reader.next(picture.data(), time_us))
+        {
+            if (reader.failed() || !reader.rewind() || !reader.next(picture.data(), time_us))
+            {
+                std::cerr << "❌ Corpus " << corpus_path << " is damaged" << std::endl;
+                return false;
+            }
+            loops++;
+            start_us = 0;
+        }
+        memcpy(pixels, picture.data(), frameSize());
+        recordSpan(STAGE_CAPTURE, capture_start, nowMicros());
+
+        // Hold the frame back until its original time since the first frame
+        if (paced)
+        {
+            uint64_t now = nowMicros();
+            if (start_us == 0)
+                start_us = now - time_us;
+            else if (start_us + time_us > now)
+                std::this_thread::sleep_for(std::chrono::microseconds(start_us + time_us - now));
+        }
+        return true;
+    }
+
+    std::string describe() const
+    {
+        return (paced ? "replay:" : "replay-max:") + corpus_path +
+               (loops ? " (loop " + std::to_string(loops + 1) + ")" : "");
+    }
+
+private:
+    CorpusReader reader;
+    std::string corpus_path;
+    std::vector<uint8_t> picture;
+    bool paced;
+    uint64_t loops;
+    uint64_t start_us;
+};
+
+/**
+ * Frames of a receiver session archive (see archive.h), starting at any
+ * time in the session and paced by the recorded capture times
+ */
+class ArchiveSource : public CaptureSource
+{
+public:
+    ArchiveSource() : position(0), loops(0), start_us(0) {}
+
+    bool open(const std::string &dir, double start_seconds)
+    {
+        archive_dir = dir;
+        if (!archive.open(dir))
+            return false;
+        frame_width = archive.width();
+        frame_height = archive.height();
+        picture.assign(frameSize(), 0);
+        decoder.reset(new FrameDecoder(archive.codec(), frame_width, frame_height, 1));
+
+        // Jump to the keyframe before the start time and decode up to it
+        uint64_t start = (uint64_t)(start_seconds * 1000000);
+        position = archive.seek(start);
+        size_t target = archive.seekTarget(start);
+        size_t skipped = target - position;
+        while (position < target)
+        {
+            if (!decodeNext())
+                return false;
+        }
+        if (start > 0)
+            std::cout << "⏩ Starting at " << start_seconds << "s: keyframe " << skipped
+                      << " frame(s) earlier" << std::endl;
+        return true;
+    }
+
+    bool grab(uint8_t *pixels)
+    {
+        uint64_t capture_start = nowMicros();
+        if (position >= archive.count())
+        {
+            position = 0;
+            loops++;
+            start_us = 0;
+        }
+        uint64_t time_us = archive.entry(position).time_us;
+        if (!decodeNext())
+            return false;
+        memcpy(pixels, picture.data(), frameSize());
+        recordSpan(STAGE_CAPTURE, capture_start, nowMicros());
+
+        uint64_t now = nowMicros();
+        if (start_us == 0)
+            start_us = now - time_us;
+        else if (start_us + time_us > now)
+            std::this_thread::sleep_for(std::chrono::microseconds(start_us + time_us - now));
+        return true;
+    }
+
+    std::string describe() const
+    {
+        return "archive:" + archive_dir + (loops ? " (loop " + std::to_string(loops + 1) + ")" : "");
+    }
+
+private:
+    bool decodeNext()
+    {
+        ArchiveEntry entry = archive.entry(position);
+        const uint8_t *data = archive.payload(entry);
+        if (!data || !decoder->decode(data, entry.length, (entry.flags & FRAME_FLAG_KEYFRAME) != 0, picture.data()))
+        {
+            std::cerr << "❌ Archive " << archive_dir << " is damaged at frame " << entry.frame_id << std::endl;
+            return false;
+        }
+        position++;
+        return true;
+    }
+
+    ArchiveReader archive;
+    std::string archive_dir;
+    std::unique_ptr<FrameDecoder> decoder;
+    std::vector<uint8_t> picture;
+    size_t position;
+    uint64_t loops;
+    uint64_t start_us;
+};
+
+std::unique_ptr<CaptureSource> createCaptureSource(const std::string &spec, int width, int height)
+{
+    if (spec == "screen")
+    {
+        ScreenCaptureSource *screen = new ScreenCaptureSource();
+        std::unique_ptr<CaptureSource> source(screen);
+        if (!screen->open())
+        {
+            std::cerr << "   Use --source synthetic:<pattern> on machines without a display." << std::endl;
+            return std::unique_ptr<CaptureSource>();
+        }
+        return source;
+    }
+
+    const std::string prefix = "synthetic:";
+    if (spec.compare(0, prefix.size(), prefix) == 0)
+    {
+        std::string name = spec.substr(prefix.size());
+        static const char *names[] = {"static", "scroll", "window", "noise", "typing", "video"};
+        for (int i = 0; i < 6; i++)
+        {
+            if (name == names[i])
+            {
+                if (width < 64 || height < 64)
+                {
+                    std::cerr << "❌ Synthetic resolution must be at least 64x64" << std::endl;
+                    return std::unique_ptr<CaptureSource>();
+                }
+                return std::unique_ptr<CaptureSource>(
+                    new SyntheticSource((SyntheticSource::Pattern)i, name, width, height));
+            }
+        }
+        std::cerr << "❌ Unknown synthetic pattern '" << name
+                  << "' (static, scroll, window, noise, typing, video)" << std::endl;
+        return std::unique_ptr<CaptureSource>();
+    }
+
+    bool max_speed = spec.compare(0, 11, "replay-max:") == 0;
+    if (max_speed || spec.compare(0, 7, "replay:") == 0)
+    {
+        ReplaySource *replay = new ReplaySource(!max_speed);
+        std::unique_ptr<CaptureSource> source(replay);
+        if (!replay->open(spec.substr(spec.find(':') + 1)))
+            return std::unique_ptr<CaptureSource>();
+        return source;
+    }
+
+    if (spec.compare(0, 8, "archive:") == 0)
+    {
+        std::string dir = spec.substr(8);
+        double start_seconds = 0;
+        size_t at = dir.rfind('@');
+        if (at != std::string::npos)
+        {
+            start_seconds = atof(dir.c_str() + at + 1);
+            dir = dir.substr(0, at);
+        }
+        ArchiveSource *archive = new ArchiveSource();
+        std::unique_ptr<CaptureSource> source(archive);
+        if (!archive->open(dir, start_seconds))
+            return std::unique_ptr<CaptureSource>();
+        return source;
+    }
+
+    std::cerr << "❌ Unknown capture source '" << spec << "'" << std::endl;
+    return std::unique_ptr<CaptureSource>();
+}
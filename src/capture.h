@@ -0,0 +1,66 @@
+/**
+ * CAPTURE.H - FRAME SOURCES FOR THE SENDER
+ *
+ * A CaptureSource produces packed RGB frames (BYTES_PER_PIXEL per pixel, no
+ * row padding). The screen source grabs the desktop through X11 or GDI; the
+ * synthetic source renders deterministic test patterns so the pipeline can
+ * be benchmarked on machines without a display, and the replay source plays
+ * back a recorded real session.
+ */
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <memory>
+
+class CaptureSource
+{
+public:
+    CaptureSource() : frame_width(0), frame_height(0) {}
+    virtual ~CaptureSource() {}
+
+    int width() const { return frame_width; }
+    int height() const { return frame_height; }
+    size_t frameSize() const;
+
+    // Write the next frame (frameSize() bytes) into `pixels`
+    virtual bool grab(uint8_t *pixels) = 0;
+
+    /**
+     * Called before every grab(): true when the display changed size
+     * (xrandr, monitor hotplug), width() and height() then give the new one
+     */
+    virtual bool resized() { return false; }
+
+    // Produce width x height frames from the next grab() on; false if the source cannot
+    virtual bool resize(int width, int height)
+    {
+        (void)width;
+        (void)height;
+        return false;
+    }
+
+    virtual std::string describe() const = 0;
+
+protected:
+    int frame_width;
+    int frame_height;
+};
+
+/**
+ * Create a source from a command line spec:
+ *   "screen"               - the local display (width/height are detected)
+ *   "synthetic:<pattern>"  - static, scroll, window, noise, typing or video,
+ *                            rendered at width x height
+ *   "replay:<file>"        - a recorded corpus (sender --record), paced by
+ *                            the recorded capture times; size from the file
+ *   "replay-max:<file>"    - the same, as fast as frames are taken
+ *   "archive:<dir>[@sec]"  - a receiver session archive (receiver --archive),
+ *                            from `sec` seconds into the session
+ * Returns nullptr (after printing why) when the spec cannot be opened.
+ */
+std::unique_ptr<CaptureSource> createCaptureSource(const std::string &spec, int width, int height);
+
+#endif
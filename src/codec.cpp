@@ -0,0 +1,1193 @@
+/**
+ * CODEC.CPP - RAW AND TILE-DELTA FRAME CODECS
+ */
+#include "codec.h"
+#include "protocol.h"
+#include <cstring>
+#include <atomic>
+#include <algorithm>
+
+#define HASH_PRIME 0x9E3779B97F4A7C15ULL // 2^64 / golden ratio
+#define RLE_MAX_LITERAL 128              // Pixels per literal chunk
+#define RLE_MAX_RUN 129                  // Pixels per repeat chunk
+#define MOTION_MIN_TILES 4               // Changed tiles before a frame is searched for motion
+#define MOTION_ANCHORS 256               // Most tiles row segments are taken from
+#define MOTION_ROW_STEP 4                // Previous frame rows scanned: one in this many
+#define MOTION_MIN_VOTES 3               // Matches an offset needs to be tried
+#define MOTION_HITS 65536                // Matches counted per worker (repetitive content)
+#define MOTION_FILTER_BITS 18            // Anchor bit set size, log2
+#define LOSSY_REFINE_FRAMES 30           // Frames a lossy tile stays unchanged before it is resent losslessly
+
+static const char *CODEC_NAMES[CODEC_COUNT] = {"raw", "tile"};
+
+const char *codecName(int codec)
+{
+    return codec >= 0 && codec < CODEC_COUNT ? CODEC_NAMES[codec] : "unknown";
+}
+
+int codecFromName(const std::string &name)
+{
+    for (int i = 0; i < CODEC_COUNT; i++)
+    {
+        if (name == CODEC_NAMES[i])
+            return i;
+    }
+    return -1;
+}
+
+size_t maxEncodedSize(int codec, int width, int height)
+{
+    size_t frame_size = (size_t)width * height * BYTES_PER_PIXEL;
+    if (codec != CODEC_TILE)
+        return frame_size;
+    // Tiles that do not shrink under RLE are stored raw; a reference or copy
+    // body (8 bytes) can be larger than the pixels of a thin edge tile
+    TileGrid grid(width, height);
+    size_t total = 4;
+    for (int index = 0; index < grid.count(); index++)
+    {
+        int x, y, w, h;
+        grid.rect(index, x, y, w, h);
+        total += TILE_RECORD_HEADER + std::max((size_t)w * h * BYTES_PER_PIXEL, (size_t)8);
+    }
+    return total;
+}
+
+// ============================================================================
+// WORKER POOL
+// ============================================================================
+
+WorkerPool::WorkerPool(int count)
+    : thread_count(count < 1 ? 1 : count), current_job(NULL), generation(0),
+      pending(0), stopping(false)
+{
+    for (int i = 1; i < thread_count; i++)
+        threads.push_back(std::thread(&WorkerPool::workerLoop, this, i));
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    start_cv.notify_all();
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+}
+
+/**
+ * Run `job` on every worker and return once all of them finished
+ */
+void WorkerPool::run(const std::function<void(int)> &job)
+{
+    if (thread_count == 1)
+    {
+        job(0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current_job = &job;
+        pending = thread_count - 1;
+        generation++;
+    }
+    start_cv.notify_all();
+
+    job(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [this] { return pending == 0; });
+}
+
+void WorkerPool::workerLoop(int index)
+{
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        start_cv.wait(lock, [&] { return stopping || generation != seen; });
+        if (stopping)
+            return;
+        seen = generation;
+        const std::function<void(int)> *job = current_job;
+
+        lock.unlock();
+        (*job)(index);
+        lock.lock();
+
+        if (--pending == 0)
+            done_cv.notify_one();
+    }
+}
+
+// ============================================================================
+// TILE KERNELS
+// ============================================================================
+
+TileGrid::TileGrid(int w, int h)
+    : width(w), height(h),
+      columns((w + TILE_SIZE - 1) / TILE_SIZE),
+      rows((h + TILE_SIZE - 1) / TILE_SIZE)
+{
+}
+
+void TileGrid::rect(int index, int &x, int &y, int &w, int &h) const
+{
+    x = (index % columns) * TILE_SIZE;
+    y = (index / columns) * TILE_SIZE;
+    w = width - x < TILE_SIZE ? width - x : TILE_SIZE;
+    h = height - y < TILE_SIZE ? height - y : TILE_SIZE;
+}
+
+static inline uint64_t load64(const uint8_t *p)
+{
+    uint64_t value;
+    memcpy(&value, p, 8);
+    return value;
+}
+
+static inline uint64_t mixWord(uint64_t h, uint64_t word)
+{
+    h = (h ^ word) * HASH_PRIME;
+    return h ^ (h >> 32);
+}
+
+/**
+ * 64-bit content hash of a tile
+ *
+ * Four independent multiply lanes keep the multiplier busy; the row index
+ * is folded in so identical rows at different heights do not cancel.
+ */
+uint64_t hashTile(const uint8_t *frame, size_t stride, int w, int h)
+{
+    size_t row_bytes = (size_t)w * BYTES_PER_PIXEL;
+    uint64_t a = 0x243F6A8885A308D3ULL;
+    uint64_t b = 0x13198A2E03707344ULL;
+    uint64_t c = 0xA4093822299F31D0ULL;
+    uint64_t d = 0x082EFA98EC4E6C89ULL;
+
+    for (int y = 0; y < h; y++)
+    {
+        const uint8_t *row = frame + (size_t)y * stride;
+        size_t i = 0;
+        for (; i + 32 <= row_bytes; i += 32)
+        {
+            a = mixWord(a, load64(row + i));
+            b = mixWord(b, load64(row + i + 8));
+            c = mixWord(c, load64(row + i + 16));
+            d = mixWord(d, load64(row + i + 24));
+        }
+        for (; i + 8 <= row_bytes; i += 8)
+            a = mixWord(a, load64(row + i));
+
+        uint64_t tail = 0;
+        memcpy(&tail, row + i, row_bytes - i);
+        d = mixWord(d, tail ^ ((uint64_t)y << 48));
+    }
+
+    uint64_t hash = mixWord(mixWord(mixWord(a, b), c), d);
+    return mixWord(hash, ((uint64_t)w << 32) | (uint32_t)h);
+}
+
+size_t rleBound(size_t count)
+{
+    return count * BYTES_PER_PIXEL + count / RLE_MAX_LITERAL + 1;
+}
+
+static inline bool samePixel(const uint8_t *a, const uint8_t *b)
+{
+    return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+}
+
+size_t rleEncode(const uint8_t *pixels, size_t count, uint8_t *out)
+{
+    uint8_t *start = out;
+    size_t literal_start = 0;
+    size_t i = 0;
+
+    while (i < count)
+    {
+        const uint8_t *pixel = pixels + i * BYTES_PER_PIXEL;
+        size_t run = 1;
+        while (i + run < count && run < RLE_MAX_RUN &&
+               samePixel(pixel, pixel + run * BYTES_PER_PIXEL))
+            run++;
+
+        if (run >= 2)
+        {
+            size_t literal = i - literal_start;
+            if (literal > 0)
+            {
+                *out++ = (uint8_t)(literal - 1);
+                memcpy(out, pixels + literal_start * BYTES_PER_PIXEL, literal * BYTES_PER_PIXEL);
+                out += literal * BYTES_PER_PIXEL;
+            }
+            *out++ = (uint8_t)(run + 126);
+            memcpy(out, pixel, BYTES_PER_PIXEL);
+            out += BYTES_PER_PIXEL;
+            i += run;
+            literal_start = i;
+        }
+        else
+        {
+            i++;
+            if (i - literal_start == RLE_MAX_LITERAL)
+            {
+                *out++ = RLE_MAX_LITERAL - 1;
+                memcpy(out, pixels + literal_start * BYTES_PER_PIXEL, RLE_MAX_LITERAL * BYTES_PER_PIXEL);
+                out += RLE_MAX_LITERAL * BYTES_PER_PIXEL;
+                literal_start = i;
+            }
+        }
+    }
+
+    size_t literal = count - literal_start;
+    if (literal > 0)
+    {
+        *out++ = (uint8_t)(literal - 1);
+        memcpy(out, pixels + literal_start * BYTES_PER_PIXEL, literal * BYTES_PER_PIXEL);
+        out += literal * BYTES_PER_PIXEL;
+    }
+    return out - start;
+}
+
+bool rleDecode(const uint8_t *in, size_t size, uint8_t *pixels, size_t count)
+{
+    const uint8_t *end = in + size;
+    size_t done = 0;
+
+    while (in < end)
+    {
+        uint8_t control = *in++;
+        if (control < 128)
+        {
+            size_t literal = control + 1;
+            size_t bytes = literal * BYTES_PER_PIXEL;
+            if (done + literal > count || (size_t)(end - in) < bytes)
+                return false;
+            memcpy(pixels + done * BYTES_PER_PIXEL, in, bytes);
+            in += bytes;
+            done += literal;
+        }
+        else
+        {
+            size_t run = control - 126;
+            if (done + run > count || end - in < BYTES_PER_PIXEL)
+                return false;
+            uint8_t *out = pixels + done * BYTES_PER_PIXEL;
+            for (size_t i = 0; i < run; i++, out += BYTES_PER_PIXEL)
+                memcpy(out, in, BYTES_PER_PIXEL);
+            in += BYTES_PER_PIXEL;
+            done += run;
+        }
+    }
+    return done == count;
+}
+
+// ============================================================================
+// TILE CACHE
+// ============================================================================
+
+void TileCache::reset(size_t tiles, bool with_pixels)
+{
+    capacity = tiles;
+    keep_pixels = with_pixels;
+    clear();
+    pixels.clear();
+    pixels.shrink_to_fit();
+    entries.reserve(tiles);
+}
+
+void TileCache::clear()
+{
+    order.clear();
+    entries.clear();
+}
+
+bool TileCache::touch(uint64_t hash)
+{
+    std::unordered_map<uint64_t, Entry>::iterator found = entries.find(hash);
+    if (found == entries.end())
+        return false;
+    order.splice(order.begin(), order, found->second.position);
+    return true;
+}
+
+void TileCache::insert(uint64_t hash, const uint8_t *origin, size_t stride, int w, int h)
+{
+    if (capacity == 0 || touch(hash))
+        return;
+
+    // A full cache hands the least recently used tile's slot on
+    size_t slot = entries.size();
+    if (slot == capacity)
+    {
+        std::unordered_map<uint64_t, Entry>::iterator oldest = entries.find(order.back());
+        slot = oldest->second.slot;
+        entries.erase(oldest);
+        order.pop_back();
+    }
+    order.push_front(hash);
+    Entry entry = {order.begin(), slot, w, h};
+    entries[hash] = entry;
+
+    if (!keep_pixels || !origin)
+        return;
+    if (pixels.size() < (slot + 1) * TILE_BYTES)
+        pixels.resize((slot + 1) * TILE_BYTES);
+    size_t row_bytes = (size_t)w * BYTES_PER_PIXEL;
+    uint8_t *out = pixels.data() + slot * TILE_BYTES;
+    for (int row = 0; row < h; row++)
+        memcpy(out + row * row_bytes, origin + row * stride, row_bytes);
+}
+
+const uint8_t *TileCache::find(uint64_t hash, int w, int h)
+{
+    std::unordered_map<uint64_t, Entry>::iterator found = entries.find(hash);
+    if (found == entries.end() || found->second.w != w || found->second.h != h ||
+        pixels.size() < (found->second.slot + 1) * TILE_BYTES)
+        return NULL;
+    order.splice(order.begin(), order, found->second.position);
+    return pixels.data() + found->second.slot * TILE_BYTES;
+}
+
+// ============================================================================
+// ENCODER
+// ============================================================================
+
+// Contiguous share of `count` items handled by `worker`
+static void workerRange(int count, int worker, int workers, int &first, int &last)
+{
+    first = (int)((int64_t)count * worker / workers);
+    last = (int)((int64_t)count * (worker + 1) / workers);
+}
+
+FrameEncoder::FrameEncoder(int codec, int width, int height, int threads)
+    : codec_id(codec), grid(width, height),
+      pool(codec == CODEC_TILE ? threads : 1), have_reference(false), refresh_frames(0), refresh_phase(0),
+      motion(false), motion_dx(0), motion_dy(0), lossy_quality(0)
+{
+    if (codec_id != CODEC_TILE)
+        return;
+
+    size_t tile_pixels = TILE_SIZE * TILE_SIZE;
+    size_t record_bound = TILE_RECORD_HEADER + rleBound(tile_pixels);
+    tile_hashes.assign(grid.count(), 0);
+    tile_choices.assign(grid.count(), CHOICE_SKIP);
+    parts.resize(pool.size());
+    part_sizes.assign(pool.size(), 0);
+    part_tiles.assign(pool.size(), 0);
+    part_cached.assign(pool.size(), 0);
+    part_copied.assign(pool.size(), 0);
+    part_lossy.assign(pool.size(), 0);
+    tile_lossy.assign(grid.count(), 0);
+    tile_still.assign(grid.count(), 0);
+    scratch.resize(pool.size());
+
+    size_t total = 4;
+    for (int worker = 0; worker < pool.size(); worker++)
+    {
+        int first, last;
+        workerRange(grid.count(), worker, pool.size(), first, last);
+        parts[worker].resize((last - first) * record_bound);
+        scratch[worker].resize(tile_pixels * BYTES_PER_PIXEL);
+        total += parts[worker].size();
+    }
+    output.resize(total);
+}
+
+void FrameEncoder::setRefresh(int frames)
+{
+    refresh_frames = frames > 0 ? frames : 0;
+    refresh_phase = 0;
+}
+
+void FrameEncoder::setTileCache(int tiles)
+{
+    cache.reset(codec_id == CODEC_TILE && tiles > 0 ? tiles : 0, false);
+}
+
+void FrameEncoder::setMotion(bool enabled)
+{
+    motion = codec_id == CODEC_TILE && enabled;
+    if (!motion)
+    {
+        previous.clear();
+        previous.shrink_to_fit();
+        return;
+    }
+    if (previous.size() != (size_t)grid.width * grid.height * BYTES_PER_PIXEL)
+    {
+        // Nothing to copy from until the next frame is encoded
+        previous.assign((size_t)grid.width * grid.height * BYTES_PER_PIXEL, 0);
+        have_reference = false;
+    }
+    anchor_filter.assign((size_t)1 << (MOTION_FILTER_BITS - 6), 0);
+    votes.resize(pool.size());
+}
+
+void FrameEncoder::setQuality(int quality)
+{
+    lossy_quality = codec_id == CODEC_TILE && quality > 0 ? std::min(quality, DCT_QUALITY_MAX) : 0;
+    if (lossy_quality > 0)
+    {
+        dct.resize(pool.size());
+        lossy_bodies.resize((size_t)grid.count() * TILE_BYTES);
+        lossy_sizes.resize(grid.count());
+    }
+    std::fill(tile_lossy.begin(), tile_lossy.end(), 0);
+}
+
+// Polynomial hash of MOTION_SPAN pixels, rolled along a row by motionRoll()
+#define MOTION_BASE 0x100000001B3ULL
+
+static inline uint64_t pixelWord(const uint8_t *p)
+{
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16;
+}
+
+static uint64_t motionHash(const uint8_t *p)
+{
+    uint64_t hash = 0;
+    for (int i = 0; i < MOTION_SPAN; i++, p += BYTES_PER_PIXEL)
+        hash = hash * MOTION_BASE + pixelWord(p);
+    return hash;
+}
+
+// Slide the window one pixel: `leaving` drops out, `entering` comes in; `top` is MOTION_BASE^(MOTION_SPAN-1)
+static inline uint64_t motionRoll(uint64_t hash, const uint8_t *leaving, const uint8_t *entering, uint64_t top)
+{
+    return (hash - pixelWord(leaving) * top) * MOTION_BASE + pixelWord(entering);
+}
+
+static bool flatSegment(const uint8_t *p)
+{
+    for (int i = 1; i < MOTION_SPAN; i++)
+    {
+        if (!samePixel(p, p + i * BYTES_PER_PIXEL))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Find the offset most changed tiles moved by and turn the tiles it
+ * explains into CHOICE_COPY; false if there is none.
+ *
+ * Row hashing: row segments (MOTION_SPAN pixels, not flat) of the changed
+ * tiles are hashed, then a rolling hash slides over the rows of the
+ * previous frame inside the changed area, and each position whose hash and
+ * pixels match a segment votes for the offset between the two. Then
+ * verification: the tiles of the winning offset are compared with the
+ * previous frame pixel for pixel, so only exact copies are sent as such.
+ * Refresh tiles are always sent as pixels.
+ */
+bool FrameEncoder::findMotion(const uint8_t *pixels, int refresh_first, int refresh_end)
+{
+    size_t stride = (size_t)grid.width * BYTES_PER_PIXEL;
+    int changed = 0;
+    int left = grid.columns, top = grid.rows, right = -1, bottom = -1;
+    for (int index = 0; index < grid.count(); index++)
+    {
+        if (!sendsPixels(tile_choices[index]) || (index >= refresh_first && index < refresh_end))
+            continue;
+        int column = index % grid.columns, row = index / grid.columns;
+        left = std::min(left, column);
+        right = std::max(right, column);
+        top = std::min(top, row);
+        bottom = std::max(bottom, row);
+        changed++;
+    }
+    if (changed < MOTION_MIN_TILES || grid.width < MOTION_SPAN)
+        return false;
+
+    // Anchors: from every `every`th changed full tile, MOTION_ROW_STEP rows
+    // in a row from the first non-flat one nearest its middle, so whatever
+    // the offset one of them lands on a scanned row of the previous frame
+    anchors.clear();
+    int every = (changed + MOTION_ANCHORS - 1) / MOTION_ANCHORS, seen = 0;
+    for (int index = 0; index < grid.count(); index++)
+    {
+        if (!sendsPixels(tile_choices[index]) || (index >= refresh_first && index < refresh_end) ||
+            seen++ % every != 0)
+            continue;
+        int x, y, w, h;
+        grid.rect(index, x, y, w, h);
+        if (w != TILE_SIZE || h != TILE_SIZE)
+            continue;
+        int ax = x + (TILE_SIZE - MOTION_SPAN) / 2;
+        int start = -1;
+        for (int step = 0; step < TILE_SIZE && start < 0; step++)
+        {
+            int ay = y + TILE_SIZE / 2 + (step % 2 ? -(step + 1) / 2 : step / 2);
+            if (!flatSegment(pixels + (size_t)ay * stride + (size_t)ax * BYTES_PER_PIXEL))
+                start = std::min(ay, y + TILE_SIZE - MOTION_ROW_STEP);
+        }
+        for (int ay = start; start >= 0 && ay < start + MOTION_ROW_STEP; ay++)
+        {
+            const uint8_t *segment = pixels + (size_t)ay * stride + (size_t)ax * BYTES_PER_PIXEL;
+            if (flatSegment(segment))
+                continue;
+            MotionAnchor anchor = {motionHash(segment), ax, ay};
+            anchors.push_back(anchor);
+        }
+    }
+    if (anchors.size() < MOTION_MIN_VOTES)
+        return false;
+    std::sort(anchors.begin(), anchors.end());
+    std::fill(anchor_filter.begin(), anchor_filter.end(), 0);
+    for (size_t i = 0; i < anchors.size(); i++)
+    {
+        uint64_t bit = anchors[i].hash >> (64 - MOTION_FILTER_BITS);
+        anchor_filter[bit >> 6] |= 1ULL << (bit & 63);
+    }
+
+    // Slide over every MOTION_ROW_STEP'th row of the previous frame's changed area, rows shared among workers
+    int area_x = left * TILE_SIZE, area_y = top * TILE_SIZE;
+    int area_right = std::min(grid.width, (right + 1) * TILE_SIZE);
+    int area_bottom = std::min(grid.height, (bottom + 1) * TILE_SIZE);
+    if (area_right - area_x < MOTION_SPAN)
+        return false;
+    uint64_t top_power = 1;
+    for (int i = 1; i < MOTION_SPAN; i++)
+        top_power *= MOTION_BASE;
+
+    pool.run([&](int worker) {
+        std::unordered_map<uint64_t, int> &counts = votes[worker];
+        counts.clear();
+        int first, last, hits = 0;
+        workerRange((area_bottom - area_y) / MOTION_ROW_STEP, worker, pool.size(), first, last);
+        for (int y = area_y + first * MOTION_ROW_STEP; y < area_y + last * MOTION_ROW_STEP && hits < MOTION_HITS;
+             y += MOTION_ROW_STEP)
+        {
+            const uint8_t *row = previous.data() + (size_t)y * stride;
+            const uint8_t *window = row + (size_t)area_x * BYTES_PER_PIXEL;
+            uint64_t hash = motionHash(window);
+            for (int x = area_x; ; x++, window += BYTES_PER_PIXEL)
+            {
+                uint64_t bit = hash >> (64 - MOTION_FILTER_BITS);
+                if (anchor_filter[bit >> 6] & (1ULL << (bit & 63)))
+                {
+                    MotionAnchor key = {hash, 0, 0};
+                    std::vector<MotionAnchor>::const_iterator match =
+                        std::lower_bound(anchors.begin(), anchors.end(), key);
+                    for (; match != anchors.end() && match->hash == hash; ++match)
+                    {
+                        int dx = x - match->x, dy = y - match->y;
+                        const uint8_t *segment = pixels + (size_t)match->y * stride + (size_t)match->x * BYTES_PER_PIXEL;
+                        if ((dx == 0 && dy == 0) || memcmp(segment, window, MOTION_SPAN * BYTES_PER_PIXEL) != 0)
+                            continue;
+                        counts[(uint64_t)(uint32_t)dx << 32 | (uint32_t)dy]++;
+                        hits++;
+                    }
+                }
+                if (x + MOTION_SPAN >= area_right)
+                    break;
+                hash = motionRoll(hash, window, window + MOTION_SPAN * BYTES_PER_PIXEL, top_power);
+            }
+        }
+    });
+
+    // The offset with the most votes (the smallest key on a tie, for repeatable output)
+    std::unordered_map<uint64_t, int> &total = votes[0];
+    for (int worker = 1; worker < pool.size(); worker++)
+    {
+        for (std::unordered_map<uint64_t, int>::const_iterator it = votes[worker].begin(); it != votes[worker].end(); ++it)
+            total[it->first] += it->second;
+    }
+    uint64_t best = 0;
+    int best_votes = 0;
+    for (std::unordered_map<uint64_t, int>::const_iterator it = total.begin(); it != total.end(); ++it)
+    {
+        if (it->second > best_votes || (it->second == best_votes && it->first < best))
+        {
+            best = it->first;
+            best_votes = it->second;
+        }
+    }
+    if (best_votes < MOTION_MIN_VOTES)
+        return false;
+    motion_dx = (int32_t)(uint32_t)(best >> 32);
+    motion_dy = (int32_t)(uint32_t)best;
+
+    // Verify: a tile is a copy only if every pixel of its source matches
+    pool.run([&](int worker) {
+        int first, last;
+        workerRange(grid.count(), worker, pool.size(), first, last);
+        for (int index = first; index < last; index++)
+        {
+            if (!sendsPixels(tile_choices[index]) || (index >= refresh_first && index < refresh_end))
+                continue;
+            int x, y, w, h;
+            grid.rect(index, x, y, w, h);
+            int sx = x + motion_dx, sy = y + motion_dy;
+            if (sx < 0 || sy < 0 || sx + w > grid.width || sy + h > grid.height)
+                continue;
+            size_t row_bytes = (size_t)w * BYTES_PER_PIXEL;
+            const uint8_t *origin = pixels + (size_t)y * stride + (size_t)x * BYTES_PER_PIXEL;
+            const uint8_t *source = previous.data() + (size_t)sy * stride + (size_t)sx * BYTES_PER_PIXEL;
+            int row = 0;
+            while (row < h && memcmp(origin + row * stride, source + row * stride, row_bytes) == 0)
+                row++;
+            if (row == h)
+                tile_choices[index] = CHOICE_COPY;
+        }
+    });
+    return true;
+}
+
+/**
+ * Encode one frame. A tile codec keyframe carries every tile; other frames
+ * only the tiles whose hash changed since they were last sent, plus the
+ * refresh stripe. Picking also sorts photographic tiles out for the lossy
+ * codec (setQuality()).
+ *
+ * With the tile cache or motion search, tiles are hashed and picked first.
+ * findMotion() then turns the tiles that moved into copies; then, in
+ * record order, tiles the decoder still holds become references and the
+ * others enter the cache; then the records are written. A keyframe starts
+ * the cache over, so it only refers to tiles earlier in itself. Copies and
+ * lossy tiles are not cached on either end.
+ */
+void FrameEncoder::encode(const uint8_t *pixels, bool force_keyframe, EncodedFrame &out)
+{
+    if (codec_id != CODEC_TILE)
+    {
+        out.data = pixels;
+        out.size = (size_t)grid.width * grid.height * BYTES_PER_PIXEL;
+        out.keyframe = true;
+        out.tiles_sent = grid.count();
+        out.tiles_cached = 0;
+        out.tiles_copied = 0;
+        out.tiles_lossy = 0;
+        return;
+    }
+
+    bool keyframe = force_keyframe || !have_reference;
+    size_t stride = (size_t)grid.width * BYTES_PER_PIXEL;
+
+    // Tiles [refresh_first, refresh_end) go out whether they changed or not
+    int refresh_first = 0, refresh_end = 0;
+    if (refresh_frames > 0)
+    {
+        refresh_first = (int)((int64_t)grid.rows * refresh_phase / refresh_frames) * grid.columns;
+        refresh_end = (int)((int64_t)grid.rows * (refresh_phase + 1) / refresh_frames) * grid.columns;
+        refresh_phase = (refresh_phase + 1) % refresh_frames;
+    }
+
+    // Hash a tile and decide whether and how it goes out
+    auto pick = [&](int index, int worker) {
+        int x, y, w, h;
+        grid.rect(index, x, y, w, h);
+        const uint8_t *origin = pixels + (size_t)y * stride + (size_t)x * BYTES_PER_PIXEL;
+        uint64_t hash = hashTile(origin, stride, w, h);
+        bool same = hash == tile_hashes[index];
+        if (!keyframe && same && (index < refresh_first || index >= refresh_end))
+        {
+            bool refine = tile_lossy[index] && ++tile_still[index] >= LOSSY_REFINE_FRAMES;
+            tile_choices[index] = refine ? CHOICE_ENCODE : CHOICE_SKIP;
+            return;
+        }
+        tile_hashes[index] = hash;
+        tile_still[index] = 0;
+
+        // New content is classified; a resent tile keeps the fidelity the decoder has
+        bool lossy = same ? tile_lossy[index] != 0
+                          : lossy_quality > 0 && w == TILE_SIZE && h == TILE_SIZE && photographicTile(origin, stride);
+        if (!lossy)
+        {
+            tile_choices[index] = CHOICE_ENCODE;
+            return;
+        }
+
+        // Encoded before the cache pass sees the choice: a tile the coder cannot
+        // make smaller than its pixels goes out as pixels, and those are cached
+        size_t length = dct[worker].encode(origin, stride, lossy_quality,
+                                           lossy_bodies.data() + (size_t)index * TILE_BYTES, TILE_BYTES - 1);
+        lossy_sizes[index] = (uint16_t)length;
+        tile_choices[index] = length > 0 ? CHOICE_LOSSY : CHOICE_ENCODE;
+    };
+
+    bool cached = cache.enabled();
+    bool picked = cached || motion;
+    if (picked)
+    {
+        pool.run([&](int worker) {
+            int first, last;
+            workerRange(grid.count(), worker, pool.size(), first, last);
+            for (int index = first; index < last; index++)
+                pick(index, worker);
+        });
+        if (motion && !keyframe)
+            findMotion(pixels, refresh_first, refresh_end);
+    }
+
+    if (cached)
+    {
+        if (keyframe)
+            cache.clear();
+        for (int index = 0; index < grid.count(); index++)
+        {
+            if (tile_choices[index] != CHOICE_ENCODE)
+                continue;
+            if (cache.touch(tile_hashes[index]))
+                tile_choices[index] = CHOICE_CACHED;
+            else
+            {
+                int x, y, w, h;
+                grid.rect(index, x, y, w, h);
+                cache.insert(tile_hashes[index], NULL, 0, w, h);
+            }
+        }
+    }
+
+    pool.run([&](int worker) {
+        int first, last;
+        workerRange(grid.count(), worker, pool.size(), first, last);
+        uint8_t *records = parts[worker].data();
+        uint8_t *tile = scratch[worker].data();
+        size_t used = 0;
+        int sent = 0, referenced = 0, copied = 0, lossy = 0;
+
+        for (int index = first; index < last; index++)
+        {
+            if (!picked)
+                pick(index, worker);
+            uint8_t choice = tile_choices[index];
+            if (choice == CHOICE_SKIP)
+                continue;
+            tile_lossy[index] = choice == CHOICE_LOSSY;
+
+            int x, y, w, h;
+            grid.rect(index, x, y, w, h);
+            const uint8_t *origin = pixels + (size_t)y * stride + (size_t)x * BYTES_PER_PIXEL;
+            size_t row_bytes = (size_t)w * BYTES_PER_PIXEL;
+            uint8_t *record = records + used;
+            uint8_t *body = record + TILE_RECORD_HEADER;
+            putU32(record, (uint32_t)index);
+
+            // The next frame's motion search compares with what the decoder shows
+            if (motion && choice != CHOICE_LOSSY)
+            {
+                uint8_t *shown = previous.data() + (size_t)y * stride + (size_t)x * BYTES_PER_PIXEL;
+                for (int row = 0; row < h; row++)
+                    memcpy(shown + row * stride, origin + row * stride, row_bytes);
+            }
+
+            if (choice == CHOICE_LOSSY)
+            {
+                size_t length = lossy_sizes[index];
+                memcpy(body, lossy_bodies.data() + (size_t)index * TILE_BYTES, length);
+                // Decoded again: the coder has encoded other tiles since this one
+                if (motion)
+                {
+                    uint8_t *shown = previous.data() + (size_t)y * stride + (size_t)x * BYTES_PER_PIXEL;
+                    dct[worker].decode(body, length, shown, stride);
+                }
+                record[4] = TILE_DCT;
+                putU32(record + 5, (uint32_t)length);
+                used += TILE_RECORD_HEADER + length;
+                sent++;
+                lossy++;
+                continue;
+            }
+            if (choice == CHOICE_COPY)
+            {
+                record[4] = TILE_COPY;
+                putU32(record + 5, 8);
+                putU32(body, (uint32_t)motion_dx);
+                putU32(body + 4, (uint32_t)motion_dy);
+                used += TILE_RECORD_HEADER + 8;
+                sent++;
+                copied++;
+                continue;
+            }
+            if (choice == CHOICE_CACHED)
+            {
+                record[4] = TILE_CACHED;
+                putU32(record + 5, 8);
+                putU64(body, tile_hashes[index]);
+                used += TILE_RECORD_HEADER + 8;
+                sent++;
+                referenced++;
+                continue;
+            }
+
+            for (int row = 0; row < h; row++)
+                memcpy(tile + row * row_bytes, origin + row * stride, row_bytes);
+
+            size_t raw_size = row_bytes * h;
+            size_t length = rleEncode(tile, (size_t)w * h, body);
+            uint8_t encoding = TILE_RLE;
+            if (length >= raw_size)
+            {
+                memcpy(body, tile, raw_size);
+                length = raw_size;
+                encoding = TILE_RAW;
+            }
+
+            record[4] = encoding;
+            putU32(record + 5, (uint32_t)length);
+            used += TILE_RECORD_HEADER + length;
+            sent++;
+        }
+        part_sizes[worker] = used;
+        part_tiles[worker] = sent;
+        part_cached[worker] = referenced;
+        part_copied[worker] = copied;
+        part_lossy[worker] = lossy;
+    });
+
+    // Stitch the per-worker records together behind the tile count
+    size_t size = 4;
+    int tiles = 0, tiles_cached = 0, tiles_copied = 0, tiles_lossy = 0;
+    for (int worker = 0; worker < pool.size(); worker++)
+    {
+        memcpy(output.data() + size, parts[worker].data(), part_sizes[worker]);
+        size += part_sizes[worker];
+        tiles += part_tiles[worker];
+        tiles_cached += part_cached[worker];
+        tiles_copied += part_copied[worker];
+        tiles_lossy += part_lossy[worker];
+    }
+    putU32(output.data(), (uint32_t)tiles);
+
+    have_reference = true;
+    out.data = output.data();
+    out.size = size;
+    out.keyframe = keyframe;
+    out.tiles_sent = tiles;
+    out.tiles_cached = tiles_cached;
+    out.tiles_copied = tiles_copied;
+    out.tiles_lossy = tiles_lossy;
+}
+
+// ============================================================================
+// DECODER
+// ============================================================================
+
+FrameDecoder::FrameDecoder(int codec, int width, int height, int threads)
+    : codec_id(codec), grid(width, height),
+      pool(codec == CODEC_TILE ? threads : 1), have_reference(false), cache_misses(0)
+{
+    if (codec_id == CODEC_TILE)
+    {
+        dct.resize(pool.size());
+        scratch.resize(pool.size());
+        for (int worker = 0; worker < pool.size(); worker++)
+            scratch[worker].resize(TILE_SIZE * TILE_SIZE * BYTES_PER_PIXEL);
+    }
+}
+
+void FrameDecoder::setTileCache(int tiles)
+{
+    cache.reset(codec_id == CODEC_TILE && tiles > 0 ? tiles : 0, true);
+}
+
+bool FrameDecoder::decode(const uint8_t *data, size_t size, bool keyframe, uint8_t *frame)
+{
+    size_t stride = (size_t)grid.width * BYTES_PER_PIXEL;
+
+    if (codec_id != CODEC_TILE)
+    {
+        if (size != stride * grid.height)
+            return false;
+        memcpy(frame, data, size);
+        return true;
+    }
+
+    if (!keyframe && !have_reference)
+        return false;
+
+    // Index the records first so workers can apply them independently
+    if (size < 4)
+        return false;
+    uint32_t count = getU32(data);
+    if (count > (uint32_t)grid.count())
+        return false;
+    records.clear();
+
+    size_t pos = 4;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (!indexRecord(data, pos, size))
+            return false;
+    }
+    if (pos != size)
+        return false;
+
+    if (keyframe)
+        cache.clear();
+    bool ok = applyRecords(frame);
+    // A damaged frame leaves the picture undefined until the next keyframe
+    have_reference = ok && (have_reference || keyframe);
+    return ok;
+}
+
+bool FrameDecoder::decodePartial(const uint8_t *data, size_t size, bool keyframe,
+                                 const std::vector<PayloadSpan> &spans, uint8_t *frame)
+{
+    size_t stride = (size_t)grid.width * BYTES_PER_PIXEL;
+
+    if (codec_id != CODEC_TILE)
+    {
+        // Raw payloads are the picture itself
+        if (size != stride * grid.height)
+            return false;
+        for (size_t i = 0; i < spans.size(); i++)
+        {
+            if (spans[i].first > size || spans[i].second > size - spans[i].first)
+                return false;
+            memcpy(frame + spans[i].first, data + spans[i].first, spans[i].second);
+        }
+        return true;
+    }
+
+    // Whole records inside each span; one cut short by a lost fragment ends it
+    records.clear();
+    for (size_t i = 0; i < spans.size(); i++)
+    {
+        if (spans[i].first > size || spans[i].second > size - spans[i].first)
+            return false;
+        size_t pos = spans[i].first == 0 ? 4 : spans[i].first;
+        size_t end = (size_t)spans[i].first + spans[i].second;
+        while (pos < end && records.size() < (size_t)grid.count())
+        {
+            if (!indexRecord(data, pos, end))
+                break;
+        }
+    }
+
+    // The encoder emptied its cache for the keyframe whether or not all of it arrived
+    if (keyframe)
+        cache.clear();
+    bool ok = applyRecords(frame);
+    have_reference = have_reference || ok; // Concealed, but a picture all the same
+    return ok;
+}
+
+/**
+ * Index the record at `pos` if it lies completely before `end`
+ */
+bool FrameDecoder::indexRecord(const uint8_t *data, size_t &pos, size_t end)
+{
+    if (end - pos < TILE_RECORD_HEADER)
+        return false;
+    TileRecord record;
+    record.index = getU32(data + pos);
+    record.encoding = data[pos + 4];
+    record.length = getU32(data + pos + 5);
+    if (record.index >= (uint32_t)grid.count() || record.encoding > TILE_DCT ||
+        record.length > end - pos - TILE_RECORD_HEADER ||
+        ((record.encoding == TILE_CACHED || record.encoding == TILE_COPY) && record.length != 8))
+        return false;
+    record.data = data + pos + TILE_RECORD_HEADER;
+    record.hash = record.encoding == TILE_CACHED ? getU64(record.data) : 0;
+    records.push_back(record);
+    pos += TILE_RECORD_HEADER + record.length;
+    return true;
+}
+
+/**
+ * Apply the TILE_COPY records, before anything else overwrites their
+ * sources. They share one offset, so copying rows in the direction the
+ * content moved (and, for sideways moves, row segments in that direction)
+ * never reads a pixel an earlier copy already replaced.
+ */
+bool FrameDecoder::applyCopies(uint8_t *frame)
+{
+    copies.clear();
+    int32_t dx = 0, dy = 0;
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        if (records[i].encoding != TILE_COPY)
+            continue;
+        int32_t record_dx = (int32_t)getU32(records[i].data);
+        int32_t record_dy = (int32_t)getU32(records[i].data + 4);
+        if (copies.empty())
+        {
+            dx = record_dx;
+            dy = record_dy;
+        }
+        else if (record_dx != dx || record_dy != dy)
+            return false;
+
+        int x, y, w, h;
+        grid.rect(records[i].index, x, y, w, h);
+        int64_t sx = (int64_t)x + dx, sy = (int64_t)y + dy;
+        if (sx < 0 || sy < 0 || sx + w > grid.width || sy + h > grid.height)
+            return false;
+        copies.push_back(records[i].index);
+    }
+    if (copies.empty())
+        return true;
+    std::sort(copies.begin(), copies.end());
+
+    size_t stride = (size_t)grid.width * BYTES_PER_PIXEL;
+    ptrdiff_t offset = (ptrdiff_t)dy * (ptrdiff_t)stride + (ptrdiff_t)dx * BYTES_PER_PIXEL;
+    for (int step = 0; step < grid.rows; step++)
+    {
+        int tile_row = dy >= 0 ? step : grid.rows - 1 - step;
+        std::vector<uint32_t>::iterator begin =
+            std::lower_bound(copies.begin(), copies.end(), (uint32_t)(tile_row * grid.columns));
+        std::vector<uint32_t>::iterator end =
+            std::lower_bound(begin, copies.end(), (uint32_t)((tile_row + 1) * grid.columns));
+        size_t count = end - begin;
+        if (count == 0)
+            continue;
+
+        int top = tile_row * TILE_SIZE;
+        int h = grid.height - top < TILE_SIZE ? grid.height - top : TILE_SIZE;
+        for (int r = 0; r < h; r++)
+        {
+            size_t row = top + (dy >= 0 ? r : h - 1 - r);
+            for (size_t k = 0; k < count; k++)
+            {
+                int x, y, w, tile_h;
+                grid.rect(begin[dx >= 0 ? k : count - 1 - k], x, y, w, tile_h);
+                uint8_t *target = frame + row * stride + (size_t)x * BYTES_PER_PIXEL;
+                memmove(target, target + offset, (size_t)w * BYTES_PER_PIXEL);
+            }
+        }
+    }
+    return true;
+}
+
+bool FrameDecoder::applyRecords(uint8_t *frame)
+{
+    cache_misses = 0;
+    if (!applyCopies(frame))
+        return false;
+    size_t stride = (size_t)grid.width * BYTES_PER_PIXEL;
+    std::atomic<bool> ok(true);
+    pool.run([&](int worker) {
+        int first, last;
+        workerRange((int)records.size(), worker, pool.size(), first, last);
+        uint8_t *tile = scratch[worker].data();
+
+        for (int i = first; i < last; i++)
+        {
+            TileRecord &record = records[i];
+            if (record.encoding == TILE_CACHED || record.encoding == TILE_COPY)
+                continue; // applyCache(), applyCopies()
+            int x, y, w, h;
+            grid.rect(record.index, x, y, w, h);
+            size_t row_bytes = (size_t)w * BYTES_PER_PIXEL;
+            uint8_t *origin = frame + (size_t)y * stride + (size_t)x * BYTES_PER_PIXEL;
+            if (record.encoding == TILE_DCT)
+            {
+                if (w != TILE_SIZE || h != TILE_SIZE || !dct[worker].decode(record.data, record.length, origin, stride))
+                {
+                    ok = false;
+                    return;
+                }
+                continue; // Lossy tiles stay out of the cache
+            }
+
+            const uint8_t *source = record.data;
+            if (record.encoding == TILE_RLE)
+            {
+                if (!rleDecode(record.data, record.length, tile, (size_t)w * h))
+                {
+                    ok = false;
+                    return;
+                }
+                source = tile;
+            }
+            else if (record.length != row_bytes * h)
+            {
+                ok = false;
+                return;
+            }
+
+            for (int row = 0; row < h; row++)
+                memcpy(origin + row * stride, source + row * row_bytes, row_bytes);
+            if (cache.enabled())
+                record.hash = hashTile(origin, stride, w, h);
+        }
+    });
+    if (ok)
+        applyCache(frame);
+    return ok;
+}
+
+/**
+ * Replay the encoder's cache decisions in record order: tiles sent as
+ * pixels enter the cache, references are copied out of it, copies of the
+ * previous picture and lossy tiles are left alone
+ */
+void FrameDecoder::applyCache(uint8_t *frame)
+{
+    size_t stride = (size_t)grid.width * BYTES_PER_PIXEL;
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        const TileRecord &record = records[i];
+        int x, y, w, h;
+        grid.rect(record.index, x, y, w, h);
+        uint8_t *origin = frame + (size_t)y * stride + (size_t)x * BYTES_PER_PIXEL;
+        if (record.encoding == TILE_COPY || record.encoding == TILE_DCT)
+            continue;
+        if (record.encoding != TILE_CACHED)
+        {
+            cache.insert(record.hash, origin, stride, w, h);
+            continue;
+        }
+
+        const uint8_t *pixels = cache.find(record.hash, w, h);
+        if (!pixels)
+        {
+            cache_misses++;
+            continue;
+        }
+        size_t row_bytes = (size_t)w * BYTES_PER_PIXEL;
+        for (int row = 0; row < h; row++)
+            memcpy(origin + row * stride, pixels + row * row_bytes, row_bytes);
+    }
+}
+
+bool FrameDecoder::expandCached(const uint8_t *frame, std::vector<uint8_t> &out) const
+{
+    size_t stride = (size_t)grid.width * BYTES_PER_PIXEL;
+    size_t size = 4;
+    bool any = false;
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        int x, y, w, h;
+        grid.rect(records[i].index, x, y, w, h);
+        bool cached = records[i].encoding == TILE_CACHED;
+        any = any || cached;
+        size += TILE_RECORD_HEADER + (cached ? (size_t)w * h * BYTES_PER_PIXEL : records[i].length);
+    }
+    if (!any)
+        return false;
+
+    out.resize(size);
+    putU32(out.data(), (uint32_t)records.size());
+    uint8_t *record = out.data() + 4;
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        putU32(record, records[i].index);
+        uint8_t *body = record + TILE_RECORD_HEADER;
+        if (records[i].encoding != TILE_CACHED)
+        {
+            record[4] = records[i].encoding;
+            putU32(record + 5, records[i].length);
+            memcpy(body, records[i].data, records[i].length);
+            record = body + records[i].length;
+            continue;
+        }
+
+        int x, y, w, h;
+        grid.rect(records[i].index, x, y, w, h);
+        size_t row_bytes = (size_t)w * BYTES_PER_PIXEL;
+        const uint8_t *origin = frame + (size_t)y * stride + (size_t)x * BYTES_PER_PIXEL;
+        for (int row = 0; row < h; row++)
+            memcpy(body + row * row_bytes, origin + row * stride, row_bytes);
+        record[4] = TILE_RAW;
+        putU32(record + 5, (uint32_t)(row_bytes * h));
+        record = body + row_bytes * h;
+    }
+    return true;
+}
@@ -0,0 +1,330 @@
+/**
+ * CODEC.H - FRAME ENCODING
+ *
+ * Two codecs, chosen by the sender and announced in the handshake:
+ *   raw  - the packed RGB frame as-is (every frame is a keyframe)
+ *   tile - the frame is cut into TILE_SIZE x TILE_SIZE tiles; only tiles
+ *          whose content hash changed since the previous frame are sent,
+ *          each run-length encoded when that makes it smaller, as a
+ *          reference to a tile the decoder has cached (TileCache), or as a
+ *          copy of the previous picture when the content moved (scrolling,
+ *          a dragged window; see FrameEncoder::setMotion()); photographic
+ *          tiles can be sent lossy instead (dct.h, FrameEncoder::setQuality())
+ *
+ * Tile payload (network byte order):
+ *   u32 tile_count
+ *   tile_count x { u32 tile_index, u8 encoding, u32 length, length bytes }
+ *
+ * Both encoder and decoder can spread tiles over a small worker pool.
+ */
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <utility>
+#include "dct.h"
+
+#define TILE_SIZE 64             // Tile edge in pixels
+#define TILE_RECORD_HEADER 9     // tile_index + encoding + length
+#define FRAME_FLAG_KEYFRAME 1    // MessageHeader::flags: frame decodes without a reference
+#define TILE_BYTES (TILE_SIZE * TILE_SIZE * 3) // Largest tile, packed RGB
+#define TILE_CACHE_MAX 65536     // Most tiles a stream may ask the decoder to cache (768 MB)
+#define MOTION_SPAN 32           // Pixels per row segment matched when looking for motion
+
+enum CodecId
+{
+    CODEC_RAW = 0,
+    CODEC_TILE = 1,
+    CODEC_COUNT
+};
+
+// Bytes [first, first + second) of a payload that arrived intact
+typedef std::pair<uint32_t, uint32_t> PayloadSpan;
+
+// Per-tile payload encodings
+enum TileEncoding
+{
+    TILE_RAW = 0, // Packed RGB rows of the tile
+    TILE_RLE = 1, // Pixel run-length encoding, see rleEncode()
+    TILE_CACHED = 2, // u64 content hash of a tile the decoder has cached
+    TILE_COPY = 3, // i32 dx, i32 dy: the previous picture's pixels at (x + dx, y + dy)
+    TILE_DCT = 4, // Lossy, see dct.h
+};
+
+const char *codecName(int codec);
+int codecFromName(const std::string &name); // -1 if unknown
+
+// Largest MSG_FRAME payload a well-behaved encoder produces
+size_t maxEncodedSize(int codec, int width, int height);
+
+/**
+ * Fixed set of threads that all run the same job, one index each.
+ * Worker 0 is the calling thread, so a pool of size 1 spawns nothing.
+ */
+class WorkerPool
+{
+public:
+    explicit WorkerPool(int threads);
+    ~WorkerPool();
+
+    int size() const { return thread_count; }
+    void run(const std::function<void(int)> &job);
+
+private:
+    void workerLoop(int index);
+
+    int thread_count;
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+    const std::function<void(int)> *current_job;
+    uint64_t generation;
+    int pending;
+    bool stopping;
+};
+
+/**
+ * Tile grid geometry shared by encoder and decoder
+ */
+struct TileGrid
+{
+    int width, height;  // Frame size in pixels
+    int columns, rows;  // Tiles per row / column
+
+    TileGrid(int w, int h);
+    int count() const { return columns * rows; }
+    // Pixel rectangle of a tile (edge tiles are smaller)
+    void rect(int index, int &x, int &y, int &w, int &h) const;
+};
+
+/**
+ * Tile kernels. hashTile() reads a w x h rectangle straight out of a frame
+ * with `stride` bytes per row; the RLE functions work on `count` contiguous
+ * pixels (tiles are gathered into a scratch buffer first).
+ *
+ * RLE stream: control byte c < 128 is followed by c + 1 literal pixels,
+ * c >= 128 by one pixel repeated c - 126 times.
+ */
+uint64_t hashTile(const uint8_t *frame, size_t stride, int w, int h);
+size_t rleEncode(const uint8_t *pixels, size_t count, uint8_t *out);
+bool rleDecode(const uint8_t *in, size_t size, uint8_t *pixels, size_t count);
+size_t rleBound(size_t count); // Worst-case rleEncode() output
+
+/**
+ * LRU set of recently sent tiles keyed by content hash (hashTile()), at
+ * most `capacity` of them. The encoder keeps only the keys, as its picture
+ * of what the decoder holds; the decoder keeps the pixels. Both insert and
+ * touch tiles in record order and start over at every keyframe, so they
+ * agree on what is cached without telling each other. A reference the
+ * decoder cannot resolve (after lost records) is a miss, not an error.
+ */
+class TileCache
+{
+public:
+    TileCache() : capacity(0), keep_pixels(false) {}
+
+    // Hold up to `tiles` tiles (0 turns the cache off), with their pixels or not
+    void reset(size_t tiles, bool pixels);
+    bool enabled() const { return capacity > 0; }
+    void clear();
+
+    // Mark a tile most recently used; false if it is not cached
+    bool touch(uint64_t hash);
+
+    // Cache the w x h tile at `origin` (NULL for keys only), evicting the least recently used
+    void insert(uint64_t hash, const uint8_t *origin, size_t stride, int w, int h);
+
+    // Packed pixels of a cached w x h tile, marked used; NULL if absent
+    const uint8_t *find(uint64_t hash, int w, int h);
+
+private:
+    struct Entry
+    {
+        std::list<uint64_t>::iterator position;
+        size_t slot; // Index into `pixels`, TILE_BYTES each
+        int w, h;
+    };
+
+    size_t capacity;
+    bool keep_pixels;
+    std::list<uint64_t> order; // Most recently used first
+    std::unordered_map<uint64_t, Entry> entries;
+    std::vector<uint8_t> pixels;
+};
+
+/**
+ * Result of encoding one frame. `data` points into the encoder (or at the
+ * input pixels for raw) and stays valid until the next encode() call.
+ */
+struct EncodedFrame
+{
+    const uint8_t *data;
+    size_t size;
+    bool keyframe;
+    int tiles_sent;
+    int tiles_cached; // Sent as TILE_CACHED references
+    int tiles_copied; // Sent as TILE_COPY records
+    int tiles_lossy;  // Sent as TILE_DCT records
+};
+
+class FrameEncoder
+{
+public:
+    FrameEncoder(int codec, int width, int height, int threads);
+
+    int codec() const { return codec_id; }
+    void encode(const uint8_t *pixels, bool force_keyframe, EncodedFrame &out);
+
+    /**
+     * Intra refresh: every frame also resends one stripe of tile rows,
+     * changed or not, so the whole picture is resent every `frames` frames
+     * without the burst of a keyframe. 0 turns it off; raw frames need none.
+     */
+    void setRefresh(int frames);
+
+    // Send tiles the decoder caches (it must hold the same `tiles`) as references; 0 turns it off
+    void setTileCache(int tiles);
+
+    /**
+     * Motion search: when many tiles changed, look for one offset the
+     * content moved by since the last frame (scrolling, a dragged window)
+     * and send the tiles it explains as TILE_COPY records, so only the
+     * newly exposed area goes out as pixels. Costs a copy of every frame.
+     */
+    void setMotion(bool enabled);
+
+    /**
+     * Send photographic tiles (photographicTile()) lossy at `quality`
+     * (1..100), text and UI stay lossless; 0 turns it off. A lossy tile
+     * that then stays unchanged for a moment is resent losslessly.
+     */
+    void setQuality(int quality);
+
+private:
+    enum TileChoice
+    {
+        CHOICE_SKIP,   // Unchanged
+        CHOICE_ENCODE, // Pixels
+        CHOICE_CACHED, // Reference to the decoder's cache
+        CHOICE_COPY,   // Copy of the previous picture at the motion offset
+        CHOICE_LOSSY,  // TILE_DCT
+    };
+
+    // Anchor of the motion search: a row segment of a changed tile
+    struct MotionAnchor
+    {
+        uint64_t hash;
+        int x, y;
+        bool operator<(const MotionAnchor &other) const { return hash < other.hash; }
+    };
+
+    bool findMotion(const uint8_t *pixels, int refresh_first, int refresh_end);
+    static bool sendsPixels(uint8_t choice) { return choice == CHOICE_ENCODE || choice == CHOICE_LOSSY; }
+
+    int codec_id;
+    TileGrid grid;
+    WorkerPool pool;
+    bool have_reference;
+    int refresh_frames;
+    int refresh_phase;                           // Stripe the next frame resends
+    TileCache cache;                             // Keys of the tiles the decoder caches
+    std::vector<uint64_t> tile_hashes;          // Hash of every tile as last sent
+    std::vector<uint8_t> tile_choices;          // TileChoice of every tile in this frame
+    std::vector<std::vector<uint8_t> > parts;    // Per-worker tile records
+    std::vector<size_t> part_sizes;
+    std::vector<int> part_tiles;
+    std::vector<int> part_cached;
+    std::vector<int> part_copied;
+    std::vector<int> part_lossy;
+    std::vector<std::vector<uint8_t> > scratch;  // Per-worker gathered tile
+    std::vector<uint8_t> output;
+
+    bool motion;
+    int motion_dx, motion_dy;                    // Offset of this frame's TILE_COPY records
+    std::vector<uint8_t> previous;               // Last frame, the source of copies
+    std::vector<MotionAnchor> anchors;
+    std::vector<uint64_t> anchor_filter;         // Bit set of anchor hashes
+    std::vector<std::unordered_map<uint64_t, int> > votes; // Per-worker offset -> matches
+
+    int lossy_quality;
+    std::vector<uint8_t> tile_lossy;             // The decoder holds a lossy version of the tile
+    std::vector<uint16_t> tile_still;            // Frames the tile has been unchanged since
+    std::vector<DctTileCoder> dct;               // Per worker
+    std::vector<uint8_t> lossy_bodies;           // TILE_DCT body of every lossy tile, TILE_BYTES apart
+    std::vector<uint16_t> lossy_sizes;
+};
+
+class FrameDecoder
+{
+public:
+    FrameDecoder(int codec, int width, int height, int threads);
+
+    int codec() const { return codec_id; }
+
+    /**
+     * Apply an encoded frame to `frame`, which holds the previous picture
+     * (width x height packed RGB). Returns false on malformed input or a
+     * delta frame without a keyframe before it.
+     */
+    bool decode(const uint8_t *data, size_t size, bool keyframe, uint8_t *frame);
+
+    /**
+     * Apply what survived of a frame with lost fragments: the whole records
+     * inside `spans` (raw: the pixel bytes). Everything else keeps the
+     * previous picture. A keyframe empties the tile cache, as in decode().
+     */
+    bool decodePartial(const uint8_t *data, size_t size, bool keyframe, const std::vector<PayloadSpan> &spans,
+                       uint8_t *frame);
+
+    // Cache `tiles` tiles for TILE_CACHED references, as many as the encoder assumes; 0 turns it off
+    void setTileCache(int tiles);
+
+    // References in the last frame that missed the cache; those tiles kept the previous picture
+    int cacheMisses() const { return cache_misses; }
+
+    /**
+     * The last decoded frame without TILE_CACHED records, which become
+     * raw tiles taken from `frame`, for readers without the cache (the
+     * archive; TILE_COPY records stay, it has the previous picture). `data`
+     * must still hold the payload. False if it had none.
+     */
+    bool expandCached(const uint8_t *frame, std::vector<uint8_t> &out) const;
+
+private:
+    struct TileRecord
+    {
+        uint32_t index;
+        uint8_t encoding;
+        const uint8_t *data;
+        uint32_t length;
+        uint64_t hash; // Content hash once applied (cache only)
+    };
+
+    int codec_id;
+    TileGrid grid;
+    WorkerPool pool;
+    bool have_reference;
+    bool indexRecord(const uint8_t *data, size_t &pos, size_t end);
+    bool applyRecords(uint8_t *frame);
+    bool applyCopies(uint8_t *frame);
+    void applyCache(uint8_t *frame);
+
+    TileCache cache;
+    int cache_misses;
+    std::vector<TileRecord> records;
+    std::vector<uint32_t> copies;               // Tiles of the TILE_COPY records
+    std::vector<std::vector<uint8_t> > scratch; // Per-worker decoded tile
+    std::vector<DctTileCoder> dct;              // Per worker
+};
+
+#endif
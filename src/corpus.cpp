@@ -0,0 +1,145 @@
+/**
+ * CORPUS.CPP - RECORDED SESSION FILES
+ */
+#include "corpus.h"
+#include "protocol.h"
+#include <iostream>
+#include <cstring>
+
+// ============================================================================
+// WRITER
+// ============================================================================
+
+CorpusWriter::CorpusWriter() : first_us(0), frame_count(0), byte_count(0) {}
+
+CorpusWriter::~CorpusWriter()
+{
+    close();
+}
+
+bool CorpusWriter::open(const std::string &file, int width, int height)
+{
+    path = file;
+    out.open(path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        std::cerr << "❌ Could not create corpus " << path << std::endl;
+        return false;
+    }
+
+    uint8_t header[CORPUS_HEADER_SIZE];
+    memcpy(header, CORPUS_MAGIC, 4);
+    putU32(header + 4, CORPUS_VERSION);
+    putU32(header + 8, width);
+    putU32(header + 12, height);
+    putU32(header + 16, CODEC_TILE);
+    out.write((const char *)header, sizeof(header));
+
+    encoder.reset(new FrameEncoder(CODEC_TILE, width, height, 1));
+    frame_count = 0;
+    byte_count = sizeof(header);
+    return out.good();
+}
+
+bool CorpusWriter::write(const uint8_t *pixels, uint64_t capture_us)
+{
+    if (!encoder || !out)
+        return false;
+    if (frame_count == 0)
+        first_us = capture_us;
+
+    EncodedFrame encoded;
+    encoder->encode(pixels, frame_count % CORPUS_KEYFRAME_INTERVAL == 0, encoded);
+
+    uint8_t header[CORPUS_FRAME_HEADER];
+    putU32(header, encoded.keyframe ? FRAME_FLAG_KEYFRAME : 0);
+    putU64(header + 4, capture_us - first_us);
+    putU32(header + 12, (uint32_t)encoded.size);
+    out.write((const char *)header, sizeof(header));
+    out.write((const char *)encoded.data, encoded.size);
+
+    frame_count++;
+    byte_count += sizeof(header) + encoded.size;
+    return out.good();
+}
+
+void CorpusWriter::close()
+{
+    if (!encoder)
+        return;
+    out.close();
+    encoder.reset();
+    std::cout << "💾 Recorded " << frame_count << " frames (" << byte_count / 1024 << " KB) to " << path << std::endl;
+}
+
+// ============================================================================
+// READER
+// ============================================================================
+
+CorpusReader::CorpusReader() : frame_width(0), frame_height(0), damaged(false) {}
+
+bool CorpusReader::open(const std::string &file)
+{
+    path = file;
+    in.open(path.c_str(), std::ios::binary);
+    if (!in)
+    {
+        std::cerr << "❌ Could not open corpus " << path << std::endl;
+        return false;
+    }
+
+    uint8_t header[CORPUS_HEADER_SIZE];
+    if (!in.read((char *)header, sizeof(header)) || memcmp(header, CORPUS_MAGIC, 4) != 0)
+    {
+        std::cerr << "❌ " << path << " is not an RGM corpus" << std::endl;
+        return false;
+    }
+    uint32_t version = getU32(header + 4);
+    uint32_t codec = getU32(header + 16);
+    frame_width = getU32(header + 8);
+    frame_height = getU32(header + 12);
+    if (version != CORPUS_VERSION || codec >= CODEC_COUNT || frame_width <= 0 || frame_height <= 0 ||
+        frame_width > 16384 || frame_height > 16384)
+    {
+        std::cerr << "❌ Unsupported corpus " << path << " (version " << version << ", codec " << codec
+                  << ", " << frame_width << "x" << frame_height << ")" << std::endl;
+        return false;
+    }
+
+    decoder.reset(new FrameDecoder(codec, frame_width, frame_height, 1));
+    return true;
+}
+
+bool CorpusReader::next(uint8_t *pixels, uint64_t &time_us)
+{
+    uint8_t header[CORPUS_FRAME_HEADER];
+    if (!in.read((char *)header, sizeof(header)))
+        return false; // Clean end of file
+
+    uint32_t flags = getU32(header);
+    time_us = getU64(header + 4);
+    uint32_t length = getU32(header + 12);
+    if (length > maxEncodedSize(decoder->codec(), frame_width, frame_height))
+    {
+        damaged = true;
+        return false;
+    }
+
+    payload.resize(length);
+    if (!in.read((char *)payload.data(), length) ||
+        !decoder->decode(payload.data(), length, (flags & FRAME_FLAG_KEYFRAME) != 0, pixels))
+    {
+        damaged = true;
+        return false;
+    }
+    return true;
+}
+
+bool CorpusReader::rewind()
+{
+    in.clear();
+    in.seekg(CORPUS_HEADER_SIZE);
+    decoder.reset(new FrameDecoder(decoder->codec(), frame_width, frame_height, 1));
+    damaged = false;
+    return in.good();
+}
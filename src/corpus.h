@@ -0,0 +1,84 @@
+/**
+ * CORPUS.H - RECORDED SESSION FILES
+ *
+ * A corpus holds the frames of a real capture session together with their
+ * capture times, so the same desktop activity can be replayed through the
+ * pipeline (--source replay:<file>) to compare codec or pipeline changes on
+ * identical input. Frames are stored with the tile codec, i.e. only changed
+ * tiles, run-length encoded, with a keyframe every CORPUS_KEYFRAME_INTERVAL
+ * frames. The stored picture is lossless.
+ *
+ * Layout (network byte order):
+ *   header: "RGMC", u32 version, u32 width, u32 height, u32 codec
+ *   frames: u32 flags, u64 time_us (since the first frame), u32 length,
+ *           length bytes of codec payload
+ */
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <memory>
+#include "codec.h"
+
+#define CORPUS_MAGIC "RGMC"
+#define CORPUS_VERSION 1
+#define CORPUS_HEADER_SIZE 20        // magic + version + width + height + codec
+#define CORPUS_FRAME_HEADER 16       // flags + time_us + length
+#define CORPUS_KEYFRAME_INTERVAL 300 // Frames between stored keyframes
+
+class CorpusWriter
+{
+public:
+    CorpusWriter();
+    ~CorpusWriter();
+
+    bool open(const std::string &path, int width, int height);
+    // Append a packed RGB frame captured at capture_us (nowMicros() clock)
+    bool write(const uint8_t *pixels, uint64_t capture_us);
+    void close();
+
+    uint64_t frames() const { return frame_count; }
+    uint64_t bytes() const { return byte_count; }
+
+private:
+    std::ofstream out;
+    std::string path;
+    std::unique_ptr<FrameEncoder> encoder;
+    uint64_t first_us;
+    uint64_t frame_count;
+    uint64_t byte_count;
+};
+
+class CorpusReader
+{
+public:
+    CorpusReader();
+
+    bool open(const std::string &path);
+    int width() const { return frame_width; }
+    int height() const { return frame_height; }
+
+    /**
+     * Decode the next frame into `pixels`, which must still hold the frame
+     * returned by the previous call. Returns false at the end of the file or
+     * on a damaged record (see failed()).
+     */
+    bool next(uint8_t *pixels, uint64_t &time_us);
+    bool rewind();
+    bool failed() const { return damaged; }
+
+private:
+    std::ifstream in;
+    std::string path;
+    std::unique_ptr<FrameDecoder> decoder;
+    std::vector<uint8_t> payload;
+    int frame_width;
+    int frame_height;
+    bool damaged;
+};
+
+#endif
@@ -0,0 +1,249 @@
+/**
+ * DCT.CPP - LOSSY TILE CODEC
+ */
+#include "dct.h"
+#include "codec.h"
+#include "protocol.h"
+#include "simd.h"
+#include <cstring>
+#include <algorithm>
+
+#define DCT_LUMA_BLOCKS 64   // 8 x 8 blocks of Y
+#define DCT_CHROMA_BLOCKS 16 // 4 x 4 blocks of Co, then of Cg
+#define DCT_BLOCKS (DCT_LUMA_BLOCKS + 2 * DCT_CHROMA_BLOCKS)
+#define DCT_END_OF_BLOCK 0xFF
+#define DCT_WIDE_LEVEL 0x40
+#define PHOTO_MIN_COLORS 192 // Distinct colours (of 2048 sampled pixels) of a photographic tile
+#define PHOTO_MAX_REPEATS 25 // Percent of pixels equal to their left neighbour, at most
+
+// Zigzag position -> natural position
+static const uint8_t ZIGZAG[64] = {
+    0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+// JPEG (ITU T.81 Annex K) quantization tables at quality 50, natural order
+static const uint8_t LUMA_TABLE[64] = {
+    16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55,
+    14, 13, 16, 24, 40, 57, 69, 56, 14, 17, 22, 29, 51, 87, 80, 62,
+    18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92,
+    49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99,
+};
+static const uint8_t CHROMA_TABLE[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+};
+
+/**
+ * Sample every other row: count pixels equal to their left neighbour, and
+ * distinct colours in a 1024-bit set. Text and UI repeat pixels along
+ * rows (flat backgrounds, strokes) or use few colours; camera content and
+ * rendered video do neither. Most tiles are text or UI, so the count of
+ * repeats stops the scan as soon as it is over the limit.
+ */
+bool photographicTile(const uint8_t *origin, size_t stride)
+{
+    const int sampled = TILE_SIZE * TILE_SIZE / 2;
+    const int max_repeats = sampled * PHOTO_MAX_REPEATS / 100;
+    uint64_t colors[16] = {0};
+    int repeats = 0;
+    for (int y = 0; y < TILE_SIZE; y += 2)
+    {
+        const uint8_t *p = origin + (size_t)y * stride;
+        for (int x = 0; x < TILE_SIZE; x++, p += BYTES_PER_PIXEL)
+        {
+            if (x > 0 && p[0] == p[-3] && p[1] == p[-2] && p[2] == p[-1])
+                repeats++;
+            uint32_t color = p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16;
+            uint32_t bit = (color * 0x9E3779B1u) >> 22;
+            colors[bit >> 6] |= 1ULL << (bit & 63);
+        }
+        if (repeats > max_repeats)
+            return false;
+    }
+
+    int distinct = 0;
+    for (int i = 0; i < 16; i++)
+        distinct += __builtin_popcountll(colors[i]);
+    return distinct >= PHOTO_MIN_COLORS;
+}
+
+DctTileCoder::DctTileCoder()
+    : table_quality(0), raster(DCT_BLOCKS * 64), planes(DCT_BLOCKS * 64), coefs(DCT_BLOCKS * 64),
+      levels(DCT_BLOCKS * 64), tokens(DCT_BLOCKS * (64 * 3 + 1))
+{
+}
+
+// libjpeg's quality scaling; steps of at least 2 keep recip within 16 bits
+void DctTileCoder::setQuality(int quality)
+{
+    if (quality == table_quality)
+        return;
+    table_quality = quality;
+    int scale = quality < 50 ? 5000 / quality : 200 - 2 * quality;
+    for (int i = 0; i < 64; i++)
+    {
+        const uint8_t *base[2] = {LUMA_TABLE, CHROMA_TABLE};
+        for (int plane = 0; plane < 2; plane++)
+        {
+            int step = (base[plane][i] * scale + 50) / 100;
+            step = step < 2 ? 2 : step > 32767 ? 32767 : step;
+            steps[plane][i] = (uint16_t)step;
+            half[plane][i] = (uint16_t)(step / 2);
+            recip[plane][i] = (uint16_t)(65536 / step);
+        }
+    }
+}
+
+// Copy a plane of `width` x `height` samples to or from 8x8 blocks in raster order
+static void toBlocks(const int16_t *raster, int width, int height, int16_t *blocks)
+{
+    for (int by = 0; by < height; by += 8)
+        for (int bx = 0; bx < width; bx += 8, blocks += 64)
+            for (int row = 0; row < 8; row++)
+                memcpy(blocks + row * 8, raster + (size_t)(by + row) * width + bx, 8 * sizeof(int16_t));
+}
+
+static void fromBlocks(const int16_t *blocks, int width, int height, int16_t *raster)
+{
+    for (int by = 0; by < height; by += 8)
+        for (int bx = 0; bx < width; bx += 8, blocks += 64)
+            for (int row = 0; row < 8; row++)
+                memcpy(raster + (size_t)(by + row) * width + bx, blocks + row * 8, 8 * sizeof(int16_t));
+}
+
+size_t DctTileCoder::encode(const uint8_t *origin, size_t stride, int quality, uint8_t *out, size_t capacity)
+{
+    // Colour transform two rows at a time (simd.h), then the planes into blocks
+    const int chroma_size = TILE_SIZE / 2;
+    int16_t *luma = raster.data();
+    int16_t *co = luma + TILE_SIZE * TILE_SIZE;
+    int16_t *cg = co + chroma_size * chroma_size;
+    for (int y = 0; y < TILE_SIZE; y += 2)
+        rgbToYCoCg(origin + (size_t)y * stride, origin + (size_t)(y + 1) * stride, luma + y * TILE_SIZE,
+                   luma + (y + 1) * TILE_SIZE, co + y / 2 * chroma_size, cg + y / 2 * chroma_size, TILE_SIZE);
+    toBlocks(luma, TILE_SIZE, TILE_SIZE, planes.data());
+    toBlocks(co, chroma_size, chroma_size, planes.data() + DCT_LUMA_BLOCKS * 64);
+    toBlocks(cg, chroma_size, chroma_size, planes.data() + (DCT_LUMA_BLOCKS + DCT_CHROMA_BLOCKS) * 64);
+    fdct8x8(planes.data(), coefs.data(), DCT_BLOCKS);
+
+    for (quality = quality < 1 ? 1 : quality > DCT_QUALITY_MAX ? DCT_QUALITY_MAX : quality;; quality /= 2)
+    {
+        setQuality(quality);
+        quantizeBlocks(coefs.data(), levels.data(), half[0], recip[0], DCT_LUMA_BLOCKS);
+        quantizeBlocks(coefs.data() + DCT_LUMA_BLOCKS * 64, levels.data() + DCT_LUMA_BLOCKS * 64, half[1], recip[1],
+                       2 * DCT_CHROMA_BLOCKS);
+        if (capacity < 1)
+            return 0;
+        out[0] = (uint8_t)quality;
+        size_t length = writeTokens(out + 1, capacity - 1);
+        if (length > 0)
+            return length + 1;
+        if (quality == 1)
+            return 0;
+    }
+}
+
+/**
+ * Zigzag run/level tokens of every block; 0 if they do not fit in
+ * `capacity`. Written branch-free into `tokens`, which has room for the
+ * worst case: every coefficient writes a full token and only advances past
+ * it when it is not zero, since with noisy content which ones are zero is
+ * anybody's guess.
+ */
+size_t DctTileCoder::writeTokens(uint8_t *out, size_t capacity)
+{
+    uint8_t *data = tokens.data();
+    size_t used = 0;
+    for (int block = 0; block < DCT_BLOCKS; block++)
+    {
+        const int16_t *block_levels = levels.data() + block * 64;
+        unsigned run = 0;
+        for (int i = 0; i < 64; i++)
+        {
+            int16_t level = block_levels[ZIGZAG[i]];
+            unsigned wide = (unsigned)(level + 128) > 255;
+            unsigned nonzero = level != 0;
+            data[used] = (uint8_t)(run | wide << 6);
+            data[used + 1] = wide ? (uint8_t)((uint16_t)level >> 8) : (uint8_t)level;
+            data[used + 2] = (uint8_t)level;
+            used += nonzero * (2 + wide);
+            run = (run + 1) * (1 - nonzero);
+        }
+        data[used++] = DCT_END_OF_BLOCK;
+    }
+    if (used > capacity)
+        return 0;
+    memcpy(out, data, used);
+    return used;
+}
+
+bool DctTileCoder::decode(const uint8_t *in, size_t size, uint8_t *origin, size_t stride)
+{
+    if (size < 1 || in[0] < 1 || in[0] > DCT_QUALITY_MAX)
+        return false;
+    setQuality(in[0]);
+
+    // Tokens to levels, then the same reconstruction as the encoder's
+    std::fill(levels.begin(), levels.end(), 0);
+    size_t pos = 1;
+    for (int block = 0; block < DCT_BLOCKS; block++)
+    {
+        int16_t *block_levels = levels.data() + block * 64;
+        int i = 0;
+        while (true)
+        {
+            if (pos >= size)
+                return false;
+            uint8_t token = in[pos++];
+            if (token == DCT_END_OF_BLOCK)
+                break;
+            i += token & 0x3F;
+            int level;
+            if (token & DCT_WIDE_LEVEL)
+            {
+                if (size - pos < 2)
+                    return false;
+                level = (int16_t)(in[pos] << 8 | in[pos + 1]);
+                pos += 2;
+            }
+            else
+            {
+                if (pos >= size)
+                    return false;
+                level = (int8_t)in[pos++];
+            }
+            if (i > 63)
+                return false;
+            block_levels[ZIGZAG[i++]] = (int16_t)level;
+        }
+    }
+    if (pos != size)
+        return false;
+    reconstruct(origin, stride);
+    return true;
+}
+
+void DctTileCoder::reconstruct(uint8_t *origin, size_t stride)
+{
+    dequantizeBlocks(levels.data(), coefs.data(), steps[0], DCT_LUMA_BLOCKS);
+    dequantizeBlocks(levels.data() + DCT_LUMA_BLOCKS * 64, coefs.data() + DCT_LUMA_BLOCKS * 64, steps[1],
+                     2 * DCT_CHROMA_BLOCKS);
+    idct8x8(coefs.data(), planes.data(), DCT_BLOCKS);
+
+    const int chroma_size = TILE_SIZE / 2;
+    int16_t *luma = raster.data();
+    int16_t *co = luma + TILE_SIZE * TILE_SIZE;
+    int16_t *cg = co + chroma_size * chroma_size;
+    fromBlocks(planes.data(), TILE_SIZE, TILE_SIZE, luma);
+    fromBlocks(planes.data() + DCT_LUMA_BLOCKS * 64, chroma_size, chroma_size, co);
+    fromBlocks(planes.data() + (DCT_LUMA_BLOCKS + DCT_CHROMA_BLOCKS) * 64, chroma_size, chroma_size, cg);
+    for (int y = 0; y < TILE_SIZE; y += 2)
+        yCoCgToRgb(luma + y * TILE_SIZE, luma + (y + 1) * TILE_SIZE, co + y / 2 * chroma_size,
+                   cg + y / 2 * chroma_size, origin + (size_t)y * stride, origin + (size_t)(y + 1) * stride,
+                   TILE_SIZE);
+}
@@ -0,0 +1,67 @@
+/**
+ * DCT.H - LOSSY TILE CODEC
+ *
+ * Photographs and video do not run-length encode: hardly two neighbouring
+ * pixels are equal. Tiles that look like that (photographicTile()) can go
+ * out as TILE_DCT records instead, coded JPEG-style:
+ *   - RGB to YCoCg-R, chroma averaged over 2x2 pixels (4:2:0)
+ *   - 8x8 integer DCT and quantization, with the JPEG tables scaled to a
+ *     quality of 1..100
+ *   - coefficients in zigzag order as (zero run, level) tokens
+ * The colour transform, DCT and (de)quantization are simd.h kernels.
+ *
+ * Full TILE_SIZE tiles only. Record body: u8 quality, then the 64 Y blocks,
+ * 16 Co blocks and 16 Cg blocks in raster order, each a list of tokens:
+ *   u8 t == 0xFF    end of block
+ *   otherwise       t & 0x3F zero coefficients, then one level: int16
+ *                   (network byte order) if t & 0x40, else int8
+ *
+ * Decoding is integer arithmetic only and gives the same pixels on every
+ * CPU, so an encoder can keep an exact copy of the decoder's picture.
+ */
+#ifndef DCT_H
+#define DCT_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#define DCT_QUALITY_MAX 100
+
+// True for a full tile with few repeated pixels and many colours (not text or UI)
+bool photographicTile(const uint8_t *origin, size_t stride);
+
+class DctTileCoder
+{
+public:
+    DctTileCoder();
+
+    /**
+     * Encode the full tile at `origin` at `quality` into at most `capacity`
+     * bytes, halving the quality until it fits. Returns the length, 0 if
+     * it does not fit even at quality 1.
+     */
+    size_t encode(const uint8_t *origin, size_t stride, int quality, uint8_t *out, size_t capacity);
+
+    // Decode a TILE_DCT body into the tile at `origin`; false if it is malformed
+    bool decode(const uint8_t *in, size_t size, uint8_t *origin, size_t stride);
+
+    // Write the pixels decoding the last encode() output gives, without parsing it
+    void reconstruct(uint8_t *origin, size_t stride);
+
+private:
+    void setQuality(int quality);
+    size_t writeTokens(uint8_t *out, size_t capacity);
+
+    int table_quality;
+    uint16_t steps[2][64];  // Luma, chroma; natural order
+    uint16_t half[2][64];
+    uint16_t recip[2][64];
+    std::vector<int16_t> raster; // Y, Co, Cg planes of the tile, row by row
+    std::vector<int16_t> planes; // The same as 8x8 blocks
+    std::vector<int16_t> coefs;
+    std::vector<int16_t> levels;
+    std::vector<uint8_t> tokens;
+};
+
+#endif
@@ -177,6 +177,27 @@ bool testTcpConnection(const std::string &ip, int port, int timeout_ms)
     return connected;
 }
 
+/**
+ * Join a multicast group on the default interface
+ */
+bool joinMulticastGroup(int sock, const std::string &group)
+{
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr.s_addr = inet_addr(group.c_str());
+    mreq.imr_interface.s_addr = INADDR_ANY;
+    return setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, (char *)&mreq, sizeof(mreq)) == 0;
+}
+
+/**
+ * TTL of outgoing multicast datagrams, and whether this host sees its own
+ */
+void setMulticastSendOptions(int sock, int ttl, bool loopback)
+{
+    setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, (char *)&ttl, sizeof(ttl));
+    unsigned char loop = loopback ? 1 : 0;
+    setsockopt(sock, IPPROTO_IP, IP_MULTICAST_LOOP, (char *)&loop, sizeof(loop));
+}
+
 /**
  * Parse SSDP response to extract IP and port
  */
@@ -277,11 +298,7 @@ std::vector<DiscoveredDevice> discoverReceivers(int timeout_seconds)
     int sock_buf_size = SOCKET_BUFFER_SIZE;
     setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char *)&sock_buf_size, sizeof(sock_buf_size));
 
-    struct ip_mreq mreq;
-    mreq.imr_multiaddr.s_addr = inet_addr(SSDP_MULTICAST_GROUP);
-    mreq.imr_interface.s_addr = INADDR_ANY;
-
-    if (setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, (char *)&mreq, sizeof(mreq)) < 0)
+    if (!joinMulticastGroup((int)sock, SSDP_MULTICAST_GROUP))
     {
         std::cerr << "❌ Failed to join multicast group" << std::endl;
 #ifdef _WIN32
@@ -37,4 +37,8 @@ std::string listDevices(const std::vector<DiscoveredDevice> &devices);
 std::string getLocalIPAddress();
 bool testTcpConnection(const std::string &ip, int port, int timeout_ms = 1000);
 
+// Multicast helpers shared by SSDP and the multicast stream transport
+bool joinMulticastGroup(int sock, const std::string &group);
+void setMulticastSendOptions(int sock, int ttl, bool loopback);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,702 @@
+/**
+ * IMPAIR.CPP - NETWORK IMPAIRMENT PROXY
+ *
+ * Sits between sender and receiver on one machine and makes the path
+ * behave like a worse network:
+ *
+ *   sender --connect 127.0.0.1:<listen>  ->  impair  ->  receiver (--target)
+ *
+ * Every TCP segment and UDP datagram waits for the one-way delay plus a
+ * random jitter, queues behind a bandwidth cap and is lost with the given
+ * probability. A lost TCP segment cannot vanish from the byte stream, so it
+ * arrives one retransmission timeout later instead: loss shows up on TCP as
+ * head-of-line blocking, the way it does on a real link. Datagrams are
+ * dropped, and also dropped when more than PIPE_QUEUE_US of them wait for
+ * the bandwidth cap (a router's tail drop).
+ *
+ * When the receiver hands out a UDP port (MSG_TRANSPORT), the proxy opens
+ * a relay port of its own and rewrites the reply, so sessions on the UDP
+ * transport go through the same conditions.
+ *
+ * Conditions come from a named profile or from flags. A script changes
+ * them over time, one step per line, counted from the start of each
+ * connection:
+ *
+ *   # seconds  settings (missing ones keep their value)
+ *   0    profile=wifi
+ *   5    loss=5 jitter=30
+ *   10   rate=2
+ *
+ * POSIX only.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <random>
+#include <functional>
+#include <memory>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include "protocol.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <signal.h>
+
+#define PIPE_SEGMENT 1448          // TCP bytes scheduled as one segment (Ethernet MSS)
+#define PIPE_BACKLOG_BYTES 4194304 // TCP bytes held at most before the reader stops (sender sees backpressure)
+#define PIPE_QUEUE_US 100000       // Datagrams queued behind the bandwidth cap at most this long
+#define PIPE_MIN_RTO_US 20000      // Shortest delay a lost TCP segment costs
+#define DATAGRAM_MAX 65536
+
+/**
+ * Network conditions in one direction
+ */
+struct Conditions
+{
+    double delay_ms;  // One-way delay
+    double jitter_ms; // Up to this much extra delay, uniformly distributed
+    double rate_mbit; // Bandwidth cap in Mbit/s, 0 = unlimited
+    double loss_pct;  // Probability of losing a segment or datagram
+};
+
+static const struct
+{
+    const char *name;
+    Conditions conditions;
+} PROFILES[] = {
+    {"none", {0, 0, 0, 0}},
+    {"lan", {0.5, 0.2, 1000, 0}},
+    {"wifi", {3, 4, 200, 0.5}},
+    {"busy-wifi", {8, 25, 40, 2}},
+    {"cellular", {35, 15, 15, 1}},
+    {"satellite", {300, 20, 10, 0.5}},
+};
+static const int PROFILE_COUNT = sizeof(PROFILES) / sizeof(PROFILES[0]);
+
+static bool findProfile(const std::string &name, Conditions &conditions)
+{
+    for (int i = 0; i < PROFILE_COUNT; i++)
+    {
+        if (name == PROFILES[i].name)
+        {
+            conditions = PROFILES[i].conditions;
+            return true;
+        }
+    }
+    std::cerr << "❌ Unknown profile: " << name << " (";
+    for (int i = 0; i < PROFILE_COUNT; i++)
+        std::cerr << (i ? ", " : "") << PROFILES[i].name;
+    std::cerr << ")" << std::endl;
+    return false;
+}
+
+/**
+ * Apply one `key=value` setting; false if it is not one
+ */
+static bool applySetting(const std::string &setting, Conditions &conditions)
+{
+    size_t equals = setting.find('=');
+    if (equals == std::string::npos)
+        return false;
+    std::string key = setting.substr(0, equals);
+    std::string value = setting.substr(equals + 1);
+    if (key == "profile")
+        return findProfile(value, conditions);
+
+    double number = atof(value.c_str());
+    if (key == "delay")
+        conditions.delay_ms = number;
+    else if (key == "jitter")
+        conditions.jitter_ms = number;
+    else if (key == "rate")
+        conditions.rate_mbit = number;
+    else if (key == "loss")
+        conditions.loss_pct = number;
+    else
+        return false;
+    return true;
+}
+
+/**
+ * Conditions over time: the base conditions, changed by script steps
+ */
+class Schedule
+{
+public:
+    explicit Schedule(const Conditions &base) { steps.push_back(Step(0, base)); }
+
+    bool load(const std::string &path)
+    {
+        std::ifstream in(path.c_str());
+        if (!in)
+        {
+            std::cerr << "❌ Could not read script " << path << std::endl;
+            return false;
+        }
+        std::string line;
+        int number = 0;
+        while (std::getline(in, line))
+        {
+            number++;
+            size_t hash = line.find('#');
+            if (hash != std::string::npos)
+                line.erase(hash);
+            std::istringstream fields(line);
+            double at_s;
+            if (!(fields >> at_s))
+                continue; // Blank or comment
+
+            Conditions conditions = steps.back().second;
+            std::string setting;
+            while (fields >> setting)
+            {
+                if (!applySetting(setting, conditions))
+                {
+                    std::cerr << "❌ " << path << ":" << number << ": bad setting " << setting << std::endl;
+                    return false;
+                }
+            }
+            if (at_s < steps.back().first)
+            {
+                std::cerr << "❌ " << path << ":" << number << ": steps must be in time order" << std::endl;
+                return false;
+            }
+            steps.push_back(Step(at_s, conditions));
+        }
+        return true;
+    }
+
+    // Conditions `seconds` into a connection
+    const Conditions &at(double seconds) const
+    {
+        size_t i = steps.size() - 1;
+        while (i > 0 && steps[i].first > seconds)
+            i--;
+        return steps[i].second;
+    }
+
+    size_t size() const { return steps.size(); }
+    const Conditions &first() const { return steps[0].second; }
+
+private:
+    typedef std::pair<double, Conditions> Step;
+    std::vector<Step> steps;
+};
+
+static std::string describe(const Conditions &c)
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1) << c.delay_ms << " ms + " << c.jitter_ms << " ms jitter, "
+        << (c.rate_mbit > 0 ? std::to_string((int)c.rate_mbit) + " Mbit/s" : std::string("unlimited")) << ", "
+        << std::setprecision(2) << c.loss_pct << "% loss";
+    return out.str();
+}
+
+/**
+ * One direction of the path
+ *
+ * submit() stamps every segment or datagram with its delivery time and
+ * queues it; run() delivers them when their time comes. A stream pipe
+ * (TCP) keeps the byte order, so a late segment holds back everything
+ * behind it; a datagram pipe delivers in time order, so jitter reorders.
+ */
+class Pipe
+{
+public:
+    Pipe(const Schedule &schedule, bool stream, uint32_t seed)
+        : schedule(schedule), stream(stream), random(seed), start_us(nowMicros()), link_free_us(0),
+          last_deliver_us(0), order(0), queued_bytes(0), closed(false), packets(0), bytes(0), lost(0),
+          dropped(0), retransmitted(0) {}
+
+    void submit(const uint8_t *data, size_t size)
+    {
+        for (size_t offset = 0; offset < size; offset += stream ? PIPE_SEGMENT : size)
+            enqueue(data + offset, stream && size - offset > PIPE_SEGMENT ? PIPE_SEGMENT : size - offset);
+    }
+
+    // Nothing more will be submitted; run() returns once the queue is empty
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        ready.notify_all();
+        space.notify_all();
+    }
+
+    // Deliver until closed and drained (true), or until `deliver` fails
+    bool run(const std::function<bool(const std::vector<uint8_t> &)> &deliver)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            if (queue.empty())
+            {
+                if (closed)
+                    break;
+                ready.wait(lock);
+                continue;
+            }
+            uint64_t now_us = nowMicros();
+            if (queue.top().deliver_us > now_us)
+            {
+                ready.wait_for(lock, std::chrono::microseconds(queue.top().deliver_us - now_us));
+                continue;
+            }
+
+            Packet packet = queue.top();
+            queue.pop();
+            queued_bytes -= packet.data.size();
+            space.notify_all();
+            lock.unlock();
+            bool ok = deliver(packet.data);
+            lock.lock();
+            if (!ok)
+            {
+                // The far end is gone; unblock the reader
+                closed = true;
+                while (!queue.empty())
+                    queue.pop();
+                space.notify_all();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void showSummary(const char *label) const
+    {
+        std::cout << label << ": " << packets << (stream ? " segments, " : " datagrams, ") << std::fixed
+                  << std::setprecision(2) << bytes / (1024.0 * 1024.0) << " MB";
+        if (stream)
+            std::cout << ", " << retransmitted << " delayed by loss";
+        else
+            std::cout << ", " << lost << " lost, " << dropped << " dropped at the bandwidth cap";
+        std::cout << std::endl;
+    }
+
+private:
+    struct Packet
+    {
+        uint64_t deliver_us;
+        uint64_t order;
+        std::vector<uint8_t> data;
+        bool operator<(const Packet &other) const
+        {
+            // priority_queue pops the largest: earliest time first, then submission order
+            return deliver_us != other.deliver_us ? deliver_us > other.deliver_us : order > other.order;
+        }
+    };
+
+    void enqueue(const uint8_t *data, size_t size)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (stream && !closed && queued_bytes > PIPE_BACKLOG_BYTES)
+            space.wait(lock);
+        if (closed)
+            return;
+
+        uint64_t now_us = nowMicros();
+        const Conditions &c = schedule.at((now_us - start_us) / 1e6);
+        packets++;
+        bytes += size;
+
+        // Serialization behind the bandwidth cap (bits / Mbit/s = microseconds)
+        uint64_t transmit_us = c.rate_mbit > 0 ? (uint64_t)(size * 8 / c.rate_mbit) : 0;
+        if (link_free_us < now_us)
+            link_free_us = now_us;
+        if (!stream && link_free_us - now_us > PIPE_QUEUE_US)
+        {
+            dropped++;
+            return;
+        }
+        link_free_us += transmit_us;
+
+        uint64_t delay_us = (uint64_t)(c.delay_ms * 1000);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        uint64_t deliver_us = link_free_us + delay_us + (uint64_t)(unit(random) * c.jitter_ms * 1000);
+        if (unit(random) * 100 < c.loss_pct)
+        {
+            if (!stream)
+            {
+                lost++;
+                return;
+            }
+            // Resent after about a round trip, at least the minimum RTO
+            uint64_t rto_us = 2 * delay_us + (uint64_t)(c.jitter_ms * 1000);
+            deliver_us += rto_us > PIPE_MIN_RTO_US ? rto_us : PIPE_MIN_RTO_US;
+            retransmitted++;
+        }
+        if (stream && deliver_us < last_deliver_us)
+            deliver_us = last_deliver_us;
+        last_deliver_us = deliver_us;
+
+        Packet packet;
+        packet.deliver_us = deliver_us;
+        packet.order = order++;
+        packet.data.assign(data, data + size);
+        queue.push(packet);
+        queued_bytes += size;
+        ready.notify_all();
+    }
+
+    const Schedule &schedule;
+    bool stream;
+    std::mt19937 random;
+    uint64_t start_us;
+    uint64_t link_free_us;    // When the bandwidth cap has sent everything queued so far
+    uint64_t last_deliver_us; // Stream order
+    uint64_t order;
+    std::priority_queue<Packet> queue;
+    size_t queued_bytes;
+    bool closed;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::condition_variable space;
+    uint64_t packets, bytes, lost, dropped, retransmitted;
+};
+
+static bool sendAllTo(int sock, const uint8_t *data, size_t size)
+{
+    size_t sent = 0;
+    while (sent < size)
+    {
+        ssize_t n = send(sock, data + sent, size - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        sent += n;
+    }
+    return true;
+}
+
+/**
+ * Relays the datagrams of a UDP transport session through a datagram pipe
+ */
+class UdpRelay
+{
+public:
+    UdpRelay(const Schedule &schedule, uint32_t seed)
+        : pipe(schedule, false, seed), in_sock(-1), out_sock(-1), stopping(false) {}
+    ~UdpRelay() { stop(); }
+
+    // Listen on an ephemeral port and forward to `target`; returns our port, 0 on failure
+    int start(const struct sockaddr_in &target)
+    {
+        in_sock = socket(AF_INET, SOCK_DGRAM, 0);
+        out_sock = socket(AF_INET, SOCK_DGRAM, 0);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        socklen_t len = sizeof(addr);
+        int buffer = 8 * 1024 * 1024;
+        setsockopt(in_sock, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+        setsockopt(out_sock, SOL_SOCKET, SO_SNDBUF, &buffer, sizeof(buffer));
+        struct timeval tv;
+        tv.tv_sec = 0;
+        tv.tv_usec = 100000;
+        setsockopt(in_sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        if (in_sock < 0 || out_sock < 0 || bind(in_sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+            getsockname(in_sock, (struct sockaddr *)&addr, &len) != 0 ||
+            connect(out_sock, (const struct sockaddr *)&target, sizeof(target)) != 0)
+            return 0;
+
+        reader = std::thread(&UdpRelay::readLoop, this);
+        writer = std::thread([this]() {
+            pipe.run([this](const std::vector<uint8_t> &datagram) {
+                send(out_sock, datagram.data(), datagram.size(), 0); // A refused datagram is just lost
+                return true;
+            });
+        });
+        return ntohs(addr.sin_port);
+    }
+
+    void stop()
+    {
+        stopping = true;
+        if (reader.joinable())
+            reader.join();
+        pipe.close();
+        if (writer.joinable())
+            writer.join();
+        if (in_sock >= 0)
+            close(in_sock);
+        if (out_sock >= 0)
+            close(out_sock);
+        in_sock = out_sock = -1;
+    }
+
+    void showSummary() const { pipe.showSummary("📶 sender → receiver (UDP)"); }
+
+private:
+    void readLoop()
+    {
+        std::vector<uint8_t> datagram(DATAGRAM_MAX);
+        while (true)
+        {
+            // Once stopping, take what is already queued and no more
+            ssize_t n = recv(in_sock, datagram.data(), datagram.size(), stopping ? MSG_DONTWAIT : 0);
+            if (n > 0)
+                pipe.submit(datagram.data(), n);
+            else if (stopping)
+                break;
+        }
+    }
+
+    Pipe pipe;
+    int in_sock, out_sock;
+    std::atomic<bool> stopping;
+    std::thread reader, writer;
+};
+
+/**
+ * Proxy one sender connection: both TCP directions through stream pipes,
+ * plus the UDP relay if the receiver hands out a port
+ */
+static void proxyConnection(int client, const struct sockaddr_in &target, const Schedule &schedule, uint32_t seed)
+{
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    if (server < 0 || connect(server, (const struct sockaddr *)&target, sizeof(target)) != 0)
+    {
+        std::cerr << "❌ Could not reach the receiver: " << strerror(errno) << std::endl;
+        if (server >= 0)
+            close(server);
+        return;
+    }
+    int one = 1;
+    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setsockopt(server, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    Pipe up(schedule, true, seed);
+    Pipe down(schedule, true, seed + 1);
+    std::unique_ptr<UdpRelay> relay;
+    std::mutex relay_mutex;
+
+    // Sender -> receiver: handshake and frames, passed through untouched
+    std::thread up_reader([&]() {
+        std::vector<uint8_t> buffer(65536);
+        ssize_t n;
+        while ((n = recv(client, buffer.data(), buffer.size(), 0)) > 0)
+            up.submit(buffer.data(), n);
+        up.close();
+    });
+    std::thread up_writer([&]() {
+        if (!up.run([&](const std::vector<uint8_t> &data) { return sendAllTo(server, data.data(), data.size()); }))
+            shutdown(client, SHUT_RDWR); // Receiver gone: let the sender notice
+        // Datagrams still on their way arrive before the end of the session
+        {
+            std::lock_guard<std::mutex> lock(relay_mutex);
+            if (relay)
+                relay->stop();
+        }
+        shutdown(server, SHUT_WR);
+    });
+
+    // Receiver -> sender: whole messages, so MSG_TRANSPORT can be rewritten
+    std::thread down_reader([&]() {
+        std::vector<uint8_t> buffer(65536);
+        std::vector<uint8_t> pending;
+        ssize_t n;
+        while ((n = recv(server, buffer.data(), buffer.size(), 0)) > 0)
+        {
+            pending.insert(pending.end(), buffer.begin(), buffer.begin() + n);
+            while (pending.size() >= MESSAGE_HEADER_SIZE)
+            {
+                MessageHeader header;
+                unpackHeader(pending.data(), header);
+                size_t length = MESSAGE_HEADER_SIZE + header.size;
+                if (pending.size() < length)
+                    break;
+                std::lock_guard<std::mutex> lock(relay_mutex);
+                if (header.type == MSG_TRANSPORT && header.frame_id != 0 && !relay)
+                {
+                    struct sockaddr_in udp_target = target;
+                    udp_target.sin_port = htons((uint16_t)header.frame_id);
+                    relay.reset(new UdpRelay(schedule, seed + 2));
+                    header.frame_id = relay->start(udp_target);
+                    packHeader(header, pending.data());
+                    std::cout << "📶 Relaying UDP port " << ntohs(udp_target.sin_port) << " via "
+                              << header.frame_id << std::endl;
+                }
+                down.submit(pending.data(), length);
+                pending.erase(pending.begin(), pending.begin() + length);
+            }
+        }
+        down.close();
+    });
+    std::thread down_writer([&]() {
+        down.run([&](const std::vector<uint8_t> &data) { return sendAllTo(client, data.data(), data.size()); });
+        shutdown(client, SHUT_WR);
+    });
+
+    up_reader.join();
+    up_writer.join();
+    // The receiver closes once the stream ended; make sure its reader wakes up
+    shutdown(server, SHUT_RD);
+    down_reader.join();
+    down_writer.join();
+
+    up.showSummary("⬆️  sender → receiver");
+    down.showSummary("⬇️  receiver → sender");
+    if (relay)
+        relay->showSummary();
+    close(server);
+}
+
+static bool parseAddress(const std::string &text, struct sockaddr_in &addr)
+{
+    size_t colon = text.rfind(':');
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    if (colon == std::string::npos)
+        return false;
+    addr.sin_port = htons(atoi(text.c_str() + colon + 1));
+    return inet_pton(AF_INET, text.substr(0, colon).c_str(), &addr.sin_addr) > 0 && addr.sin_port != 0;
+}
+
+static void usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " --listen <port> --target <ip:port> [options]\n"
+              << "  --profile <name>     starting conditions: none (default), lan, wifi, busy-wifi,\n"
+              << "                       cellular, satellite\n"
+              << "  --delay <ms>         one-way delay\n"
+              << "  --jitter <ms>        up to this much extra delay per packet\n"
+              << "  --rate <Mbit/s>      bandwidth cap, 0 = unlimited\n"
+              << "  --loss <percent>     packet loss\n"
+              << "  --script <file>      change the conditions over time (see impair.cpp)\n"
+              << "  --seed <n>           random seed (default 1), for repeatable runs\n"
+              << "  --once               exit after the first connection\n";
+}
+
+/**
+ * Main function
+ * Accepts sender connections one after another and proxies each to the
+ * receiver under the configured conditions
+ */
+int main(int argc, char *argv[])
+{
+    Conditions base = {0, 0, 0, 0};
+    Conditions overrides = {-1, -1, -1, -1};
+    std::string script_path;
+    struct sockaddr_in target;
+    bool have_target = false;
+    int listen_port = 0;
+    uint32_t seed = 1;
+    bool once = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--listen" && has_value)
+            listen_port = atoi(argv[++i]);
+        else if (arg == "--target" && has_value)
+        {
+            have_target = parseAddress(argv[++i], target);
+            if (!have_target)
+            {
+                std::cerr << "❌ Expected --target <ip>:<port>, got " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--profile" && has_value)
+        {
+            if (!findProfile(argv[++i], base))
+                return 1;
+        }
+        else if (arg == "--delay" && has_value)
+            overrides.delay_ms = atof(argv[++i]);
+        else if (arg == "--jitter" && has_value)
+            overrides.jitter_ms = atof(argv[++i]);
+        else if (arg == "--rate" && has_value)
+            overrides.rate_mbit = atof(argv[++i]);
+        else if (arg == "--loss" && has_value)
+            overrides.loss_pct = atof(argv[++i]);
+        else if (arg == "--script" && has_value)
+            script_path = argv[++i];
+        else if (arg == "--seed" && has_value)
+            seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (arg == "--once")
+            once = true;
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (listen_port <= 0 || !have_target)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Flags refine the profile
+    if (overrides.delay_ms >= 0)
+        base.delay_ms = overrides.delay_ms;
+    if (overrides.jitter_ms >= 0)
+        base.jitter_ms = overrides.jitter_ms;
+    if (overrides.rate_mbit >= 0)
+        base.rate_mbit = overrides.rate_mbit;
+    if (overrides.loss_pct >= 0)
+        base.loss_pct = overrides.loss_pct;
+    Schedule schedule(base);
+    if (!script_path.empty() && !schedule.load(script_path))
+        return 1;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(listen_port);
+    if (listener < 0 || bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, 5) != 0)
+    {
+        std::cerr << "❌ Could not listen on port " << listen_port << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+
+    char target_ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &target.sin_addr, target_ip, sizeof(target_ip));
+    std::cout << "🌧️  Impairing :" << listen_port << " → " << target_ip << ":" << ntohs(target.sin_port) << ", "
+              << describe(schedule.first());
+    if (schedule.size() > 1)
+        std::cout << ", " << schedule.size() - 1 << " scripted step(s)";
+    std::cout << std::endl;
+
+    while (true)
+    {
+        int client = accept(listener, NULL, NULL);
+        if (client < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            std::cerr << "❌ Accept failed: " << strerror(errno) << std::endl;
+            break;
+        }
+        std::cout << "🔗 Sender connected" << std::endl;
+        proxyConnection(client, target, schedule, seed);
+        close(client);
+        if (once)
+            break;
+    }
+    close(listener);
+    return 0;
+}
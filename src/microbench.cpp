@@ -0,0 +1,576 @@
+/**
+ * MICROBENCH.CPP - PER-KERNEL MICROBENCHMARK
+ *
+ * Times the hot loops of the sender and receiver one at a time, on frames
+ * from the synthetic sources, at tile and frame size:
+ *
+ *   pack32       - 32-bit to 24-bit pixel conversion (X11 capture), every SIMD level
+ *   hash_tile    - content hash of one tile
+ *   diff_frame   - change detection: hash every tile, compare with the last frame
+ *   memcmp_frame - the same comparison done with memcmp on identical frames
+ *                  (every byte compared), for reference
+ *   rle_encode / rle_decode - tile run-length coding
+ *   fdct / idct / quantize / dequantize / rgb_ycocg / ycocg_rgb - kernels
+ *                  of the lossy codec on one tile, every SIMD level (checked
+ *                  against scalar)
+ *   dct_encode / dct_decode - lossy tile codec, whole tiles
+ *   encode_key / decode_key - whole-frame tile codec, keyframes
+ *   encode_delta - whole-frame tile codec, alternating two consecutive frames
+ *
+ * The thread is pinned to one CPU; every kernel is warmed up first, then run
+ * in several timed batches of which the median is reported as ns per call,
+ * cycles per pixel (TSC, x86 only) and GB/s of input. Results can be written
+ * as CSV for comparing builds.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include "protocol.h"
+#include "capture.h"
+#include "codec.h"
+#include "simd.h"
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+
+#define DEFAULT_WARMUP_MS 100 // Untimed calls before each kernel
+#define DEFAULT_TIME_MS 500   // Timed budget per kernel, split over the runs
+#define DEFAULT_RUNS 5        // Timed batches per kernel (median reported)
+
+/**
+ * Command line configuration
+ */
+struct MicroConfig
+{
+    int width;
+    int height;
+    std::vector<std::string> patterns;
+    std::vector<std::string> kernels; // Empty = all
+    int cpu;
+    int runs;
+    int warmup_ms;
+    int time_ms;
+    int threads;
+    std::string output_path;
+};
+
+/**
+ * One measured kernel
+ */
+struct MicroResult
+{
+    std::string kernel;
+    std::string level;
+    std::string pattern;
+    int width, height;   // Pixels processed per call
+    double ns_per_call;
+    double cycles_per_pixel; // 0 without a TSC
+    double gb_per_s;
+};
+
+static std::vector<std::string> splitList(const std::string &list)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        if (!item.empty())
+            items.push_back(item);
+    }
+    return items;
+}
+
+static uint64_t readCycles()
+{
+#ifdef HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static bool pinToCpu(int cpu)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+// Keeps results alive so the compiler cannot drop a kernel call
+static volatile uint64_t g_sink;
+
+class MicroBench
+{
+public:
+    explicit MicroBench(const MicroConfig &config) : config(config) {}
+
+    bool wanted(const std::string &kernel) const
+    {
+        if (config.kernels.empty())
+            return true;
+        return std::find(config.kernels.begin(), config.kernels.end(), kernel) != config.kernels.end();
+    }
+
+    /**
+     * Warm up, size the batches from the warmup rate, then time `runs`
+     * batches and keep the median
+     */
+    void measure(const std::string &kernel, const std::string &level, const std::string &pattern,
+                 int width, int height, size_t bytes, const std::function<void()> &call)
+    {
+        if (!wanted(kernel))
+            return;
+
+        uint64_t warmup_start = nowMicros();
+        uint64_t warmup_calls = 0;
+        do
+        {
+            call();
+            warmup_calls++;
+        } while (nowMicros() - warmup_start < (uint64_t)config.warmup_ms * 1000);
+
+        double us_per_call = (double)(nowMicros() - warmup_start) / warmup_calls;
+        uint64_t batch = (uint64_t)(config.time_ms * 1000.0 / config.runs / us_per_call);
+        if (batch < 1)
+            batch = 1;
+
+        std::vector<double> ns(config.runs), cycles(config.runs);
+        for (int run = 0; run < config.runs; run++)
+        {
+            uint64_t start = nowMicros();
+            uint64_t cycle_start = readCycles();
+            for (uint64_t i = 0; i < batch; i++)
+                call();
+            cycles[run] = (double)(readCycles() - cycle_start) / batch;
+            ns[run] = (nowMicros() - start) * 1000.0 / batch;
+        }
+        std::sort(ns.begin(), ns.end());
+        std::sort(cycles.begin(), cycles.end());
+
+        MicroResult result;
+        result.kernel = kernel;
+        result.level = level;
+        result.pattern = pattern;
+        result.width = width;
+        result.height = height;
+        result.ns_per_call = ns[config.runs / 2];
+        result.cycles_per_pixel = cycles[config.runs / 2] / ((double)width * height);
+        result.gb_per_s = result.ns_per_call > 0 ? bytes / result.ns_per_call : 0;
+        results.push_back(result);
+        print(result);
+    }
+
+    const std::vector<MicroResult> &all() const { return results; }
+
+private:
+    static void print(const MicroResult &result)
+    {
+        std::ostringstream size;
+        size << result.width << "x" << result.height;
+        std::cout << "⏲️  " << std::left << std::setw(13) << result.kernel << std::setw(7) << result.level
+                  << std::setw(8) << result.pattern << std::setw(10) << size.str() << std::right
+                  << std::fixed << std::setprecision(0) << std::setw(10) << result.ns_per_call << " ns"
+                  << std::setprecision(2) << std::setw(8) << result.cycles_per_pixel << " cyc/px"
+                  << std::setw(8) << result.gb_per_s << " GB/s" << std::endl;
+    }
+
+    const MicroConfig &config;
+    std::vector<MicroResult> results;
+};
+
+/**
+ * All kernels on two consecutive frames of one synthetic pattern
+ */
+static bool benchPattern(MicroBench &bench, const MicroConfig &config, const std::string &pattern)
+{
+    std::unique_ptr<CaptureSource> source = createCaptureSource("synthetic:" + pattern, config.width, config.height);
+    if (!source)
+        return false;
+
+    const int width = config.width;
+    const int height = config.height;
+    const size_t frame_size = source->frameSize();
+    const size_t stride = (size_t)width * BYTES_PER_PIXEL;
+    const size_t pixels = (size_t)width * height;
+
+    std::vector<uint8_t> frame_a(frame_size), frame_b(frame_size);
+    source->grab(frame_a.data());
+    source->grab(frame_b.data());
+
+    // 32-bit version of the frame as an X server would hand it over
+    std::vector<uint8_t> frame32(pixels * 4), packed(frame_size);
+    for (size_t i = 0; i < pixels; i++)
+    {
+        memcpy(&frame32[i * 4], &frame_a[i * BYTES_PER_PIXEL], BYTES_PER_PIXEL);
+        frame32[i * 4 + 3] = 0xFF;
+    }
+    for (int level = 0; level < SIMD_LEVEL_COUNT; level++)
+    {
+        PackPixelsFn pack = packPixels32Kernel(level);
+        if (!pack)
+            continue;
+        bench.measure("pack32", simdLevelName(level), pattern, width, height, pixels * 4, [&]()
+                      { pack(frame32.data(), packed.data(), pixels); });
+        if (bench.wanted("pack32") && memcmp(packed.data(), frame_a.data(), frame_size) != 0)
+        {
+            std::cerr << "❌ pack32 (" << simdLevelName(level) << ") produced wrong pixels" << std::endl;
+            return false;
+        }
+    }
+
+    // Tile kernels cycle through the tiles of the frame
+    TileGrid grid(width, height);
+    int tile_index = 0;
+    auto nextTile = [&](int &x, int &y, int &w, int &h)
+    {
+        grid.rect(tile_index, x, y, w, h);
+        tile_index = (tile_index + 1) % grid.count();
+    };
+
+    const size_t tile_pixels = (size_t)TILE_SIZE * TILE_SIZE;
+    bench.measure("hash_tile", "base", pattern, TILE_SIZE, TILE_SIZE, tile_pixels * BYTES_PER_PIXEL, [&]()
+                  {
+                      int x, y, w, h;
+                      nextTile(x, y, w, h);
+                      g_sink = g_sink + hashTile(&frame_a[y * stride + (size_t)x * BYTES_PER_PIXEL], stride, w, h);
+                  });
+
+    std::vector<uint64_t> hashes(grid.count());
+    for (int i = 0; i < grid.count(); i++)
+    {
+        int x, y, w, h;
+        grid.rect(i, x, y, w, h);
+        hashes[i] = hashTile(&frame_a[y * stride + (size_t)x * BYTES_PER_PIXEL], stride, w, h);
+    }
+    bench.measure("diff_frame", "base", pattern, width, height, frame_size, [&]()
+                  {
+                      uint64_t changed = 0;
+                      for (int i = 0; i < grid.count(); i++)
+                      {
+                          int x, y, w, h;
+                          grid.rect(i, x, y, w, h);
+                          changed += hashTile(&frame_b[y * stride + (size_t)x * BYTES_PER_PIXEL], stride, w, h) != hashes[i];
+                      }
+                      g_sink = g_sink + changed;
+                  });
+    // The memcmp baseline runs on two identical frames: it stops at the first
+    // difference, so only then does it read both frames in full, as hashing does
+    std::vector<uint8_t> frame_copy(frame_a);
+    bench.measure("memcmp_frame", "base", pattern, width, height, frame_size * 2, [&]()
+                  {
+                      uint64_t changed = 0;
+                      for (int i = 0; i < grid.count(); i++)
+                      {
+                          int x, y, w, h;
+                          grid.rect(i, x, y, w, h);
+                          size_t offset = y * stride + (size_t)x * BYTES_PER_PIXEL;
+                          for (int row = 0; row < h; row++, offset += stride)
+                          {
+                              if (memcmp(&frame_a[offset], &frame_copy[offset], (size_t)w * BYTES_PER_PIXEL) != 0)
+                              {
+                                  changed++;
+                                  break;
+                              }
+                          }
+                      }
+                      g_sink = g_sink + changed;
+                  });
+
+    // RLE on gathered tiles, as the encoder does
+    std::vector<std::vector<uint8_t> > tiles(grid.count()), encoded(grid.count());
+    for (int i = 0; i < grid.count(); i++)
+    {
+        int x, y, w, h;
+        grid.rect(i, x, y, w, h);
+        tiles[i].resize((size_t)w * h * BYTES_PER_PIXEL);
+        for (int row = 0; row < h; row++)
+            memcpy(&tiles[i][(size_t)row * w * BYTES_PER_PIXEL],
+                   &frame_a[(y + row) * stride + (size_t)x * BYTES_PER_PIXEL], (size_t)w * BYTES_PER_PIXEL);
+        encoded[i].resize(rleBound((size_t)w * h));
+        encoded[i].resize(rleEncode(tiles[i].data(), (size_t)w * h, encoded[i].data()));
+    }
+    std::vector<uint8_t> rle_out(rleBound(tile_pixels)), tile_out(tile_pixels * BYTES_PER_PIXEL);
+    int rle_index = 0;
+    bench.measure("rle_encode", "base", pattern, TILE_SIZE, TILE_SIZE, tile_pixels * BYTES_PER_PIXEL, [&]()
+                  {
+                      const std::vector<uint8_t> &tile = tiles[rle_index];
+                      rle_index = (rle_index + 1) % grid.count();
+                      g_sink = g_sink + rleEncode(tile.data(), tile.size() / BYTES_PER_PIXEL, rle_out.data());
+                  });
+    rle_index = 0;
+    bench.measure("rle_decode", "base", pattern, TILE_SIZE, TILE_SIZE, tile_pixels * BYTES_PER_PIXEL, [&]()
+                  {
+                      const std::vector<uint8_t> &rle = encoded[rle_index];
+                      size_t count = tiles[rle_index].size() / BYTES_PER_PIXEL;
+                      rle_index = (rle_index + 1) % grid.count();
+                      g_sink = g_sink + rleDecode(rle.data(), rle.size(), tile_out.data(), count);
+                  });
+
+    // Lossy codec kernels on the first tile: its pixels for the colour
+    // transform, its green channel as 64 blocks of samples for the rest
+    const size_t dct_values = tile_pixels;
+    const size_t chroma_values = tile_pixels / 4;
+    std::vector<int16_t> samples(dct_values), result(dct_values), chroma(2 * chroma_values);
+    std::vector<uint8_t> rgb(tile_pixels * BYTES_PER_PIXEL), reference;
+    for (size_t i = 0; i < dct_values; i++)
+    {
+        size_t x = i % 8 + (i / 64) % 8 * 8, y = i / 8 % 8 + i / 512 * 8;
+        samples[i] = (int16_t)(frame_a[y * stride + x * BYTES_PER_PIXEL + 1] - 128);
+    }
+    std::vector<uint16_t> half(64, 8), recip(64, 65536 / 16), steps(64, 16);
+    const size_t tile_row = (size_t)TILE_SIZE * BYTES_PER_PIXEL;
+    const char *dct_kernels[] = {"fdct", "idct", "quantize", "dequantize", "rgb_ycocg", "ycocg_rgb"};
+    for (int kernel = 0; kernel < 6; kernel++)
+    {
+        for (int level = 0; level < SIMD_LEVEL_COUNT; level++)
+        {
+            std::function<void()> call;
+            Dct8x8Fn transform = kernel == 0 ? fdct8x8Kernel(level) : kernel == 1 ? idct8x8Kernel(level) : NULL;
+            QuantizeFn quantize = kernel == 2 ? quantizeKernel(level) : NULL;
+            DequantizeFn dequantize = kernel == 3 ? dequantizeKernel(level) : NULL;
+            ToYCoCgFn to_ycocg = kernel == 4 ? rgbToYCoCgKernel(level) : NULL;
+            FromYCoCgFn from_ycocg = kernel == 5 ? yCoCgToRgbKernel(level) : NULL;
+            if (transform)
+                call = [&]() { transform(samples.data(), result.data(), dct_values / 64); };
+            else if (quantize)
+                call = [&]() { quantize(samples.data(), result.data(), half.data(), recip.data(), dct_values / 64); };
+            else if (dequantize)
+                call = [&]() { dequantize(samples.data(), result.data(), steps.data(), dct_values / 64); };
+            else if (to_ycocg)
+                call = [&]()
+                {
+                    for (int y = 0; y < TILE_SIZE; y += 2)
+                        to_ycocg(&frame_a[y * stride], &frame_a[(y + 1) * stride], &result[y * TILE_SIZE],
+                                 &result[(y + 1) * TILE_SIZE], &chroma[y / 2 * (TILE_SIZE / 2)],
+                                 &chroma[chroma_values + y / 2 * (TILE_SIZE / 2)], TILE_SIZE);
+                };
+            else if (from_ycocg)
+                call = [&]()
+                {
+                    for (int y = 0; y < TILE_SIZE; y += 2)
+                        from_ycocg(&samples[y * TILE_SIZE], &samples[(y + 1) * TILE_SIZE],
+                                   &samples[y / 2 * (TILE_SIZE / 2)], &samples[chroma_values + y / 2 * (TILE_SIZE / 2)],
+                                   &rgb[y * tile_row], &rgb[(y + 1) * tile_row], TILE_SIZE);
+                };
+            else
+                continue;
+            bench.measure(dct_kernels[kernel], simdLevelName(level), pattern, TILE_SIZE, TILE_SIZE,
+                          kernel >= 4 ? rgb.size() : dct_values * sizeof(int16_t), call);
+            if (!bench.wanted(dct_kernels[kernel]))
+                continue;
+
+            // Every level must give the scalar kernel's output
+            std::fill(result.begin(), result.end(), 0);
+            std::fill(chroma.begin(), chroma.end(), 0);
+            std::fill(rgb.begin(), rgb.end(), 0);
+            call();
+            std::vector<uint8_t> output((const uint8_t *)result.data(), (const uint8_t *)(result.data() + result.size()));
+            output.insert(output.end(), (const uint8_t *)chroma.data(), (const uint8_t *)(chroma.data() + chroma.size()));
+            output.insert(output.end(), rgb.begin(), rgb.end());
+            if (level == SIMD_SCALAR)
+                reference = output;
+            else if (output != reference)
+            {
+                std::cerr << "❌ " << dct_kernels[kernel] << " (" << simdLevelName(level) << ") differs from scalar"
+                          << std::endl;
+                return false;
+            }
+        }
+    }
+
+    // Lossy codec on the full tiles of the frame
+    std::vector<int> full_tiles;
+    for (int i = 0; i < grid.count(); i++)
+    {
+        int x, y, w, h;
+        grid.rect(i, x, y, w, h);
+        if (w == TILE_SIZE && h == TILE_SIZE)
+            full_tiles.push_back(i);
+    }
+    if (!full_tiles.empty())
+    {
+        DctTileCoder coder;
+        std::vector<std::vector<uint8_t> > lossy(full_tiles.size());
+        for (size_t i = 0; i < full_tiles.size(); i++)
+        {
+            lossy[i].resize(tile_pixels * BYTES_PER_PIXEL);
+            lossy[i].resize(coder.encode(tiles[full_tiles[i]].data(), TILE_SIZE * BYTES_PER_PIXEL, 75, lossy[i].data(),
+                                         lossy[i].size()));
+        }
+        size_t dct_index = 0;
+        bench.measure("dct_encode", "base", pattern, TILE_SIZE, TILE_SIZE, tile_pixels * BYTES_PER_PIXEL, [&]()
+                      {
+                          const std::vector<uint8_t> &tile = tiles[full_tiles[dct_index]];
+                          dct_index = (dct_index + 1) % full_tiles.size();
+                          g_sink = g_sink + coder.encode(tile.data(), TILE_SIZE * BYTES_PER_PIXEL, 75, rle_out.data(),
+                                                         tile.size());
+                      });
+        dct_index = 0;
+        bench.measure("dct_decode", "base", pattern, TILE_SIZE, TILE_SIZE, tile_pixels * BYTES_PER_PIXEL, [&]()
+                      {
+                          const std::vector<uint8_t> &data = lossy[dct_index];
+                          dct_index = (dct_index + 1) % full_tiles.size();
+                          g_sink = g_sink + coder.decode(data.data(), data.size(), tile_out.data(),
+                                                         TILE_SIZE * BYTES_PER_PIXEL);
+                      });
+    }
+
+    // Whole-frame tile codec
+    std::string threads = config.threads > 1 ? "t" + std::to_string(config.threads) : "base";
+    FrameEncoder encoder(CODEC_TILE, width, height, config.threads);
+    EncodedFrame out;
+    bench.measure("encode_key", threads, pattern, width, height, frame_size, [&]()
+                  {
+                      encoder.encode(frame_a.data(), true, out);
+                      g_sink = g_sink + out.size;
+                  });
+    bool flip = false;
+    bench.measure("encode_delta", threads, pattern, width, height, frame_size, [&]()
+                  {
+                      flip = !flip;
+                      encoder.encode(flip ? frame_b.data() : frame_a.data(), false, out);
+                      g_sink = g_sink + out.size;
+                  });
+
+    encoder.encode(frame_a.data(), true, out);
+    std::vector<uint8_t> keyframe(out.data, out.data + out.size);
+    FrameDecoder decoder(CODEC_TILE, width, height, config.threads);
+    std::vector<uint8_t> decoded(frame_size);
+    bench.measure("decode_key", threads, pattern, width, height, frame_size, [&]()
+                  { g_sink = g_sink + decoder.decode(keyframe.data(), keyframe.size(), true, decoded.data()); });
+    if (bench.wanted("decode_key") && memcmp(decoded.data(), frame_a.data(), frame_size) != 0)
+    {
+        std::cerr << "❌ decode_key produced wrong pixels" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static void usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --size <WxH>            frame size (default 1920x1080)\n"
+              << "  --patterns <name,...>   synthetic patterns (default typing,noise)\n"
+              << "  --kernels <name,...>    only these kernels (default all)\n"
+              << "  --cpu <n>               pin to this CPU, -1 = no pinning (default 0)\n"
+              << "  --runs <n>              timed batches per kernel (default " << DEFAULT_RUNS << ")\n"
+              << "  --warmup-ms <n>         warmup per kernel (default " << DEFAULT_WARMUP_MS << ")\n"
+              << "  --time-ms <n>           timed budget per kernel (default " << DEFAULT_TIME_MS << ")\n"
+              << "  --threads <n>           codec worker threads (default 1)\n"
+              << "  --output <file>         also write CSV results\n";
+}
+
+/**
+ * Main function
+ * Parses options, pins the thread and runs every kernel on every pattern
+ */
+int main(int argc, char *argv[])
+{
+    MicroConfig config;
+    config.width = 1920;
+    config.height = 1080;
+    config.patterns = splitList("typing,noise");
+    config.cpu = 0;
+    config.runs = DEFAULT_RUNS;
+    config.warmup_ms = DEFAULT_WARMUP_MS;
+    config.time_ms = DEFAULT_TIME_MS;
+    config.threads = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--size" && has_value)
+        {
+            if (sscanf(argv[++i], "%dx%d", &config.width, &config.height) != 2 ||
+                config.width <= 0 || config.height <= 0)
+            {
+                std::cerr << "❌ Bad size: " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--patterns" && has_value)
+            config.patterns = splitList(argv[++i]);
+        else if (arg == "--kernels" && has_value)
+            config.kernels = splitList(argv[++i]);
+        else if (arg == "--cpu" && has_value)
+            config.cpu = atoi(argv[++i]);
+        else if (arg == "--runs" && has_value)
+            config.runs = std::max(1, atoi(argv[++i]));
+        else if (arg == "--warmup-ms" && has_value)
+            config.warmup_ms = std::max(0, atoi(argv[++i]));
+        else if (arg == "--time-ms" && has_value)
+            config.time_ms = std::max(1, atoi(argv[++i]));
+        else if (arg == "--threads" && has_value)
+            config.threads = std::max(1, atoi(argv[++i]));
+        else if (arg == "--output" && has_value)
+            config.output_path = argv[++i];
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::cout << "========================================" << std::endl;
+    std::cout << "🔬 RGM KERNEL MICROBENCHMARK" << std::endl;
+    std::cout << "========================================" << std::endl;
+    std::cout << "Frame:   " << config.width << "x" << config.height << ", tiles " << TILE_SIZE << "x" << TILE_SIZE << std::endl;
+    std::cout << "SIMD:    " << simdLevelName(detectedSimdLevel()) << " (active "
+              << simdLevelName(activeSimdLevel()) << ")" << std::endl;
+    if (config.cpu >= 0)
+        std::cout << "CPU:     " << (pinToCpu(config.cpu) ? "pinned to " : "could not pin to ") << config.cpu << std::endl;
+#ifndef HAVE_TSC
+    std::cout << "Cycles:  no TSC on this platform, cyc/px reads 0" << std::endl;
+#endif
+    std::cout << "========================================" << std::endl;
+
+    MicroBench bench(config);
+    for (size_t p = 0; p < config.patterns.size(); p++)
+    {
+        if (!benchPattern(bench, config, config.patterns[p]))
+            return 1;
+    }
+
+    if (!config.output_path.empty())
+    {
+        std::ofstream out(config.output_path.c_str());
+        if (!out)
+        {
+            std::cerr << "❌ Could not write " << config.output_path << std::endl;
+            return 1;
+        }
+        out << "kernel,level,pattern,width,height,ns_per_call,cycles_per_pixel,gb_s\n";
+        const std::vector<MicroResult> &results = bench.all();
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const MicroResult &r = results[i];
+            out << r.kernel << "," << r.level << "," << r.pattern << "," << r.width << "," << r.height << ","
+                << std::fixed << std::setprecision(1) << r.ns_per_call << "," << std::setprecision(3)
+                << r.cycles_per_pixel << "," << r.gb_per_s << "\n";
+        }
+        std::cout << "📄 " << results.size() << " results written to " << config.output_path << std::endl;
+    }
+    return 0;
+}
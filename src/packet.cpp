@@ -0,0 +1,618 @@
+/**
+ * PACKET.CPP - DATAGRAM PACKETIZER AND FRAME REASSEMBLY
+ */
+#include "packet.h"
+#include <cstring>
+
+#define PACKET_GAP_MAX 4096 // Sequence gaps tracked at most (older ones are hopeless anyway)
+
+void packPacketHeader(const PacketHeader &header, uint8_t *out)
+{
+    putU32(out + 0, header.magic);
+    putU32(out + 4, header.stream);
+    out[8] = header.type;
+    out[9] = header.flags;
+    out[10] = (uint8_t)(header.index >> 8);
+    out[11] = (uint8_t)header.index;
+    out[12] = (uint8_t)(header.count >> 8);
+    out[13] = (uint8_t)header.count;
+    out[14] = (uint8_t)(header.group >> 8);
+    out[15] = (uint8_t)header.group;
+    putU32(out + 16, header.seq);
+    putU32(out + 20, header.frame_id);
+    putU32(out + 24, header.offset);
+    putU32(out + 28, header.frame_size);
+    putU32(out + 32, header.frame_flags);
+    putU64(out + 36, header.timestamp_us);
+}
+
+bool unpackPacketHeader(const uint8_t *in, size_t size, PacketHeader &header)
+{
+    if (size < PACKET_HEADER_SIZE || getU32(in) != PACKET_MAGIC)
+        return false;
+    header.magic = PACKET_MAGIC;
+    header.stream = getU32(in + 4);
+    header.type = in[8];
+    header.flags = in[9];
+    header.index = (uint16_t)((in[10] << 8) | in[11]);
+    header.count = (uint16_t)((in[12] << 8) | in[13]);
+    header.group = (uint16_t)((in[14] << 8) | in[15]);
+    header.seq = getU32(in + 16);
+    header.frame_id = getU32(in + 20);
+    header.offset = getU32(in + 24);
+    header.frame_size = getU32(in + 28);
+    header.frame_flags = getU32(in + 32);
+    header.timestamp_us = getU64(in + 36);
+    return true;
+}
+
+// Packets of a frame: its fragments plus one parity packet per FEC group
+static uint32_t framePackets(uint32_t count, uint32_t group)
+{
+    return count + (group > 0 ? (count + group - 1) / group : 0);
+}
+
+// ============================================================================
+// PACKETIZER
+// ============================================================================
+
+FramePacketizer::FramePacketizer(uint32_t stream)
+    : stream_id(stream), next_seq(0), align_codec(-1), fec_group(0), history(PACKET_HISTORY)
+{
+}
+
+/**
+ * Decide where the fragments of a frame start and end
+ */
+void FramePacketizer::cut(const MessageHeader &frame, const uint8_t *payload)
+{
+    cuts.clear();
+    cut_flags.clear();
+    size_t size = frame.size;
+    if (size == 0)
+    {
+        cuts.push_back(std::make_pair(0u, 0u));
+        cut_flags.push_back(0);
+        return;
+    }
+
+    if (align_codec != CODEC_TILE || size < 4)
+    {
+        uint8_t flags = align_codec == CODEC_RAW ? PACKET_FLAG_RECORD_START : 0;
+        for (size_t offset = 0; offset < size; offset += PACKET_PAYLOAD_MAX)
+        {
+            size_t length = size - offset < PACKET_PAYLOAD_MAX ? size - offset : PACKET_PAYLOAD_MAX;
+            cuts.push_back(std::make_pair((uint32_t)offset, (uint32_t)length));
+            cut_flags.push_back(flags);
+        }
+        return;
+    }
+
+    // End each fragment at the last record boundary that fits; records
+    // larger than a fragment continue in unflagged ones
+    size_t start = 0;
+    size_t record = 4; // Next record boundary not yet passed
+    bool at_record = true;
+    while (start < size)
+    {
+        size_t limit = start + PACKET_PAYLOAD_MAX;
+        size_t end = size;
+        bool ends_at_record = true;
+        if (limit < size)
+        {
+            size_t boundary = 0;
+            while (record <= limit)
+            {
+                if (record > start)
+                    boundary = record;
+                if (size - record < TILE_RECORD_HEADER)
+                {
+                    record = size;
+                    break;
+                }
+                size_t length = getU32(payload + record + 5);
+                record = length > size - record - TILE_RECORD_HEADER ? size : record + TILE_RECORD_HEADER + length;
+            }
+            end = boundary != 0 ? boundary : limit;
+            ends_at_record = boundary != 0;
+        }
+
+        cuts.push_back(std::make_pair((uint32_t)start, (uint32_t)(end - start)));
+        cut_flags.push_back(at_record ? PACKET_FLAG_RECORD_START : 0);
+        at_record = ends_at_record;
+        start = end;
+    }
+}
+
+uint32_t FramePacketizer::packetize(const MessageHeader &frame, const uint8_t *payload)
+{
+    uint32_t first = next_seq;
+    cut(frame, payload);
+    if (cuts.size() > 0xFFFF)
+        return first; // Larger than any frame maxEncodedSize() allows
+
+    PacketHeader header = {};
+    header.magic = PACKET_MAGIC;
+    header.stream = stream_id;
+    header.type = PKT_DATA;
+    header.count = (uint16_t)cuts.size();
+    header.group = (uint16_t)fec_group;
+    header.frame_id = frame.frame_id;
+    header.frame_size = frame.size;
+    header.frame_flags = frame.flags;
+    header.timestamp_us = frame.timestamp_us;
+
+    for (size_t i = 0; i < cuts.size(); i++)
+    {
+        size_t offset = cuts[i].first;
+        size_t length = cuts[i].second;
+        header.index = (uint16_t)i;
+        header.flags = cut_flags[i];
+        header.seq = next_seq;
+        header.offset = (uint32_t)offset;
+
+        std::vector<uint8_t> &datagram = history[next_seq % PACKET_HISTORY];
+        datagram.resize(PACKET_HEADER_SIZE + length);
+        packPacketHeader(header, datagram.data());
+        if (length > 0)
+            memcpy(datagram.data() + PACKET_HEADER_SIZE, payload + offset, length);
+        next_seq++;
+
+        if (fec_group > 0 && ((i + 1) % fec_group == 0 || i + 1 == cuts.size()))
+            addParity(header, i - i % fec_group, i + 1, payload);
+    }
+    return first;
+}
+
+/**
+ * XOR the blocks of fragments [first, end) into one PKT_PARITY datagram
+ */
+void FramePacketizer::addParity(PacketHeader header, size_t first, size_t end, const uint8_t *payload)
+{
+    size_t longest = 0;
+    for (size_t i = first; i < end; i++)
+        longest = cuts[i].second > longest ? cuts[i].second : longest;
+
+    header.type = PKT_PARITY;
+    header.flags = 0;
+    header.index = (uint16_t)first;
+    header.seq = next_seq;
+    header.offset = 0;
+
+    std::vector<uint8_t> &datagram = history[next_seq % PACKET_HISTORY];
+    datagram.assign(PACKET_HEADER_SIZE + PACKET_PARITY_BLOCK + longest, 0);
+    packPacketHeader(header, datagram.data());
+    uint8_t *block = datagram.data() + PACKET_HEADER_SIZE;
+    for (size_t i = first; i < end; i++)
+    {
+        uint8_t head[PACKET_PARITY_BLOCK];
+        head[0] = (uint8_t)(cuts[i].second >> 8);
+        head[1] = (uint8_t)cuts[i].second;
+        head[2] = cut_flags[i];
+        putU32(head + 3, cuts[i].first);
+        for (size_t b = 0; b < PACKET_PARITY_BLOCK; b++)
+            block[b] ^= head[b];
+        const uint8_t *data = payload + cuts[i].first;
+        uint8_t *out = block + PACKET_PARITY_BLOCK;
+        for (size_t b = 0; b < cuts[i].second; b++)
+            out[b] ^= data[b];
+    }
+    next_seq++;
+}
+
+const std::vector<uint8_t> *FramePacketizer::packet(uint32_t seq) const
+{
+    if (next_seq - seq > PACKET_HISTORY || seq - next_seq < 0x80000000u)
+        return NULL; // Overwritten already, or not sent yet
+    return &history[seq % PACKET_HISTORY];
+}
+
+std::vector<uint8_t> FramePacketizer::control(PacketType type, const uint8_t *payload, size_t size,
+                                              uint32_t frame_id) const
+{
+    PacketHeader header = {};
+    header.magic = PACKET_MAGIC;
+    header.stream = stream_id;
+    header.type = type;
+    header.frame_id = frame_id;
+    header.seq = next_seq; // Lets receivers spot data packets lost before it
+
+    std::vector<uint8_t> datagram(PACKET_HEADER_SIZE + size);
+    packPacketHeader(header, datagram.data());
+    if (size > 0)
+        memcpy(datagram.data() + PACKET_HEADER_SIZE, payload, size);
+    return datagram;
+}
+
+// ============================================================================
+// REASSEMBLY
+// ============================================================================
+
+FrameReassembler::FrameReassembler(bool conceal) : conceal(conceal)
+{
+    reset();
+}
+
+void FrameReassembler::reset()
+{
+    while (!pending.empty())
+    {
+        spare.push_back(std::vector<uint8_t>());
+        spare.back().swap(pending.begin()->second.data);
+        pending.erase(pending.begin());
+    }
+    gaps.clear();
+    have_seq = false;
+    highest_seq = 0;
+    have_last = false;
+    last_frame = 0;
+    waiting_key = !conceal;
+    frames_lost = 0;
+    frames_concealed = 0;
+    packets_repaired = 0;
+    packets_recovered = 0;
+}
+
+/**
+ * Frames from `first_frame` on are of a new resolution or codec: what is
+ * pending belongs to the old one, and so does anything older arriving late.
+ * Sequence tracking and the counters carry on.
+ */
+void FrameReassembler::restart(uint32_t first_frame)
+{
+    while (!pending.empty())
+        drop(pending.begin());
+    have_last = true;
+    last_frame = first_frame - 1;
+}
+
+/**
+ * Track which sequence numbers have not shown up yet
+ */
+void FrameReassembler::noteSeq(uint32_t seq)
+{
+    if (!have_seq)
+    {
+        have_seq = true;
+        highest_seq = seq;
+        return;
+    }
+
+    if ((int32_t)(seq - highest_seq) > 0)
+    {
+        uint32_t from = highest_seq + 1;
+        if (seq - from > PACKET_GAP_MAX)
+            from = seq - PACKET_GAP_MAX;
+        for (uint32_t s = from; s != seq; s++)
+        {
+            Missing gap = {0, 0};
+            gaps[s] = gap;
+        }
+        highest_seq = seq;
+    }
+    else
+    {
+        gaps.erase(seq);
+    }
+}
+
+void FrameReassembler::drop(PendingIt it)
+{
+    // Nothing of this frame is worth asking for any more
+    Pending &frame = it->second;
+    gaps.erase(gaps.lower_bound(frame.first_seq), gaps.lower_bound(frame.first_seq + frame.seq_count));
+    frames_lost++;
+    spare.push_back(std::vector<uint8_t>());
+    spare.back().swap(frame.data);
+    pending.erase(it);
+}
+
+/**
+ * The pending frame a packet belongs to, created on its first packet
+ */
+FrameReassembler::PendingIt FrameReassembler::open(const PacketHeader &header, uint64_t now_us)
+{
+    PendingIt it = pending.find(header.frame_id);
+    if (it != pending.end())
+        return it;
+
+    if (pending.size() >= PACKET_PENDING_FRAMES)
+    {
+        drop(pending.begin());
+        waiting_key = !conceal;
+    }
+
+    // Parity packets follow their group, and one follows every group before
+    uint32_t group = header.group;
+    uint32_t first_seq = header.seq - header.index;
+    if (group > 0 && header.type == PKT_DATA)
+        first_seq -= header.index / group;
+    else if (group > 0)
+        first_seq -= (header.index + group < header.count ? header.index + group : header.count) - header.index +
+                     header.index / group;
+
+    it = pending.insert(std::make_pair(header.frame_id, Pending())).first;
+    Pending &frame = it->second;
+    frame.frame_size = header.frame_size;
+    frame.flags = header.frame_flags;
+    frame.timestamp_us = header.timestamp_us;
+    frame.count = header.count;
+    frame.received = 0;
+    frame.group = header.group;
+    frame.first_seq = first_seq;
+    frame.seq_count = framePackets(header.count, group);
+    frame.first_us = now_us;
+    frame.have.assign(header.count, false);
+    frame.offsets.resize(header.count);
+    frame.lengths.resize(header.count);
+    frame.fragment_flags.resize(header.count);
+    frame.parity.clear();
+    if (group > 0)
+        frame.parity.resize((header.count + group - 1) / group);
+    if (!spare.empty())
+    {
+        frame.data.swap(spare.back());
+        spare.pop_back();
+    }
+    frame.data.resize(header.frame_size);
+    return it;
+}
+
+void FrameReassembler::store(Pending &frame, size_t index, uint8_t flags, uint32_t offset, const uint8_t *data,
+                             size_t size)
+{
+    if (offset > frame.frame_size || size > frame.frame_size - offset)
+        return;
+    if (size > 0)
+        memcpy(frame.data.data() + offset, data, size);
+    frame.have[index] = true;
+    frame.offsets[index] = offset;
+    frame.lengths[index] = (uint16_t)size;
+    frame.fragment_flags[index] = flags & PACKET_FLAG_RECORD_START;
+    frame.received++;
+}
+
+/**
+ * Rebuild the one fragment of a group that is missing, once its parity is in
+ */
+void FrameReassembler::recover(Pending &frame, size_t group)
+{
+    const std::vector<uint8_t> &parity = frame.parity[group];
+    size_t first = group * frame.group;
+    size_t end = first + frame.group < frame.count ? first + frame.group : frame.count;
+    if (parity.empty())
+        return;
+
+    size_t lost = end;
+    for (size_t i = first; i < end; i++)
+    {
+        if (frame.have[i])
+            continue;
+        if (lost != end)
+            return; // Two or more: parity cannot help
+        lost = i;
+    }
+    if (lost == end)
+        return;
+
+    block.assign(parity.begin(), parity.end());
+    for (size_t i = first; i < end; i++)
+    {
+        if (i == lost)
+            continue;
+        if (frame.lengths[i] > block.size() - PACKET_PARITY_BLOCK)
+            return;
+        uint8_t head[PACKET_PARITY_BLOCK];
+        head[0] = (uint8_t)(frame.lengths[i] >> 8);
+        head[1] = (uint8_t)frame.lengths[i];
+        head[2] = frame.fragment_flags[i];
+        putU32(head + 3, frame.offsets[i]);
+        for (size_t b = 0; b < PACKET_PARITY_BLOCK; b++)
+            block[b] ^= head[b];
+        const uint8_t *data = frame.data.data() + frame.offsets[i];
+        uint8_t *out = block.data() + PACKET_PARITY_BLOCK;
+        for (size_t b = 0; b < frame.lengths[i]; b++)
+            out[b] ^= data[b];
+    }
+
+    size_t length = (size_t)((block[0] << 8) | block[1]);
+    if (length > block.size() - PACKET_PARITY_BLOCK)
+        return;
+    size_t received = frame.received;
+    store(frame, lost, block[2], getU32(block.data() + 3), block.data() + PACKET_PARITY_BLOCK, length);
+    if (frame.received == received)
+        return;
+    packets_recovered++;
+    gaps.erase(frame.first_seq + (uint32_t)(lost + group));
+}
+
+void FrameReassembler::add(const PacketHeader &header, const uint8_t *data, size_t size, uint64_t now_us)
+{
+    if (header.type != PKT_DATA && header.type != PKT_PARITY)
+    {
+        // Control packets carry the next data seq: anything before it is due
+        if (have_seq && (int32_t)(header.seq - 1 - highest_seq) > 0)
+        {
+            noteSeq(header.seq);
+            highest_seq = header.seq - 1;
+        }
+        return;
+    }
+
+    noteSeq(header.seq);
+    if ((header.flags & PACKET_FLAG_RETRANSMIT) != 0)
+        packets_repaired++;
+
+    // Malformed, or a frame we are already past
+    if (header.count == 0 || header.index >= header.count || size > PACKET_PARITY_BLOCK + PACKET_PAYLOAD_MAX ||
+        (size_t)header.frame_size > (size_t)header.count * PACKET_PAYLOAD_MAX)
+        return;
+    if (header.type == PKT_PARITY && (header.group == 0 || header.index % header.group != 0 ||
+                                      size < PACKET_PARITY_BLOCK))
+        return;
+    if (have_last && (int32_t)(header.frame_id - last_frame) <= 0)
+        return;
+
+    PendingIt it = open(header, now_us);
+    Pending &frame = it->second;
+    if (header.count != frame.count || header.frame_size != frame.frame_size || header.group != frame.group)
+        return;
+
+    if (header.type == PKT_PARITY)
+    {
+        size_t group = header.index / header.group;
+        if (!frame.parity[group].empty())
+            return;
+        frame.parity[group].assign(data, data + size);
+        recover(frame, group);
+        return;
+    }
+
+    if (frame.have[header.index] || size > PACKET_PAYLOAD_MAX)
+        return;
+    store(frame, header.index, header.flags, header.offset, data, size);
+    if (frame.group > 0)
+        recover(frame, header.index / frame.group);
+}
+
+/**
+ * Hand a pending frame out, with the decodable spans if it is incomplete
+ */
+void FrameReassembler::release(PendingIt it, ReassembledFrame &out)
+{
+    Pending &frame = it->second;
+    out.header.type = MSG_FRAME;
+    out.header.size = frame.frame_size;
+    out.header.frame_id = it->first;
+    out.header.flags = frame.flags;
+    out.header.timestamp_us = frame.timestamp_us;
+    out.first_us = frame.first_us;
+    out.complete = frame.complete();
+    out.spans.clear();
+
+    // Runs of contiguous fragments, from the first one that starts a record
+    size_t i = 0;
+    while (!out.complete && i < frame.count)
+    {
+        if (!frame.have[i] || frame.fragment_flags[i] == 0)
+        {
+            i++;
+            continue;
+        }
+        uint32_t start = frame.offsets[i];
+        uint32_t end = start + frame.lengths[i];
+        for (i++; i < frame.count && frame.have[i] && frame.offsets[i] == end; i++)
+            end += frame.lengths[i];
+        out.spans.push_back(PayloadSpan(start, end - start));
+    }
+    if (!out.complete)
+        frames_concealed++;
+
+    out.payload.swap(frame.data);
+    spare.push_back(std::vector<uint8_t>());
+    spare.back().swap(frame.data);
+
+    // Gaps up to this frame can no longer matter
+    gaps.erase(gaps.begin(), gaps.lower_bound(frame.first_seq + frame.seq_count));
+
+    if (frame.flags & FRAME_FLAG_KEYFRAME)
+        waiting_key = false;
+    have_last = true;
+    last_frame = it->first;
+    pending.erase(it);
+}
+
+bool FrameReassembler::next(ReassembledFrame &out, uint64_t now_us)
+{
+    if (conceal)
+    {
+        if (pending.empty())
+            return false;
+
+        // Give the oldest frame until the next one is well underway
+        PendingIt it = pending.begin();
+        const Pending &frame = it->second;
+        if (!frame.complete())
+        {
+            const Pending &newest = pending.rbegin()->second;
+            bool overtaken = pending.size() > 1 && now_us - newest.first_us >= PACKET_REORDER_US;
+            if (!overtaken && now_us - frame.first_us < PACKET_CONCEAL_TIMEOUT_US)
+                return false;
+        }
+        if (have_last)
+            frames_lost += it->first - last_frame - 1; // Not a single packet of these arrived
+        release(it, out);
+        return true;
+    }
+
+    while (!pending.empty())
+    {
+        // A complete keyframe makes everything older irrelevant
+        PendingIt key = pending.end();
+        for (PendingIt it = pending.begin(); it != pending.end(); ++it)
+        {
+            if (it->second.complete() && (it->second.flags & FRAME_FLAG_KEYFRAME))
+                key = it;
+        }
+
+        PendingIt it = pending.begin();
+        if (key != pending.end())
+        {
+            while (pending.begin() != key)
+                drop(pending.begin());
+            it = key;
+        }
+        else
+        {
+            Pending &frame = it->second;
+            bool is_key = (frame.flags & FRAME_FLAG_KEYFRAME) != 0;
+
+            // Deltas are useless until a keyframe restarts the chain
+            if (waiting_key && !is_key)
+            {
+                drop(it);
+                continue;
+            }
+
+            bool follows = !have_last || it->first == last_frame + 1;
+            if (!frame.complete() || !follows)
+            {
+                // Wait for repair, then give up on this frame and the chain
+                if (now_us - frame.first_us < PACKET_REPAIR_TIMEOUT_US)
+                    return false;
+                if (!frame.complete())
+                    drop(it);
+                waiting_key = true; // A complete delta goes on the next pass
+                continue;
+            }
+        }
+
+        release(it, out);
+        return true;
+    }
+    return false;
+}
+
+void FrameReassembler::missing(std::vector<uint32_t> &seqs, uint64_t now_us)
+{
+    seqs.clear();
+    std::map<uint32_t, Missing>::iterator it = gaps.begin();
+    while (it != gaps.end() && seqs.size() < PACKET_NACK_MAX)
+    {
+        Missing &gap = it->second;
+        if (gap.tries > 0 && now_us - gap.asked_us < PACKET_NACK_RETRY_US)
+        {
+            ++it;
+            continue;
+        }
+        if (gap.tries >= PACKET_NACK_TRIES)
+        {
+            gaps.erase(it++);
+            continue;
+        }
+        seqs.push_back(it->first);
+        gap.asked_us = now_us;
+        gap.tries++;
+        ++it;
+    }
+}
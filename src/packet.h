@@ -0,0 +1,241 @@
+/**
+ * PACKET.H - DATAGRAM FRAMING FOR THE MULTICAST AND UDP TRANSPORTS
+ *
+ * Frames sent over UDP are cut into datagrams that fit a 1500-byte MTU.
+ * Every datagram starts with a PACKET_HEADER_SIZE header (network byte
+ * order):
+ *
+ *   u32 magic, u32 stream, u8 type, u8 flags, u16 index, u16 count,
+ *   u16 group, u32 seq, u32 frame_id, u32 offset, u32 frame_size,
+ *   u32 frame_flags, u64 timestamp_us
+ *
+ * PKT_DATA carries bytes [offset, offset + length) of the MSG_FRAME payload
+ * of frame `frame_id`; it is fragment `index` of `count`. Data and parity
+ * packets of one stream are numbered by `seq` without gaps, so a receiver
+ * can tell exactly which packets it missed and ask for them again with
+ * PKT_NACK (a list of u32 seqs, sent unicast to the source of the stream).
+ * The sender answers from a ring of recently sent packets. A receiver that
+ * just joined, or lost frames for good, asks for a keyframe with
+ * PKT_KEY_REQUEST the same way.
+ *
+ * With forward error correction (`group` > 0) every `group` fragments of a
+ * frame are followed by a PKT_PARITY packet covering fragments [index,
+ * index + group): the XOR of their blocks { u16 length, u8 flags, u32
+ * offset, data padded to the longest }, which rebuilds any one lost
+ * fragment of the group without a round trip.
+ *
+ * Aligned packetization starts a datagram at every tile record boundary it
+ * can and marks it PACKET_FLAG_RECORD_START, so a frame missing fragments
+ * still holds whole records that decode on their own.
+ *
+ * PKT_CONFIG carries the packed Handshake, so receivers that join late
+ * learn the stream's resolution and codec, and `frame_id` is the first
+ * frame it describes (a new one means the stream was reconfigured);
+ * PKT_BYE ends the stream.
+ * `stream` is chosen at random by each sender run.
+ */
+#ifndef PACKET_H
+#define PACKET_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <map>
+#include "protocol.h"
+#include "codec.h"
+
+#define PACKET_MAGIC 0x52474D50        // "RGMP"
+#define PACKET_HEADER_SIZE 44          // Serialized size of PacketHeader
+#define PACKET_PAYLOAD_MAX 1400        // Data bytes per datagram (1500 MTU - IP/UDP - header)
+#define PACKET_PARITY_BLOCK 7          // length, flags and offset ahead of each parity block
+#define PACKET_HISTORY 16384           // Sent packets kept for retransmission (~23 MB)
+#define PACKET_NACK_MAX 256            // Sequence numbers per PKT_NACK
+#define PACKET_NACK_RETRY_US 30000     // Ask again for a packet after this long
+#define PACKET_NACK_TRIES 3            // Give up on a packet after this many requests
+#define PACKET_REPAIR_TIMEOUT_US 150000 // Longest wait for a frame's missing packets
+#define PACKET_REORDER_US 3000         // Concealment: wait after a newer frame started arriving
+#define PACKET_CONCEAL_TIMEOUT_US 50000 // Concealment: longest wait for a frame
+#define PACKET_PENDING_FRAMES 64       // Incomplete frames held at most
+
+enum PacketType
+{
+    PKT_DATA = 1,   // Sender -> receivers: a slice of a frame payload
+    PKT_CONFIG = 2, // Sender -> group: packed Handshake
+    PKT_NACK = 3,   // Receiver -> sender (unicast): u32 seqs to send again
+    PKT_BYE = 4,    // Sender -> group: the stream ended
+    PKT_PARITY = 5, // Sender -> receivers: XOR of a group of PKT_DATA blocks
+    PKT_KEY_REQUEST = 6, // Receiver -> sender (unicast): send a keyframe soon
+};
+
+#define PACKET_FLAG_RETRANSMIT 1   // Sent again after a NACK
+#define PACKET_FLAG_RECORD_START 2 // PKT_DATA begins at a record boundary
+
+struct PacketHeader
+{
+    uint32_t magic;
+    uint32_t stream;      // Random per sender run
+    uint8_t type;         // PacketType
+    uint8_t flags;        // PACKET_FLAG_* bits
+    uint16_t index;       // Fragment index within the frame (PKT_PARITY: first covered)
+    uint16_t count;       // Fragments in the frame, entries (PKT_NACK)
+    uint16_t group;       // Fragments per FEC group, 0 without FEC
+    uint32_t seq;         // Packet sequence number (PKT_DATA, PKT_PARITY)
+    uint32_t frame_id;
+    uint32_t offset;      // Payload offset of this fragment
+    uint32_t frame_size;  // Whole frame payload in bytes
+    uint32_t frame_flags; // MessageHeader::flags of the frame
+    uint64_t timestamp_us;
+};
+
+void packPacketHeader(const PacketHeader &header, uint8_t *out);
+// False if the datagram is too short or not ours
+bool unpackPacketHeader(const uint8_t *in, size_t size, PacketHeader &header);
+
+/**
+ * Sender side: cuts frames into numbered PKT_DATA (and PKT_PARITY)
+ * datagrams and keeps the last PACKET_HISTORY of them for NACK repair.
+ * Only one thread may call packetize(); packet() may be called
+ * concurrently for seqs that are at least a frame older than the one being
+ * packetized (callers lock).
+ */
+class FramePacketizer
+{
+public:
+    explicit FramePacketizer(uint32_t stream);
+
+    uint32_t stream() const { return stream_id; }
+
+    // Cut payloads of this codec at tile records (CODEC_RAW: every fragment stands alone)
+    void setAlignment(int codec) { align_codec = codec; }
+    // One PKT_PARITY after every `group` fragments, 0 disables FEC
+    void setFec(int group) { fec_group = group; }
+
+    // Packetize one frame; its datagrams are packet(first) .. packet(nextSeq() - 1)
+    uint32_t packetize(const MessageHeader &frame, const uint8_t *payload);
+    uint32_t nextSeq() const { return next_seq; }
+
+    // A sent datagram, NULL once it fell out of the history
+    const std::vector<uint8_t> *packet(uint32_t seq) const;
+
+    // An unsequenced control datagram (PKT_CONFIG, PKT_BYE)
+    std::vector<uint8_t> control(PacketType type, const uint8_t *payload, size_t size, uint32_t frame_id = 0) const;
+
+private:
+    void cut(const MessageHeader &frame, const uint8_t *payload);
+    void addParity(PacketHeader header, size_t first, size_t end, const uint8_t *payload);
+
+    uint32_t stream_id;
+    uint32_t next_seq;
+    int align_codec;  // -1: fixed-size fragments
+    int fec_group;
+    std::vector<std::pair<uint32_t, uint32_t> > cuts; // (offset, length) per fragment
+    std::vector<uint8_t> cut_flags;
+    std::vector<std::vector<uint8_t> > history; // Indexed by seq % PACKET_HISTORY
+};
+
+/**
+ * A frame put back together by FrameReassembler. Frames released
+ * incomplete (concealment) list the runs of received fragments that start
+ * at a record boundary, for FrameDecoder::decodePartial().
+ */
+struct ReassembledFrame
+{
+    MessageHeader header;
+    uint64_t first_us; // First datagram of the frame arrived
+    bool complete;
+    std::vector<PayloadSpan> spans; // Only for incomplete frames
+    std::vector<uint8_t> payload;
+};
+
+/**
+ * Receiver side: collects PKT_DATA datagrams into whole frames, rebuilding
+ * single losses per FEC group from PKT_PARITY.
+ *
+ * Frames come out of next() in order. A delta frame is only released right
+ * after the frame before it; when a frame cannot be repaired within
+ * PACKET_REPAIR_TIMEOUT_US, everything up to the next complete keyframe is
+ * skipped. A complete keyframe is released at once and supersedes anything
+ * older. Receivers start by waiting for a keyframe, which is how late
+ * joiners get in.
+ *
+ * In concealment mode nothing waits for repair: a frame still incomplete
+ * PACKET_REORDER_US after the next one started arriving (or after
+ * PACKET_CONCEAL_TIMEOUT_US) is released as it is, and frames that never
+ * showed up are skipped. Tile records replace whole tiles, so later deltas
+ * still apply; lost tiles keep their previous content until they change.
+ */
+class FrameReassembler
+{
+public:
+    explicit FrameReassembler(bool conceal = false);
+
+    // Forget everything (new stream)
+    void reset();
+
+    // Forget pending frames and ignore any before `first_frame` (the stream was reconfigured)
+    void restart(uint32_t first_frame);
+
+    void add(const PacketHeader &header, const uint8_t *data, size_t size, uint64_t now_us);
+
+    // Next frame ready for decoding; `out` keeps its buffer between calls
+    bool next(ReassembledFrame &out, uint64_t now_us);
+
+    // Sequence numbers to request now (each at most PACKET_NACK_TRIES times)
+    void missing(std::vector<uint32_t> &seqs, uint64_t now_us);
+
+    uint64_t framesLost() const { return frames_lost; } // Never decodable, or skipped waiting for a keyframe
+    uint64_t framesConcealed() const { return frames_concealed; }
+    uint64_t packetsRepaired() const { return packets_repaired; }
+    uint64_t packetsRecovered() const { return packets_recovered; } // Rebuilt from parity
+
+private:
+    struct Pending
+    {
+        uint32_t frame_size;
+        uint32_t flags;
+        uint64_t timestamp_us;
+        uint16_t count;
+        uint16_t received;
+        uint16_t group;         // FEC group size
+        uint32_t first_seq;     // seq of fragment 0
+        uint32_t seq_count;     // Data and parity packets of the frame
+        uint64_t first_us;      // First fragment arrived
+        std::vector<bool> have;
+        std::vector<uint32_t> offsets;
+        std::vector<uint16_t> lengths;
+        std::vector<uint8_t> fragment_flags;
+        std::vector<std::vector<uint8_t> > parity; // By group, empty until it arrives
+        std::vector<uint8_t> data;
+        bool complete() const { return received == count; }
+    };
+    struct Missing
+    {
+        uint64_t asked_us;
+        int tries;
+    };
+    typedef std::map<uint32_t, Pending>::iterator PendingIt;
+
+    PendingIt open(const PacketHeader &header, uint64_t now_us);
+    void store(Pending &frame, size_t index, uint8_t flags, uint32_t offset, const uint8_t *data, size_t size);
+    void recover(Pending &frame, size_t group);
+    void release(PendingIt it, ReassembledFrame &out);
+    void drop(PendingIt it);
+    void noteSeq(uint32_t seq);
+
+    bool conceal;
+    std::map<uint32_t, Pending> pending;  // By frame_id
+    std::map<uint32_t, Missing> gaps;     // By seq
+    std::vector<std::vector<uint8_t> > spare; // Reusable frame buffers
+    std::vector<uint8_t> block;           // Parity scratch
+    bool have_seq;
+    uint32_t highest_seq;
+    bool have_last;
+    uint32_t last_frame;    // Last frame released
+    bool waiting_key;
+    uint64_t frames_lost;
+    uint64_t frames_concealed;
+    uint64_t packets_repaired;
+    uint64_t packets_recovered;
+};
+
+#endif
@@ -0,0 +1,422 @@
+/**
+ * PLAYER.CPP - ARCHIVE PLAYBACK TO A RECEIVER
+ *
+ * Serves a session archived by `receiver --archive` to a receiver as if it
+ * were a live sender: same handshake, clock exchange and MSG_FRAME stream,
+ * with the archived payloads sent unchanged (no decoding or re-encoding).
+ * Payloads go from the segment files to the socket without passing through
+ * user space: with sendfile() on Linux, otherwise with send() straight from
+ * the mmap'ed segment. Only the 24-byte message header is built per frame.
+ *
+ * At --speed 0 the player pushes frames as fast as the receiver takes them,
+ * which makes it a stress generator for receivers that costs almost no CPU
+ * on the sending side. POSIX only, like ArchiveReader.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include "protocol.h"
+#include "archive.h"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+#define CONNECT_RETRIES 50                             // Retries while the receiver starts
+#define CONNECT_RETRY_MS 100                           // Pause between those retries
+#define STATS_INTERVAL_SEC 5                           // Statistics display interval
+static const int SOCKET_BUFFER_SIZE = 4 * 1024 * 1024; // Same send buffer as the sender
+
+#ifndef MSG_MORE
+#define MSG_MORE 0 // Header coalescing hint, Linux only
+#endif
+
+// How payloads get from the archive to the socket
+enum PayloadIo
+{
+    IO_SENDFILE, // sendfile() from the segment file (Linux)
+    IO_MMAP,     // send() from the mapped segment
+};
+
+std::atomic<bool> g_running{true};
+
+void handleSignal(int signum)
+{
+    (void)signum;
+    g_running = false;
+}
+
+/**
+ * Blocking TCP connection to the receiver, retried while it starts up
+ */
+static int connectReceiver(const std::string &ip, int port)
+{
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    if (inet_pton(AF_INET, ip.c_str(), &address.sin_addr) != 1)
+    {
+        std::cerr << "❌ Invalid receiver address " << ip << std::endl;
+        return -1;
+    }
+
+    for (int attempt = 0; attempt <= CONNECT_RETRIES && g_running; attempt++)
+    {
+        int sock = socket(AF_INET, SOCK_STREAM, 0);
+        if (sock < 0)
+            return -1;
+        if (connect(sock, (sockaddr *)&address, sizeof(address)) == 0)
+        {
+            int nodelay = 1;
+            setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (char *)&nodelay, sizeof(nodelay));
+            int sock_buf_size = SOCKET_BUFFER_SIZE;
+            setsockopt(sock, SOL_SOCKET, SO_SNDBUF, (char *)&sock_buf_size, sizeof(sock_buf_size));
+            std::cout << "✅ Connected to " << ip << ":" << port << std::endl;
+            return sock;
+        }
+        close(sock);
+        std::this_thread::sleep_for(std::chrono::milliseconds(CONNECT_RETRY_MS));
+    }
+    std::cerr << "❌ Could not connect to " << ip << ":" << port << std::endl;
+    return -1;
+}
+
+/**
+ * Segment files opened for sendfile(), with their sizes for bounds checks
+ */
+class SegmentFiles
+{
+public:
+    ~SegmentFiles()
+    {
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            if (files[i].fd >= 0)
+                close(files[i].fd);
+        }
+    }
+
+    // File descriptor holding [offset, offset + length) of a segment, -1 if unavailable
+    int get(const ArchiveReader &reader, uint32_t segment, uint64_t offset, uint32_t length)
+    {
+        if (segment == 0 || segment > 1000000)
+            return -1;
+        while (files.size() < segment)
+            files.push_back(File());
+
+        File &file = files[segment - 1];
+        if (file.fd < 0)
+        {
+            file.fd = open(reader.segmentPath(segment).c_str(), O_RDONLY);
+            struct stat info;
+            if (file.fd < 0 || fstat(file.fd, &info) != 0)
+                return -1;
+            file.size = info.st_size;
+        }
+        return offset + length <= file.size ? file.fd : -1;
+    }
+
+private:
+    struct File
+    {
+        File() : fd(-1), size(0) {}
+        int fd;
+        uint64_t size;
+    };
+    std::vector<File> files;
+};
+
+/**
+ * Send `length` bytes of a segment file starting at `offset`
+ */
+static bool sendFromFile(int sock, int fd, uint64_t offset, size_t length)
+{
+#ifdef __linux__
+    off_t position = (off_t)offset;
+    while (length > 0)
+    {
+        ssize_t sent = sendfile(sock, fd, &position, length);
+        if (sent < 0 && errno == EINTR && g_running)
+            continue;
+        if (sent <= 0)
+            return false;
+        length -= sent;
+    }
+    return true;
+#else
+    (void)sock;
+    (void)fd;
+    (void)offset;
+    (void)length;
+    return false;
+#endif
+}
+
+/**
+ * Send the frame header, hinting that the payload follows so both share packets
+ */
+static bool sendHeader(int sock, const MessageHeader &header)
+{
+    uint8_t wire[MESSAGE_HEADER_SIZE];
+    packHeader(header, wire);
+    size_t sent_total = 0;
+    while (sent_total < sizeof(wire))
+    {
+        ssize_t sent = send(sock, wire + sent_total, sizeof(wire) - sent_total, MSG_MORE);
+        if (sent < 0 && errno == EINTR && g_running)
+            continue;
+        if (sent <= 0)
+            return false;
+        sent_total += sent;
+    }
+    return true;
+}
+
+static void usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " <session-dir> --connect <ip:port> [options]\n"
+              << "  --speed <x>        playback speed, 1 = recorded pace, 0 = as fast as possible (default 1)\n"
+              << "  --from <seconds>   start at this offset into the session\n"
+              << "  --loop             start over at the end instead of stopping\n"
+              << "  --frames <n>       stop after n frames\n"
+              << "  --io sendfile|mmap how payloads reach the socket (default sendfile on Linux)\n";
+}
+
+/**
+ * Main function
+ * Opens the archive, connects, then streams the archived frames on the
+ * recorded schedule (scaled by --speed)
+ */
+int main(int argc, char *argv[])
+{
+    std::string session_dir;
+    std::string connect_target;
+    double speed = 1.0;
+    double from_seconds = 0;
+    bool loop = false;
+    long frame_limit = 0;
+#ifdef __linux__
+    PayloadIo io = IO_SENDFILE;
+#else
+    PayloadIo io = IO_MMAP;
+#endif
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--connect" && has_value)
+            connect_target = argv[++i];
+        else if (arg == "--speed" && has_value)
+            speed = atof(argv[++i]);
+        else if (arg == "--from" && has_value)
+            from_seconds = atof(argv[++i]);
+        else if (arg == "--loop")
+            loop = true;
+        else if (arg == "--frames" && has_value)
+            frame_limit = atol(argv[++i]);
+        else if (arg == "--io" && has_value)
+        {
+            std::string name = argv[++i];
+            if (name == "mmap")
+                io = IO_MMAP;
+#ifdef __linux__
+            else if (name == "sendfile")
+                io = IO_SENDFILE;
+#endif
+            else
+            {
+                std::cerr << "❌ Unsupported --io " << name << std::endl;
+                return 1;
+            }
+        }
+        else if (session_dir.empty() && !arg.empty() && arg[0] != '-')
+            session_dir = arg;
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (session_dir.empty() || connect_target.empty() || speed < 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    signal(SIGINT, handleSignal);
+    signal(SIGPIPE, SIG_IGN); // A receiver going away is reported by send()
+
+    ArchiveReader reader;
+    if (!reader.open(session_dir))
+        return 1;
+    size_t count = reader.count();
+    // Decoding has to start at a keyframe; frames up to the target are sent unpaced
+    size_t target = reader.seekTarget((uint64_t)(from_seconds * 1000000));
+    size_t start = reader.seek((uint64_t)(from_seconds * 1000000));
+    ArchiveEntry last = reader.entry(count - 1);
+    uint32_t recorded_fps = last.time_us > 0 ? (uint32_t)((count - 1) * 1000000ull / last.time_us) : 0;
+
+    std::cout << "========================================" << std::endl;
+    std::cout << "⏯️  RGM ARCHIVE PLAYER" << std::endl;
+    std::cout << "========================================" << std::endl;
+    std::cout << "Archive:    " << session_dir << " (" << count << " frames, "
+              << std::fixed << std::setprecision(1) << last.time_us / 1e6 << " s)" << std::endl;
+    std::cout << "Resolution: " << reader.width() << "x" << reader.height() << std::endl;
+    std::cout << "Codec:      " << codecName(reader.codec()) << std::endl;
+    std::cout << "Speed:      ";
+    if (speed > 0)
+        std::cout << std::setprecision(2) << speed << "x" << std::endl;
+    else
+        std::cout << "max" << std::endl;
+    std::cout << "I/O:        " << (io == IO_SENDFILE ? "sendfile" : "mmap + send") << std::endl;
+    std::cout << "========================================" << std::endl;
+
+    size_t colon = connect_target.rfind(':');
+    int sock = connectReceiver(connect_target.substr(0, colon),
+                               colon == std::string::npos ? 8081 : atoi(connect_target.c_str() + colon + 1));
+    if (sock < 0)
+        return 1;
+
+    // Same session setup as a live sender
+    Handshake handshake = {(uint32_t)reader.width(), (uint32_t)reader.height(),
+                           recorded_fps, PROTOCOL_VERSION, (uint32_t)reader.codec(), 0, 0};
+    int64_t clock_offset_us = 0;
+    uint32_t session = 0;
+    bool resumed = false;
+    uint32_t tile_cache = 0; // Archived frames never refer to the cache
+    if (!startSession(sock, handshake, clock_offset_us, session, resumed, tile_cache))
+    {
+        std::cerr << "❌ Session setup with the receiver failed" << std::endl;
+        close(sock);
+        return 1;
+    }
+    std::cout << "⏱️  Clock offset to receiver: " << clock_offset_us << " us" << std::endl;
+    std::cout << "🎬 Playing from " << std::setprecision(1) << reader.entry(target).time_us / 1e6 << " s";
+    if (start != target)
+        std::cout << " (keyframe at " << reader.entry(start).time_us / 1e6 << " s)";
+    std::cout << std::endl;
+
+    SegmentFiles files;
+    uint64_t play_start = nowMicros();
+    uint64_t stats_time = play_start;
+    uint64_t media_us = 0; // Recorded time played so far
+    uint64_t previous_us = reader.entry(start).time_us;
+    uint64_t last_gap_us = recorded_fps > 0 ? 1000000 / recorded_fps : 0;
+    uint64_t frames_sent = 0, bytes_sent = 0, stats_frames = 0, stats_bytes = 0;
+    size_t next = start;
+    bool caught_up = false;
+
+    while (g_running && (frame_limit == 0 || (long)frames_sent < frame_limit))
+    {
+        if (next >= count)
+        {
+            if (!loop)
+                break;
+            next = 0; // The first entry of an archive is always a keyframe
+        }
+        bool catching_up = !caught_up && next <= target;
+        caught_up = caught_up || next >= target;
+        ArchiveEntry e = reader.entry(next++);
+
+        // Recorded spacing; a loop restart keeps the previous frame interval
+        if (e.time_us > previous_us)
+            last_gap_us = e.time_us - previous_us;
+        if (frames_sent > 0)
+            media_us += e.time_us > previous_us ? e.time_us - previous_us : last_gap_us;
+        previous_us = e.time_us;
+
+        if (catching_up)
+        {
+            // The recorded schedule starts at the target frame
+            play_start = nowMicros();
+            media_us = 0;
+        }
+        else if (speed > 0)
+        {
+            uint64_t due = play_start + (uint64_t)(media_us / speed);
+            uint64_t now = nowMicros();
+            if (due > now)
+                std::this_thread::sleep_for(std::chrono::microseconds(due - now));
+        }
+
+        MessageHeader header = {};
+        header.type = MSG_FRAME;
+        header.size = e.length;
+        header.frame_id = (uint32_t)frames_sent;
+        header.flags = e.flags & FRAME_FLAG_KEYFRAME;
+        header.timestamp_us = nowMicros();
+
+        bool ok;
+        errno = 0;
+        if (io == IO_SENDFILE)
+        {
+            int fd = files.get(reader, e.segment, e.offset, e.length);
+            ok = fd >= 0 && sendHeader(sock, header) && sendFromFile(sock, fd, e.offset, e.length);
+        }
+        else
+        {
+            const uint8_t *payload = reader.payload(e);
+            ok = payload && sendHeader(sock, header) && sendAll(sock, payload, e.length);
+        }
+        if (!ok)
+        {
+            if (g_running)
+                std::cerr << "❌ Sending frame " << frames_sent << " failed: "
+                          << (errno ? strerror(errno) : "damaged archive entry") << std::endl;
+            break;
+        }
+
+        frames_sent++;
+        bytes_sent += MESSAGE_HEADER_SIZE + e.length;
+
+        uint64_t now = nowMicros();
+        if (now - stats_time >= STATS_INTERVAL_SEC * 1000000ull)
+        {
+            double seconds = (now - stats_time) / 1e6;
+            std::cout << "📊 Frames: " << frames_sent << " | FPS: " << std::setprecision(1)
+                      << (frames_sent - stats_frames) / seconds << " | Bandwidth: " << std::setprecision(2)
+                      << (bytes_sent - stats_bytes) / (1024.0 * 1024.0) / seconds << " MB/s" << std::endl;
+            stats_time = now;
+            stats_frames = frames_sent;
+            stats_bytes = bytes_sent;
+        }
+    }
+
+    // The receiver closes the session instead of holding it for a resume
+    MessageHeader bye = {};
+    bye.type = MSG_BYE;
+    sendHeader(sock, bye);
+    close(sock);
+
+    double seconds = (nowMicros() - play_start) / 1e6;
+    if (seconds <= 0)
+        seconds = 1e-6;
+    std::cout << "========================================" << std::endl;
+    std::cout << "📊 PLAYBACK STATISTICS" << std::endl;
+    std::cout << "========================================" << std::endl;
+    std::cout << "Frames sent:     " << frames_sent << std::endl;
+    std::cout << "Duration:        " << std::setprecision(2) << seconds << " seconds" << std::endl;
+    std::cout << "Average FPS:     " << std::setprecision(1) << frames_sent / seconds << std::endl;
+    std::cout << "Throughput:      " << std::setprecision(2) << bytes_sent / (1024.0 * 1024.0) / seconds
+              << " MB/s" << std::endl;
+    std::cout << "========================================" << std::endl;
+    return 0;
+}
@@ -0,0 +1,293 @@
+/**
+ * PROTOCOL.CPP - WIRE FORMAT HELPERS AND CLOCK SYNCHRONIZATION
+ */
+#include "protocol.h"
+#include <iostream>
+#include <cstring>
+#include <chrono>
+#include <limits>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#endif
+
+/**
+ * Microseconds on the monotonic clock
+ */
+uint64_t nowMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void putU32(uint8_t *out, uint32_t value)
+{
+    uint32_t net = htonl(value);
+    memcpy(out, &net, 4);
+}
+
+uint32_t getU32(const uint8_t *in)
+{
+    uint32_t net;
+    memcpy(&net, in, 4);
+    return ntohl(net);
+}
+
+void putU64(uint8_t *out, uint64_t value)
+{
+    putU32(out, (uint32_t)(value >> 32));
+    putU32(out + 4, (uint32_t)value);
+}
+
+uint64_t getU64(const uint8_t *in)
+{
+    return ((uint64_t)getU32(in) << 32) | getU32(in + 4);
+}
+
+void packHeader(const MessageHeader &header, uint8_t *out)
+{
+    putU32(out + 0, header.type);
+    putU32(out + 4, header.size);
+    putU32(out + 8, header.frame_id);
+    putU32(out + 12, header.flags);
+    putU64(out + 16, header.timestamp_us);
+}
+
+void unpackHeader(const uint8_t *in, MessageHeader &header)
+{
+    header.type = getU32(in + 0);
+    header.size = getU32(in + 4);
+    header.frame_id = getU32(in + 8);
+    header.flags = getU32(in + 12);
+    header.timestamp_us = getU64(in + 16);
+}
+
+void packHandshake(const Handshake &handshake, uint8_t *out)
+{
+    putU32(out + 0, handshake.width);
+    putU32(out + 4, handshake.height);
+    putU32(out + 8, handshake.fps);
+    putU32(out + 12, handshake.version);
+    putU32(out + 16, handshake.codec);
+    putU32(out + 20, handshake.session);
+    putU32(out + 24, handshake.tile_cache);
+}
+
+void unpackHandshake(const uint8_t *in, Handshake &handshake)
+{
+    handshake.width = getU32(in + 0);
+    handshake.height = getU32(in + 4);
+    handshake.fps = getU32(in + 8);
+    handshake.version = getU32(in + 12);
+    handshake.codec = getU32(in + 16);
+    handshake.session = getU32(in + 20);
+    handshake.tile_cache = getU32(in + 24);
+}
+
+bool sameStream(const Handshake &a, const Handshake &b)
+{
+    return a.width == b.width && a.height == b.height && a.codec == b.codec;
+}
+
+/**
+ * Send all data, handling partial sends
+ */
+bool sendAll(int sock, const void *data, size_t size)
+{
+    const char *buffer = (const char *)data;
+    size_t total_sent = 0;
+
+    while (total_sent < size)
+    {
+        int sent = ::send(sock, buffer + total_sent, size - total_sent, 0);
+        if (sent <= 0)
+            return false;
+        total_sent += sent;
+    }
+    return true;
+}
+
+/**
+ * Receive exactly `size` bytes, handling partial receives
+ */
+bool recvAll(int sock, void *data, size_t size)
+{
+    char *buffer = (char *)data;
+    size_t total_received = 0;
+
+    while (total_received < size)
+    {
+        int received = ::recv(sock, buffer + total_received, size - total_received, 0);
+        if (received <= 0)
+            return false;
+        total_received += received;
+    }
+    return true;
+}
+
+bool sendMessage(int sock, const MessageHeader &header, const void *payload)
+{
+    uint8_t wire[MESSAGE_HEADER_SIZE];
+    packHeader(header, wire);
+    if (!sendAll(sock, wire, sizeof(wire)))
+        return false;
+    return header.size == 0 || sendAll(sock, payload, header.size);
+}
+
+bool recvHeader(int sock, MessageHeader &header)
+{
+    uint8_t wire[MESSAGE_HEADER_SIZE];
+    if (!recvAll(sock, wire, sizeof(wire)))
+        return false;
+    unpackHeader(wire, header);
+    return true;
+}
+
+/**
+ * Receiver side of the clock exchange
+ *
+ * For each round: t1 = probe sent, t2 = probe received by sender,
+ * t3 = reply sent by sender, t4 = reply received. The round with the
+ * smallest (t4 - t1) - (t3 - t2) has the least queueing noise.
+ */
+bool probeClockOffset(int sock, int64_t &offset_us, int64_t &rtt_us)
+{
+    ClockEstimator clock;
+    while (!clock.done())
+    {
+        if (!sendMessage(sock, clock.probe(), NULL))
+            return false;
+
+        MessageHeader reply;
+        uint8_t payload[CLOCK_REPLY_PAYLOAD];
+        if (!recvHeader(sock, reply) || reply.type != MSG_CLOCK_REPLY ||
+            reply.size != sizeof(payload) || !recvAll(sock, payload, sizeof(payload)))
+        {
+            std::cerr << "❌ Invalid clock sync reply" << std::endl;
+            return false;
+        }
+        clock.add(reply, payload, nowMicros());
+    }
+
+    offset_us = clock.offset_us;
+    rtt_us = clock.rtt_us;
+    return sendMessage(sock, clock.result(), NULL);
+}
+
+ClockEstimator::ClockEstimator()
+    : offset_us(0), rtt_us(std::numeric_limits<int64_t>::max()), rounds(0)
+{
+}
+
+MessageHeader ClockEstimator::probe() const
+{
+    MessageHeader probe = {};
+    probe.type = MSG_CLOCK_PROBE;
+    probe.frame_id = rounds;
+    probe.timestamp_us = nowMicros();
+    return probe;
+}
+
+// Keep the sample with the smallest round trip
+void ClockEstimator::add(const MessageHeader &reply, const uint8_t *payload, uint64_t received_us)
+{
+    int64_t t4 = (int64_t)received_us;
+    int64_t t1 = (int64_t)reply.timestamp_us;
+    int64_t t2 = (int64_t)getU64(payload);
+    int64_t t3 = (int64_t)getU64(payload + 8);
+
+    int64_t rtt = (t4 - t1) - (t3 - t2);
+    if (rtt < rtt_us)
+    {
+        rtt_us = rtt;
+        offset_us = ((t1 - t2) + (t4 - t3)) / 2;
+    }
+    rounds++;
+}
+
+MessageHeader ClockEstimator::result() const
+{
+    MessageHeader result = {};
+    result.type = MSG_CLOCK_RESULT;
+    result.timestamp_us = (uint64_t)offset_us;
+    return result;
+}
+
+/**
+ * Sender side of the clock exchange: answer probes until the result arrives
+ */
+bool answerClockProbes(int sock, int64_t &offset_us)
+{
+    while (true)
+    {
+        MessageHeader probe;
+        if (!recvHeader(sock, probe))
+            return false;
+        uint64_t t2 = nowMicros();
+
+        if (probe.type == MSG_CLOCK_RESULT)
+        {
+            offset_us = (int64_t)probe.timestamp_us;
+            return true;
+        }
+        if (probe.type != MSG_CLOCK_PROBE || probe.size != 0)
+        {
+            std::cerr << "❌ Unexpected message during clock sync: " << probe.type << std::endl;
+            return false;
+        }
+
+        MessageHeader reply = {};
+        reply.type = MSG_CLOCK_REPLY;
+        reply.size = CLOCK_REPLY_PAYLOAD;
+        reply.frame_id = probe.frame_id;
+        reply.timestamp_us = probe.timestamp_us;
+        uint8_t payload[CLOCK_REPLY_PAYLOAD];
+        putU64(payload, t2);
+        putU64(payload + 8, nowMicros());
+        if (!sendMessage(sock, reply, payload))
+            return false;
+    }
+}
+
+// Read the receiver's MSG_SESSION
+static bool recvSession(int sock, uint32_t &token, bool &resumed, uint32_t &tile_cache)
+{
+    MessageHeader reply;
+    uint8_t payload[4];
+    if (!recvHeader(sock, reply) || reply.type != MSG_SESSION || reply.size != sizeof(payload) ||
+        !recvAll(sock, payload, sizeof(payload)))
+        return false;
+    token = reply.frame_id;
+    resumed = reply.flags != 0;
+    tile_cache = getU32(payload);
+    return true;
+}
+
+bool startSession(int sock, const Handshake &handshake, int64_t &offset_us, uint32_t &token, bool &resumed,
+                  uint32_t &tile_cache)
+{
+    uint8_t wire[sizeof(Handshake)];
+    packHandshake(handshake, wire);
+    if (!sendAll(sock, wire, sizeof(wire)))
+        return false;
+
+    // A resume is answered right away, before any clock probe
+    resumed = false;
+    if (handshake.session != 0)
+    {
+        if (!recvSession(sock, token, resumed, tile_cache))
+            return false;
+        if (resumed && token == handshake.session)
+            return true;
+        resumed = false;
+    }
+    return answerClockProbes(sock, offset_us) && recvSession(sock, token, resumed, tile_cache) && token != 0 &&
+           tile_cache <= handshake.tile_cache;
+}
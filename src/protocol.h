@@ -0,0 +1,134 @@
+/**
+ * PROTOCOL.H - STREAMING WIRE FORMAT AND CLOCK SYNCHRONIZATION
+ *
+ * Shared by sender and receiver. Every message on the TCP stream starts with
+ * a fixed-size MessageHeader (network byte order) followed by `size` bytes of
+ * payload.
+ */
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cstdint>
+#include <cstddef>
+
+#define PROTOCOL_VERSION 11       // Bumped whenever the wire format changes
+#define BYTES_PER_PIXEL 3         // Frames are packed RGB24
+#define MESSAGE_HEADER_SIZE 24    // Serialized size of MessageHeader
+#define CLOCK_SYNC_ROUNDS 8       // Probe round trips used to estimate the clock offset
+#define CLOCK_REPLY_PAYLOAD 16    // t2 + t3 carried by MSG_CLOCK_REPLY
+
+// Message types carried in MessageHeader::type
+enum MessageType
+{
+    MSG_FRAME = 1,        // Sender -> receiver: frame pixels
+    MSG_CLOCK_PROBE = 2,  // Receiver -> sender: timestamp_us = t1
+    MSG_CLOCK_REPLY = 3,  // Sender -> receiver: timestamp_us = t1, payload = t2, t3
+    MSG_CLOCK_RESULT = 4, // Receiver -> sender: timestamp_us = offset (two's complement)
+    MSG_TRANSPORT = 5,    // Sender -> receiver: frame_id = Transport, flags = FEC group;
+                          // receiver -> sender: frame_id = UDP port to send frames to
+    MSG_SESSION = 6,      // Receiver -> sender: frame_id = session token, flags = 1 if resumed,
+                          // payload = u32 tiles the receiver caches (Handshake::tile_cache, at most
+                          // what was offered); token 0 turns a resume down and the full setup follows
+    MSG_BYE = 7,          // Sender -> receiver: the stream is over, the session is not resumed
+    MSG_CONFIGURE = 8,    // Sender -> receiver: payload = packed Handshake describing the stream from
+                          // frame frame_id on (a keyframe); over UDP the receiver echoes the header once ready
+    MSG_KEYFRAME_REQUEST = 9, // Receiver -> sender: the picture is damaged, send a keyframe soon;
+                              // frame_id = last frame received
+};
+
+// Where frames travel after the handshake (MSG_TRANSPORT)
+enum Transport
+{
+    TRANSPORT_TCP = 0, // MSG_FRAME on this connection (the default, no MSG_TRANSPORT)
+    TRANSPORT_UDP = 1, // Datagrams of packet.h; the connection only marks the session
+};
+
+/**
+ * Connection handshake, sent once by the sender right after connecting
+ */
+struct Handshake
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t fps;
+    uint32_t version;
+    uint32_t codec;   // CodecId used for every MSG_FRAME payload
+    uint32_t session; // Token of a session to resume after a dropped connection, 0 for a new one
+    uint32_t tile_cache; // Tiles the decoder caches for TILE_CACHED references (codec.h); the
+                         // sender's offer, which the receiver may lower in MSG_SESSION
+};
+
+/**
+ * Header in front of every message after the handshake
+ */
+struct MessageHeader
+{
+    uint32_t type;         // MessageType
+    uint32_t size;         // Payload bytes that follow the header
+    uint32_t frame_id;     // Incrementing frame counter (MSG_FRAME)
+    uint32_t flags;        // FRAME_FLAG_* bits (MSG_FRAME)
+    uint64_t timestamp_us; // Capture time on the sender clock (MSG_FRAME)
+};
+
+// Same resolution and codec: frames of one fit a session set up for the other
+bool sameStream(const Handshake &a, const Handshake &b);
+
+// Monotonic clock in microseconds, used for every timestamp on the wire
+uint64_t nowMicros();
+
+// Serialization helpers (network byte order)
+void packHeader(const MessageHeader &header, uint8_t *out);
+void unpackHeader(const uint8_t *in, MessageHeader &header);
+void packHandshake(const Handshake &handshake, uint8_t *out);
+void unpackHandshake(const uint8_t *in, Handshake &handshake);
+void putU32(uint8_t *out, uint32_t value);
+uint32_t getU32(const uint8_t *in);
+void putU64(uint8_t *out, uint64_t value);
+uint64_t getU64(const uint8_t *in);
+
+// Blocking socket helpers that loop over partial transfers
+bool sendAll(int sock, const void *data, size_t size);
+bool recvAll(int sock, void *data, size_t size);
+bool sendMessage(int sock, const MessageHeader &header, const void *payload);
+bool recvHeader(int sock, MessageHeader &header);
+
+/**
+ * NTP-style clock offset estimation
+ *
+ * The receiver drives the exchange with CLOCK_SYNC_ROUNDS probes and keeps
+ * the sample with the smallest round trip. The resulting offset converts a
+ * sender timestamp into receiver time: receiver_us = sender_us + offset_us.
+ * Both sides learn the offset.
+ */
+bool probeClockOffset(int sock, int64_t &offset_us, int64_t &rtt_us);
+bool answerClockProbes(int sock, int64_t &offset_us);
+
+/**
+ * Sender side of the session setup, right after connecting: send the
+ * handshake, answer the clock probes and take the receiver's session
+ * token. A handshake carrying the token of a dropped session asks to
+ * resume it; if the receiver still holds it (`resumed`), the clock
+ * exchange is skipped and `offset_us` stays as it was. `tile_cache` is
+ * what the receiver accepted of handshake.tile_cache.
+ */
+bool startSession(int sock, const Handshake &handshake, int64_t &offset_us, uint32_t &token, bool &resumed,
+                  uint32_t &tile_cache);
+
+/**
+ * The arithmetic of probeClockOffset() for receivers that cannot block:
+ * send MSG_CLOCK_PROBE with probe(), feed every MSG_CLOCK_REPLY to add().
+ */
+struct ClockEstimator
+{
+    int64_t offset_us;
+    int64_t rtt_us;
+    int rounds; // Replies taken so far
+
+    ClockEstimator();
+    MessageHeader probe() const; // The next MSG_CLOCK_PROBE
+    void add(const MessageHeader &reply, const uint8_t *payload, uint64_t received_us);
+    bool done() const { return rounds >= CLOCK_SYNC_ROUNDS; }
+    MessageHeader result() const; // MSG_CLOCK_RESULT to send once done()
+};
+
+#endif
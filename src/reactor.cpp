@@ -0,0 +1,672 @@
+/**
+ * REACTOR.CPP - EPOLL AND IO_URING EVENT LOOP, DECODE TASK POOL
+ */
+#include "reactor.h"
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+#ifdef __has_include
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+#if defined(IORING_RECV_MULTISHOT) && defined(__NR_io_uring_setup)
+#define RGM_HAVE_URING 1
+#endif
+#endif
+
+// ============================================================================
+// REACTOR
+// ============================================================================
+
+Reactor::Reactor()
+    : active(REACTOR_EPOLL), epoll_fd(-1), wake_fd(-1), next_token(1), wakeup_count(0), ring_fd(-1),
+      sq_ring(NULL), sq_ring_size(0), cq_ring(NULL), cq_ring_size(0), sqe_memory(NULL), sqe_memory_size(0),
+      sq_head(NULL), sq_tail(NULL), sq_mask(NULL), sq_array(NULL), cq_head(NULL), cq_tail(NULL), cq_mask(NULL),
+      cqes(NULL), sq_pending(0), buffer_ring(NULL), buffer_ring_size(0)
+{
+}
+
+Reactor::~Reactor()
+{
+#ifdef __linux__
+    closeUring();
+    for (std::map<uint64_t, int>::iterator it = timers.begin(); it != timers.end(); ++it)
+        close(it->second);
+    if (wake_fd >= 0)
+        close(wake_fd);
+    if (epoll_fd >= 0)
+        close(epoll_fd);
+#endif
+}
+
+bool Reactor::open(ReactorBackend backend)
+{
+#ifdef __linux__
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd < 0)
+    {
+        std::cerr << "❌ Could not create the reactor eventfd: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    if (backend == REACTOR_URING)
+    {
+        if (openUring())
+        {
+            active = REACTOR_URING;
+            add(wake_fd, REACTOR_READ, [this](uint32_t) {
+                uint64_t value;
+                while (read(wake_fd, &value, sizeof(value)) > 0)
+                {
+                }
+            });
+            return true;
+        }
+        closeUring();
+        std::cerr << "⚠️  Using epoll instead" << std::endl;
+    }
+
+    active = REACTOR_EPOLL;
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0)
+    {
+        std::cerr << "❌ Could not create the epoll set: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Token 0 is the wakeup eventfd
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | EPOLLET;
+    event.data.u64 = 0;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event) == 0;
+#else
+    (void)backend;
+    std::cerr << "❌ The reactor needs Linux" << std::endl;
+    return false;
+#endif
+}
+
+uint64_t Reactor::add(int fd, uint32_t events, const Handler &handler)
+{
+#ifdef __linux__
+    uint64_t token = next_token++;
+    if (active == REACTOR_URING)
+    {
+        Op op;
+        op.type = OP_POLL;
+        op.fd = fd;
+        op.cancelled = false;
+        op.handler = handler;
+        op.buffer = NULL;
+        op.size = events;
+        ops[token] = op;
+        armPoll(token, op);
+        return token;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLET | EPOLLRDHUP;
+    if (events & REACTOR_READ)
+        event.events |= EPOLLIN;
+    if (events & REACTOR_WRITE)
+        event.events |= EPOLLOUT;
+    event.data.u64 = token;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)
+    {
+        std::cerr << "❌ epoll_ctl failed: " << strerror(errno) << std::endl;
+        return 0;
+    }
+    Watch watch;
+    watch.fd = fd;
+    watch.handler = handler;
+    watches[token] = watch;
+    return token;
+#else
+    (void)fd;
+    (void)events;
+    (void)handler;
+    return 0;
+#endif
+}
+
+void Reactor::remove(uint64_t token)
+{
+#ifdef __linux__
+    if (active == REACTOR_URING)
+    {
+        cancel(token);
+        return;
+    }
+    std::map<uint64_t, Watch>::iterator it = watches.find(token);
+    if (it == watches.end())
+        return;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, it->second.fd, NULL);
+    watches.erase(it);
+#else
+    (void)token;
+#endif
+}
+
+uint64_t Reactor::addTimer(uint64_t interval_us, const std::function<void()> &fn)
+{
+#ifdef __linux__
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0)
+        return 0;
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = interval_us / 1000000;
+    spec.it_interval.tv_nsec = (interval_us % 1000000) * 1000;
+    spec.it_value = spec.it_interval;
+    timerfd_settime(fd, 0, &spec, NULL);
+
+    // A late wakeup covers every expiry it missed with one call
+    uint64_t token = add(fd, REACTOR_READ, [fd, fn](uint32_t) {
+        uint64_t expirations;
+        if (read(fd, &expirations, sizeof(expirations)) == (ssize_t)sizeof(expirations))
+            fn();
+    });
+    if (token == 0)
+        close(fd);
+    else
+        timers[token] = fd;
+    return token;
+#else
+    (void)interval_us;
+    (void)fn;
+    return 0;
+#endif
+}
+
+void Reactor::removeTimer(uint64_t token)
+{
+#ifdef __linux__
+    std::map<uint64_t, int>::iterator it = timers.find(token);
+    if (it == timers.end())
+        return;
+    remove(token);
+    close(it->second);
+    timers.erase(it);
+#else
+    (void)token;
+#endif
+}
+
+void Reactor::post(const std::function<void()> &fn)
+{
+    {
+        std::lock_guard<std::mutex> lock(posted_mutex);
+        posted.push_back(fn);
+    }
+#ifdef __linux__
+    uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        std::cerr << "⚠️  Could not wake the reactor" << std::endl;
+#endif
+}
+
+void Reactor::runPosted()
+{
+    std::vector<std::function<void()> > batch;
+    {
+        std::lock_guard<std::mutex> lock(posted_mutex);
+        batch.swap(posted);
+    }
+    for (size_t i = 0; i < batch.size(); i++)
+        batch[i]();
+}
+
+bool Reactor::runOnce(int timeout_ms)
+{
+#ifdef __linux__
+    if (active == REACTOR_URING)
+    {
+        // Submitting and waiting is one syscall; completions are read from shared memory
+        if (!submit(1, timeout_ms))
+            return false;
+        unsigned head = *cq_head;
+        unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        if (head != tail)
+            wakeup_count++;
+        while (head != tail)
+        {
+            const struct io_uring_cqe &cqe = ((const struct io_uring_cqe *)cqes)[head & *cq_mask];
+            uint64_t token = cqe.user_data;
+            int32_t result = cqe.res;
+            uint32_t flags = cqe.flags;
+            __atomic_store_n(cq_head, ++head, __ATOMIC_RELEASE);
+            complete(token, result, flags);
+            tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        }
+        runPosted();
+        return true;
+    }
+
+    struct epoll_event events[REACTOR_BATCH];
+    int count = epoll_wait(epoll_fd, events, REACTOR_BATCH, timeout_ms);
+    if (count < 0)
+        return errno == EINTR;
+    if (count > 0)
+        wakeup_count++;
+
+    for (int i = 0; i < count; i++)
+    {
+        uint64_t token = events[i].data.u64;
+        if (token == 0)
+        {
+            uint64_t value;
+            while (read(wake_fd, &value, sizeof(value)) > 0)
+            {
+            }
+            continue;
+        }
+
+        // A handler earlier in the batch may have removed this one
+        std::map<uint64_t, Watch>::iterator it = watches.find(token);
+        if (it == watches.end())
+            continue;
+        uint32_t flags = 0;
+        if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+            flags |= REACTOR_READ;
+        if (events[i].events & EPOLLOUT)
+            flags |= REACTOR_WRITE;
+        Handler handler = it->second.handler;
+        handler(flags);
+    }
+
+    // Posted work runs after the socket events, whether or not the eventfd fired
+    runPosted();
+    return true;
+#else
+    (void)timeout_ms;
+    return false;
+#endif
+}
+
+// ============================================================================
+// IO_URING BACKEND
+// ============================================================================
+
+#ifdef RGM_HAVE_URING
+
+static int uringSetup(unsigned entries, struct io_uring_params *params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uringEnter(int fd, unsigned submit, unsigned wait, unsigned flags, void *arg, size_t size)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, submit, wait, flags, arg, size);
+}
+
+static int uringRegister(int fd, unsigned opcode, void *arg, unsigned count)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+/**
+ * Map the rings and register the datagram buffer ring. Needs
+ * IORING_FEAT_EXT_ARG (5.11) for waits with a timeout and buffer rings
+ * (5.19); multishot receives (6.0) fail later, per receive.
+ */
+bool Reactor::openUring()
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = REACTOR_RING_ENTRIES * 4;
+    ring_fd = uringSetup(REACTOR_RING_ENTRIES, &params);
+    if (ring_fd < 0)
+    {
+        std::cerr << "⚠️  io_uring unavailable: " << strerror(errno) << std::endl;
+        return false;
+    }
+    if (!(params.features & IORING_FEAT_EXT_ARG) || !(params.features & IORING_FEAT_NODROP))
+    {
+        std::cerr << "⚠️  io_uring too old (needs Linux 5.11)" << std::endl;
+        return false;
+    }
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    sq_ring = mmap(NULL, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    cq_ring = mmap(NULL, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+    sqe_memory_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqe_memory = mmap(NULL, sqe_memory_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqe_memory == MAP_FAILED)
+    {
+        std::cerr << "⚠️  io_uring rings could not be mapped: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    uint8_t *sq = (uint8_t *)sq_ring;
+    sq_head = (unsigned *)(sq + params.sq_off.head);
+    sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    sq_array = (unsigned *)(sq + params.sq_off.array);
+    uint8_t *cq = (uint8_t *)cq_ring;
+    cq_head = (unsigned *)(cq + params.cq_off.head);
+    cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    cqes = cq + params.cq_off.cqes;
+
+    // Provided buffers for multishot datagram receives, group 0
+    buffer_ring_size = REACTOR_BUFFER_COUNT * sizeof(struct io_uring_buf);
+    buffer_ring = mmap(NULL, buffer_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer_ring == MAP_FAILED)
+    {
+        buffer_ring = NULL;
+        return false;
+    }
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)buffer_ring;
+    reg.ring_entries = REACTOR_BUFFER_COUNT;
+    reg.bgid = 0;
+    if (uringRegister(ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+        std::cerr << "⚠️  io_uring buffer rings unavailable (needs Linux 5.19): " << strerror(errno) << std::endl;
+        return false;
+    }
+    buffers.assign((size_t)REACTOR_BUFFER_COUNT * REACTOR_BUFFER_SIZE, 0);
+    for (unsigned i = 0; i < REACTOR_BUFFER_COUNT; i++)
+        recycleBuffer((uint16_t)i);
+    return true;
+}
+
+void Reactor::closeUring()
+{
+    if (ring_fd >= 0)
+        close(ring_fd);
+    ring_fd = -1;
+    if (sq_ring && sq_ring != MAP_FAILED)
+        munmap(sq_ring, sq_ring_size);
+    if (cq_ring && cq_ring != MAP_FAILED)
+        munmap(cq_ring, cq_ring_size);
+    if (sqe_memory && sqe_memory != MAP_FAILED)
+        munmap(sqe_memory, sqe_memory_size);
+    if (buffer_ring)
+        munmap(buffer_ring, buffer_ring_size);
+    sq_ring = cq_ring = sqe_memory = buffer_ring = NULL;
+    ops.clear();
+}
+
+// Hand a buffer (back) to the kernel
+void Reactor::recycleBuffer(uint16_t id)
+{
+    // Entries are indexed by hand: in C++ the header's flexible `bufs` array sits 8 bytes off
+    struct io_uring_buf_ring *ring = (struct io_uring_buf_ring *)buffer_ring;
+    uint16_t tail = ring->tail;
+    struct io_uring_buf &entry = ((struct io_uring_buf *)buffer_ring)[tail & (REACTOR_BUFFER_COUNT - 1)];
+    entry.addr = (uint64_t)(uintptr_t)(buffers.data() + (size_t)id * REACTOR_BUFFER_SIZE);
+    entry.len = REACTOR_BUFFER_SIZE;
+    entry.bid = id;
+    __atomic_store_n(&ring->tail, (uint16_t)(tail + 1), __ATOMIC_RELEASE);
+}
+
+// A cleared submission queue entry; flushes the queue when it is full
+void *Reactor::nextSqe()
+{
+    unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *sq_tail + sq_pending;
+    if (tail - head >= REACTOR_RING_ENTRIES)
+    {
+        submit(0, 0);
+        head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+        tail = *sq_tail + sq_pending;
+    }
+    unsigned index = tail & *sq_mask;
+    struct io_uring_sqe *sqe = (struct io_uring_sqe *)sqe_memory + index;
+    memset(sqe, 0, sizeof(*sqe));
+    sq_array[index] = index;
+    sq_pending++;
+    return sqe;
+}
+
+// Submit what is prepared and wait for `wait` completions at most `timeout_ms`
+bool Reactor::submit(unsigned wait, int timeout_ms)
+{
+    unsigned count = sq_pending;
+    __atomic_store_n(sq_tail, *sq_tail + sq_pending, __ATOMIC_RELEASE);
+    sq_pending = 0;
+
+    // Completions already waiting are taken without blocking
+    if (wait > 0 && *cq_head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+        wait = 0;
+    if (count == 0 && wait == 0)
+        return true;
+
+    struct __kernel_timespec timeout;
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = (uint64_t)(uintptr_t)&timeout;
+    unsigned flags = wait > 0 ? IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG : 0;
+    int result = uringEnter(ring_fd, count, wait, flags, wait > 0 ? &arg : NULL, wait > 0 ? sizeof(arg) : 0);
+    if (result < 0 && errno != ETIME && errno != EINTR && errno != EBUSY)
+    {
+        std::cerr << "❌ io_uring_enter failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void Reactor::armPoll(uint64_t token, const Op &op)
+{
+    struct io_uring_sqe *sqe = (struct io_uring_sqe *)nextSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = op.fd;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->poll32_events = ((op.size & REACTOR_READ) ? POLLIN | POLLRDHUP : 0) | ((op.size & REACTOR_WRITE) ? POLLOUT : 0);
+    sqe->user_data = token;
+}
+
+void Reactor::armDatagrams(uint64_t token, const Op &op)
+{
+    struct io_uring_sqe *sqe = (struct io_uring_sqe *)nextSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = op.fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+    sqe->user_data = token;
+}
+
+uint64_t Reactor::receive(int fd, void *buffer, size_t size, const Completion &done)
+{
+    uint64_t token = next_token++;
+    Op op;
+    op.type = OP_RECEIVE;
+    op.fd = fd;
+    op.cancelled = false;
+    op.done = done;
+    op.buffer = buffer;
+    op.size = size;
+    ops[token] = op;
+
+    struct io_uring_sqe *sqe = (struct io_uring_sqe *)nextSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buffer;
+    sqe->len = (uint32_t)size;
+    sqe->msg_flags = MSG_WAITALL;
+    sqe->user_data = token;
+    return token;
+}
+
+uint64_t Reactor::receiveDatagrams(int fd, const DatagramHandler &handler)
+{
+    uint64_t token = next_token++;
+    Op op;
+    op.type = OP_DATAGRAMS;
+    op.fd = fd;
+    op.cancelled = false;
+    op.datagram = handler;
+    op.buffer = NULL;
+    op.size = 0;
+    ops[token] = op;
+    armDatagrams(token, op);
+    return token;
+}
+
+// The op stays until its last completion arrives; user data 0 marks the cancel request itself
+void Reactor::cancel(uint64_t token)
+{
+    std::map<uint64_t, Op>::iterator it = ops.find(token);
+    if (it == ops.end() || it->second.cancelled)
+        return;
+    it->second.cancelled = true;
+    struct io_uring_sqe *sqe = (struct io_uring_sqe *)nextSqe();
+    sqe->opcode = it->second.type == OP_POLL ? IORING_OP_POLL_REMOVE : IORING_OP_ASYNC_CANCEL;
+    sqe->addr = token;
+    sqe->user_data = 0;
+}
+
+void Reactor::complete(uint64_t token, int32_t result, uint32_t flags)
+{
+    std::map<uint64_t, Op>::iterator it = ops.find(token);
+    if (token == 0 || it == ops.end())
+        return;
+    bool more = (flags & IORING_CQE_F_MORE) != 0;
+    bool has_buffer = (flags & IORING_CQE_F_BUFFER) != 0;
+    uint16_t buffer_id = (uint16_t)(flags >> IORING_CQE_BUFFER_SHIFT);
+
+    if (it->second.cancelled)
+    {
+        if (has_buffer)
+            recycleBuffer(buffer_id);
+        if (!more)
+            ops.erase(it);
+        return;
+    }
+
+    switch (it->second.type)
+    {
+    case OP_POLL:
+    {
+        // A multishot poll ends on errors or overflow; arm it again
+        if (!more)
+            armPoll(token, it->second);
+        uint32_t events = 0;
+        if (result > 0 && (result & (POLLIN | POLLRDHUP | POLLHUP | POLLERR)))
+            events |= REACTOR_READ;
+        if (result > 0 && (result & POLLOUT))
+            events |= REACTOR_WRITE;
+        Handler handler = it->second.handler;
+        if (events)
+            handler(events);
+        break;
+    }
+
+    case OP_RECEIVE:
+    {
+        Completion done = it->second.done;
+        ops.erase(it);
+        done(result);
+        break;
+    }
+
+    case OP_DATAGRAMS:
+    {
+        // Out of buffers (or any other stop): arm again, the handler returns buffers as it goes
+        if (!more)
+            armDatagrams(token, it->second);
+        DatagramHandler handler = it->second.datagram;
+        if (has_buffer)
+        {
+            if (result > 0)
+                handler(buffers.data() + (size_t)buffer_id * REACTOR_BUFFER_SIZE, (size_t)result);
+            recycleBuffer(buffer_id);
+        }
+        else if (result < 0 && result != -ENOBUFS)
+        {
+            std::cerr << "❌ io_uring datagram receive failed: " << strerror(-result) << std::endl;
+            std::map<uint64_t, Op>::iterator again = ops.find(token);
+            if (again != ops.end())
+                again->second.cancelled = true;
+        }
+        break;
+    }
+    }
+}
+
+#else
+
+bool Reactor::openUring()
+{
+    std::cerr << "⚠️  This build has no io_uring support" << std::endl;
+    return false;
+}
+
+void Reactor::closeUring() {}
+void *Reactor::nextSqe() { return NULL; }
+bool Reactor::submit(unsigned, int) { return false; }
+void Reactor::armPoll(uint64_t, const Op &) {}
+void Reactor::armDatagrams(uint64_t, const Op &) {}
+void Reactor::complete(uint64_t, int32_t, uint32_t) {}
+void Reactor::recycleBuffer(uint16_t) {}
+uint64_t Reactor::receive(int, void *, size_t, const Completion &) { return 0; }
+uint64_t Reactor::receiveDatagrams(int, const DatagramHandler &) { return 0; }
+void Reactor::cancel(uint64_t) {}
+
+#endif
+
+// ============================================================================
+// TASK POOL
+// ============================================================================
+
+TaskPool::TaskPool(int count) : stopping(false)
+{
+    for (int i = 0; i < (count < 1 ? 1 : count); i++)
+        threads.push_back(std::thread(&TaskPool::workerLoop, this));
+}
+
+TaskPool::~TaskPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+}
+
+void TaskPool::submit(const std::function<void()> &task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(task);
+    }
+    ready.notify_one();
+}
+
+void TaskPool::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        ready.wait(lock, [this] { return stopping || !tasks.empty(); });
+        if (tasks.empty())
+            return;
+        std::function<void()> task = tasks.front();
+        tasks.pop_front();
+
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
@@ -0,0 +1,195 @@
+/**
+ * REACTOR.H - EVENT LOOP FOR THE RECEIVER'S SOCKETS
+ *
+ * One thread waits for every socket the receiver serves: the listening
+ * socket, each sender's connection and UDP port, and the SSDP socket.
+ * Timers are timerfds in the same set, and other threads hand work back to
+ * the loop with post(), which wakes it through an eventfd.
+ *
+ * Two backends:
+ *   epoll    - sockets are registered edge-triggered, so a handler is
+ *              called once per burst of data and must read (or accept)
+ *              until EAGAIN
+ *   io_uring - readiness through multishot polls, plus completion-based
+ *              receives: receive() reads a whole message (MSG_WAITALL)
+ *              straight into the caller's buffer with one submission, and
+ *              receiveDatagrams() is a multishot receive into a ring of
+ *              REACTOR_BUFFER_SIZE buffers registered with the kernel, so
+ *              a stream of datagrams costs no syscall per datagram
+ *
+ * Linux only: elsewhere open() fails and the receiver keeps its
+ * thread-per-connection loop. io_uring falls back to epoll on kernels
+ * without multishot receives and buffer rings (before 6.0).
+ */
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define REACTOR_READ 1  // Handler events: readable (or hung up)
+#define REACTOR_WRITE 2 // Handler events: writable
+#define REACTOR_BATCH 64 // Events taken per wait
+#define REACTOR_RING_ENTRIES 256  // io_uring submission queue (completion queue is 4x)
+#define REACTOR_BUFFER_SIZE 2048  // io_uring: one datagram per provided buffer (MTU-sized packets)
+#define REACTOR_BUFFER_COUNT 1024 // io_uring: provided buffers (power of two)
+
+enum ReactorBackend
+{
+    REACTOR_EPOLL,
+    REACTOR_URING,
+};
+
+class Reactor
+{
+public:
+    typedef std::function<void(uint32_t events)> Handler;
+    typedef std::function<void(int result)> Completion;
+    typedef std::function<void(const uint8_t *data, size_t size)> DatagramHandler;
+
+    Reactor();
+    ~Reactor();
+
+    /**
+     * Set up the backend. REACTOR_URING falls back to epoll (after saying
+     * why) when the kernel cannot do it; false (after printing why) when
+     * neither works.
+     */
+    bool open(ReactorBackend backend = REACTOR_EPOLL);
+    ReactorBackend backend() const { return active; }
+    const char *describe() const { return active == REACTOR_URING ? "io_uring" : "epoll"; }
+
+    // Watch `fd` (REACTOR_READ and/or REACTOR_WRITE); returns a token for remove()
+    uint64_t add(int fd, uint32_t events, const Handler &handler);
+
+    // Stop watching; the handler is not called again, even later in the same batch
+    void remove(uint64_t token);
+
+    // Call `fn` every `interval_us`; returns a token for removeTimer()
+    uint64_t addTimer(uint64_t interval_us, const std::function<void()> &fn);
+    void removeTimer(uint64_t token);
+
+    // Run `fn` on the loop thread; safe from any thread
+    void post(const std::function<void()> &fn);
+
+    // Wait at most `timeout_ms` and dispatch what happened; false on error
+    bool runOnce(int timeout_ms);
+
+    /**
+     * io_uring only. Receive up to `size` bytes into `buffer`, waiting for
+     * all of them (MSG_WAITALL), then call `done` with the byte count, 0 at
+     * end of stream or -errno. The buffer must stay valid until `done` ran
+     * or the cancelled receive completed; `done` keeps its captures alive
+     * until then.
+     */
+    uint64_t receive(int fd, void *buffer, size_t size, const Completion &done);
+
+    // io_uring only. Call `handler` for every datagram arriving on `fd`, until cancel()
+    uint64_t receiveDatagrams(int fd, const DatagramHandler &handler);
+
+    // io_uring only. Cancel a receive; its callback is not called again
+    void cancel(uint64_t token);
+
+    uint64_t wakeups() const { return wakeup_count; }
+
+private:
+    struct Watch
+    {
+        int fd;
+        Handler handler;
+    };
+
+    void runPosted();
+
+    ReactorBackend active;
+    int epoll_fd;
+    int wake_fd;
+    uint64_t next_token;
+    std::map<uint64_t, Watch> watches;
+    std::map<uint64_t, int> timers; // token -> timerfd
+    std::mutex posted_mutex;
+    std::vector<std::function<void()> > posted;
+    uint64_t wakeup_count;
+
+    // io_uring
+    enum OpType
+    {
+        OP_POLL,
+        OP_RECEIVE,
+        OP_DATAGRAMS,
+    };
+    struct Op
+    {
+        OpType type;
+        int fd;
+        bool cancelled;
+        Handler handler;
+        Completion done;
+        DatagramHandler datagram;
+        void *buffer;
+        size_t size;
+    };
+
+    bool openUring();
+    void closeUring();
+    void *nextSqe();
+    bool submit(unsigned wait, int timeout_ms);
+    void armPoll(uint64_t token, const Op &op);
+    void armDatagrams(uint64_t token, const Op &op);
+    void complete(uint64_t token, int32_t result, uint32_t flags);
+    void recycleBuffer(uint16_t id);
+
+    int ring_fd;
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    void *sqe_memory;
+    size_t sqe_memory_size;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    void *cqes;
+    unsigned sq_pending; // Prepared, not yet submitted
+    void *buffer_ring;   // REACTOR_BUFFER_COUNT io_uring_buf entries
+    size_t buffer_ring_size;
+    std::vector<uint8_t> buffers;
+    std::map<uint64_t, Op> ops;
+};
+
+/**
+ * Threads that run queued tasks in order of submission, for work that
+ * should leave the reactor thread (decoding). Tasks of one source that
+ * must not overlap are serialized by the caller.
+ */
+class TaskPool
+{
+public:
+    explicit TaskPool(int threads);
+    ~TaskPool(); // Runs what is queued, then joins
+
+    int size() const { return (int)threads.size(); }
+    void submit(const std::function<void()> &task);
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<std::function<void()> > tasks;
+    bool stopping;
+};
+
+#endif
@@ -13,8 +13,23 @@
 #include <cstdint>
 #include <atomic>
 #include <iomanip>
-#include <SDL2/SDL.h>
+#include <cstdlib>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <list>
+#include <deque>
+#include <map>
+#include <random>
 #include "discover.h"
+#include "protocol.h"
+#include "stats.h"
+#include "trace.h"
+#include "codec.h"
+#include "sink.h"
+#include "archive.h"
+#include "packet.h"
+#include "reactor.h"
 
 #ifdef _WIN32
 #include <winsock2.h>
@@ -28,50 +43,89 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <signal.h>
+#include <sys/select.h>
 #endif
 
 // Constants - easily modifiable for future upgrades
-#define TCP_STREAM_PORT 8081                           // TCP port for video streaming
-#define BYTES_PER_PIXEL 3                              // RGB format
+#define TCP_STREAM_PORT 8081                           // Default TCP port for video streaming
 #define SSDP_ADDRESS "239.255.255.250"                 // SSDP multicast address
 #define SSDP_PORT 1900                                 // SSDP port
-#define MAX_DISPLAY_WIDTH 1920                         // Maximum display width (for scaling)
-#define MAX_DISPLAY_HEIGHT 1080                        // Maximum display height (for scaling)
+#define MULTICAST_POLL_US 10000                        // Window events between datagrams at most this often
+#define MULTICAST_NACK_INTERVAL_US 5000                // Missing packets are requested this often
+#define MULTICAST_IDLE_US 5000000                      // A silent multicast stream has ended
+#define UDP_WAIT_US 5000                               // Longest sleep in the UDP loop (frame release timers)
+#define MOSAIC_COMPOSE_US 5000                         // Concurrent sessions: the mosaic is redrawn this often at most
+#define SSDP_NOTIFY_US 30000000                        // NOTIFY announcements this often
+#define RESUME_WINDOW_US 30000000                      // A sender that dropped may resume its session this long
+#define REACTOR_WAIT_MS 100                            // --io epoll/uring: longest wait, to notice Ctrl+C
+#define REACTOR_TICK_US 5000                           // --io epoll/uring: UDP frame release and idle checks
+#define REACTOR_IDLE_US 10000000                       // --io epoll/uring: a silent sender has gone (like SO_RCVTIMEO)
+#define KEYFRAME_REQUEST_US 250000                     // A damaged picture asks the sender for a keyframe at most this often
+#define DECODE_QUEUE_FRAMES 2                          // --io epoll/uring: frames of a sender waiting for the decode pool
 static const int SOCKET_BUFFER_SIZE = 4 * 1024 * 1024; // 4MB socket buffer
 
 // Global variables for screen dimensions (updated from sender)
 int SCREEN_WIDTH = 1920;  // Default, will be updated from sender
 int SCREEN_HEIGHT = 1080; // Default, will be updated from sender
 int TARGET_FPS = 60;      // Default, will be updated from sender
+int DECODE_THREADS = 1;   // Tile decode workers (--threads)
+int WARMUP_FRAMES = 0;    // Frames per session left out of the figures (--warmup)
+uint32_t TILE_CACHE_TILES = 64 * 1024 * 1024 / TILE_BYTES; // Most tiles a sender may have us cache (--tile-cache)
+int TCP_PORT = TCP_STREAM_PORT; // Listening port (--port)
 
 // Global flag for thread shutdown (atomic for thread safety)
 std::atomic<bool> g_running{true};
 
+// Set by SIGUSR1 to write the trace without stopping the stream
+std::atomic<bool> g_trace_dump_requested{false};
+std::string g_trace_path;
+
+// Sessions are archived below this directory when set (--archive)
+std::string g_archive_root;
+
+// Receiver-wide totals across sessions, reported by --stats-json
+// (guarded by g_totals_mutex, sessions may run concurrently)
+std::mutex g_totals_mutex;
+int g_total_frames = 0;
+double g_total_seconds = 0;
+uint64_t g_total_bytes = 0;
+
 /**
- * SSDP advertisement thread function
- *
- * Handles two types of SSDP traffic:
- * 1. Responds to M-SEARCH queries from senders
- * 2. Sends periodic NOTIFY announcements
+ * SIGINT handler - request a clean shutdown
  */
-void ssdpAdvertisementThread()
+void handleSignal(int signum)
 {
-    std::cout << "📡 Starting SSDP advertiser thread..." << std::endl;
+#ifdef SIGUSR1
+    if (signum == SIGUSR1)
+    {
+        g_trace_dump_requested = true;
+        return;
+    }
+#endif
+    (void)signum;
+    g_running = false;
+}
 
+/**
+ * Create the socket that receives SSDP M-SEARCH queries: joined to the
+ * SSDP group and bound to the SSDP port. -1 (after printing why) on failure.
+ */
+int openSsdpSocket()
+{
     // Create UDP socket for SSDP responses
 #ifdef _WIN32
     SOCKET response_sock = socket(AF_INET, SOCK_DGRAM, 0);
     if (response_sock == INVALID_SOCKET)
     {
         std::cerr << "❌ Failed to create SSDP response socket" << std::endl;
-        return;
+        return -1;
     }
 #else
     int response_sock = socket(AF_INET, SOCK_DGRAM, 0);
     if (response_sock < 0)
     {
         std::cerr << "❌ Failed to create SSDP response socket" << std::endl;
-        return;
+        return -1;
     }
 #endif
 
@@ -84,12 +138,7 @@ void ssdpAdvertisementThread()
     setsockopt(response_sock, SOL_SOCKET, SO_RCVBUF, (char *)&sock_buf_size, sizeof(sock_buf_size));
 
     // Join multicast group
-    struct ip_mreq mreq;
-    mreq.imr_multiaddr.s_addr = inet_addr(SSDP_ADDRESS);
-    mreq.imr_interface.s_addr = INADDR_ANY;
-
-    if (setsockopt(response_sock, IPPROTO_IP, IP_ADD_MEMBERSHIP,
-                   (char *)&mreq, sizeof(mreq)) < 0)
+    if (!joinMulticastGroup((int)response_sock, SSDP_ADDRESS))
     {
         std::cerr << "❌ Failed to join multicast group" << std::endl;
 #ifdef _WIN32
@@ -97,7 +146,7 @@ void ssdpAdvertisementThread()
 #else
         close(response_sock);
 #endif
-        return;
+        return -1;
     }
 
     // Bind to SSDP port
@@ -115,125 +164,168 @@ void ssdpAdvertisementThread()
 #else
         close(response_sock);
 #endif
-        return;
+        return -1;
     }
 
     std::cout << "📡 Listening for SSDP M-SEARCH queries on port " << SSDP_PORT << std::endl;
+    return (int)response_sock;
+}
+
+/**
+ * Receive one SSDP message and answer it if it is an M-SEARCH for our
+ * service. False when nothing arrived (timeout, or EAGAIN when non-blocking).
+ */
+bool answerSsdpQuery(int response_sock, const std::string &local_ip)
+{
+    char buffer[2048];
+    struct sockaddr_in sender;
+    socklen_t sender_len = sizeof(sender);
+
+    // Wait for incoming SSDP messages
+    int bytes = recvfrom(response_sock, buffer, sizeof(buffer) - 1, 0,
+                         (struct sockaddr *)&sender, &sender_len);
+    if (bytes <= 0)
+        return false;
+
+    buffer[bytes] = '\0';
+    std::string request(buffer);
+
+    // Check if it's an M-SEARCH for our service
+    if (request.find("M-SEARCH") != std::string::npos &&
+        request.find("urn:screen-share:receiver") != std::string::npos)
+    {
+        std::cout << "📡 Received M-SEARCH from "
+                  << inet_ntoa(sender.sin_addr) << std::endl;
+
+        // Build SSDP response
+        std::string response =
+            "HTTP/1.1 200 OK\r\n"
+            "CACHE-CONTROL: max-age=30\r\n"
+            "DATE: " + std::to_string(time(nullptr)) + "\r\n"
+            "LOCATION: http://" + local_ip + ":" +
+            std::to_string(TCP_PORT) + "/\r\n"
+            "SERVER: ScreenShare/1.0\r\n"
+            "ST: urn:screen-share:receiver\r\n"
+            "USN: uuid:screen-share-" + local_ip + "\r\n"
+            "\r\n";
+
+        // Send response
+        sendto(response_sock, response.c_str(), response.length(), 0,
+               (struct sockaddr *)&sender, sender_len);
+
+        std::cout << "📡 Sent SSDP response to "
+                  << inet_ntoa(sender.sin_addr) << std::endl;
+    }
+    return true;
+}
+
+/**
+ * Create the socket for NOTIFY announcements, -1 on failure
+ */
+int openSsdpNotifySocket()
+{
+#ifdef _WIN32
+    SOCKET notify_sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (notify_sock == INVALID_SOCKET)
+        return -1;
+#else
+    int notify_sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (notify_sock < 0)
+        return -1;
+#endif
+
+    // Enable broadcast
+    int broadcast = 1;
+    setsockopt(notify_sock, SOL_SOCKET, SO_BROADCAST,
+               (char *)&broadcast, sizeof(broadcast));
+
+    // Set TTL for multicast
+    setMulticastSendOptions((int)notify_sock, 4, true);
+    return (int)notify_sock;
+}
+
+/**
+ * Announce the receiver to the SSDP group (NOTIFY ssdp:alive)
+ */
+void sendSsdpNotify(int notify_sock, const std::string &local_ip, int notify_count)
+{
+    // Build NOTIFY message
+    std::string notify_msg =
+        "NOTIFY * HTTP/1.1\r\n"
+        "HOST: " +
+        std::string(SSDP_ADDRESS) + ":" + std::to_string(SSDP_PORT) + "\r\n"
+                                                                      "CACHE-CONTROL: max-age=30\r\n"
+                                                                      "LOCATION: http://" +
+        local_ip + ":" + std::to_string(TCP_PORT) + "/\r\n"
+                                                           "NT: urn:screen-share:receiver\r\n"
+                                                           "NTS: ssdp:alive\r\n"
+                                                           "SERVER: ScreenShare/1.0\r\n"
+                                                           "USN: uuid:screen-share-" +
+        local_ip + "\r\n"
+                   "\r\n";
+
+    struct sockaddr_in dest_addr;
+    memset(&dest_addr, 0, sizeof(dest_addr));
+    dest_addr.sin_family = AF_INET;
+    dest_addr.sin_port = htons(SSDP_PORT);
+    inet_pton(AF_INET, SSDP_ADDRESS, &dest_addr.sin_addr);
+
+    sendto(notify_sock, notify_msg.c_str(), notify_msg.length(), 0,
+           (struct sockaddr *)&dest_addr, sizeof(dest_addr));
+
+    std::cout << "📡 SSDP NOTIFY #" << notify_count << " sent" << std::endl;
+}
+
+/**
+ * SSDP advertisement thread function
+ *
+ * Handles two types of SSDP traffic:
+ * 1. Responds to M-SEARCH queries from senders
+ * 2. Sends periodic NOTIFY announcements
+ */
+void ssdpAdvertisementThread()
+{
+    std::cout << "📡 Starting SSDP advertiser thread..." << std::endl;
+
+    int response_sock = openSsdpSocket();
+    if (response_sock < 0)
+        return;
 
     /**
      * Response thread - handles incoming M-SEARCH queries
      */
     std::thread response_thread([response_sock]()
                                 {
-        char buffer[2048];
-        struct sockaddr_in sender;
-        socklen_t sender_len = sizeof(sender);
         std::string local_ip = getLocalIPAddress();
-        
+
+        // Set receive timeout
+#ifdef _WIN32
+        int timeout = 1000;
+        setsockopt(response_sock, SOL_SOCKET, SO_RCVTIMEO, (char*)&timeout, sizeof(timeout));
+#else
+        struct timeval tv;
+        tv.tv_sec = 1;
+        tv.tv_usec = 0;
+        setsockopt(response_sock, SOL_SOCKET, SO_RCVTIMEO, (char*)&tv, sizeof(tv));
+#endif
+
         while (g_running)
-        {
-            // Set receive timeout
-            struct timeval tv;
-            tv.tv_sec = 1;
-            tv.tv_usec = 0;
-            setsockopt(response_sock, SOL_SOCKET, SO_RCVTIMEO, (char*)&tv, sizeof(tv));
-            
-            // Wait for incoming SSDP messages
-            int bytes = recvfrom(response_sock, buffer, sizeof(buffer) - 1, 0,
-                               (struct sockaddr*)&sender, &sender_len);
-            
-            if (!g_running)
-                break;
-                
-            if (bytes > 0)
-            {
-                buffer[bytes] = '\0';
-                std::string request(buffer);
-                
-                // Check if it's an M-SEARCH for our service
-                if (request.find("M-SEARCH") != std::string::npos && 
-                    request.find("urn:screen-share:receiver") != std::string::npos)
-                {
-                    std::cout << "📡 Received M-SEARCH from " 
-                              << inet_ntoa(sender.sin_addr) << std::endl;
-                    
-                    // Build SSDP response
-                    std::string response = 
-                        "HTTP/1.1 200 OK\r\n"
-                        "CACHE-CONTROL: max-age=30\r\n"
-                        "DATE: " + std::to_string(time(nullptr)) + "\r\n"
-                        "LOCATION: http://" + local_ip + ":" + 
-                        std::to_string(TCP_STREAM_PORT) + "/\r\n"
-                        "SERVER: ScreenShare/1.0\r\n"
-                        "ST: urn:screen-share:receiver\r\n"
-                        "USN: uuid:screen-share-" + local_ip + "\r\n"
-                        "\r\n";
-                    
-                    // Send response
-                    sendto(response_sock, response.c_str(), response.length(), 0,
-                           (struct sockaddr*)&sender, sender_len);
-                    
-                    std::cout << "📡 Sent SSDP response to " 
-                              << inet_ntoa(sender.sin_addr) << std::endl;
-                }
-            }
-        } });
+            answerSsdpQuery(response_sock, local_ip); });
 
     /**
      * Notification thread - sends periodic NOTIFY announcements
      */
-#ifdef _WIN32
-    SOCKET notify_sock = socket(AF_INET, SOCK_DGRAM, 0);
-    if (notify_sock != INVALID_SOCKET)
-#else
-    int notify_sock = socket(AF_INET, SOCK_DGRAM, 0);
+    int notify_sock = openSsdpNotifySocket();
     if (notify_sock >= 0)
-#endif
     {
-        // Enable broadcast
-        int broadcast = 1;
-        setsockopt(notify_sock, SOL_SOCKET, SO_BROADCAST,
-                   (char *)&broadcast, sizeof(broadcast));
-
-        // Set TTL for multicast
-        int ttl = 4;
-        setsockopt(notify_sock, IPPROTO_IP, IP_MULTICAST_TTL,
-                   (char *)&ttl, sizeof(ttl));
-
         std::string local_ip = getLocalIPAddress();
-
-        // Build NOTIFY message
-        std::string notify_msg =
-            "NOTIFY * HTTP/1.1\r\n"
-            "HOST: " +
-            std::string(SSDP_ADDRESS) + ":" + std::to_string(SSDP_PORT) + "\r\n"
-                                                                          "CACHE-CONTROL: max-age=30\r\n"
-                                                                          "LOCATION: http://" +
-            local_ip + ":" + std::to_string(TCP_STREAM_PORT) + "/\r\n"
-                                                               "NT: urn:screen-share:receiver\r\n"
-                                                               "NTS: ssdp:alive\r\n"
-                                                               "SERVER: ScreenShare/1.0\r\n"
-                                                               "USN: uuid:screen-share-" +
-            local_ip + "\r\n"
-                       "\r\n";
-
-        struct sockaddr_in dest_addr;
-        memset(&dest_addr, 0, sizeof(dest_addr));
-        dest_addr.sin_family = AF_INET;
-        dest_addr.sin_port = htons(SSDP_PORT);
-        inet_pton(AF_INET, SSDP_ADDRESS, &dest_addr.sin_addr);
-
         std::cout << "📡 Sending SSDP NOTIFY announcements every 30 seconds" << std::endl;
 
         // Send NOTIFY announcements periodically
         int notify_count = 0;
         while (g_running)
         {
-            sendto(notify_sock, notify_msg.c_str(), notify_msg.length(), 0,
-                   (struct sockaddr *)&dest_addr, sizeof(dest_addr));
-
-            notify_count++;
-            std::cout << "📡 SSDP NOTIFY #" << notify_count << " sent" << std::endl;
+            sendSsdpNotify(notify_sock, local_ip, ++notify_count);
 
             // Wait 30 seconds or until shutdown
             for (int i = 0; i < 30 && g_running; i++)
@@ -260,442 +352,2413 @@ void ssdpAdvertisementThread()
 }
 
 /**
- * Handle a single client connection
- *
- * This function:
- * 1. Receives handshake with screen dimensions
- * 2. Sets up SDL window and renderer
- * 3. Receives and displays video frames
+ * Glass-to-glass latency distributions, all on the receiver clock
  */
-bool handleClientConnection(int client_sock)
+struct LatencyStats
 {
-    // Increase socket buffer size for high FPS streaming
-    int sock_buf_size = SOCKET_BUFFER_SIZE;
-    setsockopt(client_sock, SOL_SOCKET, SO_RCVBUF, (char *)&sock_buf_size, sizeof(sock_buf_size));
-
-    // Set socket timeout
-#ifdef _WIN32
-    int timeout = 10000; // 10 seconds
-    setsockopt(client_sock, SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout, sizeof(timeout));
-#else
-    struct timeval tv;
-    tv.tv_sec = 10;
-    tv.tv_usec = 0;
-    setsockopt(client_sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-#endif
+    LatencyHistogram capture_to_receive; // Sender capture -> last byte received
+    LatencyHistogram receive_to_decode;  // Last byte received -> pixels ready
+    LatencyHistogram decode_to_present;  // Pixels ready -> sink presented the frame
+    LatencyHistogram capture_to_present; // Whole pipeline
 
-    /**
-     * Receive handshake with screen dimensions
-     */
-    struct
+    void merge(const LatencyStats &other)
     {
-        uint32_t width;
-        uint32_t height;
-        uint32_t fps;
-    } handshake;
+        capture_to_receive.merge(other.capture_to_receive);
+        receive_to_decode.merge(other.receive_to_decode);
+        decode_to_present.merge(other.decode_to_present);
+        capture_to_present.merge(other.capture_to_present);
+    }
 
-    int bytes_received = recv(client_sock, (char *)&handshake, sizeof(handshake), 0);
-    if (bytes_received != sizeof(handshake))
+    void reset()
     {
-        std::cerr << "❌ Failed to receive screen dimensions from sender" << std::endl;
-        return false;
+        capture_to_receive.reset();
+        receive_to_decode.reset();
+        decode_to_present.reset();
+        capture_to_present.reset();
     }
+};
+
+// Latency over every session, reported by --stats-json
+LatencyStats g_total_latency;
+
+/**
+ * Print latency percentiles, one line per pipeline segment
+ */
+void showLatency(const LatencyStats &latency)
+{
+    std::cout << "⏱️  Capture→receive: " << latency.capture_to_receive.summary() << std::endl;
+    std::cout << "⏱️  Receive→decode:  " << latency.receive_to_decode.summary() << std::endl;
+    std::cout << "⏱️  Decode→present:  " << latency.decode_to_present.summary() << std::endl;
+    std::cout << "⏱️  Glass-to-glass:  " << latency.capture_to_present.summary() << std::endl;
+}
 
-    // Update dimensions from sender
-    SCREEN_WIDTH = ntohl(handshake.width);
-    SCREEN_HEIGHT = ntohl(handshake.height);
-    TARGET_FPS = ntohl(handshake.fps);
+/**
+ * A frame header the transport may read a payload for, in a stream of this
+ * resolution and codec: raw frames are the whole picture, encoded ones at
+ * most maxEncodedSize()
+ */
+bool frameFits(const MessageHeader &header, int width, int height, int codec)
+{
+    size_t max_payload = maxEncodedSize(codec, width, height);
+    bool raw = codec == CODEC_RAW;
+    if (header.type == MSG_FRAME && header.size <= max_payload && (!raw || header.size == max_payload))
+        return true;
+    std::cerr << "❌ Invalid frame size: " << header.size
+              << " (expected " << (raw ? "" : "at most ") << max_payload << ")" << std::endl;
+    return false;
+}
 
-    std::cout << "📐 Received sender resolution: " << SCREEN_WIDTH << "x" << SCREEN_HEIGHT
-              << " @ " << TARGET_FPS << " FPS" << std::endl;
+/**
+ * Decode, present, archive and measure the frames of one session
+ *
+ * The transports (TCP connection, multicast group) deliver complete
+ * MSG_FRAME messages; everything after that is shared.
+ */
+class StreamSession
+{
+public:
+    // `label` (the sender's address) tags the statistics of concurrent sessions
+    explicit StreamSession(FrameSink &target, const std::string &label = "")
+        : sink(target), label(label), width(0), height(0), codec(CODEC_RAW), tile_cache(0),
+          clock_offset_us(0), clock_known(false), have_frame(false), last_frame(0), waiting_key(false),
+          key_wanted(false), last_key_request_us(0), key_requests(0), frames_received(0), session_bytes(0) {}
 
-    // Initialize SDL with video support
-    if (SDL_Init(SDL_INIT_VIDEO) < 0)
+    /**
+     * Open the sink and allocate the buffers for the stream `handshake`
+     * describes. Capture timestamps are only compared with our clock when
+     * the transport measured the offset (`clock_known`).
+     */
+    bool begin(const Handshake &handshake, int64_t offset_us, bool offset_known)
     {
-        std::cerr << "❌ SDL initialization failed: " << SDL_GetError() << std::endl;
-        return false;
+        // Update dimensions from sender
+        width = handshake.width;
+        height = handshake.height;
+        codec = handshake.codec;
+        tile_cache = handshake.tile_cache;
+        clock_offset_us = offset_us;
+        clock_known = offset_known;
+        {
+            std::lock_guard<std::mutex> lock(g_totals_mutex);
+            SCREEN_WIDTH = width;
+            SCREEN_HEIGHT = height;
+            TARGET_FPS = handshake.fps;
+        }
+
+        std::cout << prefix() << "📐 Received sender resolution: " << width << "x" << height
+                  << " @ " << handshake.fps << " FPS, codec " << codecName(codec) << ", " << handshake.tile_cache
+                  << " cached tiles" << std::endl;
+
+        // Open the sink (SDL window unless running headless)
+        if (!sink.open(width, height))
+            return false;
+        allocate();
+
+        // Optional archive of the encoded stream, written on its own thread
+        if (!g_archive_root.empty() && !archive.start(g_archive_root, width, height, codec))
+            std::cerr << "⚠️  Continuing without archiving" << std::endl;
+
+        frames_received = 0;
+        session_bytes = 0;
+        key_requests = 0;
+        have_frame = false;
+        waiting_key = false;
+        start_time = std::chrono::steady_clock::now();
+        window_start = start_time;
+        session_latency.reset();
+        window_latency.reset();
+        return true;
     }
 
     /**
-     * Calculate initial window size
-     * Scale down if screen is too large, but maintain aspect ratio
+     * The sender switched resolution or codec mid-stream (MSG_CONFIGURE or
+     * a new PKT_CONFIG); its next frame is a keyframe. The sink is resized
+     * and the buffers and decoder start over, the statistics carry on. The
+     * tile cache keeps the size agreed on at the start. An archive holds
+     * one resolution, so it continues in a new directory.
      */
-    int window_width = SCREEN_WIDTH;
-    int window_height = SCREEN_HEIGHT;
-
-    if (window_width > MAX_DISPLAY_WIDTH || window_height > MAX_DISPLAY_HEIGHT)
+    bool reconfigure(const Handshake &handshake)
     {
-        float scale = std::min((float)MAX_DISPLAY_WIDTH / window_width,
-                               (float)MAX_DISPLAY_HEIGHT / window_height);
-        window_width = (int)(window_width * scale);
-        window_height = (int)(window_height * scale);
+        width = handshake.width;
+        height = handshake.height;
+        codec = handshake.codec;
+        {
+            std::lock_guard<std::mutex> lock(g_totals_mutex);
+            SCREEN_WIDTH = width;
+            SCREEN_HEIGHT = height;
+        }
+
+        std::cout << prefix() << "📐 Sender switched to " << width << "x" << height << ", codec "
+                  << codecName(codec) << std::endl;
+        if (!sink.resize(width, height))
+            return false;
+        allocate();
+        waiting_key = false;
+
+        if (archive.active())
+        {
+            archive.stop();
+            if (!archive.start(g_archive_root, width, height, codec))
+                std::cerr << "⚠️  Continuing without archiving" << std::endl;
+        }
+        return true;
     }
 
-    // Create main window
-    SDL_Window *window = SDL_CreateWindow("RGM Receiver",
-                                          SDL_WINDOWPOS_CENTERED,
-                                          SDL_WINDOWPOS_CENTERED,
-                                          window_width,
-                                          window_height,
-                                          SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
+    bool raw() const { return codec == CODEC_RAW; }
 
-    if (!window)
+    // A resumed sender must stream what the sink and decoder were set up for
+    bool matches(const Handshake &handshake) const
     {
-        std::cerr << "❌ Window creation failed: " << SDL_GetError() << std::endl;
-        SDL_Quit();
-        return false;
+        return (int)handshake.width == width && (int)handshake.height == height && (int)handshake.codec == codec &&
+               handshake.tile_cache == tile_cache;
     }
 
-    /**
-     * Create hardware-accelerated renderer
-     */
-    SDL_Renderer *renderer = SDL_CreateRenderer(window, -1,
-                                                SDL_RENDERER_ACCELERATED |
-                                                    SDL_RENDERER_PRESENTVSYNC);
+    // A header the transport may read a payload for
+    bool accepts(const MessageHeader &header) const
+    {
+        return frameFits(header, width, height, codec);
+    }
 
-    if (!renderer)
+    // Where to receive a payload of `size` bytes: raw frames go straight into the picture
+    uint8_t *payloadBuffer(size_t size)
     {
-        std::cerr << "❌ Renderer creation failed: " << SDL_GetError() << std::endl;
-        SDL_DestroyWindow(window);
-        SDL_Quit();
-        return false;
+        if (raw())
+            return frame.data();
+        if (payload.size() < size)
+            payload.resize(size);
+        return payload.data();
     }
 
-    // Enable linear filtering for smooth scaling
-    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
+    // The transport has no keyframe yet, or lost one: ask the sender for it
+    void wantKeyframe()
+    {
+        key_wanted = true;
+    }
 
     /**
-     * Create texture with sender's resolution
-     * This texture will be scaled to window size by the renderer
+     * Whether the transport should send a keyframe request now, at most
+     * every KEYFRAME_REQUEST_US. Only the transport's thread calls this.
      */
-    SDL_Texture *texture = SDL_CreateTexture(renderer,
-                                             SDL_PIXELFORMAT_RGB24,
-                                             SDL_TEXTUREACCESS_STREAMING,
-                                             SCREEN_WIDTH,
-                                             SCREEN_HEIGHT);
-
-    if (!texture)
-    {
-        std::cerr << "❌ Texture creation failed: " << SDL_GetError() << std::endl;
-        SDL_DestroyRenderer(renderer);
-        SDL_DestroyWindow(window);
-        SDL_Quit();
-        return false;
+    bool takeKeyframeRequest(uint64_t now_us)
+    {
+        if (!key_wanted || now_us - last_key_request_us < KEYFRAME_REQUEST_US)
+            return false;
+        key_wanted = false;
+        last_key_request_us = now_us;
+        key_requests++;
+        return true;
     }
 
-    std::cout << "✅ SDL initialized successfully with " << SCREEN_WIDTH << "x" << SCREEN_HEIGHT << " texture" << std::endl;
-
-    // Allocate frame buffer
-    std::vector<uint8_t> frame(SCREEN_WIDTH * SCREEN_HEIGHT * BYTES_PER_PIXEL);
-
-    SDL_Event event;
-    bool streaming = true;
-    int frames_received = 0;
-    auto start_time = std::chrono::steady_clock::now();
+    uint32_t lastFrame() const { return last_frame; }
 
     /**
-     * Main display loop
+     * Decode and present one frame. `data` is the payload, either in
+     * payloadBuffer() or in a buffer of the transport. A frame that arrived
+     * with holes comes with the `spans` that did arrive; the rest of the
+     * picture is concealed with the previous frame.
+     *
+     * Tiles left stale by a concealed frame or a gap in the frame numbers
+     * make the session want a keyframe (takeKeyframeRequest). A frame that
+     * does not decode is not fatal: frames are skipped until the keyframe.
      */
-    while (streaming && g_running)
+    bool present(const MessageHeader &header, const uint8_t *data, uint64_t header_us, uint64_t received_us,
+                 const std::vector<PayloadSpan> *spans = NULL)
     {
-        // Handle SDL events
-        while (SDL_PollEvent(&event))
+        setTraceFrame(header.frame_id);
+        recordSpan(STAGE_RECV, header_us, received_us);
+        addCounter(COUNTER_BYTES, MESSAGE_HEADER_SIZE + header.size);
+
+        bool keyframe = (header.flags & FRAME_FLAG_KEYFRAME) != 0;
+        bool gap = have_frame && header.frame_id != last_frame + 1;
+        have_frame = true;
+        last_frame = header.frame_id;
+        if (keyframe && !spans)
+            waiting_key = key_wanted = false;
+        else if (waiting_key)
+            return true; // Nothing to decode onto
+        else if (!raw() && (spans || gap))
+            key_wanted = true;
+
+        // Raw RGB is the picture; tiles are applied to the last picture
+        if (spans)
         {
-            if (event.type == SDL_QUIT)
-            {
-                streaming = false;
-                g_running = false;
-            }
-            else if (event.type == SDL_KEYDOWN)
-            {
-                if (event.key.keysym.sym == SDLK_ESCAPE ||
-                    event.key.keysym.sym == SDLK_q)
-                {
-                    streaming = false;
-                    g_running = false;
-                }
-            }
-            else if (event.type == SDL_WINDOWEVENT)
+            if (!decoder->decodePartial(data, header.size, keyframe, *spans, frame.data()))
             {
-                if (event.window.event == SDL_WINDOWEVENT_RESIZED)
-                {
-                    std::cout << "Window resized to " << event.window.data1 << "x" << event.window.data2 << std::endl;
-                }
+                std::cerr << "⚠️  Could not conceal frame " << header.frame_id << ", waiting for a keyframe"
+                          << std::endl;
+                waiting_key = key_wanted = true;
+                return true;
             }
+            if (decoder->cacheMisses() > 0)
+                key_wanted = true; // Those tiles kept the previous picture
         }
-
-        // Receive frame size
-        uint32_t net_frame_size;
-        bytes_received = recv(client_sock, (char *)&net_frame_size, 4, 0);
-
-        if (bytes_received <= 0)
+        else if (raw())
         {
-            if (bytes_received == 0)
-                std::cout << "🔌 Sender disconnected" << std::endl;
-            else
-                std::cerr << "❌ Error receiving frame size" << std::endl;
-            break;
+            if (data != frame.data())
+                memcpy(frame.data(), data, frame.size());
         }
-
-        uint32_t frame_size = ntohl(net_frame_size);
-
-        // Validate frame size
-        if (frame_size != frame.size())
+        else if (!decoder->decode(data, header.size, keyframe, frame.data()))
         {
-            std::cerr << "❌ Invalid frame size: " << frame_size
-                      << " (expected " << frame.size() << ")" << std::endl;
-            break;
+            std::cerr << "⚠️  Could not decode frame " << header.frame_id << ", waiting for a keyframe" << std::endl;
+            waiting_key = key_wanted = true;
+            return true;
         }
+        else if (decoder->cacheMisses() > 0)
+            key_wanted = true;
+        uint64_t decoded_us = nowMicros();
+        recordSpan(STAGE_DECODE, received_us, decoded_us);
 
         /**
-         * Receive frame data
-         * Handle partial receives until complete frame is received
+         * Hand the frame to the sink and present it
          */
-        size_t total_received = 0;
-        while (total_received < frame_size)
+        if (!sink.upload(frame.data(), header.frame_id))
         {
-            bytes_received = recv(client_sock,
-                                  (char *)frame.data() + total_received,
-                                  frame_size - total_received, 0);
-
-            if (bytes_received <= 0)
-            {
-                std::cerr << "❌ Error receiving frame data" << std::endl;
-                streaming = false;
-                break;
-            }
-
-            total_received += bytes_received;
+            std::cerr << "❌ Frame sink " << sink.describe() << " failed" << std::endl;
+            return false;
         }
+        uint64_t uploaded_us = nowMicros();
+        recordSpan(STAGE_UPLOAD, decoded_us, uploaded_us);
 
-        if (!streaming)
-            break;
+        sink.present();
+        uint64_t presented_us = nowMicros();
+        recordSpan(STAGE_PRESENT, uploaded_us, presented_us);
+        addCounter(COUNTER_FRAMES);
 
-        /**
-         * Update texture and render
-         * The texture maintains the original resolution,
-         * the renderer scales it to window size
-         */
-        SDL_UpdateTexture(texture, NULL, frame.data(),
-                          SCREEN_WIDTH * BYTES_PER_PIXEL);
+        // Archive after presenting; a full queue drops frames instead of waiting
+        if (archive.active())
+        {
+            // Cache references are resolved, an archive is read without the cache
+            if (spans || (!keyframe && archive.wantsSnapshot(header.timestamp_us)))
+                archive.submitSnapshot(header.frame_id, header.timestamp_us, frame.data());
+            else if (!raw() && decoder->expandCached(frame.data(), expanded))
+                archive.submit(header.frame_id, header.timestamp_us, header.flags, expanded.data(), expanded.size());
+            else
+                archive.submit(header.frame_id, header.timestamp_us, header.flags, data, header.size);
+        }
 
-        SDL_RenderClear(renderer);
-        SDL_RenderCopy(renderer, texture, NULL, NULL);
-        SDL_RenderPresent(renderer);
+        // Capture time mapped onto our clock; clamp estimation error at zero
+        if (clock_known)
+        {
+            int64_t captured_us = (int64_t)header.timestamp_us + clock_offset_us;
+            window_latency.capture_to_receive.record(received_us > (uint64_t)captured_us ? received_us - captured_us : 0);
+            window_latency.capture_to_present.record(presented_us > (uint64_t)captured_us ? presented_us - captured_us : 0);
+        }
+        window_latency.receive_to_decode.record(decoded_us - received_us);
+        window_latency.decode_to_present.record(presented_us - decoded_us);
 
         frames_received++;
+        session_bytes += MESSAGE_HEADER_SIZE + header.size;
+
+        // Benchmarks leave the first frames (keyframe, cold caches) out of the figures
+        if (frames_received == WARMUP_FRAMES)
+        {
+            window_latency.reset();
+            session_latency.reset();
+            session_bytes = 0;
+            start_time = std::chrono::steady_clock::now();
+        }
 
         // Show statistics every 100 frames
         if (frames_received % 100 == 0)
         {
             auto now = std::chrono::steady_clock::now();
-            auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
-                               now - start_time)
-                               .count();
+            double elapsed = std::chrono::duration<double>(now - window_start).count();
+            window_start = now;
 
             if (elapsed > 0)
             {
-                float fps = frames_received / (float)elapsed;
-                std::cout << "📊 Frames: " << frames_received
+                double fps = 100 / elapsed;
+                std::cout << prefix() << "📊 Frames: " << frames_received
                           << " | FPS: " << std::fixed << std::setprecision(1) << fps
-                          << " | Resolution: " << SCREEN_WIDTH << "x" << SCREEN_HEIGHT << std::endl;
+                          << " | Resolution: " << width << "x" << height << std::endl;
+                showLatency(window_latency);
+
+                // Stage figures are receiver-wide, only a lone session shows them
+                if (label.empty())
+                {
+                    LatencyHistogram stages[STAGE_COUNT];
+                    stage_window.advance(stages);
+                    showStages(stages);
+                }
             }
+
+            if (g_trace_dump_requested.exchange(false))
+                writeTrace(g_trace_path, "RGM receiver", TRACE_PID_RECEIVER);
+
+            // Live figures cover the last 100 frames, the session keeps everything
+            session_latency.merge(window_latency);
+            window_latency.reset();
         }
+        return true;
     }
 
-    // Display final statistics
-    auto end_time = std::chrono::steady_clock::now();
-    auto total_seconds = std::chrono::duration_cast<std::chrono::seconds>(
-                             end_time - start_time)
-                             .count();
-
-    std::cout << "========================================" << std::endl;
-    std::cout << "📊 RECEIVER STATISTICS" << std::endl;
-    std::cout << "========================================" << std::endl;
-    std::cout << "Resolution:      " << SCREEN_WIDTH << "x" << SCREEN_HEIGHT << std::endl;
-    std::cout << "Frames received: " << frames_received << std::endl;
-    std::cout << "Duration:        " << total_seconds << " seconds" << std::endl;
-    if (total_seconds > 0)
+    // Print the session figures, add them to the totals and close the sink
+    void end()
     {
-        std::cout << "Average FPS:     " << (frames_received / total_seconds) << std::endl;
+        session_latency.merge(window_latency);
+        window_latency.reset();
+
+        // Display final statistics
+        auto end_time = std::chrono::steady_clock::now();
+        double total_seconds = std::chrono::duration<double>(end_time - start_time).count();
+        int measured_frames = frames_received > WARMUP_FRAMES ? frames_received - WARMUP_FRAMES : 0;
+        std::unique_lock<std::mutex> lock(g_totals_mutex);
+        g_total_frames += measured_frames;
+        g_total_seconds += total_seconds;
+        g_total_bytes += measured_frames > 0 ? session_bytes : 0;
+        g_total_latency.merge(session_latency);
+
+        // The lock also keeps the report of concurrent sessions in one piece
+        std::cout << "========================================" << std::endl;
+        std::cout << "📊 RECEIVER STATISTICS" << std::endl;
+        std::cout << "========================================" << std::endl;
+        if (!label.empty())
+            std::cout << "Sender:          " << label << std::endl;
+        std::cout << "Resolution:      " << width << "x" << height << std::endl;
+        std::cout << "Frames received: " << frames_received << std::endl;
+        if (key_requests > 0)
+            std::cout << "Keyframes asked: " << key_requests << std::endl;
+        std::cout << "Duration:        " << std::fixed << std::setprecision(1) << total_seconds << " seconds" << std::endl;
+        if (total_seconds > 0)
+        {
+            std::cout << "Average FPS:     " << (measured_frames / total_seconds);
+            if (WARMUP_FRAMES > 0)
+                std::cout << " (after " << WARMUP_FRAMES << " warmup frames)";
+            std::cout << std::endl;
+        }
+        showLatency(session_latency);
+        std::cout << "========================================" << std::endl;
+        lock.unlock();
+
+        // Close the window (or flush the headless sink)
+        sink.close();
+        archive.stop();
     }
-    std::cout << "========================================" << std::endl;
 
-    // Cleanup SDL resources
-    SDL_DestroyTexture(texture);
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
-    SDL_Quit();
+private:
+    std::string prefix() const { return label.empty() ? "" : "[" + label + "] "; }
 
-    return true;
-}
+    // Allocate frame buffer; raw frames are received straight into it,
+    // encoded ones land in `payload` and are decoded on top of the last picture
+    void allocate()
+    {
+        frame.assign((size_t)width * height * BYTES_PER_PIXEL, 0);
+        decoder.reset(new FrameDecoder(codec, width, height, DECODE_THREADS));
+        decoder->setTileCache(tile_cache);
+    }
+
+    FrameSink &sink;
+    std::string label;
+    int width, height;
+    int codec;
+    uint32_t tile_cache;
+    std::vector<uint8_t> frame;
+    std::vector<uint8_t> payload;
+    std::vector<uint8_t> expanded; // Frame for the archive, without cache references
+    std::unique_ptr<FrameDecoder> decoder;
+    ArchiveRecorder archive;
+    int64_t clock_offset_us;
+    bool clock_known;
+
+    // Decoding thread; key_wanted is also read by the transport
+    bool have_frame;
+    std::atomic<uint32_t> last_frame;
+    bool waiting_key; // A frame did not decode: skip to the next keyframe
+    std::atomic<bool> key_wanted;
+    uint64_t last_key_request_us; // Transport thread
+    uint64_t key_requests;
+
+    int frames_received;
+    uint64_t session_bytes;
+    std::chrono::steady_clock::time_point start_time;
+    std::chrono::steady_clock::time_point window_start;
+    LatencyStats session_latency;
+    LatencyStats window_latency;
+    StageWindow stage_window;
+};
 
 /**
- * Main function
- *
- * Sets up the receiver:
- * 1. Starts SSDP advertisement thread
- * 2. Creates TCP server socket
- * 3. Waits for sender connections
- * 4. Handles each connection
+ * Check a handshake (TCP or multicast PKT_CONFIG) before starting a session
  */
-int main()
+bool validHandshake(const Handshake &handshake)
 {
-    std::cout << "========================================" << std::endl;
-    std::cout << "📺 RGM RECEIVER v2.0" << std::endl;
-    std::cout << "========================================" << std::endl;
-    std::cout << "Local IP: " << getLocalIPAddress() << std::endl;
-    std::cout << "TCP Port: " << TCP_STREAM_PORT << std::endl;
-    std::cout << "SSDP:     " << SSDP_ADDRESS << ":" << SSDP_PORT << std::endl;
-    std::cout << "Resolution will be auto-detected from sender" << std::endl;
-    std::cout << "========================================" << std::endl;
-
-    // Initialize network sockets
-    if (!initSockets())
+    if (handshake.version != PROTOCOL_VERSION)
     {
-        std::cerr << "❌ Failed to initialize sockets" << std::endl;
-        return 1;
+        std::cerr << "❌ Protocol version mismatch: sender " << handshake.version
+                  << ", receiver " << PROTOCOL_VERSION << std::endl;
+        return false;
     }
 
-    // Start SSDP advertisement thread
-    std::thread ssdp_thread(ssdpAdvertisementThread);
-
-    // Create TCP server socket
-#ifdef _WIN32
-    SOCKET server_sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_sock == INVALID_SOCKET)
+    if (handshake.codec >= CODEC_COUNT)
     {
-        std::cerr << "❌ Failed to create server socket" << std::endl;
-        cleanupSockets();
-        return 1;
-    }
-#else
-    int server_sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_sock < 0)
-    {
-        std::cerr << "❌ Failed to create server socket" << std::endl;
-        cleanupSockets();
-        return 1;
+        std::cerr << "❌ Unsupported codec from sender: " << handshake.codec << std::endl;
+        return false;
     }
-#endif
 
-    // Allow address reuse
-    int reuse = 1;
-    if (setsockopt(server_sock, SOL_SOCKET, SO_REUSEADDR,
-                   (char *)&reuse, sizeof(reuse)) < 0)
+    if (handshake.tile_cache > TILE_CACHE_MAX)
     {
-        std::cerr << "⚠️  Failed to set SO_REUSEADDR" << std::endl;
+        std::cerr << "❌ Tile cache too large: " << handshake.tile_cache << " tiles" << std::endl;
+        return false;
     }
+    return true;
+}
 
-    // Set socket buffer size
-    int sock_buf_size = SOCKET_BUFFER_SIZE;
-    setsockopt(server_sock, SOL_SOCKET, SO_RCVBUF, (char *)&sock_buf_size, sizeof(sock_buf_size));
+// What we accept of the sender's tile cache offer, for MSG_SESSION and the decoder
+uint32_t acceptTileCache(Handshake &handshake)
+{
+    handshake.tile_cache = std::min(handshake.tile_cache, TILE_CACHE_TILES);
+    return handshake.tile_cache;
+}
 
-    // Bind to TCP port
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(TCP_STREAM_PORT);
-    server_addr.sin_addr.s_addr = INADDR_ANY;
+/**
+ * Read the stream description of a MSG_CONFIGURE and check it
+ */
+bool readConfiguration(int sock, const MessageHeader &header, Handshake &stream)
+{
+    uint8_t wire[sizeof(Handshake)];
+    if (header.size != sizeof(Handshake) || !recvAll(sock, wire, sizeof(wire)))
+    {
+        std::cerr << "❌ Invalid stream reconfiguration" << std::endl;
+        return false;
+    }
+    unpackHandshake(wire, stream);
+    return validHandshake(stream);
+}
 
-    if (bind(server_sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
+// Over UDP: the receiver is ready for the frames of a MSG_CONFIGURE
+bool confirmConfiguration(int sock, const MessageHeader &request)
+{
+    MessageHeader reply = {};
+    reply.type = MSG_CONFIGURE;
+    reply.frame_id = request.frame_id;
+    return sendMessage(sock, reply, NULL);
+}
+
+// MSG_KEYFRAME_REQUEST: the picture is damaged after `last_frame`
+bool requestKeyframe(int sock, uint32_t last_frame)
+{
+    MessageHeader request = {};
+    request.type = MSG_KEYFRAME_REQUEST;
+    request.frame_id = last_frame;
+    return sendMessage(sock, request, NULL);
+}
+
+/**
+ * Answer a MSG_TRANSPORT request: bind a UDP port and tell the sender
+ * (port 0 turns it down). Returns the non-blocking socket, -1 on failure.
+ */
+int openDatagramPort(int client_sock, const MessageHeader &request)
+{
+    int sock = (int)socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    socklen_t addr_len = sizeof(addr);
+    int sock_buf_size = SOCKET_BUFFER_SIZE;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char *)&sock_buf_size, sizeof(sock_buf_size));
+    bool ok = request.frame_id == TRANSPORT_UDP && sock >= 0 &&
+              bind(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0 &&
+              getsockname(sock, (struct sockaddr *)&addr, &addr_len) == 0;
+
+    // Port 0 turns the sender down
+    MessageHeader reply = {};
+    reply.type = MSG_TRANSPORT;
+    reply.frame_id = ok ? ntohs(addr.sin_port) : 0;
+    uint8_t wire[MESSAGE_HEADER_SIZE];
+    packHeader(reply, wire);
+    if (send(client_sock, (const char *)wire, sizeof(wire), 0) != (int)sizeof(wire) || !ok)
     {
-        std::cerr << "❌ Failed to bind to port " << TCP_STREAM_PORT << std::endl;
+        std::cerr << "❌ Could not set up the UDP transport" << std::endl;
+        if (sock >= 0)
+        {
 #ifdef _WIN32
-        closesocket(server_sock);
+            closesocket(sock);
 #else
-        close(server_sock);
+            close(sock);
 #endif
-        cleanupSockets();
-        return 1;
+        }
+        return -1;
     }
+    std::cout << "📶 Receiving frames on UDP port " << ntohs(addr.sin_port) << " (FEC group "
+              << request.flags << ")" << std::endl;
 
-    // Start listening
-    if (listen(server_sock, 5) < 0)
+    // Drained after every wakeup
+#ifdef _WIN32
+    u_long mode = 1;
+    ioctlsocket(sock, FIONBIO, &mode);
+#else
+    int flags = fcntl(sock, F_GETFL, 0);
+    fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+#endif
+    return sock;
+}
+
+/**
+ * Receive the frames of a session over UDP (the sender asked with
+ * MSG_TRANSPORT): bind a port, tell the sender, then reassemble datagrams
+ * until the sender closes the TCP connection. Nothing is resent; a single
+ * loss per FEC group is rebuilt from parity, anything worse is concealed
+ * with the previous picture (see FrameReassembler) and a keyframe is
+ * requested on the connection. The connection carries MSG_CONFIGURE,
+ * confirmed once the session is reconfigured, and MSG_BYE.
+ * True if the connection dropped without MSG_BYE, i.e. the sender may come
+ * back to resume.
+ */
+bool receiveDatagrams(int client_sock, const MessageHeader &request, StreamSession &session, FrameSink &sink)
+{
+    int sock = openDatagramPort(client_sock, request);
+    if (sock < 0)
+        return false;
+
+    FrameReassembler reassembler(true);
+    ReassembledFrame frame;
+    std::vector<uint8_t> datagram(65536);
+    bool have_stream = false;
+    uint32_t stream = 0;
+    uint64_t packets = 0;
+    uint64_t last_poll_us = 0;
+    bool connected = true;
+    bool dropped = true;
+
+    while (g_running && connected)
     {
-        std::cerr << "❌ Failed to listen on socket" << std::endl;
+        // Handle window events (closing the window quits the receiver)
+        uint64_t now_us = nowMicros();
+        if (now_us - last_poll_us >= MULTICAST_POLL_US)
+        {
+            last_poll_us = now_us;
+            if (!sink.poll())
+            {
+                g_running = false;
+                break;
+            }
+        }
+
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(sock, &readable);
+        FD_SET(client_sock, &readable);
+        struct timeval wait;
+        wait.tv_sec = 0;
+        wait.tv_usec = UDP_WAIT_US;
+        int ready = select((sock > client_sock ? sock : client_sock) + 1, &readable, NULL, NULL, &wait);
+
+        // Datagrams still queued when the connection closes are taken first
+        if (ready > 0 && FD_ISSET(client_sock, &readable))
+        {
+            MessageHeader header;
+            Handshake stream;
+            if (!recvHeader(client_sock, header))
+            {
+                std::cout << "🔌 Sender disconnected" << std::endl;
+                connected = false;
+            }
+            else if (header.type == MSG_BYE)
+                dropped = false;
+            else if (header.type != MSG_CONFIGURE || !readConfiguration(client_sock, header, stream) ||
+                     !session.reconfigure(stream) || !confirmConfiguration(client_sock, header))
+            {
+                connected = false;
+                dropped = false;
+            }
+            else
+                reassembler.restart(header.frame_id); // What is pending belongs to the old stream
+        }
+
+        bool more = ready > 0 && (FD_ISSET(sock, &readable) || !connected);
+        while (more)
+        {
+            int bytes = recv(sock, (char *)datagram.data(), datagram.size(), 0);
+            more = bytes > 0;
+            PacketHeader packet;
+            if (!more || !unpackPacketHeader(datagram.data(), bytes, packet))
+                continue;
+            if (!have_stream)
+            {
+                have_stream = true;
+                stream = packet.stream;
+            }
+            if (packet.stream != stream)
+                continue;
+            packets++;
+            reassembler.add(packet, datagram.data() + PACKET_HEADER_SIZE, bytes - PACKET_HEADER_SIZE, nowMicros());
+        }
+
+        // Present frames in order, concealing what is still missing
+        now_us = nowMicros();
+        while (reassembler.next(frame, now_us))
+        {
+            if (!session.accepts(frame.header))
+                continue;
+            if (!session.present(frame.header, frame.payload.data(), frame.first_us, now_us,
+                                 frame.complete ? NULL : &frame.spans))
+            {
+                connected = false;
+                dropped = false;
+                break;
+            }
+        }
+        if (connected && session.takeKeyframeRequest(now_us))
+            requestKeyframe(client_sock, session.lastFrame());
+    }
+
+    std::cout << "📶 UDP: " << packets << " packets, " << reassembler.packetsRecovered() << " rebuilt from parity, "
+              << reassembler.framesConcealed() << " frames concealed, " << reassembler.framesLost()
+              << " frames lost" << std::endl;
+    addCounter(COUNTER_DROPPED, reassembler.framesLost());
 #ifdef _WIN32
-        closesocket(server_sock);
+    closesocket(sock);
 #else
-        close(server_sock);
+    close(sock);
 #endif
-        cleanupSockets();
-        return 1;
+    return dropped && g_running;
+}
+
+/**
+ * Token for a new session, never 0
+ */
+uint32_t newSessionToken()
+{
+    static std::random_device random;
+    uint32_t token;
+    do
+        token = random() ^ (uint32_t)nowMicros();
+    while (token == 0);
+    return token;
+}
+
+// MSG_SESSION: the token of the session, 0 to turn a resume down, and the tiles we cache
+bool sendSessionToken(int sock, uint32_t token, bool resumed, uint32_t tile_cache)
+{
+    MessageHeader reply = {};
+    reply.type = MSG_SESSION;
+    reply.size = 4;
+    reply.frame_id = token;
+    reply.flags = resumed ? 1 : 0;
+    uint8_t payload[4];
+    putU32(payload, tile_cache);
+    return sendMessage(sock, reply, payload);
+}
+
+/**
+ * A session whose sender dropped without MSG_BYE. The sink (window,
+ * texture, last picture) and the decoder stay as they are for
+ * RESUME_WINDOW_US, so a sender reconnecting with the token carries on
+ * from its next keyframe without a new window or clock exchange.
+ */
+struct ParkedSession
+{
+    ParkedSession() : token(0), since_us(0) {}
+
+    // Give the session up: print its figures and close the sink
+    void end()
+    {
+        if (!session)
+            return;
+        session->end();
+        session.reset();
     }
 
-    std::cout << "⏳ Waiting for sender connection on port "
-              << TCP_STREAM_PORT << "..." << std::endl;
+    std::unique_ptr<StreamSession> session;
+    uint32_t token;
+    uint64_t since_us;
+};
+
+/**
+ * Handle a single client connection
+ *
+ * This function:
+ * 1. Receives handshake with screen dimensions
+ * 2. Opens the frame sink (SDL window or headless), or takes the `parked`
+ *    session back when the sender resumes it
+ * 3. Receives, decodes and hands frames to the sink
+ *
+ * With `parked`, a session whose sender drops without MSG_BYE is left
+ * there instead of ending.
+ */
+bool handleClientConnection(int client_sock, FrameSink &sink, const std::string &label = "",
+                            ParkedSession *parked = NULL)
+{
+    // Increase socket buffer size for high FPS streaming
+    int sock_buf_size = SOCKET_BUFFER_SIZE;
+    setsockopt(client_sock, SOL_SOCKET, SO_RCVBUF, (char *)&sock_buf_size, sizeof(sock_buf_size));
+
+    // Set socket timeout
+#ifdef _WIN32
+    int timeout = 10000; // 10 seconds
+    setsockopt(client_sock, SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout, sizeof(timeout));
+#else
+    struct timeval tv;
+    tv.tv_sec = 10;
+    tv.tv_usec = 0;
+    setsockopt(client_sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+#endif
 
     /**
-     * Main accept loop
-     * Uses select() for non-blocking accept with timeout
+     * Receive handshake with screen dimensions
      */
-    while (g_running)
+    uint8_t handshake_wire[sizeof(Handshake)];
+    if (!recvAll(client_sock, handshake_wire, sizeof(handshake_wire)))
     {
-        fd_set readfds;
-        FD_ZERO(&readfds);
-        FD_SET(server_sock, &readfds);
+        std::cerr << "❌ Failed to receive screen dimensions from sender" << std::endl;
+        return false;
+    }
 
-        struct timeval tv;
-        tv.tv_sec = 1;
-        tv.tv_usec = 0;
+    Handshake handshake;
+    unpackHandshake(handshake_wire, handshake);
+    if (!validHandshake(handshake))
+        return false;
+    acceptTileCache(handshake);
 
-        int activity = select(server_sock + 1, &readfds, NULL, NULL, &tv);
+    // A resumed session keeps its sink, decoder and clock offset; the sender starts with a keyframe
+    std::unique_ptr<StreamSession> session;
+    uint32_t token = handshake.session;
+    if (token != 0)
+    {
+        bool resumable = parked && parked->session && parked->token == token && parked->session->matches(handshake);
+        if (!sendSessionToken(client_sock, resumable ? token : 0, resumable, handshake.tile_cache))
+            return false;
+        if (resumable)
+        {
+            std::cout << "🔁 Sender resumed its session after "
+                      << formatMicros(nowMicros() - parked->since_us) << std::endl;
+            session = std::move(parked->session);
+        }
+        else
+            std::cout << "⚠️  Session to resume is gone, starting a new one" << std::endl;
+    }
 
-        if (!g_running)
+    if (!session)
+    {
+        // Whoever else connects, the parked session is over
+        if (parked)
+            parked->end();
+
+        /**
+         * Estimate the sender's clock offset so capture timestamps
+         * can be compared against our own clock
+         */
+        int64_t clock_offset_us = 0;
+        int64_t clock_rtt_us = 0;
+        if (!probeClockOffset(client_sock, clock_offset_us, clock_rtt_us))
+        {
+            std::cerr << "❌ Clock synchronization with sender failed" << std::endl;
+            return false;
+        }
+        std::cout << "⏱️  Clock offset: " << clock_offset_us << " us (RTT "
+                  << formatMicros(clock_rtt_us) << ")" << std::endl;
+
+        token = newSessionToken();
+        if (!sendSessionToken(client_sock, token, false, handshake.tile_cache))
+            return false;
+        session.reset(new StreamSession(sink, label));
+        if (!session->begin(handshake, clock_offset_us, true))
+            return false;
+    }
+
+    /**
+     * Main display loop
+     */
+    bool dropped = false; // Gone without MSG_BYE: the sender may come back
+    while (g_running)
+    {
+        // Handle window events (closing the window quits the receiver)
+        if (!sink.poll())
+        {
+            g_running = false;
             break;
+        }
 
-        if (activity < 0)
+        // Receive frame header
+        MessageHeader header;
+        if (!recvHeader(client_sock, header))
         {
-            std::cerr << "❌ Select error" << std::endl;
+            std::cout << "🔌 Sender disconnected" << std::endl;
+            dropped = g_running;
+            break;
+        }
+        uint64_t header_us = nowMicros();
+        if (header.type == MSG_BYE)
+        {
+            std::cout << "👋 Sender finished the stream" << std::endl;
+            break;
+        }
+        if (header.type == MSG_TRANSPORT)
+        {
+            dropped = receiveDatagrams(client_sock, header, *session, sink);
+            break;
+        }
+        if (header.type == MSG_CONFIGURE)
+        {
+            // In order with the frames: everything from here on is the new stream
+            Handshake stream;
+            if (!readConfiguration(client_sock, header, stream) || !session->reconfigure(stream))
+                break;
             continue;
         }
+        if (!session->accepts(header))
+            break;
 
-        if (activity == 0)
-            continue; // Timeout, check g_running again
+        /**
+         * Receive frame data
+         * recvAll handles partial receives until the complete frame is in
+         */
+        uint8_t *payload = session->payloadBuffer(header.size);
+        if (!recvAll(client_sock, payload, header.size))
+        {
+            std::cerr << "❌ Error receiving frame data" << std::endl;
+            dropped = g_running;
+            break;
+        }
 
-        // Accept new connection
-        struct sockaddr_in client_addr;
-        socklen_t client_len = sizeof(client_addr);
+        if (!session->present(header, payload, header_us, nowMicros()))
+            break;
+        if (session->takeKeyframeRequest(nowMicros()))
+            requestKeyframe(client_sock, session->lastFrame());
+    }
 
-#ifdef _WIN32
-        SOCKET client_sock = accept(server_sock, (struct sockaddr *)&client_addr, &client_len);
-        if (client_sock == INVALID_SOCKET)
-#else
-        int client_sock = accept(server_sock, (struct sockaddr *)&client_addr, &client_len);
-        if (client_sock < 0)
-#endif
+    if (dropped && parked)
+    {
+        std::cout << "⏸️  Keeping the session for " << RESUME_WINDOW_US / 1000000 << " s in case the sender comes back"
+                  << std::endl;
+        parked->session = std::move(session);
+        parked->token = token;
+        parked->since_us = nowMicros();
+        return true;
+    }
+    session->end();
+    return true;
+}
+
+/**
+ * Receive one multicast stream (--multicast group:port)
+ *
+ * Waits for the sender's PKT_CONFIG, then reassembles frames from the
+ * group and asks the sender for missing packets with unicast PKT_NACKs (see
+ * packet.h). Decoding starts at the next keyframe, which the sender
+ * refreshes periodically for late joiners; the receiver asks for one
+ * (PKT_KEY_REQUEST) when it joins and when frames are lost for good, so it
+ * does not wait for the refresh. A PKT_CONFIG with a new
+ * resolution or codec reconfigures the session in place. Returns after
+ * PKT_BYE, a change of stream, or MULTICAST_IDLE_US of silence.
+ */
+bool handleMulticastStream(int sock, FrameSink &sink)
+{
+    StreamSession session(sink);
+    FrameReassembler reassembler;
+    ReassembledFrame frame;
+    Handshake handshake = {};
+    bool started = false;
+    uint32_t stream = 0;
+    struct sockaddr_in source;
+    memset(&source, 0, sizeof(source));
+
+    std::vector<uint8_t> datagram(65536);
+    std::vector<uint32_t> lost;
+    std::vector<uint8_t> nack(PACKET_HEADER_SIZE + 4 * PACKET_NACK_MAX);
+    uint64_t last_packet_us = nowMicros();
+    uint64_t last_poll_us = 0;
+    uint64_t last_nack_us = 0;
+    uint64_t frames_lost = 0;
+    bool done = false;
+
+    while (g_running && !done)
+    {
+        uint64_t now_us = nowMicros();
+
+        // Handle window events (closing the window quits the receiver)
+        if (now_us - last_poll_us >= MULTICAST_POLL_US)
         {
-            std::cerr << "❌ Failed to accept connection" << std::endl;
+            last_poll_us = now_us;
+            if (!sink.poll())
+            {
+                g_running = false;
+                break;
+            }
+        }
+
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        int bytes = recvfrom(sock, (char *)datagram.data(), datagram.size(), 0, (struct sockaddr *)&from, &from_len);
+        now_us = nowMicros();
+
+        PacketHeader packet;
+        if (bytes > 0 && unpackPacketHeader(datagram.data(), bytes, packet))
+        {
+            const uint8_t *data = datagram.data() + PACKET_HEADER_SIZE;
+            size_t size = bytes - PACKET_HEADER_SIZE;
+
+            if (!started)
+            {
+                // Everything but the stream description is useless before it
+                if (packet.type != PKT_CONFIG || size < sizeof(Handshake))
+                    continue;
+                unpackHandshake(data, handshake);
+                if (!validHandshake(handshake))
+                    return false;
+                std::cout << "📡 Joined multicast stream from " << inet_ntoa(from.sin_addr) << ":"
+                          << ntohs(from.sin_port) << std::endl;
+                if (!session.begin(handshake, 0, false))
+                    return false;
+                session.wantKeyframe();
+                started = true;
+                stream = packet.stream;
+                source = from;
+            }
+            else if (packet.stream != stream)
+            {
+                std::cout << "📡 A new stream started on the group" << std::endl;
+                break;
+            }
+            else if (packet.type == PKT_CONFIG)
+            {
+                // A new resolution or codec from frame_id on; older frames still arriving are ignored
+                Handshake current;
+                if (size >= sizeof(Handshake))
+                {
+                    unpackHandshake(data, current);
+                    if (!sameStream(current, handshake))
+                    {
+                        if (!validHandshake(current) || !session.reconfigure(current))
+                            break;
+                        handshake = current;
+                        reassembler.restart(packet.frame_id);
+                    }
+                }
+            }
+            else if (packet.type == PKT_BYE)
+            {
+                std::cout << "🔌 Sender ended the stream" << std::endl;
+                done = true;
+            }
+            reassembler.add(packet, data, size, now_us);
+            last_packet_us = now_us;
+        }
+
+        if (!started)
             continue;
+
+        // Present whatever is complete, in order
+        while (reassembler.next(frame, now_us))
+        {
+            if (!session.accepts(frame.header))
+                continue;
+            if (!session.present(frame.header, frame.payload.data(), frame.first_us, now_us))
+            {
+                done = true;
+                break;
+            }
         }
 
-        std::cout << "✅ Sender connected from "
-                  << inet_ntoa(client_addr.sin_addr) << std::endl;
+        // Frames skipped for good wait for a keyframe; ask for it rather than wait for the refresh
+        if (reassembler.framesLost() != frames_lost)
+        {
+            frames_lost = reassembler.framesLost();
+            session.wantKeyframe();
+        }
+        if (session.takeKeyframeRequest(now_us))
+        {
+            PacketHeader request = {};
+            request.magic = PACKET_MAGIC;
+            request.stream = stream;
+            request.type = PKT_KEY_REQUEST;
+            packPacketHeader(request, nack.data());
+            sendto(sock, (const char *)nack.data(), PACKET_HEADER_SIZE, 0, (struct sockaddr *)&source,
+                   sizeof(source));
+        }
 
-        // Handle the connection
-        handleClientConnection(client_sock);
+        // Ask the sender for what is missing
+        if (now_us - last_nack_us >= MULTICAST_NACK_INTERVAL_US)
+        {
+            last_nack_us = now_us;
+            reassembler.missing(lost, now_us);
+            if (!lost.empty())
+            {
+                PacketHeader request = {};
+                request.magic = PACKET_MAGIC;
+                request.stream = stream;
+                request.type = PKT_NACK;
+                request.count = (uint16_t)lost.size();
+                packPacketHeader(request, nack.data());
+                for (size_t i = 0; i < lost.size(); i++)
+                    putU32(nack.data() + PACKET_HEADER_SIZE + 4 * i, lost[i]);
+                sendto(sock, (const char *)nack.data(), PACKET_HEADER_SIZE + 4 * lost.size(), 0,
+                       (struct sockaddr *)&source, sizeof(source));
+            }
+        }
 
-        // Close client socket
-#ifdef _WIN32
-        closesocket(client_sock);
-#else
-        close(client_sock);
-#endif
+        if (now_us - last_packet_us > MULTICAST_IDLE_US)
+        {
+            std::cout << "🔌 Multicast stream went silent" << std::endl;
+            break;
+        }
+    }
 
-        std::cout << "⏳ Waiting for next sender..." << std::endl;
+    if (started)
+    {
+        std::cout << "📡 Multicast: " << reassembler.packetsRepaired() << " packets repaired, "
+                  << reassembler.framesLost() << " frames skipped" << std::endl;
+        addCounter(COUNTER_DROPPED, reassembler.framesLost());
+        session.end();
     }
+    return started;
+}
 
-    // Cleanup
+/**
+ * Create the TCP socket senders connect to, bound to TCP_PORT and
+ * listening. -1 (after printing why) on failure.
+ */
+int openServerSocket()
+{
+    // Create TCP server socket
 #ifdef _WIN32
-    closesocket(server_sock);
+    SOCKET server_sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (server_sock == INVALID_SOCKET)
+    {
+        std::cerr << "❌ Failed to create server socket" << std::endl;
+        return -1;
+    }
 #else
-    close(server_sock);
+    int server_sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (server_sock < 0)
+    {
+        std::cerr << "❌ Failed to create server socket" << std::endl;
+        return -1;
+    }
 #endif
 
+    // Allow address reuse
+    int reuse = 1;
+    if (setsockopt(server_sock, SOL_SOCKET, SO_REUSEADDR,
+                   (char *)&reuse, sizeof(reuse)) < 0)
+    {
+        std::cerr << "⚠️  Failed to set SO_REUSEADDR" << std::endl;
+    }
+
+    // Set socket buffer size
+    int sock_buf_size = SOCKET_BUFFER_SIZE;
+    setsockopt(server_sock, SOL_SOCKET, SO_RCVBUF, (char *)&sock_buf_size, sizeof(sock_buf_size));
+
+    // Bind to TCP port
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(TCP_PORT);
+    server_addr.sin_addr.s_addr = INADDR_ANY;
+
+    if (bind(server_sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
+    {
+        std::cerr << "❌ Failed to bind to port " << TCP_PORT << std::endl;
+#ifdef _WIN32
+        closesocket(server_sock);
+#else
+        close(server_sock);
+#endif
+        return -1;
+    }
+
+    // Start listening
+    if (listen(server_sock, 5) < 0)
+    {
+        std::cerr << "❌ Failed to listen on socket" << std::endl;
+#ifdef _WIN32
+        closesocket(server_sock);
+#else
+        close(server_sock);
+#endif
+        return -1;
+    }
+
+    return (int)server_sock;
+}
+
+/**
+ * A concurrent session (--sessions): its thread, and whether it finished
+ */
+struct SessionWorker
+{
+    std::thread thread;
+    std::atomic<bool> done{false};
+};
+
+/**
+ * Accept senders over TCP (the default transport). Without a mosaic their
+ * sessions are handled one after another on this thread; with one, up to
+ * `max_sessions` run at once on their own threads while this thread
+ * composes their pictures onto `sink`. With `once`, returns after the
+ * first sender (or the first `max_sessions` senders) finished. False if
+ * the server socket cannot be set up.
+ */
+bool serveSenders(FrameSink &sink, bool once, FrameMosaic *mosaic, int max_sessions)
+{
+    int server_sock = openServerSocket();
+    if (server_sock < 0)
+        return false;
+
+    std::cout << "⏳ Waiting for sender connection on port "
+              << TCP_PORT << "..." << std::endl;
+
+    std::list<SessionWorker> workers;
+    int accepted = 0;
+    ParkedSession parked; // One session at a time: the last one, if its sender dropped
+
+    /**
+     * Main accept loop
+     * Uses select() for non-blocking accept with timeout
+     */
+    while (g_running)
+    {
+        if (mosaic)
+        {
+            // Closing the window quits the receiver and with it every session
+            if (!mosaic->poll() || !mosaic->compose())
+            {
+                g_running = false;
+                break;
+            }
+
+            for (std::list<SessionWorker>::iterator it = workers.begin(); it != workers.end();)
+            {
+                if (!it->done)
+                {
+                    ++it;
+                    continue;
+                }
+                it->thread.join();
+                it = workers.erase(it);
+            }
+            if (once && accepted == max_sessions && workers.empty())
+                break;
+        }
+        else
+        {
+            // The window outlives sessions and stays responsive between them
+            if (!sink.poll())
+            {
+                g_running = false;
+                break;
+            }
+            if (parked.session && nowMicros() - parked.since_us > RESUME_WINDOW_US)
+            {
+                std::cout << "⌛ The sender did not come back" << std::endl;
+                parked.end();
+                if (once)
+                    break;
+                std::cout << "⏳ Waiting for next sender..." << std::endl;
+            }
+        }
+
+        // A full mosaic (or a finished --once batch) accepts nobody until a session ends
+        bool accepting = !mosaic || ((int)workers.size() < max_sessions && !(once && accepted == max_sessions));
+
+        fd_set readfds;
+        FD_ZERO(&readfds);
+        if (accepting)
+            FD_SET(server_sock, &readfds);
+
+        struct timeval tv;
+        bool polling = parked.session || sink.interactive();
+        tv.tv_sec = mosaic || polling ? 0 : 1;
+        tv.tv_usec = mosaic ? MOSAIC_COMPOSE_US : polling ? MULTICAST_POLL_US : 0;
+
+        int activity = select(server_sock + 1, &readfds, NULL, NULL, &tv);
+
+        if (!g_running)
+            break;
+
+        if (activity < 0)
+        {
+            std::cerr << "❌ Select error" << std::endl;
+            continue;
+        }
+
+        if (activity == 0)
+            continue; // Timeout, check g_running again
+
+        // Accept new connection
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+
+#ifdef _WIN32
+        SOCKET client_sock = accept(server_sock, (struct sockaddr *)&client_addr, &client_len);
+        if (client_sock == INVALID_SOCKET)
+#else
+        int client_sock = accept(server_sock, (struct sockaddr *)&client_addr, &client_len);
+        if (client_sock < 0)
+#endif
+        {
+            std::cerr << "❌ Failed to accept connection" << std::endl;
+            continue;
+        }
+
+        std::string address = inet_ntoa(client_addr.sin_addr);
+        std::cout << "✅ Sender connected from " << address << std::endl;
+
+        if (mosaic)
+        {
+            // Each session decodes into its own mosaic slot on its own thread
+            accepted++;
+            std::string label = address + ":" + std::to_string(ntohs(client_addr.sin_port));
+            std::shared_ptr<FrameSink> slot(mosaic->slot(label));
+            workers.emplace_back();
+            SessionWorker &worker = workers.back();
+            worker.thread = std::thread([client_sock, slot, label, &worker]() {
+                handleClientConnection(client_sock, *slot, label);
+#ifdef _WIN32
+                closesocket(client_sock);
+#else
+                close(client_sock);
+#endif
+                slot->close();
+                worker.done = true;
+            });
+            continue;
+        }
+
+        // Handle the connection
+        handleClientConnection(client_sock, sink, "", &parked);
+
+        // Close client socket
+#ifdef _WIN32
+        closesocket(client_sock);
+#else
+        close(client_sock);
+#endif
+
+        if (parked.session)
+            continue;
+        if (once)
+            break;
+        std::cout << "⏳ Waiting for next sender..." << std::endl;
+    }
+
+    // Sessions notice g_running (or their sender leaving) and end on their own
+    for (std::list<SessionWorker>::iterator it = workers.begin(); it != workers.end(); ++it)
+        it->thread.join();
+    if (mosaic)
+        mosaic->close();
+    parked.end();
+
+#ifdef _WIN32
+    closesocket(server_sock);
+#else
+    close(server_sock);
+#endif
+    return true;
+}
+
+// ============================================================================
+// REACTOR (--io epoll, --io uring)
+// ============================================================================
+
+#ifndef _WIN32
+class ReactorConnection;
+
+/**
+ * Accept and serve senders from one event loop on this thread (--io epoll
+ * or --io uring)
+ *
+ * The listening socket, every connection and UDP port, the SSDP socket and
+ * the timers (UDP frame release, idle senders, window events, the mosaic)
+ * share one Reactor. With a mosaic, frames are decoded on a TaskPool;
+ * otherwise right on this thread, which owns the sink either way.
+ */
+class ReactorServer
+{
+public:
+    ReactorServer(FrameSink &sink, FrameMosaic *mosaic, int max_sessions, bool once)
+        : sink(sink), mosaic(mosaic), server_sock(-1), ssdp_sock(-1), notify_sock(-1), notify_count(0),
+          max_sessions(max_sessions), once(once), accepted(0), done(false) {}
+
+    bool open(ReactorBackend backend) { return reactor.open(backend); }
+
+    // Serve until Ctrl+C, or the --once senders are done. False if the server socket cannot be set up
+    bool run(bool advertise);
+
+    // A connection ended (reactor thread); it is released here
+    void closed(const std::shared_ptr<ReactorConnection> &connection);
+
+    Reactor reactor;
+    std::unique_ptr<TaskPool> pool; // Decode workers, only with a mosaic
+    FrameSink &sink;
+    FrameMosaic *mosaic;
+
+private:
+    void acceptSenders();
+    void tick();
+
+    int server_sock;
+    int ssdp_sock;
+    int notify_sock;
+    int notify_count;
+    std::string local_ip;
+    int max_sessions;
+    bool once;
+    int accepted;
+    bool done;
+    std::map<ReactorConnection *, std::shared_ptr<ReactorConnection> > connections;
+};
+
+/**
+ * One sender on the reactor
+ *
+ * The reactor thread reads whatever arrived into the message being
+ * assembled (handshake, clock replies, frame header, payload) and never
+ * blocks. Frames are decoded on the spot, or with a decode pool queued
+ * and decoded one at a time so they stay in order. Reading stops while
+ * DECODE_QUEUE_FRAMES wait, which pushes back on the sender through TCP.
+ *
+ * On io_uring nothing is read on readiness: each message gets one receive
+ * that completes when all of it is in (the payload straight into the
+ * session's or the pool's buffer), and UDP datagrams arrive through one
+ * multishot receive.
+ */
+class ReactorConnection : public std::enable_shared_from_this<ReactorConnection>
+{
+public:
+    ReactorConnection(ReactorServer &server, int sock, const std::string &label, std::unique_ptr<FrameSink> slot)
+        : server(server), sock(sock), token(0), udp_sock(-1), udp_token(0), slot(std::move(slot)),
+          session(this->slot ? *this->slot : server.sink, label), prefix(label.empty() ? "" : "[" + label + "] "),
+          state(STATE_HANDSHAKE), target(NULL), wanted(0), filled(0), header_us(0), scheduled(false),
+          failed(false), paused(false), begun(false), ended(false), receiving(false), have_stream(false), stream(0), packets(0), last_activity_us(nowMicros()) {}
+
+    void start()
+    {
+        int sock_buf_size = SOCKET_BUFFER_SIZE;
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char *)&sock_buf_size, sizeof(sock_buf_size));
+        if (uring())
+        {
+            want(wire, sizeof(Handshake));
+            readMore();
+            return;
+        }
+        int flags = fcntl(sock, F_GETFL, 0);
+        fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+
+        want(wire, sizeof(Handshake));
+        token = server.reactor.add(sock, REACTOR_READ, [this](uint32_t) { onReadable(); });
+        if (token == 0)
+            finish("❌ Could not watch the connection");
+    }
+
+    // Reactor tick: release UDP frames whose wait ran out, drop silent senders
+    void tick(uint64_t now_us)
+    {
+        if (state == STATE_CLOSED)
+            return;
+        if (reassembler)
+            pump();
+        if (!paused && now_us - last_activity_us > REACTOR_IDLE_US)
+            finish("🔌 Sender timed out");
+    }
+
+    // Ctrl+C
+    void stop()
+    {
+        finish("");
+    }
+
+private:
+    enum State
+    {
+        STATE_HANDSHAKE, // Reading the Handshake
+        STATE_CLOCK,     // Reading a MSG_CLOCK_REPLY and its payload
+        STATE_HEADER,    // Reading a MessageHeader
+        STATE_PAYLOAD,   // Reading a MSG_FRAME payload
+        STATE_CONFIGURE, // Reading a MSG_CONFIGURE payload
+        STATE_DATAGRAMS, // Frames arrive on udp_sock; reading a MessageHeader (MSG_CONFIGURE, MSG_BYE)
+        STATE_CLOSED,
+    };
+
+    enum Fill
+    {
+        FILL_DONE,
+        FILL_AGAIN, // Nothing more to read right now
+        FILL_CLOSED,
+    };
+
+    struct QueuedFrame
+    {
+        MessageHeader header; // MSG_FRAME, or MSG_CONFIGURE to switch to `stream`
+        Handshake stream;
+        uint64_t header_us;
+        uint64_t received_us;
+        bool partial;
+        std::vector<PayloadSpan> spans;
+        std::vector<uint8_t> payload;
+    };
+
+    bool uring() const
+    {
+        return server.reactor.backend() == REACTOR_URING;
+    }
+
+    void want(uint8_t *buffer, size_t size)
+    {
+        target = buffer;
+        wanted = size;
+        filled = 0;
+    }
+
+    Fill fill()
+    {
+        while (filled < wanted)
+        {
+            ssize_t bytes = recv(sock, (char *)target + filled, wanted - filled, 0);
+            if (bytes > 0)
+            {
+                filled += bytes;
+                last_activity_us = nowMicros();
+                continue;
+            }
+            if (bytes < 0 && errno == EINTR)
+                continue;
+            if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                return FILL_AGAIN;
+            return FILL_CLOSED;
+        }
+        return FILL_DONE;
+    }
+
+    // Edge-triggered: read until the socket is empty or reading pauses
+    void onReadable()
+    {
+        while (state != STATE_CLOSED && !paused)
+        {
+            Fill result = fill();
+            if (result == FILL_AGAIN)
+                return;
+            if (result == FILL_CLOSED)
+            {
+                closedBySender();
+                return;
+            }
+            if (!advance())
+            {
+                finish("");
+                return;
+            }
+        }
+    }
+
+    // io_uring: one receive at a time, for the rest of the message being read
+    void readMore()
+    {
+        while (state != STATE_CLOSED && !paused && !receiving)
+        {
+            if (filled < wanted)
+            {
+                receive(target + filled, wanted - filled);
+                return;
+            }
+            if (!advance())
+            {
+                finish("");
+                return;
+            }
+        }
+    }
+
+    void receive(uint8_t *buffer, size_t size)
+    {
+        std::shared_ptr<ReactorConnection> self = shared_from_this();
+        receiving = true;
+        token = server.reactor.receive(sock, buffer, size, [self](int result) { self->received(result); });
+    }
+
+    void received(int result)
+    {
+        receiving = false;
+        if (state == STATE_CLOSED)
+            return;
+        if (result == -EINTR)
+        {
+            readMore();
+            return;
+        }
+        if (result <= 0)
+        {
+            closedBySender();
+            return;
+        }
+        filled += result;
+        last_activity_us = nowMicros();
+        readMore();
+    }
+
+    // The connection closed (or failed); over UDP, take the frames still on their way first
+    void closedBySender()
+    {
+        if (reassembler)
+            endDatagrams();
+        else
+            finish(state == STATE_HANDSHAKE ? "❌ Failed to receive screen dimensions from sender"
+                                            : "🔌 Sender disconnected");
+    }
+
+    // Carry on after reading paused
+    void continueReading()
+    {
+        if (uring())
+            readMore();
+        else
+            onReadable(); // No new edge comes for bytes that arrived while paused
+    }
+
+    // The message being read is complete; set up the next one. False ends the connection
+    bool advance()
+    {
+        uint64_t now_us = nowMicros();
+        switch (state)
+        {
+        case STATE_HANDSHAKE:
+            unpackHandshake(wire, handshake);
+            if (!validHandshake(handshake))
+                return false;
+            acceptTileCache(handshake);
+
+            // Sessions are not kept for a resume here: the sender gets a new one
+            if (handshake.session != 0 && !sendSessionToken(sock, 0, false, handshake.tile_cache))
+                return false;
+            if (!sendMessage(sock, clock.probe(), NULL))
+                return false;
+            state = STATE_CLOCK;
+            want(wire, MESSAGE_HEADER_SIZE + CLOCK_REPLY_PAYLOAD);
+            return true;
+
+        case STATE_CLOCK:
+        {
+            MessageHeader reply;
+            unpackHeader(wire, reply);
+            if (reply.type != MSG_CLOCK_REPLY || reply.size != CLOCK_REPLY_PAYLOAD)
+            {
+                std::cerr << "❌ Invalid clock sync reply" << std::endl;
+                return false;
+            }
+            clock.add(reply, wire + MESSAGE_HEADER_SIZE, now_us);
+            if (!clock.done())
+            {
+                want(wire, MESSAGE_HEADER_SIZE + CLOCK_REPLY_PAYLOAD);
+                return sendMessage(sock, clock.probe(), NULL);
+            }
+            if (!sendMessage(sock, clock.result(), NULL) ||
+                !sendSessionToken(sock, newSessionToken(), false, handshake.tile_cache))
+                return false;
+            std::cout << prefix << "⏱️  Clock offset: " << clock.offset_us << " us (RTT "
+                      << formatMicros(clock.rtt_us) << ")" << std::endl;
+
+            if (!session.begin(handshake, clock.offset_us, true))
+                return false;
+            begun = true;
+            state = STATE_HEADER;
+            want(wire, MESSAGE_HEADER_SIZE);
+            return true;
+        }
+
+        case STATE_HEADER:
+            header_us = now_us;
+            unpackHeader(wire, header);
+            if (header.type == MSG_TRANSPORT)
+                return openDatagrams();
+            if (header.type == MSG_BYE)
+            {
+                std::cout << prefix << "👋 Sender finished the stream" << std::endl;
+                return false;
+            }
+            if (header.type == MSG_CONFIGURE)
+                return expectConfiguration();
+            if (!frameFits(header, handshake.width, handshake.height, handshake.codec))
+                return false;
+
+            // Straight into the session's buffer, or into one the decode pool takes over
+            if (server.pool)
+            {
+                takeSpare(incoming);
+                incoming.resize(header.size);
+                want(incoming.data(), header.size);
+            }
+            else
+                want(session.payloadBuffer(header.size), header.size);
+            state = STATE_PAYLOAD;
+            return true;
+
+        case STATE_PAYLOAD:
+            state = STATE_HEADER;
+            if (!deliver(header, target, &incoming, header_us, now_us, NULL))
+                return false;
+            want(wire, MESSAGE_HEADER_SIZE);
+            return true;
+
+        case STATE_CONFIGURE:
+        {
+            Handshake stream;
+            unpackHandshake(wire, stream);
+            if (!validHandshake(stream) || !reconfigure(stream))
+                return false;
+            state = reassembler ? STATE_DATAGRAMS : STATE_HEADER;
+            want(wire, MESSAGE_HEADER_SIZE);
+            return true;
+        }
+
+        case STATE_DATAGRAMS:
+            unpackHeader(wire, header);
+            if (header.type == MSG_CONFIGURE)
+                return expectConfiguration();
+            if (header.type != MSG_BYE)
+                return false;
+            want(wire, MESSAGE_HEADER_SIZE); // The connection closes next
+            return true;
+
+        default:
+            return false;
+        }
+    }
+
+    // MSG_CONFIGURE: read the new stream description
+    bool expectConfiguration()
+    {
+        if (header.size != sizeof(Handshake))
+        {
+            std::cerr << prefix << "❌ Invalid stream reconfiguration" << std::endl;
+            return false;
+        }
+        state = STATE_CONFIGURE;
+        want(wire, sizeof(Handshake));
+        return true;
+    }
+
+    /**
+     * Frames from here on are of the stream `stream` describes: the session
+     * switches in order with the frames before, on the decode pool if there
+     * is one. Over UDP, frames still pending are of the old stream, and
+     * the sender waits for our confirmation before sending new ones.
+     */
+    bool reconfigure(const Handshake &stream)
+    {
+        handshake = stream;
+        if (reassembler)
+        {
+            pump();
+            reassembler->restart(header.frame_id);
+        }
+        if (!server.pool)
+        {
+            if (!session.reconfigure(stream))
+                return false;
+        }
+        else
+        {
+            QueuedFrame queued;
+            queued.header = header;
+            queued.stream = stream;
+            enqueue(queued);
+        }
+        return !reassembler || confirmConfiguration(sock, header);
+    }
+
+    bool openDatagrams()
+    {
+        udp_sock = openDatagramPort(sock, header);
+        if (udp_sock < 0)
+            return false;
+        reassembler.reset(new FrameReassembler(true));
+        datagram.resize(65536);
+        // io_uring waits for datagrams only on a blocking socket; a non-blocking one fails the receive at once
+        if (uring())
+        {
+            int flags = fcntl(udp_sock, F_GETFL, 0);
+            fcntl(udp_sock, F_SETFL, flags & ~O_NONBLOCK);
+            udp_token = server.reactor.receiveDatagrams(udp_sock, [this](const uint8_t *data, size_t size) {
+                if (takeDatagram(data, size))
+                    pump();
+            });
+        }
+        else
+            udp_token = server.reactor.add(udp_sock, REACTOR_READ, [this](uint32_t) {
+                drainDatagrams();
+                pump();
+            });
+        state = STATE_DATAGRAMS;
+        want(wire, MESSAGE_HEADER_SIZE);
+        return udp_token != 0;
+    }
+
+    void drainDatagrams()
+    {
+        while (true)
+        {
+            ssize_t bytes = recv(udp_sock, (char *)datagram.data(), datagram.size(), MSG_DONTWAIT);
+            if (bytes <= 0)
+                return;
+            takeDatagram(datagram.data(), bytes);
+        }
+    }
+
+    // Into the reassembler, if it belongs to the stream; false otherwise
+    bool takeDatagram(const uint8_t *data, size_t size)
+    {
+        PacketHeader packet;
+        if (!unpackPacketHeader(data, size, packet))
+            return false;
+        if (!have_stream)
+        {
+            have_stream = true;
+            stream = packet.stream;
+        }
+        if (packet.stream != stream)
+            return false;
+        packets++;
+        last_activity_us = nowMicros();
+        reassembler->add(packet, data + PACKET_HEADER_SIZE, size - PACKET_HEADER_SIZE, last_activity_us);
+        return true;
+    }
+
+    // The connection closed: take the datagrams still queued, then report and end
+    void endDatagrams()
+    {
+        drainDatagrams();
+        pump();
+        std::cout << prefix << "📶 UDP: " << packets << " packets, " << reassembler->packetsRecovered()
+                  << " rebuilt from parity, " << reassembler->framesConcealed() << " frames concealed, "
+                  << reassembler->framesLost() << " frames lost" << std::endl;
+        addCounter(COUNTER_DROPPED, reassembler->framesLost());
+        finish("🔌 Sender disconnected");
+    }
+
+    // Present UDP frames in order, concealing what is still missing
+    void pump()
+    {
+        uint64_t now_us = nowMicros();
+        while (state != STATE_CLOSED && !paused && reassembler->next(frame, now_us))
+        {
+            if (!frameFits(frame.header, handshake.width, handshake.height, handshake.codec))
+                continue;
+            if (!deliver(frame.header, frame.payload.data(), &frame.payload, frame.first_us, now_us,
+                         frame.complete ? NULL : &frame.spans))
+                finish("");
+        }
+    }
+
+    /**
+     * Hand a frame to the session: present it now, or queue it for the
+     * decode pool, which takes the buffer `owned` over
+     */
+    bool deliver(const MessageHeader &frame_header, const uint8_t *data, std::vector<uint8_t> *owned,
+                 uint64_t first_us, uint64_t received_us, const std::vector<PayloadSpan> *spans)
+    {
+        if (!server.pool)
+        {
+            bool ok = session.present(frame_header, data, first_us, received_us, spans);
+            askForKeyframe();
+            return ok;
+        }
+
+        QueuedFrame queued;
+        queued.header = frame_header;
+        queued.header_us = first_us;
+        queued.received_us = received_us;
+        queued.partial = spans != NULL;
+        if (spans)
+            queued.spans = *spans;
+        queued.payload.swap(*owned);
+        enqueue(queued);
+        return true;
+    }
+
+    // Hand a frame (or reconfiguration) to the decode pool, behind those already queued
+    void enqueue(QueuedFrame &queued)
+    {
+        bool submit;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(std::move(queued));
+            paused = queue.size() >= DECODE_QUEUE_FRAMES;
+            submit = !scheduled;
+            scheduled = true;
+        }
+        if (submit)
+        {
+            std::shared_ptr<ReactorConnection> self = shared_from_this();
+            server.pool->submit([self]() { self->decodeNext(); });
+        }
+    }
+
+    // Decode pool: one queued frame, then hand the turn on
+    void decodeNext()
+    {
+        QueuedFrame queued;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queued = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        bool ok = !failed && (queued.header.type == MSG_CONFIGURE
+                                  ? session.reconfigure(queued.stream)
+                                  : session.present(queued.header, queued.payload.data(), queued.header_us,
+                                                    queued.received_us, queued.partial ? &queued.spans : NULL));
+
+        std::shared_ptr<ReactorConnection> self = shared_from_this();
+        bool more;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            spare.push_back(std::vector<uint8_t>());
+            spare.back().swap(queued.payload);
+            if (!ok)
+                failed = true;
+            more = !queue.empty();
+            scheduled = more;
+        }
+        if (more)
+            server.pool->submit([self]() { self->decodeNext(); });
+        server.reactor.post([self]() { self->decoded(); });
+    }
+
+    // Reactor thread, after every pooled decode
+    void decoded()
+    {
+        if (failed)
+            finish("");
+        if (state == STATE_CLOSED)
+        {
+            end();
+            return;
+        }
+        askForKeyframe();
+
+        size_t queued;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queued = queue.size();
+        }
+        if (paused && queued < DECODE_QUEUE_FRAMES)
+        {
+            paused = false;
+            if (reassembler)
+                pump();
+            continueReading();
+        }
+    }
+
+    // Pass a keyframe the session wants on to the sender
+    void askForKeyframe()
+    {
+        if (state != STATE_CLOSED && session.takeKeyframeRequest(nowMicros()))
+            requestKeyframe(sock, session.lastFrame());
+    }
+
+    void takeSpare(std::vector<uint8_t> &buffer)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (spare.empty())
+            return;
+        buffer.swap(spare.back());
+        spare.pop_back();
+    }
+
+    // Stop reading; the session ends once queued frames are decoded
+    void finish(const char *reason)
+    {
+        if (state == STATE_CLOSED)
+            return;
+        if (reason[0])
+            std::cout << prefix << reason << std::endl;
+        state = STATE_CLOSED;
+        if (uring())
+            server.reactor.cancel(token);
+        else
+            server.reactor.remove(token);
+        close(sock);
+        if (udp_sock >= 0)
+        {
+            if (uring())
+                server.reactor.cancel(udp_token);
+            else
+                server.reactor.remove(udp_token);
+            close(udp_sock);
+            udp_sock = -1;
+        }
+        end();
+    }
+
+    void end()
+    {
+        if (ended)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (scheduled)
+                return; // decoded() comes back here
+        }
+        ended = true;
+        if (begun)
+            session.end();
+        server.closed(shared_from_this());
+    }
+
+    ReactorServer &server;
+    int sock;
+    uint64_t token; // Watch, or with io_uring the pending receive
+    int udp_sock;
+    uint64_t udp_token;
+    std::unique_ptr<FrameSink> slot; // Mosaic slot, or NULL for the server's sink
+    StreamSession session;
+    std::string prefix;
+
+    State state;
+    uint8_t wire[MESSAGE_HEADER_SIZE + CLOCK_REPLY_PAYLOAD]; // Handshake, headers, clock replies
+    uint8_t *target;
+    size_t wanted;
+    size_t filled;
+    Handshake handshake; // The stream as read so far; the session may still be behind (decode pool)
+    ClockEstimator clock;
+    MessageHeader header;
+    uint64_t header_us;
+    std::vector<uint8_t> incoming; // Payload being read, with a decode pool
+
+    // Decode queue, shared with the pool
+    std::mutex mutex;
+    std::deque<QueuedFrame> queue;
+    std::vector<std::vector<uint8_t> > spare;
+    bool scheduled; // A pool task owns the session
+    std::atomic<bool> failed;
+
+    bool paused;
+    bool begun;
+    bool ended;
+    bool receiving; // io_uring: a receive is pending
+
+    // UDP transport
+    std::unique_ptr<FrameReassembler> reassembler;
+    ReassembledFrame frame;
+    std::vector<uint8_t> datagram;
+    bool have_stream;
+    uint32_t stream;
+    uint64_t packets;
+
+    uint64_t last_activity_us;
+};
+
+bool ReactorServer::run(bool advertise)
+{
+    server_sock = openServerSocket();
+    if (server_sock < 0)
+        return false;
+    int flags = fcntl(server_sock, F_GETFL, 0);
+    fcntl(server_sock, F_SETFL, flags | O_NONBLOCK);
+    reactor.add(server_sock, REACTOR_READ, [this](uint32_t) { acceptSenders(); });
+
+    // SSDP queries and announcements on the same loop
+    if (advertise)
+    {
+        local_ip = getLocalIPAddress();
+        ssdp_sock = openSsdpSocket();
+        if (ssdp_sock >= 0)
+        {
+            flags = fcntl(ssdp_sock, F_GETFL, 0);
+            fcntl(ssdp_sock, F_SETFL, flags | O_NONBLOCK);
+            reactor.add(ssdp_sock, REACTOR_READ, [this](uint32_t) {
+                while (answerSsdpQuery(ssdp_sock, local_ip))
+                {
+                }
+            });
+        }
+        notify_sock = openSsdpNotifySocket();
+        if (notify_sock >= 0)
+        {
+            std::cout << "📡 Sending SSDP NOTIFY announcements every 30 seconds" << std::endl;
+            sendSsdpNotify(notify_sock, local_ip, ++notify_count);
+            reactor.addTimer(SSDP_NOTIFY_US, [this]() { sendSsdpNotify(notify_sock, local_ip, ++notify_count); });
+        }
+    }
+
+    reactor.addTimer(REACTOR_TICK_US, [this]() { tick(); });
+    if (mosaic)
+    {
+        int threads = std::max(1, std::min(max_sessions, (int)std::thread::hardware_concurrency()));
+        pool.reset(new TaskPool(threads));
+        std::cout << "🧵 Decoding on " << threads << " pool threads" << std::endl;
+        reactor.addTimer(MOSAIC_COMPOSE_US, [this]() {
+            if (!mosaic->poll() || !mosaic->compose())
+                g_running = false;
+        });
+    }
+    else
+    {
+        // Window events; the window outlives sessions
+        reactor.addTimer(MULTICAST_POLL_US, [this]() {
+            if (!sink.poll())
+                g_running = false;
+        });
+    }
+
+    std::cout << "⏳ Waiting for sender connection on port " << TCP_PORT << " (" << reactor.describe() << ")..."
+              << std::endl;
+    while (g_running && !done)
+    {
+        if (!reactor.runOnce(REACTOR_WAIT_MS))
+        {
+            std::cerr << "❌ Waiting on " << reactor.describe() << " failed" << std::endl;
+            break;
+        }
+    }
+
+    // Close every connection, then let queued frames finish decoding
+    std::vector<std::shared_ptr<ReactorConnection> > open_connections;
+    for (std::map<ReactorConnection *, std::shared_ptr<ReactorConnection> >::iterator it = connections.begin();
+         it != connections.end(); ++it)
+        open_connections.push_back(it->second);
+    for (size_t i = 0; i < open_connections.size(); i++)
+        open_connections[i]->stop();
+    while (!connections.empty() && reactor.runOnce(REACTOR_WAIT_MS))
+    {
+    }
+    pool.reset();
+    if (mosaic)
+        mosaic->close();
+
+    std::cout << "🔁 Reactor (" << reactor.describe() << "): " << reactor.wakeups() << " wakeups" << std::endl;
+    close(server_sock);
+    if (ssdp_sock >= 0)
+        close(ssdp_sock);
+    if (notify_sock >= 0)
+        close(notify_sock);
+    return true;
+}
+
+// Edge-triggered: accept until the backlog is empty, or leave it there while all sessions are busy
+void ReactorServer::acceptSenders()
+{
+    while (!done && (int)connections.size() < max_sessions && !(once && accepted >= max_sessions))
+    {
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+        int client_sock = accept(server_sock, (struct sockaddr *)&client_addr, &client_len);
+        if (client_sock < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                std::cerr << "❌ Failed to accept connection" << std::endl;
+            return;
+        }
+
+        std::string address = inet_ntoa(client_addr.sin_addr);
+        std::cout << "✅ Sender connected from " << address << std::endl;
+        accepted++;
+
+        // Concurrent sessions are labelled and get a mosaic slot
+        std::string label;
+        std::unique_ptr<FrameSink> slot;
+        if (mosaic)
+        {
+            label = address + ":" + std::to_string(ntohs(client_addr.sin_port));
+            slot = mosaic->slot(label);
+        }
+        std::shared_ptr<ReactorConnection> connection(
+            new ReactorConnection(*this, client_sock, label, std::move(slot)));
+        connections[connection.get()] = connection;
+        connection->start();
+    }
+}
+
+void ReactorServer::closed(const std::shared_ptr<ReactorConnection> &connection)
+{
+    connections.erase(connection.get());
+    if (once && accepted >= max_sessions && connections.empty())
+    {
+        done = true;
+        return;
+    }
+    if (g_running && connections.empty())
+        std::cout << "⏳ Waiting for next sender..." << std::endl;
+
+    // A free session takes the next sender from the backlog
+    if (g_running)
+        acceptSenders();
+}
+
+void ReactorServer::tick()
+{
+    uint64_t now_us = nowMicros();
+    std::vector<std::shared_ptr<ReactorConnection> > open_connections;
+    for (std::map<ReactorConnection *, std::shared_ptr<ReactorConnection> >::iterator it = connections.begin();
+         it != connections.end(); ++it)
+        open_connections.push_back(it->second);
+    for (size_t i = 0; i < open_connections.size(); i++)
+        open_connections[i]->tick(now_us);
+}
+#else
+// No epoll or io_uring on Windows: --io falls back to threads
+class ReactorServer
+{
+public:
+    bool run(bool advertise) { return !advertise && false; }
+};
+#endif
+
+/**
+ * Join a multicast stream group (--multicast group:port) and receive
+ * its streams one after another
+ */
+bool receiveMulticast(const std::string &target, FrameSink &sink, bool once)
+{
+    size_t colon = target.rfind(':');
+    if (colon == std::string::npos)
+    {
+        std::cerr << "❌ Expected --multicast <group>:<port>, got " << target << std::endl;
+        return false;
+    }
+    std::string group = target.substr(0, colon);
+    int port = atoi(target.c_str() + colon + 1);
+
+#ifdef _WIN32
+    SOCKET sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock == INVALID_SOCKET)
+#else
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0)
+#endif
+    {
+        std::cerr << "❌ Failed to create multicast socket" << std::endl;
+        return false;
+    }
+
+    // Several receivers on one host may share the group port
+    int reuse = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (char *)&reuse, sizeof(reuse));
+    int sock_buf_size = SOCKET_BUFFER_SIZE;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char *)&sock_buf_size, sizeof(sock_buf_size));
+
+    struct sockaddr_in bind_addr;
+    memset(&bind_addr, 0, sizeof(bind_addr));
+    bind_addr.sin_family = AF_INET;
+    bind_addr.sin_addr.s_addr = INADDR_ANY;
+    bind_addr.sin_port = htons(port);
+    bool ok = bind(sock, (struct sockaddr *)&bind_addr, sizeof(bind_addr)) == 0;
+    if (!ok)
+        std::cerr << "❌ Failed to bind to port " << port << std::endl;
+    else if (!(ok = joinMulticastGroup((int)sock, group)))
+        std::cerr << "❌ Failed to join multicast group " << group << std::endl;
+
+    // Short timeout so NACKs and repair deadlines run while the group is quiet
+#ifdef _WIN32
+    int timeout = MULTICAST_NACK_INTERVAL_US / 1000;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout, sizeof(timeout));
+#else
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = MULTICAST_NACK_INTERVAL_US;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+#endif
+
+    if (ok)
+        std::cout << "⏳ Waiting for a stream on multicast group " << target << "..." << std::endl;
+    while (ok && g_running)
+    {
+        if (handleMulticastStream((int)sock, sink) && once)
+            break;
+    }
+
+#ifdef _WIN32
+    closesocket(sock);
+#else
+    close(sock);
+#endif
+    return ok;
+}
+
+/**
+ * Main function
+ *
+ * Sets up the receiver:
+ * 1. Starts SSDP advertisement thread
+ * 2. Creates TCP server socket
+ * 3. Waits for sender connections
+ * 4. Handles each connection
+ *
+ * Options:
+ *   --stats-json <file>  Write stage histograms, counters and latency as JSON on exit
+ *   --trace <file>       Record a Chrome trace of every frame, written on exit
+ *                        or on SIGUSR1 (checked every 100 frames)
+ *   --threads <n>        Worker threads for decoding tile frames (default 1)
+ *   --sink <spec>        Where frames go: display (default), discard, hash[:file]
+ *                        or raw:<file>, see sink.h
+ *   --headless           Same as --sink discard; needs no display or SDL
+ *   --port <n>           TCP port to listen on (default 8081)
+ *   --no-ssdp            Do not advertise the receiver on the network
+ *   --once               Exit after the first session
+ *   --warmup <n>         Leave the first n frames of a session out of the figures
+ *   --tile-cache <MB>    Most memory a sender may have us spend on its tile
+ *                        cache (default 64); multicast streams set their own
+ *   --archive <dir>      Record every session's stream to <dir>/session-<n>, see archive.h
+ *   --multicast <g:p>    Receive the multicast stream on group g, port p instead of
+ *                        accepting TCP senders (nothing to advertise then)
+ */
+int main(int argc, char *argv[])
+{
+    std::string stats_json_path;
+#ifdef RGM_NO_SDL
+    std::string sink_spec = "discard";
+#else
+    std::string sink_spec = "display";
+#endif
+    std::string multicast_target;
+    bool advertise = true;
+    bool once = false;
+    std::string io = "threads";
+    int sessions = 1;
+    MosaicLayout layout = MOSAIC_GRID;
+    int mosaic_width = 1920;
+    int mosaic_height = 1080;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--stats-json" && i + 1 < argc)
+            stats_json_path = argv[++i];
+        else if (arg == "--trace" && i + 1 < argc)
+            g_trace_path = argv[++i];
+        else if (arg == "--threads" && i + 1 < argc)
+            DECODE_THREADS = atoi(argv[++i]);
+        else if (arg == "--sink" && i + 1 < argc)
+            sink_spec = argv[++i];
+        else if (arg == "--headless")
+            sink_spec = "discard";
+        else if (arg == "--port" && i + 1 < argc)
+            TCP_PORT = atoi(argv[++i]);
+        else if (arg == "--no-ssdp")
+            advertise = false;
+        else if (arg == "--once")
+            once = true;
+        else if (arg == "--warmup" && i + 1 < argc)
+            WARMUP_FRAMES = atoi(argv[++i]);
+        else if (arg == "--tile-cache" && i + 1 < argc)
+            TILE_CACHE_TILES = (uint32_t)((uint64_t)std::max(0, atoi(argv[++i])) * 1024 * 1024 / TILE_BYTES);
+        else if (arg == "--archive" && i + 1 < argc)
+            g_archive_root = argv[++i];
+        else if (arg == "--multicast" && i + 1 < argc)
+            multicast_target = argv[++i];
+        else if (arg == "--io" && i + 1 < argc &&
+                 (std::string(argv[i + 1]) == "threads" || std::string(argv[i + 1]) == "epoll" ||
+                  std::string(argv[i + 1]) == "uring"))
+            io = argv[++i];
+        else if (arg == "--sessions" && i + 1 < argc && atoi(argv[i + 1]) > 0)
+            sessions = atoi(argv[++i]);
+        else if (arg == "--layout" && i + 1 < argc &&
+                 (std::string(argv[i + 1]) == "grid" || std::string(argv[i + 1]) == "pip"))
+            layout = std::string(argv[++i]) == "pip" ? MOSAIC_PIP : MOSAIC_GRID;
+        else if (arg == "--mosaic" && i + 1 < argc &&
+                 sscanf(argv[i + 1], "%dx%d", &mosaic_width, &mosaic_height) == 2 &&
+                 mosaic_width > 0 && mosaic_height > 0)
+            i++;
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--stats-json <file>] [--trace <file>] [--threads n]"
+                      << " [--sink display|discard|hash[:file]|raw:<file>] [--headless] [--port n]"
+                      << " [--no-ssdp] [--once] [--warmup n] [--tile-cache MB] [--archive <dir>] [--multicast group:port]"
+                      << " [--sessions n] [--layout grid|pip] [--mosaic WxH] [--io threads|epoll|uring]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::unique_ptr<FrameSink> sink = createFrameSink(sink_spec);
+    if (!sink)
+        return 1;
+
+    // Concurrent senders share the sink through a mosaic
+    std::unique_ptr<FrameMosaic> mosaic;
+    if (sessions > 1 && multicast_target.empty())
+        mosaic.reset(new FrameMosaic(*sink, mosaic_width, mosaic_height, layout));
+
+    // Ctrl+C ends the current session cleanly so the final stats get written
+    signal(SIGINT, handleSignal);
+#ifdef SIGUSR1
+    signal(SIGUSR1, handleSignal);
+#endif
+
+    if (!g_trace_path.empty())
+    {
+        enableTracing();
+        setTraceThreadName("stream");
+    }
+
+    std::cout << "========================================" << std::endl;
+    std::cout << "📺 RGM RECEIVER v2.0" << std::endl;
+    std::cout << "========================================" << std::endl;
+    std::cout << "Local IP: " << getLocalIPAddress() << std::endl;
+    if (!multicast_target.empty())
+    {
+        std::cout << "Multicast: " << multicast_target << std::endl;
+        advertise = false;
+    }
+    else
+        std::cout << "TCP Port: " << TCP_PORT << std::endl;
+    if (advertise)
+        std::cout << "SSDP:     " << SSDP_ADDRESS << ":" << SSDP_PORT << std::endl;
+    else
+        std::cout << "SSDP:     off" << std::endl;
+    std::cout << "Sink:     " << (mosaic ? mosaic->describe() : sink->describe()) << std::endl;
+    if (mosaic)
+        std::cout << "Sessions: up to " << sessions << " at once" << std::endl;
+    std::cout << "Resolution will be auto-detected from sender" << std::endl;
+    std::cout << "========================================" << std::endl;
+
+    // Initialize network sockets
+    if (!initSockets())
+    {
+        std::cerr << "❌ Failed to initialize sockets" << std::endl;
+        return 1;
+    }
+
+    // The reactor also answers SSDP; without it (or where epoll is missing) a thread does
+    std::unique_ptr<ReactorServer> reactor;
+    if (io != "threads" && multicast_target.empty())
+    {
+#ifndef _WIN32
+        reactor.reset(new ReactorServer(*sink, mosaic.get(), sessions, once));
+        if (!reactor->open(io == "uring" ? REACTOR_URING : REACTOR_EPOLL))
+#endif
+        {
+            std::cerr << "⚠️  Falling back to --io threads" << std::endl;
+            reactor.reset();
+        }
+    }
+
+    // Start SSDP advertisement thread
+    std::thread ssdp_thread;
+    if (advertise && !reactor)
+        ssdp_thread = std::thread(ssdpAdvertisementThread);
+
+    bool served;
+    if (reactor)
+        served = reactor->run(advertise);
+    else
+        served = multicast_target.empty() ? serveSenders(*sink, once, mosaic.get(), sessions)
+                                          : receiveMulticast(multicast_target, *sink, once);
+
     g_running = false;
-    ssdp_thread.join();
+    if (ssdp_thread.joinable())
+        ssdp_thread.join();
     cleanupSockets();
+    if (!served)
+        return 1;
+
+    if (!stats_json_path.empty())
+    {
+        StatsReport report;
+        report.role = "receiver";
+        report.values.push_back(std::make_pair("width", (double)SCREEN_WIDTH));
+        report.values.push_back(std::make_pair("height", (double)SCREEN_HEIGHT));
+        report.values.push_back(std::make_pair("frames", (double)g_total_frames));
+        report.values.push_back(std::make_pair("bytes", (double)g_total_bytes));
+        report.values.push_back(std::make_pair("duration_s", g_total_seconds));
+        report.latencies.push_back(std::make_pair("capture_to_receive", g_total_latency.capture_to_receive));
+        report.latencies.push_back(std::make_pair("receive_to_decode", g_total_latency.receive_to_decode));
+        report.latencies.push_back(std::make_pair("decode_to_present", g_total_latency.decode_to_present));
+        report.latencies.push_back(std::make_pair("capture_to_present", g_total_latency.capture_to_present));
+        writeStatsJson(stats_json_path, report);
+    }
+
+    if (!g_trace_path.empty())
+        writeTrace(g_trace_path, "RGM receiver", TRACE_PID_RECEIVER);
 
     std::cout << "📺 Receiver shut down" << std::endl;
     return 0;
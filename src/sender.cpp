@@ -13,7 +13,25 @@
 #include <atomic>
 #include <iomanip>
 #include <fstream>
+#include <sstream>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <random>
+#include <algorithm>
 #include "discover.h"
+#include "protocol.h"
+#include "stats.h"
+#include "trace.h"
+#include "capture.h"
+#include "codec.h"
+#include "simd.h"
+#include "corpus.h"
+#include "packet.h"
 
 #ifdef _WIN32
 #include <winsock2.h>
@@ -29,32 +47,68 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
-#include <X11/Xlib.h>
-#include <X11/Xutil.h>
+#endif
+
+#ifndef RGM_NO_SDL
 #include <SDL2/SDL.h> // For splash screen
 #endif
 
 // Constants - easily modifiable for future upgrades
-#define BYTES_PER_PIXEL 3                              // RGB format (can be changed to RGBA=4 for alpha channel)
 #define CONNECTION_TIMEOUT_MS 5000                     // Connection timeout in milliseconds
 #define STATS_INTERVAL_SEC 5                           // Statistics display interval
 #define MAX_FRAME_SKIP 3                               // Maximum frames to skip when overloaded
+#define CONNECT_RETRIES 50                             // Retries for --connect while the receiver starts
+#define CONNECT_RETRY_MS 100                           // Pause between those retries
+#define SEND_QUEUE_FRAMES 2                            // Frames a receiver may fall behind before dropping
+#define FANOUT_KEYFRAME_MIN_US 250000                  // Shortest gap between keyframes forced for lagging receivers
+#define MULTICAST_REFRESH_US 1000000                   // Keyframe interval of multicast streams, for late joiners
+#define MULTICAST_CONFIG_US 500000                     // Stream description (PKT_CONFIG) interval
+#define UDP_REFRESH_S 2.0                              // Default intra refresh period with UDP links (--refresh)
+#define TILE_CACHE_MB 64                               // Tile cache offered to receivers (--tile-cache)
+#define CONFIGURE_TIMEOUT_US 5000000                   // UDP: wait this long for the receiver to confirm MSG_CONFIGURE
+#define UDP_FEC_GROUP 8                                // Default fragments per parity packet
+#define RECONNECT_MIN_MS 100                           // First pause before reconnecting to a lost receiver
+#define RECONNECT_MAX_MS 3200                          // The pause doubles up to this
+#define RECONNECT_TIMEOUT_US 30000000                  // A receiver unreachable this long is given up
 static const int SOCKET_BUFFER_SIZE = 4 * 1024 * 1024; // 4MB socket buffer for high FPS
 
 // Global variables for screen dimensions
 int SCREEN_WIDTH = 1920;  // Default, will be updated
 int SCREEN_HEIGHT = 1080; // Default, will be updated
-int TARGET_FPS = 60;      // Target FPS (can be made adjustable in future)
+int TARGET_FPS = 60;      // Target FPS, 0 streams as fast as possible (--fps)
+int ENCODE_THREADS = 1;   // Tile encode workers (--threads)
 
 // Global flag for running state (atomic for thread safety)
 std::atomic<bool> g_running{true};
 
+// Set by SIGUSR1 to write the trace without stopping the stream
+std::atomic<bool> g_trace_dump_requested{false};
+
+/**
+ * SIGINT handler - stop streaming and fall through to the final statistics
+ */
+void handleSignal(int signum)
+{
+#ifdef SIGUSR1
+    if (signum == SIGUSR1)
+    {
+        g_trace_dump_requested = true;
+        return;
+    }
+#endif
+    (void)signum;
+    g_running = false;
+}
+
 /**
  * Display RGM splash screen using SDL2
  * Shows the RGM.png image when the software starts
  */
 void showSplashScreen()
 {
+#ifdef RGM_NO_SDL
+    std::cout << "ℹ️  Built without SDL, skipping splash screen" << std::endl;
+#else
     std::cout << "🎬 Initializing RGM..." << std::endl;
 
     // Initialize SDL with video support only
@@ -148,36 +202,6 @@ void showSplashScreen()
     SDL_Quit();
 
     std::cout << "✅ Splash screen completed" << std::endl;
-}
-
-/**
- * Get screen dimensions - platform specific
- */
-void getScreenDimensions(int &width, int &height)
-{
-#ifdef _WIN32
-    // Windows: Use GetSystemMetrics for primary monitor
-    width = GetSystemMetrics(SM_CXSCREEN);
-    height = GetSystemMetrics(SM_CYSCREEN);
-    std::cout << "🖥️  Detected Windows display: " << width << "x" << height << std::endl;
-#else
-    // Linux: Use X11 to get display dimensions
-    Display *display = XOpenDisplay(NULL);
-    if (display)
-    {
-        int screen_num = DefaultScreen(display);
-        width = DisplayWidth(display, screen_num);
-        height = DisplayHeight(display, screen_num);
-        XCloseDisplay(display);
-        std::cout << "🖥️  Detected X11 display: " << width << "x" << height << std::endl;
-    }
-    else
-    {
-        // Fallback if X11 fails
-        width = 1920;
-        height = 1080;
-        std::cerr << "⚠️  Could not detect screen dimensions, using 1920x1080" << std::endl;
-    }
 #endif
 }
 
@@ -204,6 +228,9 @@ public:
         close();
     }
 
+    // Raw descriptor for the shared protocol helpers
+    int handle() const { return (int)sock; }
+
     // Check if socket is valid
     bool isValid() const
     {
@@ -246,7 +273,7 @@ public:
     /**
      * Connect to a remote host with timeout
      */
-    bool connect(const std::string &ip, int port, int timeout_ms = CONNECTION_TIMEOUT_MS)
+    bool connect(const std::string &ip, int port, int timeout_ms = CONNECTION_TIMEOUT_MS, bool report = true)
     {
         if (!create())
         {
@@ -317,7 +344,8 @@ public:
 
         if (!connected)
         {
-            std::cerr << "❌ Connection timeout to " << ip << ":" << port << std::endl;
+            if (report)
+                std::cerr << "❌ Connection timeout to " << ip << ":" << port << std::endl;
             close();
             return false;
         }
@@ -376,143 +404,938 @@ public:
     }
 };
 
-#ifdef _WIN32
+// Stream id of a datagram transport, unique enough per sender run
+static uint32_t randomStreamId()
+{
+    std::random_device random;
+    return random() ^ (uint32_t)nowMicros();
+}
+
 /**
- * Windows screen capture with high quality
+ * One encoded frame, shared by the send queues of every receiver
+ *
+ * Each frame is encoded once. Every link holds a reference until its copy
+ * is on the wire, and SharedFramePool hands the buffer out again once no
+ * link holds it any more.
  */
-std::vector<uint8_t> captureScreen()
+struct SharedFrame
 {
-    // Allocate pixel buffer
-    std::vector<uint8_t> pixels(SCREEN_WIDTH * SCREEN_HEIGHT * BYTES_PER_PIXEL, 0);
+    uint8_t header[MESSAGE_HEADER_SIZE];
+    std::vector<uint8_t> payload;
+    uint32_t frame_id;
+    bool keyframe;
+    Handshake stream; // Resolution and codec the frame was encoded for
+};
+typedef std::shared_ptr<SharedFrame> SharedFramePtr;
 
-    // Get device context for the entire screen
-    HDC screen_dc = GetDC(NULL);
-    if (!screen_dc)
+class SharedFramePool
+{
+public:
+    // A frame buffer no link references any more (capture thread only)
+    SharedFramePtr acquire()
     {
-        std::cerr << "❌ Failed to get screen DC" << std::endl;
-        return pixels;
+        for (size_t i = 0; i < frames.size(); i++)
+        {
+            if (frames[i].use_count() == 1)
+            {
+                // The links' last use happens before their reference is dropped
+                std::atomic_thread_fence(std::memory_order_acquire);
+                return frames[i];
+            }
+        }
+        frames.push_back(std::make_shared<SharedFrame>());
+        return frames.back();
     }
 
-    // Create compatible DC and bitmap
-    HDC mem_dc = CreateCompatibleDC(screen_dc);
-    HBITMAP bitmap = CreateCompatibleBitmap(screen_dc, SCREEN_WIDTH, SCREEN_HEIGHT);
+private:
+    std::vector<SharedFramePtr> frames;
+};
 
-    if (!bitmap)
+/**
+ * Encode-once fan-out to one or more receivers
+ *
+ * Every receiver has its own connection, send thread and queue. The capture
+ * loop runs at the pace of the fastest receiver (waitForSpace). A receiver
+ * that already has SEND_QUEUE_FRAMES frames waiting drops new ones, then
+ * skips deltas until the next keyframe, because a delta needs its
+ * predecessor. The capture loop forces that keyframe (wantsKeyframe), at
+ * most every FANOUT_KEYFRAME_MIN_US. A slow receiver therefore shows fewer
+ * frames and never holds back the others.
+ *
+ * With the UDP transport (--transport udp) the connection only carries the
+ * session setup; frames go out as datagrams with XOR parity (packet.h) and
+ * are never resent. The receiver conceals what is still lost; intra refresh
+ * (FrameEncoder::setRefresh) heals the concealed tiles over UDP_REFRESH_S.
+ *
+ * Receivers ask for a keyframe (MSG_KEYFRAME_REQUEST) when their picture is
+ * damaged: frames lost for good, or one that failed to decode. The send
+ * thread reads those between frames, and the request forces a keyframe
+ * like a lagging receiver, without dropping the frames before it.
+ *
+ * The encoder's tile cache must not outgrow any receiver's, so it holds as
+ * many tiles as the receiver that accepted the fewest (tileCache()). A
+ * receiver that comes back with less is not reconnected.
+ *
+ * A receiver whose connection drops is reconnected by its send thread,
+ * with a pause that doubles from RECONNECT_MIN_MS to RECONNECT_MAX_MS.
+ * The handshake carries the session token, so a receiver still holding
+ * the session resumes it without a clock exchange and keeps its window;
+ * the link then waits for the next keyframe, forced as for a lagging
+ * receiver. After RECONNECT_TIMEOUT_US the receiver is given up.
+ *
+ * Every frame carries the stream description it was encoded for. When that
+ * differs from what a receiver was told, its send thread puts MSG_CONFIGURE
+ * on the wire first, so the change reaches each receiver in order with its
+ * frames, whatever it had queued.
+ */
+class FanOut
+{
+public:
+    FanOut() : transport(TRANSPORT_TCP), fec_group(UDP_FEC_GROUP), stream_tile_cache(0), stopping(false),
+               last_forced_key_us(0) {}
+    ~FanOut() { stop(); }
+
+    // How frames reach receivers added from now on
+    void setTransport(int type, int fec)
     {
-        std::cerr << "❌ Failed to create bitmap" << std::endl;
-        ReleaseDC(NULL, screen_dc);
-        DeleteDC(mem_dc);
-        return pixels;
+        transport = type;
+        fec_group = fec;
     }
 
-    // Select bitmap into memory DC
-    SelectObject(mem_dc, bitmap);
+    /**
+     * Connect to a receiver and run the session setup (handshake and clock
+     * exchange). `retry` keeps trying while the receiver starts up.
+     */
+    bool add(const DiscoveredDevice &device, const Handshake &handshake, bool retry)
+    {
+        std::unique_ptr<Link> link(new Link(device, handshake));
+        bool connected = link->connection.connect(device.ip_address, device.tcp_port);
+        for (int attempt = 0; !connected && retry && attempt < CONNECT_RETRIES && g_running; attempt++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(CONNECT_RETRY_MS));
+            connected = link->connection.connect(device.ip_address, device.tcp_port, CONNECTION_TIMEOUT_MS, false);
+        }
+        if (!connected || !setup(*link))
+            return false;
+        if (links.empty())
+            setTraceClockOffset(link->clock_offset_us); // The timeline follows the first receiver
+        links.push_back(std::move(link));
+        return true;
+    }
 
-    // Capture screen with CAPTUREBLT to include layered windows
-    BitBlt(mem_dc, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, screen_dc, 0, 0, SRCCOPY | CAPTUREBLT);
+    size_t size() const { return links.size(); }
 
-    // Prepare bitmap info structure
-    BITMAPINFOHEADER bi = {0};
-    bi.biSize = sizeof(BITMAPINFOHEADER);
-    bi.biWidth = SCREEN_WIDTH;
-    bi.biHeight = -SCREEN_HEIGHT; // Negative for top-down (no flipping needed)
-    bi.biPlanes = 1;
-    bi.biBitCount = 24; // 24-bit RGB
-    bi.biCompression = BI_RGB;
+    // Tiles every receiver caches
+    uint32_t tileCache() const
+    {
+        uint32_t tiles = links.empty() ? 0 : links[0]->tile_cache;
+        for (size_t i = 1; i < links.size(); i++)
+            tiles = std::min(tiles, links[i]->tile_cache);
+        return tiles;
+    }
+
+    // Start one send thread per receiver
+    void start()
+    {
+        stream_tile_cache = tileCache();
+        for (size_t i = 0; i < links.size(); i++)
+            links[i]->thread = std::thread(&FanOut::sendLoop, this, links[i].get());
+    }
+
+    /**
+     * Block until at least one receiver has nothing waiting, so the next
+     * capture is as fresh as possible. False when no receiver is left.
+     */
+    bool waitForSpace()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (g_running)
+        {
+            bool alive = false;
+            for (size_t i = 0; i < links.size(); i++)
+            {
+                if (!links[i]->alive)
+                    continue;
+                alive = true;
+                if (links[i]->queue.empty() && !links[i]->reconnecting)
+                    return true;
+            }
+            if (!alive)
+                return false;
+            changed.wait_for(lock, std::chrono::milliseconds(100));
+        }
+        return false;
+    }
 
-    // Get the bitmap bits
-    int result = GetDIBits(mem_dc, bitmap, 0, SCREEN_HEIGHT,
-                           pixels.data(), (BITMAPINFO *)&bi, DIB_RGB_COLORS);
+    // True when the next frame should be a keyframe for a lagging receiver, or one that asked
+    bool wantsKeyframe(uint64_t now_us)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (now_us - last_forced_key_us < FANOUT_KEYFRAME_MIN_US)
+            return false;
+        for (size_t i = 0; i < links.size(); i++)
+        {
+            const Link &link = *links[i];
+            if (link.alive && (link.waiting_key || link.key_requested))
+            {
+                last_forced_key_us = now_us;
+                return true;
+            }
+        }
+        return false;
+    }
 
-    if (!result)
+    // Queue a frame for every receiver that can take it
+    void publish(const SharedFramePtr &frame)
     {
-        std::cerr << "❌ Failed to get bitmap bits" << std::endl;
+        uint64_t dropped = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t i = 0; i < links.size(); i++)
+            {
+                Link &link = *links[i];
+                if (!link.alive || link.reconnecting)
+                    continue;
+                if (link.waiting_key && !frame->keyframe)
+                {
+                    link.dropped++;
+                    dropped++;
+                    continue;
+                }
+                if (link.queue.size() >= SEND_QUEUE_FRAMES)
+                {
+                    if (!frame->keyframe)
+                    {
+                        link.dropped++;
+                        dropped++;
+                        link.waiting_key = true;
+                        continue;
+                    }
+                    // A keyframe replaces whatever is still waiting
+                    link.dropped += link.queue.size();
+                    dropped += link.queue.size();
+                    link.queue.clear();
+                }
+                if (frame->keyframe)
+                    link.waiting_key = link.key_requested = false;
+                link.queue.push_back(frame);
+            }
+        }
+        if (dropped > 0)
+            addCounter(COUNTER_DROPPED, dropped);
+        changed.notify_all();
     }
 
-    // Cleanup
-    DeleteObject(bitmap);
-    DeleteDC(mem_dc);
-    ReleaseDC(NULL, screen_dc);
+    // Send what is queued, then stop the send threads
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        for (size_t i = 0; i < links.size(); i++)
+        {
+            if (links[i]->thread.joinable())
+                links[i]->thread.join();
+        }
+    }
 
-    return pixels;
-}
+    // One line per receiver for the final statistics
+    void showSummary()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < links.size(); i++)
+        {
+            const Link &link = *links[i];
+            std::cout << "📡 " << link.device.toString() << ": " << link.sent << " sent, " << link.dropped
+                      << " dropped, " << std::fixed << std::setprecision(2) << link.bytes / (1024.0 * 1024.0)
+                      << " MB";
+            if (link.packetizer)
+                std::cout << " in " << link.datagrams << " datagrams over UDP";
+            if (link.key_requests > 0)
+                std::cout << ", " << link.key_requests << " keyframe requests";
+            if (link.reconnects > 0)
+                std::cout << ", reconnected " << link.reconnects << "x";
+            std::cout << (link.alive ? "" : " (disconnected)") << std::endl;
+        }
+    }
+
+private:
+    struct Link
+    {
+        Link(const DiscoveredDevice &target, const Handshake &stream)
+            : device(target), handshake(stream), session(0), clock_offset_us(0), udp_sock(-1), alive(true),
+              reconnecting(false), waiting_key(false), key_requested(false), control_filled(0), confirmed_frame(0),
+              tile_cache(0), sent(0), dropped(0), bytes(0), datagrams(0), reconnects(0), key_requests(0) {}
+        ~Link()
+        {
+            closeDatagrams();
+        }
+
+        void closeDatagrams()
+        {
+            if (udp_sock < 0)
+                return;
+#ifdef _WIN32
+            closesocket(udp_sock);
 #else
+            ::close(udp_sock);
+#endif
+            udp_sock = -1;
+        }
+
+        DiscoveredDevice device;
+        Handshake handshake; // Stream description the receiver has
+        uint32_t session;    // Token from the receiver, for resuming
+        int64_t clock_offset_us;
+        NetworkSocket connection;
+        int udp_sock;                                // UDP transport only
+        std::unique_ptr<FramePacketizer> packetizer; // UDP transport only
+        std::thread thread;
+        std::deque<SharedFramePtr> queue; // Frames waiting, not counting the one on the wire
+        bool alive;
+        bool reconnecting; // Send thread: the connection dropped, takes no frames
+        bool waiting_key;
+        bool key_requested;                  // The receiver asked for a keyframe
+        uint8_t control[MESSAGE_HEADER_SIZE]; // Send thread: message coming in from the receiver
+        size_t control_filled;
+        uint32_t confirmed_frame; // Last MSG_CONFIGURE the receiver confirmed
+        uint32_t tile_cache;      // Tiles the receiver accepted to cache
+        uint64_t sent, dropped, bytes, datagrams, reconnects, key_requests;
+    };
+
+    /**
+     * Session setup on a fresh connection: handshake, clock exchange (or
+     * resume of `link.session`) and the UDP transport if asked for
+     */
+    bool setup(Link &link)
+    {
+        Handshake handshake = link.handshake;
+        handshake.session = link.session;
+        bool resumed = false;
+        if (!startSession(link.connection.handle(), handshake, link.clock_offset_us, link.session, resumed,
+                          link.tile_cache))
+        {
+            std::cerr << "❌ Session setup with " << link.device.toString() << " failed" << std::endl;
+            return false;
+        }
+        if (link.tile_cache < stream_tile_cache)
+        {
+            std::cerr << "❌ " << link.device.toString() << " now caches " << link.tile_cache << " tiles, the stream needs "
+                      << stream_tile_cache << std::endl;
+            return false;
+        }
+        if (resumed)
+            std::cout << "🔁 Resumed session with " << link.device.toString() << std::endl;
+        else
+            std::cout << "⏱️  Clock offset to " << link.device.toString() << ": " << link.clock_offset_us << " us"
+                      << std::endl;
+
+        if (transport == TRANSPORT_UDP && !openDatagrams(link, handshake))
+        {
+            std::cerr << "❌ " << link.device.toString() << " did not accept the UDP transport" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Send thread, after the connection dropped: connect again with
+     * exponential backoff until the session is set up, Ctrl+C, or
+     * RECONNECT_TIMEOUT_US. Runs without the lock.
+     */
+    bool reconnect(Link &link)
+    {
+        std::cerr << "🔌 Lost receiver " << link.device.toString() << ", reconnecting..." << std::endl;
+        link.connection.close();
+        link.closeDatagrams();
+        uint64_t give_up_us = nowMicros() + RECONNECT_TIMEOUT_US;
+        int pause_ms = RECONNECT_MIN_MS;
+        while (g_running && nowMicros() < give_up_us)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (changed.wait_for(lock, std::chrono::milliseconds(pause_ms), [this]() { return stopping; }))
+                    return false;
+            }
+            pause_ms = std::min(pause_ms * 2, RECONNECT_MAX_MS);
+            if (link.connection.connect(link.device.ip_address, link.device.tcp_port, CONNECTION_TIMEOUT_MS, false) &&
+                setup(link))
+                return true;
+            link.connection.close();
+            link.closeDatagrams();
+        }
+        return false;
+    }
+
+    /**
+     * Describe a new resolution or codec to the receiver ahead of the first
+     * frame encoded for it (MSG_CONFIGURE). Over UDP the message and the
+     * frames take different paths, so wait until the receiver is ready.
+     */
+    bool configure(Link &link, const Handshake &stream, uint32_t first_frame)
+    {
+        MessageHeader header = {};
+        header.type = MSG_CONFIGURE;
+        header.size = sizeof(Handshake);
+        header.frame_id = first_frame;
+        uint8_t wire[MESSAGE_HEADER_SIZE + sizeof(Handshake)];
+        packHeader(header, wire);
+        packHandshake(stream, wire + MESSAGE_HEADER_SIZE);
+        if (!link.connection.sendAll(wire, sizeof(wire)))
+            return false;
+        if (link.packetizer)
+        {
+            // Keyframe requests may come in ahead of the confirmation
+            uint64_t give_up_us = nowMicros() + CONFIGURE_TIMEOUT_US;
+            link.confirmed_frame = first_frame - 1;
+            while (link.confirmed_frame != first_frame)
+            {
+                if (nowMicros() >= give_up_us || !readControl(link, 100))
+                    return false;
+            }
+            link.packetizer->setAlignment((int)stream.codec);
+        }
+        link.handshake = stream;
+        std::cout << "📐 " << link.device.toString() << " switched to " << stream.width << "x" << stream.height
+                  << ", codec " << codecName((int)stream.codec) << std::endl;
+        return true;
+    }
+
+    /**
+     * Send thread: take in what the receiver sent on the connection, waiting
+     * at most `wait_ms` for the first byte. False when the connection is gone.
+     */
+    bool readControl(Link &link, int wait_ms)
+    {
+        int sock = link.connection.handle();
+        while (true)
+        {
+            fd_set readable;
+            FD_ZERO(&readable);
+            FD_SET(sock, &readable);
+            struct timeval tv;
+            tv.tv_sec = wait_ms / 1000;
+            tv.tv_usec = (wait_ms % 1000) * 1000;
+            int ready = select(sock + 1, &readable, NULL, NULL, &tv);
+            if (ready == 0)
+                return true;
+            if (ready < 0)
+                return errno == EINTR;
+            int bytes = recv(sock, (char *)link.control + link.control_filled,
+                             MESSAGE_HEADER_SIZE - link.control_filled, 0);
+            if (bytes <= 0)
+                return false;
+            wait_ms = 0;
+            link.control_filled += bytes;
+            if (link.control_filled < MESSAGE_HEADER_SIZE)
+                continue;
+            link.control_filled = 0;
+
+            MessageHeader message;
+            unpackHeader(link.control, message);
+            if (message.type == MSG_KEYFRAME_REQUEST)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                link.key_requested = true;
+                link.key_requests++;
+            }
+            else if (message.type == MSG_CONFIGURE)
+                link.confirmed_frame = message.frame_id;
+        }
+    }
+
+    // Tell the receiver the stream is over, so it does not wait for a resume
+    void sayGoodbye(Link &link)
+    {
+        MessageHeader bye = {};
+        bye.type = MSG_BYE;
+        uint8_t wire[MESSAGE_HEADER_SIZE];
+        packHeader(bye, wire);
+        link.connection.sendAll(wire, sizeof(wire));
+    }
+
+    /**
+     * Ask the receiver for a UDP port (MSG_TRANSPORT) and aim a datagram
+     * socket at it
+     */
+    bool openDatagrams(Link &link, const Handshake &handshake)
+    {
+        MessageHeader request = {};
+        request.type = MSG_TRANSPORT;
+        request.frame_id = TRANSPORT_UDP;
+        request.flags = (uint32_t)fec_group;
+        uint8_t wire[MESSAGE_HEADER_SIZE];
+        packHeader(request, wire);
+        if (!link.connection.sendAll(wire, sizeof(wire)) ||
+            !recvAll(link.connection.handle(), wire, sizeof(wire)))
+            return false;
+        MessageHeader reply;
+        unpackHeader(wire, reply);
+        if (reply.type != MSG_TRANSPORT || reply.size != 0 || reply.frame_id == 0 || reply.frame_id > 0xFFFF)
+            return false;
+
+        struct sockaddr_in to;
+        memset(&to, 0, sizeof(to));
+        to.sin_family = AF_INET;
+        to.sin_port = htons((uint16_t)reply.frame_id);
+        if (inet_pton(AF_INET, link.device.ip_address.c_str(), &to.sin_addr) <= 0)
+            return false;
+        link.udp_sock = (int)socket(AF_INET, SOCK_DGRAM, 0);
+        if (link.udp_sock < 0 || connect(link.udp_sock, (struct sockaddr *)&to, sizeof(to)) < 0)
+            return false;
+        int sock_buf_size = SOCKET_BUFFER_SIZE;
+        setsockopt(link.udp_sock, SOL_SOCKET, SO_SNDBUF, (char *)&sock_buf_size, sizeof(sock_buf_size));
+
+        // A reconnected link keeps its packetizer, which the capture loop looks at under the lock
+        if (!link.packetizer)
+            link.packetizer.reset(new FramePacketizer(randomStreamId()));
+        link.packetizer->setAlignment((int)handshake.codec);
+        link.packetizer->setFec(fec_group);
+        std::cout << "📶 Frames to " << link.device.toString() << " go over UDP port " << reply.frame_id
+                  << (fec_group > 0 ? ", one parity packet per " + std::to_string(fec_group) + " fragments" : "")
+                  << std::endl;
+        return true;
+    }
+
+    // Cut a frame into datagrams and send them; lost ones are concealed, not resent
+    bool sendDatagrams(Link &link, const SharedFrame &frame, size_t &size)
+    {
+        MessageHeader header;
+        unpackHeader(frame.header, header);
+        uint32_t first = link.packetizer->packetize(header, frame.payload.data());
+        uint32_t end = link.packetizer->nextSeq();
+        size = 0;
+        for (uint32_t seq = first; seq != end; seq++)
+        {
+            const std::vector<uint8_t> *datagram = link.packetizer->packet(seq);
+            if (send(link.udp_sock, (const char *)datagram->data(), datagram->size(), 0) < 0)
+            {
+                if (errno == ENOBUFS || errno == EAGAIN)
+                    continue; // Lost like any other datagram
+                std::cerr << "❌ UDP send error: " << strerror(errno) << std::endl;
+                return false;
+            }
+            size += datagram->size();
+        }
+        link.datagrams += end - first;
+        return true;
+    }
+
+    void sendLoop(Link *link)
+    {
+        setTraceThreadName("send");
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            changed.wait(lock, [this, link]()
+                         { return stopping || !link->queue.empty(); });
+            if (link->queue.empty())
+            {
+                // Stopping and drained
+                lock.unlock();
+                sayGoodbye(*link);
+                break;
+            }
+
+            SharedFramePtr frame = link->queue.front();
+            link->queue.pop_front();
+            lock.unlock();
+
+            setTraceFrame(frame->frame_id);
+            uint64_t send_start = nowMicros();
+            size_t size = MESSAGE_HEADER_SIZE + frame->payload.size();
+            bool ok = readControl(*link, 0);
+            ok = ok && (sameStream(frame->stream, link->handshake) ||
+                        configure(*link, frame->stream, frame->frame_id));
+            ok = ok && (link->packetizer ? sendDatagrams(*link, *frame, size)
+                                         : link->connection.sendAll(frame->header, MESSAGE_HEADER_SIZE) &&
+                                               link->connection.sendAll(frame->payload.data(), frame->payload.size()));
+            if (ok)
+            {
+                recordSpan(STAGE_SEND, send_start, nowMicros());
+                addCounter(COUNTER_BYTES, size);
+            }
+            frame.reset(); // Let the pool reuse the buffer
+
+            lock.lock();
+            if (!ok)
+            {
+                link->reconnecting = true;
+                link->dropped += link->queue.size();
+                link->queue.clear();
+                changed.notify_all();
+                lock.unlock();
+
+                bool resumed = g_running && reconnect(*link);
+                lock.lock();
+                link->reconnecting = false;
+                if (!resumed)
+                {
+                    if (g_running && !stopping)
+                        std::cerr << "❌ Lost receiver " << link->device.toString() << std::endl;
+                    link->alive = false;
+                    changed.notify_all();
+                    break;
+                }
+                link->waiting_key = true; // Forces the keyframe that restarts the picture
+                link->reconnects++;
+                changed.notify_all();
+                continue;
+            }
+            link->sent++;
+            link->bytes += size;
+            changed.notify_all(); // The capture loop may be waiting for space
+        }
+    }
+
+    std::vector<std::unique_ptr<Link> > links;
+    int transport;
+    int fec_group;
+    uint32_t stream_tile_cache; // What the encoder assumes, from start() on
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool stopping;
+    uint64_t last_forced_key_us;
+};
+
 /**
- * Linux X11 screen capture with high quality
+ * One-to-many delivery over UDP multicast (--multicast group:port)
+ *
+ * Every frame is encoded once and sent to the group as PKT_DATA datagrams
+ * (see packet.h), whatever the number of receivers. A repair thread answers
+ * the receivers' PKT_NACKs from the packetizer's history, unicast to the
+ * receiver that asked. PKT_CONFIG goes out every MULTICAST_CONFIG_US and a
+ * keyframe every MULTICAST_REFRESH_US, so a receiver joining late is
+ * decoding within one refresh period; sooner when it asks for a keyframe
+ * (PKT_KEY_REQUEST), which is honoured at most every FANOUT_KEYFRAME_MIN_US.
  */
-std::vector<uint8_t> captureScreen()
+class MulticastLink
 {
-    // Allocate pixel buffer
-    std::vector<uint8_t> pixels(SCREEN_WIDTH * SCREEN_HEIGHT * BYTES_PER_PIXEL, 0);
+public:
+    MulticastLink()
+        : packetizer(randomStreamId()), sock(-1), config_frame(0), stopping(false), last_config_us(0),
+          last_key_us(0), key_requested(false), frames(0), datagrams(0), nacks(0), retransmits(0), key_requests(0) {}
+    ~MulticastLink() { stop(); }
+
+    bool active() const { return sock >= 0; }
 
-    // Open X display
-    Display *display = XOpenDisplay(NULL);
-    if (!display)
+    bool open(const std::string &target, int ttl, const Handshake &handshake)
     {
-        std::cerr << "❌ Failed to open X display" << std::endl;
-        return pixels;
-    }
+        size_t colon = target.rfind(':');
+        memset(&group, 0, sizeof(group));
+        group.sin_family = AF_INET;
+        group.sin_port = htons(colon == std::string::npos ? 0 : atoi(target.c_str() + colon + 1));
+        if (colon == std::string::npos || inet_pton(AF_INET, target.substr(0, colon).c_str(), &group.sin_addr) <= 0)
+        {
+            std::cerr << "❌ Expected --multicast <group>:<port>, got " << target << std::endl;
+            return false;
+        }
 
-    int screen_num = DefaultScreen(display);
-    Window root = RootWindow(display, screen_num);
+        sock = (int)socket(AF_INET, SOCK_DGRAM, 0);
+        if (sock < 0)
+        {
+            std::cerr << "❌ Failed to create multicast socket" << std::endl;
+            return false;
+        }
+        setMulticastSendOptions(sock, ttl, true);
+        int sock_buf_size = SOCKET_BUFFER_SIZE;
+        setsockopt(sock, SOL_SOCKET, SO_SNDBUF, (char *)&sock_buf_size, sizeof(sock_buf_size));
 
-    // Capture the screen
-    XImage *image = XGetImage(display, root, 0, 0,
-                              SCREEN_WIDTH, SCREEN_HEIGHT,
-                              AllPlanes, ZPixmap);
+        // NACKs come back to the port the stream is sent from; wake up now
+        // and then to notice stop()
+#ifdef _WIN32
+        int timeout = 100;
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout, sizeof(timeout));
+#else
+        struct timeval tv;
+        tv.tv_sec = 0;
+        tv.tv_usec = 100000;
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+#endif
 
-    if (!image)
+        packHandshake(handshake, config);
+        description = target;
+        std::cout << "📡 Streaming to multicast group " << target << " (TTL " << ttl << ")" << std::endl;
+        repair_thread = std::thread(&MulticastLink::repairLoop, this);
+        return true;
+    }
+
+    /**
+     * A new resolution or codec from frame `first_frame` on: announce it
+     * right away, a few times over since datagrams get lost, then with
+     * every periodic PKT_CONFIG
+     */
+    void reconfigure(const Handshake &handshake, uint32_t first_frame)
     {
-        std::cerr << "❌ Failed to capture screen" << std::endl;
-        XCloseDisplay(display);
-        return pixels;
+        packHandshake(handshake, config);
+        config_frame = first_frame;
+        std::vector<uint8_t> datagram = packetizer.control(PKT_CONFIG, config, sizeof(config), config_frame);
+        for (int i = 0; i < 3; i++)
+            sendDatagram(datagram.data(), datagram.size(), group);
+        last_config_us = nowMicros();
     }
 
-    // Convert XImage to RGB format
-    for (int y = 0; y < SCREEN_HEIGHT; y++)
+    // True when the next frame should be a refresh keyframe, or one a receiver asked for
+    bool wantsKeyframe(uint64_t now_us)
     {
-        for (int x = 0; x < SCREEN_WIDTH; x++)
+        bool requested = key_requested && now_us - last_key_us >= FANOUT_KEYFRAME_MIN_US;
+        if (!requested && now_us - last_key_us < MULTICAST_REFRESH_US)
+            return false;
+        key_requested = false;
+        last_key_us = now_us;
+        return true;
+    }
+
+    // Send one encoded frame to the group
+    bool publish(const MessageHeader &header, const uint8_t *payload)
+    {
+        uint64_t now_us = nowMicros();
+        if (now_us - last_config_us >= MULTICAST_CONFIG_US)
         {
-            unsigned long pixel = XGetPixel(image, x, y);
-            size_t index = (y * SCREEN_WIDTH + x) * BYTES_PER_PIXEL;
+            last_config_us = now_us;
+            std::vector<uint8_t> datagram = packetizer.control(PKT_CONFIG, config, sizeof(config), config_frame);
+            sendDatagram(datagram.data(), datagram.size(), group);
+        }
 
-            // Convert from X11 format (depends on endianness)
-#ifdef WORDS_BIGENDIAN
-            pixels[index + 0] = (pixel >> 16) & 0xFF; // Red
-            pixels[index + 1] = (pixel >> 8) & 0xFF;  // Green
-            pixels[index + 2] = pixel & 0xFF;         // Blue
+        // Only this thread writes the history; the repair thread reads older packets under the lock
+        uint32_t first, end;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            first = packetizer.packetize(header, payload);
+            end = packetizer.nextSeq();
+        }
+        for (uint32_t seq = first; seq != end; seq++)
+        {
+            const std::vector<uint8_t> *datagram = packetizer.packet(seq);
+            if (!sendDatagram(datagram->data(), datagram->size(), group))
+                return false;
+        }
+        frames++;
+        datagrams += end - first;
+        return true;
+    }
+
+    // Tell the receivers the stream is over and stop the repair thread
+    void stop()
+    {
+        if (!active())
+            return;
+        std::vector<uint8_t> bye = packetizer.control(PKT_BYE, NULL, 0);
+        for (int i = 0; i < 3; i++)
+            sendDatagram(bye.data(), bye.size(), group);
+        stopping = true;
+        if (repair_thread.joinable())
+            repair_thread.join();
+#ifdef _WIN32
+        closesocket(sock);
 #else
-            pixels[index + 0] = pixel & 0xFF;         // Blue
-            pixels[index + 1] = (pixel >> 8) & 0xFF;  // Green
-            pixels[index + 2] = (pixel >> 16) & 0xFF; // Red
+        ::close(sock);
 #endif
-        }
+        sock = -1;
     }
 
-    // Cleanup
-    XDestroyImage(image);
-    XCloseDisplay(display);
+    void showSummary() const
+    {
+        if (frames == 0)
+            return;
+        std::cout << "📡 multicast " << description << ": " << frames << " frames in " << datagrams
+                  << " datagrams, " << nacks << " NACKs, " << retransmits << " packets resent, " << key_requests
+                  << " keyframe requests" << std::endl;
+    }
 
-    return pixels;
-}
-#endif
+private:
+    bool sendDatagram(const uint8_t *data, size_t size, const struct sockaddr_in &to)
+    {
+        int sent = sendto(sock, (const char *)data, size, 0, (const struct sockaddr *)&to, sizeof(to));
+        if (sent == (int)size)
+            return true;
+        std::cerr << "❌ Multicast send error: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Answer NACKs with the requested packets, unicast to the receiver that asked; note keyframe requests
+    void repairLoop()
+    {
+        setTraceThreadName("repair");
+        std::vector<uint8_t> request(PACKET_HEADER_SIZE + 4 * PACKET_NACK_MAX);
+        std::vector<uint8_t> resend;
+        while (!stopping)
+        {
+            struct sockaddr_in from;
+            socklen_t from_len = sizeof(from);
+            int bytes = recvfrom(sock, (char *)request.data(), request.size(), 0, (struct sockaddr *)&from, &from_len);
+            PacketHeader header;
+            if (bytes <= 0 || !unpackPacketHeader(request.data(), bytes, header) ||
+                header.stream != packetizer.stream())
+                continue;
+            if (header.type == PKT_KEY_REQUEST)
+            {
+                key_requested = true;
+                key_requests++;
+                continue;
+            }
+            if (header.type != PKT_NACK || (size_t)bytes < PACKET_HEADER_SIZE + 4 * (size_t)header.count)
+                continue;
+
+            nacks++;
+            for (int i = 0; i < header.count; i++)
+            {
+                uint32_t seq = getU32(request.data() + PACKET_HEADER_SIZE + 4 * i);
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    const std::vector<uint8_t> *datagram = packetizer.packet(seq);
+                    if (!datagram)
+                        continue; // Too old, the receiver will wait for a keyframe
+                    resend = *datagram;
+                }
+                resend[9] |= PACKET_FLAG_RETRANSMIT; // PacketHeader::flags
+                if (sendDatagram(resend.data(), resend.size(), from))
+                    retransmits++;
+            }
+        }
+    }
+
+    FramePacketizer packetizer;
+    int sock;
+    struct sockaddr_in group;
+    std::string description;
+    uint8_t config[sizeof(Handshake)];
+    uint32_t config_frame; // First frame `config` describes
+    std::thread repair_thread;
+    std::mutex mutex;
+    std::atomic<bool> stopping;
+    uint64_t last_config_us;
+    uint64_t last_key_us;
+    std::atomic<bool> key_requested;
+    uint64_t frames, datagrams;
+    std::atomic<uint64_t> nacks, retransmits, key_requests;
+};
 
 /**
- * Calculate and display streaming statistics
+ * Calculate and display streaming statistics for the last interval
  */
-void showStats(int frames_sent, int elapsed_seconds, size_t bytes_sent)
+void showStats(int frames_sent, double elapsed_seconds, size_t bytes_sent)
 {
-    if (elapsed_seconds == 0)
+    if (elapsed_seconds <= 0)
         elapsed_seconds = 1;
 
-    float fps = frames_sent / (float)elapsed_seconds;
-    float mbps = (bytes_sent / (1024.0f * 1024.0f)) / elapsed_seconds;
+    double fps = frames_sent / elapsed_seconds;
+    double mbps = (bytes_sent / (1024.0 * 1024.0)) / elapsed_seconds;
 
     std::cout << "📊 Frames: " << frames_sent
               << " | FPS: " << std::fixed << std::setprecision(1) << fps
               << "/" << TARGET_FPS
               << " | Bandwidth: " << std::setprecision(2) << mbps << " MB/s"
               << " | Resolution: " << SCREEN_WIDTH << "x" << SCREEN_HEIGHT << std::endl;
+
+    // Per-stage timings recorded since the previous stats block
+    static StageWindow stage_window;
+    LatencyHistogram stages[STAGE_COUNT];
+    stage_window.advance(stages);
+    showStages(stages);
+}
+
+/**
+ * Find the TCP receivers (from --connect, or discovery and a selection),
+ * connect to each and start the fan-out. False if none is reachable.
+ */
+bool connectReceivers(const std::string &connect_target, const Handshake &handshake, FanOut &fanout)
+{
+    std::vector<DiscoveredDevice> targets;
+    if (!connect_target.empty())
+    {
+        // Explicit receivers, e.g. for scripted benchmarks: ip:port[,ip:port...]
+        std::stringstream list(connect_target);
+        std::string item;
+        while (std::getline(list, item, ','))
+        {
+            size_t colon = item.rfind(':');
+            targets.push_back(DiscoveredDevice(item.substr(0, colon),
+                                               colon == std::string::npos ? 8081 : atoi(item.c_str() + colon + 1)));
+        }
+    }
+    else
+    {
+        // Discover available receivers
+        std::cout << "🔍 Discovering receivers..." << std::endl;
+        auto receivers = discoverReceivers(5);
+
+        if (receivers.empty())
+        {
+            std::cerr << "❌ No receivers found!" << std::endl;
+            std::cerr << "   Make sure receiver is running on the same network." << std::endl;
+            std::cerr << "   Check firewall settings (UDP 1900, TCP 8081)." << std::endl;
+            return false;
+        }
+
+        // Display found receivers
+        std::cout << listDevices(receivers);
+
+        // Let user select one or more receivers, e.g. "0" or "0,2"
+        std::string choices;
+        std::cout << "Select receiver (0-" << receivers.size() - 1 << ", several separated by commas): ";
+        std::cin >> choices;
+
+        std::stringstream list(choices);
+        std::string item;
+        while (std::getline(list, item, ','))
+        {
+            char *end = NULL;
+            unsigned long choice = strtoul(item.c_str(), &end, 10);
+            if (item.empty() || *end != '\0' || choice >= receivers.size())
+            {
+                std::cerr << "❌ Invalid selection" << std::endl;
+                return false;
+            }
+            targets.push_back(receivers[choice]);
+            std::cout << "🎯 Selected: " << receivers[choice].toString() << std::endl;
+        }
+    }
+
+    // Connect to every receiver and send each the handshake
+    std::cout << "🔌 Connecting to receiver" << (targets.size() == 1 ? "" : "s") << "..." << std::endl;
+
+    for (size_t i = 0; i < targets.size(); i++)
+    {
+        // An explicit receiver may still be starting up (scripted runs), keep trying briefly
+        if (!fanout.add(targets[i], handshake, !connect_target.empty()))
+            std::cerr << "⚠️  Skipping receiver " << targets[i].toString() << std::endl;
+    }
+
+    if (fanout.size() == 0)
+    {
+        std::cerr << "❌ Failed to connect to receiver" << std::endl;
+        std::cerr << "   Check if receiver is running and firewall allows TCP port 8081." << std::endl;
+        return false;
+    }
+    fanout.start();
+    return true;
+}
+
+/**
+ * A scheduled mid-stream change (--reconfigure)
+ */
+struct Reconfiguration
+{
+    int frame;
+    int width, height; // 0: keep the resolution
+    int codec;         // -1: keep the codec
+};
+
+bool parseReconfiguration(const char *spec, Reconfiguration &change)
+{
+    change.width = change.height = 0;
+    change.codec = -1;
+    const char *colon = strchr(spec, ':');
+    if (!colon)
+        return false;
+    change.frame = atoi(spec);
+    if (sscanf(colon + 1, "%dx%d", &change.width, &change.height) == 2)
+        return true;
+    change.codec = codecFromName(colon + 1);
+    return change.codec >= 0;
 }
 
 /**
@@ -521,23 +1344,166 @@ void showStats(int frames_sent, int elapsed_seconds, size_t bytes_sent)
  * 1. Show splash screen
  * 2. Detect screen resolution
  * 3. Discover receivers
- * 4. Connect to selected receiver
+ * 4. Connect to the selected receivers
  * 5. Stream screen captures
+ *
+ * Options:
+ *   --source <spec>      Frame source: "screen" (default), synthetic:<pattern>
+ *                        with pattern static, scroll, window, noise, typing or video,
+ *                        or replay:<file> / replay-max:<file> for a corpus
+ *   --size <WxH>         Resolution of synthetic sources (default 1920x1080)
+ *   --fps <n>            Target frame rate, 0 = unlimited (default 60)
+ *   --codec <name>       Frame codec: raw (default) or tile
+ *   --threads <n>        Worker threads for the tile encoder (default 1)
+ *   --connect <list>     Skip discovery and stream to these receivers,
+ *                        ip:port[,ip:port...]; every frame is encoded once
+ *   --multicast <g:p>    Stream to multicast group g, port p instead of TCP
+ *                        receivers, with NACK repair and periodic keyframes
+ *   --ttl <n>            Multicast TTL (default 1, the local network)
+ *   --transport <t>      How frames reach --connect receivers: tcp (default)
+ *                        or udp, datagrams with FEC and no retransmission
+ *   --fec <n>            UDP: one parity packet per n fragments (default 8,
+ *                        0 = none)
+ *   --tile-cache <MB>    Tile cache offered to receivers (default 64, 0 = off):
+ *                        tiles they still hold are sent as references
+ *   --refresh <s>        Intra refresh: resend the picture a stripe of tiles
+ *                        per frame, all of it every s seconds (tile codec;
+ *                        default 2 with --transport udp, otherwise 0 = off)
+ *   --no-motion          Tile codec: do not look for scrolled or moved
+ *                        content to send as copies of the previous picture
+ *   --quality <q>        Tile codec: send photographic tiles (video) lossy
+ *                        at JPEG-style quality q, 1..100; text and UI stay
+ *                        lossless (default 0 = everything lossless)
+ *   --frames <n>         Stop after n frames (default: until Ctrl+C)
+ *   --reconfigure <n>:<to>  At frame n switch to resolution WxH (synthetic
+ *                        sources) or to another codec without reconnecting;
+ *                        may be repeated
+ *   --no-splash          Do not show the splash screen
+ *   --record <file>      Also write every captured frame to a corpus file
+ *   --stats-json <file>  Write stage histograms and counters as JSON on exit
+ *   --trace <file>       Record a Chrome trace of every frame, written on exit
+ *                        or on SIGUSR1
  */
-int main()
+int main(int argc, char *argv[])
 {
+    std::string source_spec = "screen";
+    std::string stats_json_path;
+    std::string trace_path;
+    std::string connect_target;
+    std::string record_path;
+    std::string multicast_target;
+    int multicast_ttl = 1;
+    int transport = TRANSPORT_TCP;
+    int fec_group = UDP_FEC_GROUP;
+    int codec = CODEC_RAW;
+    int frame_limit = 0;
+    double refresh_s = -1; // Not given: UDP_REFRESH_S over UDP
+    int tile_cache_mb = TILE_CACHE_MB;
+    bool motion = true;
+    int quality = 0;
+    std::vector<Reconfiguration> reconfigurations;
+    bool splash = true;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--source" && i + 1 < argc)
+            source_spec = argv[++i];
+        else if (arg == "--size" && i + 1 < argc &&
+                 sscanf(argv[i + 1], "%dx%d", &SCREEN_WIDTH, &SCREEN_HEIGHT) == 2)
+            i++;
+        else if (arg == "--fps" && i + 1 < argc)
+            TARGET_FPS = atoi(argv[++i]);
+        else if (arg == "--stats-json" && i + 1 < argc)
+            stats_json_path = argv[++i];
+        else if (arg == "--trace" && i + 1 < argc)
+            trace_path = argv[++i];
+        else if (arg == "--codec" && i + 1 < argc && codecFromName(argv[i + 1]) >= 0)
+            codec = codecFromName(argv[++i]);
+        else if (arg == "--threads" && i + 1 < argc)
+            ENCODE_THREADS = atoi(argv[++i]);
+        else if (arg == "--connect" && i + 1 < argc)
+            connect_target = argv[++i];
+        else if (arg == "--multicast" && i + 1 < argc)
+            multicast_target = argv[++i];
+        else if (arg == "--ttl" && i + 1 < argc)
+            multicast_ttl = atoi(argv[++i]);
+        else if (arg == "--transport" && i + 1 < argc &&
+                 (strcmp(argv[i + 1], "tcp") == 0 || strcmp(argv[i + 1], "udp") == 0))
+            transport = strcmp(argv[++i], "udp") == 0 ? TRANSPORT_UDP : TRANSPORT_TCP;
+        else if (arg == "--fec" && i + 1 < argc)
+            fec_group = std::max(0, std::min(atoi(argv[++i]), 255));
+        else if (arg == "--frames" && i + 1 < argc)
+            frame_limit = atoi(argv[++i]);
+        else if (arg == "--refresh" && i + 1 < argc)
+            refresh_s = std::max(0.0, atof(argv[++i]));
+        else if (arg == "--tile-cache" && i + 1 < argc)
+            tile_cache_mb = std::max(0, atoi(argv[++i]));
+        else if (arg == "--no-motion")
+            motion = false;
+        else if (arg == "--quality" && i + 1 < argc)
+            quality = std::max(0, std::min(atoi(argv[++i]), DCT_QUALITY_MAX));
+        else if (arg == "--reconfigure" && i + 1 < argc)
+        {
+            Reconfiguration change;
+            if (!parseReconfiguration(argv[++i], change))
+            {
+                std::cerr << "❌ Expected --reconfigure <frame>:<WxH|codec>, got " << argv[i] << std::endl;
+                return 1;
+            }
+            reconfigurations.push_back(change);
+        }
+        else if (arg == "--no-splash")
+            splash = false;
+        else if (arg == "--record" && i + 1 < argc)
+            record_path = argv[++i];
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--source screen|synthetic:<pattern>|replay[-max]:<file>]"
+                      << " [--size WxH] [--fps n] [--codec raw|tile] [--threads n] [--connect ip:port[,...]]"
+                      << " [--multicast group:port] [--ttl n] [--transport tcp|udp] [--fec n] [--tile-cache MB] [--refresh s] [--no-motion] [--quality q] [--frames n] [--reconfigure n:WxH|codec] [--no-splash] [--record <file>] [--stats-json <file>] [--trace <file>]"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    // Ctrl+C stops the stream but still prints and writes the statistics
+    signal(SIGINT, handleSignal);
+#ifdef SIGUSR1
+    signal(SIGUSR1, handleSignal);
+#endif
+#ifdef SIGPIPE
+    signal(SIGPIPE, SIG_IGN); // A receiver going away is reported by send(), and reconnected
+#endif
+
+    if (!trace_path.empty())
+    {
+        enableTracing();
+        setTraceThreadName("stream");
+    }
+
     // Show RGM splash screen
-    showSplashScreen();
+    if (splash)
+        showSplashScreen();
 
-    // Detect screen dimensions
-    getScreenDimensions(SCREEN_WIDTH, SCREEN_HEIGHT);
+    // Open the frame source; the screen source detects its own resolution
+    std::unique_ptr<CaptureSource> source = createCaptureSource(source_spec, SCREEN_WIDTH, SCREEN_HEIGHT);
+    if (!source)
+        return 1;
+    SCREEN_WIDTH = source->width();
+    SCREEN_HEIGHT = source->height();
 
     // Display program information
     std::cout << "========================================" << std::endl;
     std::cout << "🎥 RGM SENDER v2.0" << std::endl;
     std::cout << "========================================" << std::endl;
+    std::cout << "Source:          " << source->describe() << std::endl;
     std::cout << "Detected Resolution: " << SCREEN_WIDTH << "x" << SCREEN_HEIGHT << std::endl;
     std::cout << "Target FPS: " << TARGET_FPS << std::endl;
+    std::cout << "Codec:      " << codecName(codec);
+    if (codec == CODEC_TILE)
+        std::cout << " (" << ENCODE_THREADS << " thread" << (ENCODE_THREADS == 1 ? "" : "s") << ")";
+    std::cout << std::endl;
+    std::cout << "SIMD:       " << simdLevelName(activeSimdLevel()) << std::endl;
     std::cout << "========================================" << std::endl;
 
     // Initialize network sockets
@@ -547,68 +1513,31 @@ int main()
         return 1;
     }
 
-    // Discover available receivers
-    std::cout << "🔍 Discovering receivers..." << std::endl;
-    auto receivers = discoverReceivers(5);
-
-    if (receivers.empty())
+    Handshake handshake = {(uint32_t)SCREEN_WIDTH, (uint32_t)SCREEN_HEIGHT,
+                           (uint32_t)TARGET_FPS, PROTOCOL_VERSION, (uint32_t)codec, 0,
+                           (uint32_t)std::min((size_t)TILE_CACHE_MAX, (size_t)tile_cache_mb * 1024 * 1024 / TILE_BYTES)};
+    FanOut fanout;
+    fanout.setTransport(transport, fec_group);
+    MulticastLink multicast;
+    if (!multicast_target.empty())
     {
-        std::cerr << "❌ No receivers found!" << std::endl;
-        std::cerr << "   Make sure receiver is running on the same network." << std::endl;
-        std::cerr << "   Check firewall settings (UDP 1900, TCP 8081)." << std::endl;
-        cleanupSockets();
-        return 1;
-    }
-
-    // Display found receivers
-    std::cout << listDevices(receivers);
-
-    // Let user select receiver
-    size_t choice;
-    std::cout << "Select receiver (0-" << receivers.size() - 1 << "): ";
-    std::cin >> choice;
-
-    if (choice >= receivers.size())
-    {
-        std::cerr << "❌ Invalid selection" << std::endl;
-        cleanupSockets();
-        return 1;
+        // Receivers join the group on their own, nothing to discover
+        if (!multicast.open(multicast_target, multicast_ttl, handshake))
+        {
+            cleanupSockets();
+            return 1;
+        }
     }
-
-    const auto &selected = receivers[choice];
-    std::cout << "🎯 Selected: " << selected.toString() << std::endl;
-
-    // Connect to receiver
-    std::cout << "🔌 Connecting to receiver..." << std::endl;
-
-    NetworkSocket connection;
-    if (!connection.connect(selected.ip_address, selected.tcp_port))
+    else if (!connectReceivers(connect_target, handshake, fanout))
     {
-        std::cerr << "❌ Failed to connect to receiver" << std::endl;
-        std::cerr << "   Check if receiver is running and firewall allows TCP port 8081." << std::endl;
         cleanupSockets();
         return 1;
     }
 
-    /**
-     * Send handshake information to receiver
-     */
-    struct
-    {
-        uint32_t width;
-        uint32_t height;
-        uint32_t fps;
-    } handshake = {
-        htonl(SCREEN_WIDTH),
-        htonl(SCREEN_HEIGHT),
-        htonl(TARGET_FPS)};
-
-    if (!connection.sendAll(&handshake, sizeof(handshake)))
-    {
-        std::cerr << "❌ Failed to send screen dimensions to receiver" << std::endl;
-        cleanupSockets();
-        return 1;
-    }
+    // The encoder may only refer to tiles every receiver caches
+    if (!multicast.active())
+        handshake.tile_cache = fanout.tileCache();
+    std::cout << "🗃️  Tile cache: " << handshake.tile_cache << " tiles" << std::endl;
 
     std::cout << "🎬 Starting stream..." << std::endl;
     std::cout << "   Press Ctrl+C to stop" << std::endl;
@@ -618,10 +1547,38 @@ int main()
     auto stats_time = last_time;
     int frames_sent = 0;
     size_t total_bytes = 0;
+    int stats_frames = 0;
+    size_t stats_bytes = 0;
     bool streaming = true;
 
-    // Calculate frame duration in microseconds
-    const auto frame_duration = std::chrono::microseconds(1000000 / TARGET_FPS);
+    // Calculate frame duration in microseconds (zero when unlimited)
+    const auto frame_duration = std::chrono::microseconds(TARGET_FPS > 0 ? 1000000 / TARGET_FPS : 0);
+
+    // Frame buffer reused for every capture
+    std::vector<uint8_t> frame(source->frameSize());
+    std::unique_ptr<FrameEncoder> encoder(new FrameEncoder(codec, SCREEN_WIDTH, SCREEN_HEIGHT, ENCODE_THREADS));
+    if (refresh_s < 0)
+        refresh_s = transport == TRANSPORT_UDP && multicast_target.empty() ? UDP_REFRESH_S : 0;
+    int refresh_frames = (int)(refresh_s * (TARGET_FPS > 0 ? TARGET_FPS : 60)); // Unlimited: assume 60 fps
+    encoder->setRefresh(refresh_frames);
+    encoder->setTileCache(handshake.tile_cache);
+    encoder->setMotion(motion);
+    encoder->setQuality(quality);
+    EncodedFrame encoded;
+    uint64_t tiles_sent = 0, tiles_cached = 0, tiles_copied = 0, tiles_lossy = 0;
+    SharedFramePool frame_pool;
+
+    // Optional recording of the captured frames for later replay
+    CorpusWriter recorder;
+    if (!record_path.empty())
+    {
+        if (!recorder.open(record_path, SCREEN_WIDTH, SCREEN_HEIGHT))
+        {
+            cleanupSockets();
+            return 1;
+        }
+        std::cout << "⏺️  Recording captured frames to " << record_path << std::endl;
+    }
 
     /**
      * Main streaming loop
@@ -629,43 +1586,138 @@ int main()
     while (streaming && g_running)
     {
         auto frame_start = std::chrono::steady_clock::now();
+        setTraceFrame(frames_sent);
 
-        // Capture current screen
-        auto frame = captureScreen();
+        // Capture only once some receiver can take the frame
+        if (!multicast.active() && !fanout.waitForSpace())
+        {
+            if (g_running)
+                std::cerr << "❌ No receiver left" << std::endl;
+            break;
+        }
 
-        // Send frame size (network byte order)
-        uint32_t frame_size = frame.size();
-        uint32_t net_frame_size = htonl(frame_size);
+        /**
+         * Mid-stream reconfiguration: the display changed size, or a
+         * --reconfigure is due. A new encoder starts with a keyframe, and
+         * the receivers learn of it in-band (MSG_CONFIGURE, PKT_CONFIG)
+         */
+        bool reconfigure = source->resized();
+        for (size_t i = 0; i < reconfigurations.size(); i++)
+        {
+            const Reconfiguration &change = reconfigurations[i];
+            if (change.frame != frames_sent)
+                continue;
+            if (change.width > 0 && !source->resize(change.width, change.height))
+                std::cerr << "⚠️  " << source->describe() << " cannot change to " << change.width << "x"
+                          << change.height << std::endl;
+            if (change.codec >= 0)
+                codec = change.codec;
+            reconfigure = true;
+        }
+        if (reconfigure && (source->width() != SCREEN_WIDTH || source->height() != SCREEN_HEIGHT ||
+                            codec != encoder->codec()))
+        {
+            if (!record_path.empty() && (source->width() != SCREEN_WIDTH || source->height() != SCREEN_HEIGHT))
+            {
+                std::cerr << "⚠️  A recording has one resolution, recording stopped" << std::endl;
+                recorder.close();
+                record_path.clear();
+            }
+            SCREEN_WIDTH = source->width();
+            SCREEN_HEIGHT = source->height();
+            handshake.width = SCREEN_WIDTH;
+            handshake.height = SCREEN_HEIGHT;
+            handshake.codec = codec;
+            frame.resize(source->frameSize());
+            encoder.reset(new FrameEncoder(codec, SCREEN_WIDTH, SCREEN_HEIGHT, ENCODE_THREADS));
+            encoder->setRefresh(refresh_frames);
+            encoder->setTileCache(handshake.tile_cache);
+            encoder->setMotion(motion);
+            encoder->setQuality(quality);
+            if (multicast.active())
+                multicast.reconfigure(handshake, frames_sent);
+            std::cout << "📐 Stream reconfigured to " << SCREEN_WIDTH << "x" << SCREEN_HEIGHT << ", codec "
+                      << codecName(codec) << std::endl;
+        }
 
-        if (!connection.sendAll(&net_frame_size, 4))
+        // Capture current screen, stamped with the capture start time
+        MessageHeader header = {};
+        header.type = MSG_FRAME;
+        header.frame_id = frames_sent;
+        header.timestamp_us = nowMicros();
+        if (!source->grab(frame.data()))
         {
-            std::cerr << "❌ Failed to send frame size" << std::endl;
+            std::cerr << "❌ Frame capture failed" << std::endl;
             break;
         }
+        if (!record_path.empty() && !recorder.write(frame.data(), header.timestamp_us))
+        {
+            std::cerr << "❌ Writing " << record_path << " failed, recording stopped" << std::endl;
+            recorder.close();
+            record_path.clear();
+        }
 
-        // Send frame data
-        if (!connection.sendAll(frame.data(), frame.size()))
+        // Encode once into a shared buffer (header in network byte order),
+        // the receivers' send threads put it on the wire
+        uint64_t encode_start = nowMicros();
+        bool force_keyframe = multicast.active() ? multicast.wantsKeyframe(encode_start)
+                                                 : fanout.wantsKeyframe(encode_start);
+        encoder->encode(frame.data(), force_keyframe, encoded);
+        header.size = encoded.size;
+        header.flags = encoded.keyframe ? FRAME_FLAG_KEYFRAME : 0;
+        uint32_t frame_size = encoded.size;
+        if (encoder->codec() == CODEC_TILE)
         {
-            std::cerr << "❌ Failed to send frame data" << std::endl;
-            break;
+            tiles_sent += encoded.tiles_sent;
+            tiles_cached += encoded.tiles_cached;
+            tiles_copied += encoded.tiles_copied;
+            tiles_lossy += encoded.tiles_lossy;
+        }
+        if (multicast.active())
+        {
+            // Straight to the group, from the encoder's buffer
+            uint64_t send_start = nowMicros();
+            recordSpan(STAGE_ENCODE, encode_start, send_start);
+            if (!multicast.publish(header, encoded.data))
+                break;
+            recordSpan(STAGE_SEND, send_start, nowMicros());
+            addCounter(COUNTER_BYTES, MESSAGE_HEADER_SIZE + frame_size);
+        }
+        else
+        {
+            SharedFramePtr shared = frame_pool.acquire();
+            packHeader(header, shared->header);
+            shared->payload.assign(encoded.data, encoded.data + encoded.size);
+            shared->frame_id = header.frame_id;
+            shared->keyframe = encoded.keyframe;
+            shared->stream = handshake;
+            recordSpan(STAGE_ENCODE, encode_start, nowMicros());
+
+            fanout.publish(shared);
         }
 
         // Update statistics
         frames_sent++;
-        total_bytes += 4 + frame_size;
+        total_bytes += MESSAGE_HEADER_SIZE + frame_size;
+        addCounter(COUNTER_FRAMES);
+        if (frame_limit > 0 && frames_sent >= frame_limit)
+            streaming = false;
 
         // Display periodic statistics
         auto now = std::chrono::steady_clock::now();
-        auto stats_elapsed = std::chrono::duration_cast<std::chrono::seconds>(
-                                 now - stats_time)
-                                 .count();
+        double stats_elapsed = std::chrono::duration<double>(now - stats_time).count();
 
         if (stats_elapsed >= STATS_INTERVAL_SEC)
         {
-            showStats(frames_sent, stats_elapsed, total_bytes);
+            showStats(frames_sent - stats_frames, stats_elapsed, total_bytes - stats_bytes);
             stats_time = now;
+            stats_frames = frames_sent;
+            stats_bytes = total_bytes;
         }
 
+        if (g_trace_dump_requested.exchange(false))
+            writeTrace(trace_path, "RGM sender", TRACE_PID_SENDER);
+
         /**
          * Adaptive frame timing
          * Skip frames if we're falling behind to maintain real-time
@@ -690,6 +1742,10 @@ int main()
         }
     }
 
+    // Let every receiver get what is already queued
+    fanout.stop();
+    multicast.stop();
+
     // Display final statistics
     auto end_time = std::chrono::steady_clock::now();
     auto total_seconds = std::chrono::duration_cast<std::chrono::seconds>(
@@ -709,8 +1765,36 @@ int main()
         std::cout << "Total data:      " << std::fixed << std::setprecision(2) << total_mb << " MB" << std::endl;
         std::cout << "Avg bandwidth:   " << std::fixed << std::setprecision(2) << (total_mb / total_seconds) << " MB/s" << std::endl;
     }
+    if (tiles_sent > 0)
+        std::cout << "Tiles sent:      " << tiles_sent << " (" << tiles_cached << " from the receiver's cache, "
+                  << tiles_copied << " moved, " << tiles_lossy << " lossy)" << std::endl;
+    LatencyHistogram stages[STAGE_COUNT];
+    snapshotStages(stages);
+    showStages(stages);
+    fanout.showSummary();
+    multicast.showSummary();
     std::cout << "========================================" << std::endl;
 
+    if (!stats_json_path.empty())
+    {
+        StatsReport report;
+        report.role = "sender";
+        report.values.push_back(std::make_pair("width", (double)SCREEN_WIDTH));
+        report.values.push_back(std::make_pair("height", (double)SCREEN_HEIGHT));
+        report.values.push_back(std::make_pair("target_fps", (double)TARGET_FPS));
+        report.values.push_back(std::make_pair("codec", (double)codec));
+        report.values.push_back(std::make_pair("threads", (double)ENCODE_THREADS));
+        report.values.push_back(std::make_pair("receivers", (double)fanout.size()));
+        report.values.push_back(std::make_pair("duration_s",
+                                               std::chrono::duration<double>(end_time - last_time).count()));
+        writeStatsJson(stats_json_path, report);
+    }
+
+    if (!trace_path.empty())
+        writeTrace(trace_path, "RGM sender", TRACE_PID_SENDER);
+
+    recorder.close();
+
     // Cleanup
     cleanupSockets();
     return 0;
@@ -0,0 +1,823 @@
+/**
+ * SIMD.CPP - CPU FEATURE DISPATCH AND PIXEL KERNELS
+ */
+#include "simd.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// x86 kernels are compiled per function with target attributes, so the rest
+// of the build keeps the baseline instruction set
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RGM_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+static const char *const SIMD_LEVEL_NAMES[SIMD_LEVEL_COUNT] = {"scalar", "ssse3", "avx2"};
+
+const char *simdLevelName(int level)
+{
+    return level >= 0 && level < SIMD_LEVEL_COUNT ? SIMD_LEVEL_NAMES[level] : "unknown";
+}
+
+int simdLevelFromName(const std::string &name)
+{
+    for (int level = 0; level < SIMD_LEVEL_COUNT; level++)
+    {
+        if (name == SIMD_LEVEL_NAMES[level])
+            return level;
+    }
+    return -1;
+}
+
+int detectedSimdLevel()
+{
+#ifdef RGM_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return SIMD_AVX2;
+    if (__builtin_cpu_supports("ssse3"))
+        return SIMD_SSSE3;
+#endif
+    return SIMD_SCALAR;
+}
+
+static int chooseSimdLevel()
+{
+    int level = detectedSimdLevel();
+    const char *cap = getenv("RGM_SIMD");
+    if (cap && *cap)
+    {
+        int requested = simdLevelFromName(cap);
+        if (requested < 0)
+            std::cerr << "⚠️  Ignoring unknown RGM_SIMD=" << cap << std::endl;
+        else if (requested < level)
+            level = requested;
+    }
+    return level;
+}
+
+int activeSimdLevel()
+{
+    static const int level = chooseSimdLevel();
+    return level;
+}
+
+// ============================================================================
+// PACK 32-BIT PIXELS TO 24-BIT
+// ============================================================================
+
+static void packPixels32Scalar(const uint8_t *src, uint8_t *dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        dst[0] = src[0];
+        dst[1] = src[1];
+        dst[2] = src[2];
+        src += 4;
+        dst += 3;
+    }
+}
+
+#ifdef RGM_X86_KERNELS
+/**
+ * 16 pixels per step: each 4-pixel vector is shuffled down to 12 bytes,
+ * then four of them are stitched into three 16-byte stores.
+ */
+__attribute__((target("ssse3")))
+static void packPixels32Ssse3(const uint8_t *src, uint8_t *dst, size_t count)
+{
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 0)), shuffle);
+        __m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 16)), shuffle);
+        __m128i c = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 32)), shuffle);
+        __m128i d = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 48)), shuffle);
+
+        _mm_storeu_si128((__m128i *)(dst + 0), _mm_or_si128(a, _mm_slli_si128(b, 12)));
+        _mm_storeu_si128((__m128i *)(dst + 16), _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+        _mm_storeu_si128((__m128i *)(dst + 32), _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+        src += 64;
+        dst += 48;
+    }
+    packPixels32Scalar(src, dst, count - i);
+}
+
+/**
+ * 8 pixels per step: shuffle within each 128-bit lane, move the two 12-byte
+ * halves together with a dword permute and store 32 bytes of which 24 are
+ * valid; the next store overwrites the rest. The last few pixels go through
+ * the scalar loop so nothing is written past the destination.
+ */
+__attribute__((target("avx2")))
+static void packPixels32Avx2(const uint8_t *src, uint8_t *dst, size_t count)
+{
+    const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                             0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m256i compact = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+    size_t i = 0;
+    for (; i + 11 <= count; i += 8)
+    {
+        __m256i pixels = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)src), shuffle);
+        _mm256_storeu_si256((__m256i *)dst, _mm256_permutevar8x32_epi32(pixels, compact));
+        src += 32;
+        dst += 24;
+    }
+    packPixels32Scalar(src, dst, count - i);
+}
+#endif
+
+PackPixelsFn packPixels32Kernel(int level)
+{
+    if (level > detectedSimdLevel())
+        return NULL;
+    switch (level)
+    {
+#ifdef RGM_X86_KERNELS
+    case SIMD_AVX2:
+        return packPixels32Avx2;
+    case SIMD_SSSE3:
+        return packPixels32Ssse3;
+#endif
+    case SIMD_SCALAR:
+        return packPixels32Scalar;
+    default:
+        return NULL;
+    }
+}
+
+void packPixels32(const uint8_t *src, uint8_t *dst, size_t count)
+{
+    static const PackPixelsFn kernel = packPixels32Kernel(activeSimdLevel());
+    kernel(src, dst, count);
+}
+
+// ============================================================================
+// 8x8 DCT
+// ============================================================================
+
+#define DCT_BITS 12    // Fixed-point bits of the DCT matrix
+#define DCT_PASS1 9    // Shift after the column pass: 3 bits of headroom stay
+#define DCT_PASS2 15   // Shift after the row pass: the rest
+
+// M[u][x] = c(u) cos((2x + 1) u pi / 16) << DCT_BITS, written out so every build agrees
+static const int16_t DCT_FORWARD[8][8] = {
+    {1448, 1448, 1448, 1448, 1448, 1448, 1448, 1448},
+    {2009, 1703, 1138, 400, -400, -1138, -1703, -2009},
+    {1892, 784, -784, -1892, -1892, -784, 784, 1892},
+    {1703, -400, -2009, -1138, 1138, 2009, 400, -1703},
+    {1448, -1448, -1448, 1448, 1448, -1448, -1448, 1448},
+    {1138, -2009, 400, 1703, -1703, -400, 2009, -1138},
+    {784, -1892, 1892, -784, -784, 1892, -1892, 784},
+    {400, -1138, 1703, -2009, 2009, -1703, 1138, -400},
+};
+
+struct DctMatrix
+{
+    int16_t forward[8][8];
+    int16_t inverse[8][8]; // The transpose
+    // The same, as pairs of neighbouring entries in one 32-bit word (x86 kernels)
+    int32_t forward_pairs[8][4];
+    int32_t inverse_pairs[8][4];
+};
+
+static DctMatrix makeDctMatrix()
+{
+    DctMatrix matrix;
+    for (int u = 0; u < 8; u++)
+    {
+        for (int x = 0; x < 8; x++)
+        {
+            matrix.forward[u][x] = DCT_FORWARD[u][x];
+            matrix.inverse[x][u] = DCT_FORWARD[u][x];
+        }
+    }
+    for (int k = 0; k < 8; k++)
+    {
+        for (int u = 0; u < 4; u++)
+        {
+            matrix.forward_pairs[k][u] = (int32_t)((uint16_t)matrix.forward[k][2 * u] |
+                                                   (uint32_t)(uint16_t)matrix.forward[k][2 * u + 1] << 16);
+            matrix.inverse_pairs[k][u] = (int32_t)((uint16_t)matrix.inverse[k][2 * u] |
+                                                   (uint32_t)(uint16_t)matrix.inverse[k][2 * u + 1] << 16);
+        }
+    }
+    return matrix;
+}
+
+static const DctMatrix &dctMatrix()
+{
+    static const DctMatrix matrix = makeDctMatrix();
+    return matrix;
+}
+
+static inline int16_t saturate16(int32_t value)
+{
+    return value < -32768 ? -32768 : value > 32767 ? 32767 : (int16_t)value;
+}
+
+// out[k][x] = sum over u of a[k][u] * in[u][x], rounded, shifted and saturated
+static void dctPassScalar(const int16_t *in, int16_t *out, const int16_t a[8][8], int shift)
+{
+    for (int k = 0; k < 8; k++)
+    {
+        for (int x = 0; x < 8; x++)
+        {
+            int32_t sum = 1 << (shift - 1);
+            for (int u = 0; u < 8; u++)
+                sum += a[k][u] * in[u * 8 + x];
+            out[k * 8 + x] = saturate16(sum >> shift);
+        }
+    }
+}
+
+static void transpose8x8Scalar(const int16_t *in, int16_t *out)
+{
+    for (int y = 0; y < 8; y++)
+    {
+        for (int x = 0; x < 8; x++)
+            out[x * 8 + y] = in[y * 8 + x];
+    }
+}
+
+// A * in * A^T: a column pass, then the same pass on the transpose
+static void dct8x8Scalar(const int16_t *in, int16_t *out, size_t blocks, const int16_t a[8][8])
+{
+    int16_t pass[64], turned[64];
+    for (size_t block = 0; block < blocks; block++, in += 64, out += 64)
+    {
+        dctPassScalar(in, pass, a, DCT_PASS1);
+        transpose8x8Scalar(pass, turned);
+        dctPassScalar(turned, pass, a, DCT_PASS2);
+        transpose8x8Scalar(pass, out);
+    }
+}
+
+static void fdct8x8Scalar(const int16_t *in, int16_t *out, size_t blocks)
+{
+    dct8x8Scalar(in, out, blocks, dctMatrix().forward);
+}
+
+static void idct8x8Scalar(const int16_t *in, int16_t *out, size_t blocks)
+{
+    dct8x8Scalar(in, out, blocks, dctMatrix().inverse);
+}
+
+static void quantizeScalar(const int16_t *coefs, int16_t *levels, const uint16_t *half, const uint16_t *recip,
+                           size_t blocks)
+{
+    for (size_t block = 0; block < blocks; block++, coefs += 64, levels += 64)
+    {
+        for (int i = 0; i < 64; i++)
+        {
+            int32_t c = coefs[i];
+            uint32_t magnitude = (uint32_t)(c < 0 ? -c : c) + half[i];
+            if (magnitude > 65535)
+                magnitude = 65535;
+            int16_t level = (int16_t)((magnitude * recip[i]) >> 16);
+            levels[i] = c < 0 ? -level : c == 0 ? 0 : level;
+        }
+    }
+}
+
+static void dequantizeScalar(const int16_t *levels, int16_t *coefs, const uint16_t *steps, size_t blocks)
+{
+    for (size_t block = 0; block < blocks; block++, levels += 64, coefs += 64)
+    {
+        for (int i = 0; i < 64; i++)
+        {
+            int32_t value = levels[i] * steps[i];
+            coefs[i] = (int16_t)(value < -32768 ? -32768 : value > 32767 ? 32767 : value);
+        }
+    }
+}
+
+#ifdef RGM_X86_KERNELS
+/**
+ * The rows of a block are eight vectors. A pass interleaves pairs of input
+ * rows and multiplies them by pairs of matrix entries (pmaddwd), four
+ * multiply-adds per half row of output; the transposes are unpack ladders.
+ */
+__attribute__((target("ssse3")))
+static inline void dctPassSsse3(const __m128i *in, __m128i *out, const int32_t pairs[8][4], int shift)
+{
+    __m128i lo[4], hi[4];
+    for (int u = 0; u < 4; u++)
+    {
+        lo[u] = _mm_unpacklo_epi16(in[2 * u], in[2 * u + 1]);
+        hi[u] = _mm_unpackhi_epi16(in[2 * u], in[2 * u + 1]);
+    }
+    const __m128i round = _mm_set1_epi32(1 << (shift - 1));
+    const __m128i count = _mm_cvtsi32_si128(shift);
+    for (int k = 0; k < 8; k++)
+    {
+        __m128i sum_lo = round, sum_hi = round;
+        for (int u = 0; u < 4; u++)
+        {
+            __m128i pair = _mm_set1_epi32(pairs[k][u]);
+            sum_lo = _mm_add_epi32(sum_lo, _mm_madd_epi16(lo[u], pair));
+            sum_hi = _mm_add_epi32(sum_hi, _mm_madd_epi16(hi[u], pair));
+        }
+        out[k] = _mm_packs_epi32(_mm_sra_epi32(sum_lo, count), _mm_sra_epi32(sum_hi, count));
+    }
+}
+
+__attribute__((target("ssse3")))
+static inline void transpose8x8Ssse3(const __m128i *in, __m128i *out)
+{
+    __m128i a[8], b[8];
+    for (int i = 0; i < 4; i++)
+    {
+        a[2 * i] = _mm_unpacklo_epi16(in[2 * i], in[2 * i + 1]);
+        a[2 * i + 1] = _mm_unpackhi_epi16(in[2 * i], in[2 * i + 1]);
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        b[4 * i + 0] = _mm_unpacklo_epi32(a[4 * i + 0], a[4 * i + 2]);
+        b[4 * i + 1] = _mm_unpackhi_epi32(a[4 * i + 0], a[4 * i + 2]);
+        b[4 * i + 2] = _mm_unpacklo_epi32(a[4 * i + 1], a[4 * i + 3]);
+        b[4 * i + 3] = _mm_unpackhi_epi32(a[4 * i + 1], a[4 * i + 3]);
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        out[2 * i] = _mm_unpacklo_epi64(b[i], b[i + 4]);
+        out[2 * i + 1] = _mm_unpackhi_epi64(b[i], b[i + 4]);
+    }
+}
+
+__attribute__((target("ssse3")))
+static void dct8x8Ssse3(const int16_t *in, int16_t *out, size_t blocks, const int32_t pairs[8][4])
+{
+    __m128i rows[8], pass[8];
+    for (size_t block = 0; block < blocks; block++, in += 64, out += 64)
+    {
+        for (int r = 0; r < 8; r++)
+            rows[r] = _mm_loadu_si128((const __m128i *)(in + r * 8));
+        dctPassSsse3(rows, pass, pairs, DCT_PASS1);
+        transpose8x8Ssse3(pass, rows);
+        dctPassSsse3(rows, pass, pairs, DCT_PASS2);
+        transpose8x8Ssse3(pass, rows);
+        for (int r = 0; r < 8; r++)
+            _mm_storeu_si128((__m128i *)(out + r * 8), rows[r]);
+    }
+}
+
+static void fdct8x8Ssse3(const int16_t *in, int16_t *out, size_t blocks)
+{
+    dct8x8Ssse3(in, out, blocks, dctMatrix().forward_pairs);
+}
+
+static void idct8x8Ssse3(const int16_t *in, int16_t *out, size_t blocks)
+{
+    dct8x8Ssse3(in, out, blocks, dctMatrix().inverse_pairs);
+}
+
+/**
+ * The same instructions on two blocks at once, one per 128-bit lane: every
+ * one of them works within lanes. An odd block left over takes the SSSE3 path.
+ */
+__attribute__((target("avx2")))
+static inline void dctPassAvx2(const __m256i *in, __m256i *out, const int32_t pairs[8][4], int shift)
+{
+    __m256i lo[4], hi[4];
+    for (int u = 0; u < 4; u++)
+    {
+        lo[u] = _mm256_unpacklo_epi16(in[2 * u], in[2 * u + 1]);
+        hi[u] = _mm256_unpackhi_epi16(in[2 * u], in[2 * u + 1]);
+    }
+    const __m256i round = _mm256_set1_epi32(1 << (shift - 1));
+    const __m128i count = _mm_cvtsi32_si128(shift);
+    for (int k = 0; k < 8; k++)
+    {
+        __m256i sum_lo = round, sum_hi = round;
+        for (int u = 0; u < 4; u++)
+        {
+            __m256i pair = _mm256_set1_epi32(pairs[k][u]);
+            sum_lo = _mm256_add_epi32(sum_lo, _mm256_madd_epi16(lo[u], pair));
+            sum_hi = _mm256_add_epi32(sum_hi, _mm256_madd_epi16(hi[u], pair));
+        }
+        out[k] = _mm256_packs_epi32(_mm256_sra_epi32(sum_lo, count), _mm256_sra_epi32(sum_hi, count));
+    }
+}
+
+__attribute__((target("avx2")))
+static inline void transpose8x8Avx2(const __m256i *in, __m256i *out)
+{
+    __m256i a[8], b[8];
+    for (int i = 0; i < 4; i++)
+    {
+        a[2 * i] = _mm256_unpacklo_epi16(in[2 * i], in[2 * i + 1]);
+        a[2 * i + 1] = _mm256_unpackhi_epi16(in[2 * i], in[2 * i + 1]);
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        b[4 * i + 0] = _mm256_unpacklo_epi32(a[4 * i + 0], a[4 * i + 2]);
+        b[4 * i + 1] = _mm256_unpackhi_epi32(a[4 * i + 0], a[4 * i + 2]);
+        b[4 * i + 2] = _mm256_unpacklo_epi32(a[4 * i + 1], a[4 * i + 3]);
+        b[4 * i + 3] = _mm256_unpackhi_epi32(a[4 * i + 1], a[4 * i + 3]);
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        out[2 * i] = _mm256_unpacklo_epi64(b[i], b[i + 4]);
+        out[2 * i + 1] = _mm256_unpackhi_epi64(b[i], b[i + 4]);
+    }
+}
+
+__attribute__((target("avx2")))
+static void dct8x8Avx2(const int16_t *in, int16_t *out, size_t blocks, const int32_t pairs[8][4])
+{
+    __m256i rows[8], pass[8];
+    size_t block = 0;
+    for (; block + 2 <= blocks; block += 2, in += 128, out += 128)
+    {
+        for (int r = 0; r < 8; r++)
+            rows[r] = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(in + r * 8))),
+                                              _mm_loadu_si128((const __m128i *)(in + 64 + r * 8)), 1);
+        dctPassAvx2(rows, pass, pairs, DCT_PASS1);
+        transpose8x8Avx2(pass, rows);
+        dctPassAvx2(rows, pass, pairs, DCT_PASS2);
+        transpose8x8Avx2(pass, rows);
+        for (int r = 0; r < 8; r++)
+        {
+            _mm_storeu_si128((__m128i *)(out + r * 8), _mm256_castsi256_si128(rows[r]));
+            _mm_storeu_si128((__m128i *)(out + 64 + r * 8), _mm256_extracti128_si256(rows[r], 1));
+        }
+    }
+    dct8x8Ssse3(in, out, blocks - block, pairs);
+}
+
+static void fdct8x8Avx2(const int16_t *in, int16_t *out, size_t blocks)
+{
+    dct8x8Avx2(in, out, blocks, dctMatrix().forward_pairs);
+}
+
+static void idct8x8Avx2(const int16_t *in, int16_t *out, size_t blocks)
+{
+    dct8x8Avx2(in, out, blocks, dctMatrix().inverse_pairs);
+}
+
+// abs, saturating add of the rounding term, high half of the product, sign back on
+__attribute__((target("ssse3")))
+static void quantizeSsse3(const int16_t *coefs, int16_t *levels, const uint16_t *half, const uint16_t *recip,
+                          size_t blocks)
+{
+    for (size_t block = 0; block < blocks; block++, coefs += 64, levels += 64)
+    {
+        for (int i = 0; i < 64; i += 8)
+        {
+            __m128i c = _mm_loadu_si128((const __m128i *)(coefs + i));
+            __m128i magnitude = _mm_adds_epu16(_mm_abs_epi16(c), _mm_loadu_si128((const __m128i *)(half + i)));
+            __m128i level = _mm_mulhi_epu16(magnitude, _mm_loadu_si128((const __m128i *)(recip + i)));
+            _mm_storeu_si128((__m128i *)(levels + i), _mm_sign_epi16(level, c));
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+static void quantizeAvx2(const int16_t *coefs, int16_t *levels, const uint16_t *half, const uint16_t *recip,
+                         size_t blocks)
+{
+    for (size_t block = 0; block < blocks; block++, coefs += 64, levels += 64)
+    {
+        for (int i = 0; i < 64; i += 16)
+        {
+            __m256i c = _mm256_loadu_si256((const __m256i *)(coefs + i));
+            __m256i magnitude = _mm256_adds_epu16(_mm256_abs_epi16(c), _mm256_loadu_si256((const __m256i *)(half + i)));
+            __m256i level = _mm256_mulhi_epu16(magnitude, _mm256_loadu_si256((const __m256i *)(recip + i)));
+            _mm256_storeu_si256((__m256i *)(levels + i), _mm256_sign_epi16(level, c));
+        }
+    }
+}
+
+// Full 32-bit products from the low and high halves, saturated back to int16
+__attribute__((target("ssse3")))
+static void dequantizeSsse3(const int16_t *levels, int16_t *coefs, const uint16_t *steps, size_t blocks)
+{
+    for (size_t block = 0; block < blocks; block++, levels += 64, coefs += 64)
+    {
+        for (int i = 0; i < 64; i += 8)
+        {
+            __m128i level = _mm_loadu_si128((const __m128i *)(levels + i));
+            __m128i step = _mm_loadu_si128((const __m128i *)(steps + i));
+            __m128i low = _mm_mullo_epi16(level, step), high = _mm_mulhi_epi16(level, step);
+            _mm_storeu_si128((__m128i *)(coefs + i),
+                             _mm_packs_epi32(_mm_unpacklo_epi16(low, high), _mm_unpackhi_epi16(low, high)));
+        }
+    }
+}
+
+// packs works within 128-bit lanes, and so does the unpack: the order comes out right
+__attribute__((target("avx2")))
+static void dequantizeAvx2(const int16_t *levels, int16_t *coefs, const uint16_t *steps, size_t blocks)
+{
+    for (size_t block = 0; block < blocks; block++, levels += 64, coefs += 64)
+    {
+        for (int i = 0; i < 64; i += 16)
+        {
+            __m256i level = _mm256_loadu_si256((const __m256i *)(levels + i));
+            __m256i step = _mm256_loadu_si256((const __m256i *)(steps + i));
+            __m256i low = _mm256_mullo_epi16(level, step), high = _mm256_mulhi_epi16(level, step);
+            _mm256_storeu_si256((__m256i *)(coefs + i), _mm256_packs_epi32(_mm256_unpacklo_epi16(low, high),
+                                                                            _mm256_unpackhi_epi16(low, high)));
+        }
+    }
+}
+#endif
+
+Dct8x8Fn fdct8x8Kernel(int level)
+{
+    if (level > detectedSimdLevel())
+        return NULL;
+    switch (level)
+    {
+#ifdef RGM_X86_KERNELS
+    case SIMD_AVX2:
+        return fdct8x8Avx2;
+    case SIMD_SSSE3:
+        return fdct8x8Ssse3;
+#endif
+    case SIMD_SCALAR:
+        return fdct8x8Scalar;
+    default:
+        return NULL;
+    }
+}
+
+Dct8x8Fn idct8x8Kernel(int level)
+{
+    if (level > detectedSimdLevel())
+        return NULL;
+    switch (level)
+    {
+#ifdef RGM_X86_KERNELS
+    case SIMD_AVX2:
+        return idct8x8Avx2;
+    case SIMD_SSSE3:
+        return idct8x8Ssse3;
+#endif
+    case SIMD_SCALAR:
+        return idct8x8Scalar;
+    default:
+        return NULL;
+    }
+}
+
+QuantizeFn quantizeKernel(int level)
+{
+    if (level > detectedSimdLevel())
+        return NULL;
+    switch (level)
+    {
+#ifdef RGM_X86_KERNELS
+    case SIMD_AVX2:
+        return quantizeAvx2;
+    case SIMD_SSSE3:
+        return quantizeSsse3;
+#endif
+    case SIMD_SCALAR:
+        return quantizeScalar;
+    default:
+        return NULL;
+    }
+}
+
+DequantizeFn dequantizeKernel(int level)
+{
+    if (level > detectedSimdLevel())
+        return NULL;
+    switch (level)
+    {
+#ifdef RGM_X86_KERNELS
+    case SIMD_AVX2:
+        return dequantizeAvx2;
+    case SIMD_SSSE3:
+        return dequantizeSsse3;
+#endif
+    case SIMD_SCALAR:
+        return dequantizeScalar;
+    default:
+        return NULL;
+    }
+}
+
+void fdct8x8(const int16_t *in, int16_t *out, size_t blocks)
+{
+    static const Dct8x8Fn kernel = fdct8x8Kernel(activeSimdLevel());
+    kernel(in, out, blocks);
+}
+
+void idct8x8(const int16_t *in, int16_t *out, size_t blocks)
+{
+    static const Dct8x8Fn kernel = idct8x8Kernel(activeSimdLevel());
+    kernel(in, out, blocks);
+}
+
+void quantizeBlocks(const int16_t *coefs, int16_t *levels, const uint16_t *half, const uint16_t *recip,
+                    size_t blocks)
+{
+    static const QuantizeFn kernel = quantizeKernel(activeSimdLevel());
+    kernel(coefs, levels, half, recip, blocks);
+}
+
+void dequantizeBlocks(const int16_t *levels, int16_t *coefs, const uint16_t *steps, size_t blocks)
+{
+    static const DequantizeFn kernel = dequantizeKernel(activeSimdLevel());
+    kernel(levels, coefs, steps, blocks);
+}
+
+// ============================================================================
+// YCoCg-R COLOUR TRANSFORM
+// ============================================================================
+
+#define YCOCG_LIMIT 1024 // Decoded samples are clamped to [-limit, limit) so int16 never overflows
+
+static void rgbToYCoCgScalar(const uint8_t *row0, const uint8_t *row1, int16_t *y0, int16_t *y1, int16_t *co,
+                             int16_t *cg, size_t pixels)
+{
+    for (size_t x = 0; x < pixels; x += 2)
+    {
+        int co_sum = 0, cg_sum = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            const uint8_t *p = (i < 2 ? row0 : row1) + (x + (i & 1)) * 3;
+            int pixel_co = p[0] - p[2];
+            int t = p[2] + (pixel_co >> 1);
+            int pixel_cg = p[1] - t;
+            (i < 2 ? y0 : y1)[x + (i & 1)] = (int16_t)(t + (pixel_cg >> 1) - 128);
+            co_sum += pixel_co;
+            cg_sum += pixel_cg;
+        }
+        co[x / 2] = (int16_t)((co_sum + 2) >> 2);
+        cg[x / 2] = (int16_t)((cg_sum + 2) >> 2);
+    }
+}
+
+static inline int clampSample(int v)
+{
+    return v < -YCOCG_LIMIT ? -YCOCG_LIMIT : v >= YCOCG_LIMIT ? YCOCG_LIMIT - 1 : v;
+}
+
+static void yCoCgToRgbScalar(const int16_t *y0, const int16_t *y1, const int16_t *co, const int16_t *cg,
+                             uint8_t *row0, uint8_t *row1, size_t pixels)
+{
+    for (size_t x = 0; x < pixels; x++)
+    {
+        int pixel_co = clampSample(co[x / 2]), pixel_cg = clampSample(cg[x / 2]);
+        for (int k = 0; k < 2; k++)
+        {
+            uint8_t *p = (k ? row1 : row0) + x * 3;
+            int t = clampSample((k ? y1 : y0)[x]) + 128 - (pixel_cg >> 1);
+            int g = pixel_cg + t;
+            int b = t - (pixel_co >> 1);
+            int r = b + pixel_co;
+            p[0] = (uint8_t)(r < 0 ? 0 : r > 255 ? 255 : r);
+            p[1] = (uint8_t)(g < 0 ? 0 : g > 255 ? 255 : g);
+            p[2] = (uint8_t)(b < 0 ? 0 : b > 255 ? 255 : b);
+        }
+    }
+}
+
+#ifdef RGM_X86_KERNELS
+// Split 8 packed pixels (24 bytes, no read past them) into three int16 vectors
+__attribute__((target("ssse3")))
+static inline void loadPixels8(const uint8_t *p, __m128i &c0, __m128i &c1, __m128i &c2)
+{
+    __m128i lo = _mm_loadu_si128((const __m128i *)p);
+    __m128i hi = _mm_loadl_epi64((const __m128i *)(p + 16));
+    c0 = _mm_or_si128(_mm_shuffle_epi8(lo, _mm_setr_epi8(0, -1, 3, -1, 6, -1, 9, -1, 12, -1, 15, -1, -1, -1, -1, -1)),
+                      _mm_shuffle_epi8(hi, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, -1, 5, -1)));
+    c1 = _mm_or_si128(_mm_shuffle_epi8(lo, _mm_setr_epi8(1, -1, 4, -1, 7, -1, 10, -1, 13, -1, -1, -1, -1, -1, -1, -1)),
+                      _mm_shuffle_epi8(hi, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, -1, 3, -1, 6, -1)));
+    c2 = _mm_or_si128(_mm_shuffle_epi8(lo, _mm_setr_epi8(2, -1, 5, -1, 8, -1, 11, -1, 14, -1, -1, -1, -1, -1, -1, -1)),
+                      _mm_shuffle_epi8(hi, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, -1, 4, -1, 7, -1)));
+}
+
+// Forward transform of 8 pixels: Y - 128 stored, Co and Cg returned for averaging
+__attribute__((target("ssse3")))
+static inline void toYCoCg8(const uint8_t *p, int16_t *y, __m128i &co, __m128i &cg)
+{
+    __m128i c0, c1, c2;
+    loadPixels8(p, c0, c1, c2);
+    co = _mm_sub_epi16(c0, c2);
+    __m128i t = _mm_add_epi16(c2, _mm_srai_epi16(co, 1));
+    cg = _mm_sub_epi16(c1, t);
+    __m128i luma = _mm_sub_epi16(_mm_add_epi16(t, _mm_srai_epi16(cg, 1)), _mm_set1_epi16(128));
+    _mm_storeu_si128((__m128i *)y, luma);
+}
+
+// 16 x 2 pixels per step; the 2x2 chroma sums come from a horizontal add of both rows
+__attribute__((target("ssse3")))
+static void rgbToYCoCgSsse3(const uint8_t *row0, const uint8_t *row1, int16_t *y0, int16_t *y1, int16_t *co,
+                            int16_t *cg, size_t pixels)
+{
+    const __m128i round = _mm_set1_epi16(2);
+    size_t x = 0;
+    for (; x + 16 <= pixels; x += 16)
+    {
+        __m128i co_a, cg_a, co_b, cg_b, co_c, cg_c, co_d, cg_d;
+        toYCoCg8(row0 + x * 3, y0 + x, co_a, cg_a);
+        toYCoCg8(row0 + x * 3 + 24, y0 + x + 8, co_b, cg_b);
+        toYCoCg8(row1 + x * 3, y1 + x, co_c, cg_c);
+        toYCoCg8(row1 + x * 3 + 24, y1 + x + 8, co_d, cg_d);
+        __m128i co_sum = _mm_hadd_epi16(_mm_add_epi16(co_a, co_c), _mm_add_epi16(co_b, co_d));
+        __m128i cg_sum = _mm_hadd_epi16(_mm_add_epi16(cg_a, cg_c), _mm_add_epi16(cg_b, cg_d));
+        _mm_storeu_si128((__m128i *)(co + x / 2), _mm_srai_epi16(_mm_add_epi16(co_sum, round), 2));
+        _mm_storeu_si128((__m128i *)(cg + x / 2), _mm_srai_epi16(_mm_add_epi16(cg_sum, round), 2));
+    }
+    rgbToYCoCgScalar(row0 + x * 3, row1 + x * 3, y0 + x, y1 + x, co + x / 2, cg + x / 2, pixels - x);
+}
+
+// Inverse transform of 8 pixels whose chroma is already widened; packus does the clamping to bytes
+__attribute__((target("ssse3")))
+static inline void fromYCoCg8(const int16_t *y, __m128i co, __m128i cg, uint8_t *p)
+{
+    const __m128i low = _mm_set1_epi16(-YCOCG_LIMIT), high = _mm_set1_epi16(YCOCG_LIMIT - 1);
+    __m128i luma = _mm_min_epi16(_mm_max_epi16(_mm_loadu_si128((const __m128i *)y), low), high);
+    __m128i t = _mm_sub_epi16(_mm_add_epi16(luma, _mm_set1_epi16(128)), _mm_srai_epi16(cg, 1));
+    __m128i g = _mm_add_epi16(cg, t);
+    __m128i b = _mm_sub_epi16(t, _mm_srai_epi16(co, 1));
+    __m128i r = _mm_add_epi16(b, co);
+    __m128i rg = _mm_packus_epi16(r, g);
+    __m128i bb = _mm_packus_epi16(b, b);
+    __m128i lo = _mm_or_si128(_mm_shuffle_epi8(rg, _mm_setr_epi8(0, 8, -1, 1, 9, -1, 2, 10, -1, 3, 11, -1, 4, 12, -1, 5)),
+                              _mm_shuffle_epi8(bb, _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1)));
+    __m128i hi = _mm_or_si128(_mm_shuffle_epi8(rg, _mm_setr_epi8(13, -1, 6, 14, -1, 7, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+                              _mm_shuffle_epi8(bb, _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, -1, -1, -1, -1, -1, -1)));
+    _mm_storeu_si128((__m128i *)p, lo);
+    _mm_storel_epi64((__m128i *)(p + 16), hi);
+}
+
+// 16 x 2 pixels per step, each chroma sample duplicated for its two columns
+__attribute__((target("ssse3")))
+static void yCoCgToRgbSsse3(const int16_t *y0, const int16_t *y1, const int16_t *co, const int16_t *cg,
+                            uint8_t *row0, uint8_t *row1, size_t pixels)
+{
+    const __m128i low = _mm_set1_epi16(-YCOCG_LIMIT), high = _mm_set1_epi16(YCOCG_LIMIT - 1);
+    size_t x = 0;
+    for (; x + 16 <= pixels; x += 16)
+    {
+        __m128i pixel_co = _mm_min_epi16(_mm_max_epi16(_mm_loadu_si128((const __m128i *)(co + x / 2)), low), high);
+        __m128i pixel_cg = _mm_min_epi16(_mm_max_epi16(_mm_loadu_si128((const __m128i *)(cg + x / 2)), low), high);
+        __m128i co_a = _mm_unpacklo_epi16(pixel_co, pixel_co), co_b = _mm_unpackhi_epi16(pixel_co, pixel_co);
+        __m128i cg_a = _mm_unpacklo_epi16(pixel_cg, pixel_cg), cg_b = _mm_unpackhi_epi16(pixel_cg, pixel_cg);
+        fromYCoCg8(y0 + x, co_a, cg_a, row0 + x * 3);
+        fromYCoCg8(y0 + x + 8, co_b, cg_b, row0 + x * 3 + 24);
+        fromYCoCg8(y1 + x, co_a, cg_a, row1 + x * 3);
+        fromYCoCg8(y1 + x + 8, co_b, cg_b, row1 + x * 3 + 24);
+    }
+    yCoCgToRgbScalar(y0 + x, y1 + x, co + x / 2, cg + x / 2, row0 + x * 3, row1 + x * 3, pixels - x);
+}
+#endif
+
+// Byte shuffling dominates, which 256-bit lanes do not speed up: AVX2 runs the SSSE3 kernels
+ToYCoCgFn rgbToYCoCgKernel(int level)
+{
+    if (level > detectedSimdLevel())
+        return NULL;
+    switch (level)
+    {
+#ifdef RGM_X86_KERNELS
+    case SIMD_AVX2:
+    case SIMD_SSSE3:
+        return rgbToYCoCgSsse3;
+#endif
+    case SIMD_SCALAR:
+        return rgbToYCoCgScalar;
+    default:
+        return NULL;
+    }
+}
+
+FromYCoCgFn yCoCgToRgbKernel(int level)
+{
+    if (level > detectedSimdLevel())
+        return NULL;
+    switch (level)
+    {
+#ifdef RGM_X86_KERNELS
+    case SIMD_AVX2:
+    case SIMD_SSSE3:
+        return yCoCgToRgbSsse3;
+#endif
+    case SIMD_SCALAR:
+        return yCoCgToRgbScalar;
+    default:
+        return NULL;
+    }
+}
+
+void rgbToYCoCg(const uint8_t *row0, const uint8_t *row1, int16_t *y0, int16_t *y1, int16_t *co, int16_t *cg,
+                size_t pixels)
+{
+    static const ToYCoCgFn kernel = rgbToYCoCgKernel(activeSimdLevel());
+    kernel(row0, row1, y0, y1, co, cg, pixels);
+}
+
+void yCoCgToRgb(const int16_t *y0, const int16_t *y1, const int16_t *co, const int16_t *cg, uint8_t *row0,
+                uint8_t *row1, size_t pixels)
+{
+    static const FromYCoCgFn kernel = yCoCgToRgbKernel(activeSimdLevel());
+    kernel(y0, y1, co, cg, row0, row1, pixels);
+}
@@ -0,0 +1,90 @@
+/**
+ * SIMD.H - CPU FEATURE DISPATCH AND PIXEL KERNELS
+ *
+ * Hot pixel loops come in a portable scalar version plus x86 versions
+ * compiled for newer instruction sets. The best level the CPU supports is
+ * picked once at startup; RGM_SIMD=scalar|ssse3|avx2 in the environment caps
+ * it (to compare levels or to rule out a miscompiled kernel).
+ */
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+enum SimdLevel
+{
+    SIMD_SCALAR = 0,
+    SIMD_SSSE3 = 1,
+    SIMD_AVX2 = 2,
+    SIMD_LEVEL_COUNT
+};
+
+const char *simdLevelName(int level);
+int simdLevelFromName(const std::string &name); // -1 if unknown
+
+int detectedSimdLevel(); // What the CPU (and OS) support
+int activeSimdLevel();   // Detected level, capped by RGM_SIMD
+
+/**
+ * Pack `count` 32-bit pixels into 3 bytes each by dropping the fourth byte,
+ * keeping the byte order (X11 ZPixmap rows to the wire format).
+ */
+typedef void (*PackPixelsFn)(const uint8_t *src, uint8_t *dst, size_t count);
+
+void packPixels32(const uint8_t *src, uint8_t *dst, size_t count); // Active level
+PackPixelsFn packPixels32Kernel(int level);                          // NULL if unsupported
+
+/**
+ * 8x8 DCT of `blocks` consecutive blocks of 64 int16 (8 rows of 8): the
+ * orthonormal DCT-II in 12-bit fixed point, applied down the columns, then
+ * along the rows, saturating to int16 after each pass. Every level computes
+ * the same integers, so an encoder's reconstruction matches the decoder's
+ * on any CPU.
+ */
+typedef void (*Dct8x8Fn)(const int16_t *in, int16_t *out, size_t blocks);
+
+void fdct8x8(const int16_t *in, int16_t *out, size_t blocks); // Forward, active level
+void idct8x8(const int16_t *in, int16_t *out, size_t blocks); // Inverse, active level
+Dct8x8Fn fdct8x8Kernel(int level);                              // NULL if unsupported
+Dct8x8Fn idct8x8Kernel(int level);
+
+/**
+ * Quantize `blocks` blocks of DCT coefficients with one table of 64 steps:
+ * level = sign(c) * (min(|c| + half, 65535) * recip >> 16), with half =
+ * step / 2 and recip = 65536 / step (step >= 2).
+ */
+typedef void (*QuantizeFn)(const int16_t *coefs, int16_t *levels, const uint16_t *half, const uint16_t *recip,
+                           size_t blocks);
+
+void quantizeBlocks(const int16_t *coefs, int16_t *levels, const uint16_t *half, const uint16_t *recip,
+                    size_t blocks); // Active level
+QuantizeFn quantizeKernel(int level);
+
+// The way back: coef = level * step (step <= 32767), saturated to int16
+typedef void (*DequantizeFn)(const int16_t *levels, int16_t *coefs, const uint16_t *steps, size_t blocks);
+
+void dequantizeBlocks(const int16_t *levels, int16_t *coefs, const uint16_t *steps, size_t blocks); // Active level
+DequantizeFn dequantizeKernel(int level);
+
+/**
+ * Lossless YCoCg-R colour transform of two rows of `pixels` packed pixels
+ * (an even count), with chroma subsampled 2x2 (4:2:0): Y - 128 of every
+ * pixel into y0 and y1, the rounded average Co and Cg of each 2x2 group
+ * into co and cg. The inverse clamps its input samples to [-1024, 1024)
+ * and the pixels to bytes, so any input gives the same output everywhere.
+ */
+typedef void (*ToYCoCgFn)(const uint8_t *row0, const uint8_t *row1, int16_t *y0, int16_t *y1, int16_t *co,
+                          int16_t *cg, size_t pixels);
+typedef void (*FromYCoCgFn)(const int16_t *y0, const int16_t *y1, const int16_t *co, const int16_t *cg,
+                            uint8_t *row0, uint8_t *row1, size_t pixels);
+
+void rgbToYCoCg(const uint8_t *row0, const uint8_t *row1, int16_t *y0, int16_t *y1, int16_t *co, int16_t *cg,
+                size_t pixels); // Active level
+void yCoCgToRgb(const int16_t *y0, const int16_t *y1, const int16_t *co, const int16_t *cg, uint8_t *row0,
+                uint8_t *row1, size_t pixels);
+ToYCoCgFn rgbToYCoCgKernel(int level);
+FromYCoCgFn yCoCgToRgbKernel(int level);
+
+#endif
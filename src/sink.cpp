@@ -0,0 +1,632 @@
+/**
+ * SINK.CPP - DISPLAY AND HEADLESS FRAME SINKS
+ */
+#include "sink.h"
+#include "protocol.h"
+#include "codec.h"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+
+#ifndef RGM_NO_SDL
+#include <SDL2/SDL.h>
+#endif
+
+#define MAX_DISPLAY_WIDTH 1920  // Maximum initial window width (for scaling)
+#define MAX_DISPLAY_HEIGHT 1080 // Maximum initial window height (for scaling)
+
+// ============================================================================
+// DISPLAY
+// ============================================================================
+
+#ifndef RGM_NO_SDL
+/**
+ * SDL window showing the stream, scaled to the window size
+ *
+ * SDL, the window and the renderer live as long as the sink, so a
+ * reconnecting sender finds the window where it was; a session only
+ * replaces the texture, and only when its resolution differs.
+ */
+class DisplaySink : public FrameSink
+{
+public:
+    DisplaySink() : window(NULL), renderer(NULL), texture(NULL), frame_width(0), frame_height(0) {}
+    ~DisplaySink() { shutdown(); }
+
+    bool open(int width, int height)
+    {
+        if (!window && !createWindow(width, height))
+            return false;
+
+        if (texture && width == frame_width && height == frame_height)
+        {
+            std::cout << "♻️  Reusing the window and its " << width << "x" << height << " texture" << std::endl;
+            return true;
+        }
+
+        if (texture)
+        {
+            SDL_DestroyTexture(texture);
+            texture = NULL;
+            SDL_SetWindowSize(window, windowWidth(width, height), windowHeight(width, height));
+        }
+
+        /**
+         * Create texture with sender's resolution
+         * This texture will be scaled to window size by the renderer
+         */
+        texture = SDL_CreateTexture(renderer,
+                                    SDL_PIXELFORMAT_RGB24,
+                                    SDL_TEXTUREACCESS_STREAMING,
+                                    width,
+                                    height);
+
+        if (!texture)
+        {
+            std::cerr << "❌ Texture creation failed: " << SDL_GetError() << std::endl;
+            frame_width = frame_height = 0;
+            return false;
+        }
+        frame_width = width;
+        frame_height = height;
+
+        std::cout << "✅ SDL texture ready: " << width << "x" << height << std::endl;
+        return true;
+    }
+
+    bool poll()
+    {
+        if (!window)
+            return true;
+
+        SDL_Event event;
+        while (SDL_PollEvent(&event))
+        {
+            if (event.type == SDL_QUIT)
+                return false;
+            else if (event.type == SDL_KEYDOWN)
+            {
+                if (event.key.keysym.sym == SDLK_ESCAPE ||
+                    event.key.keysym.sym == SDLK_q)
+                    return false;
+            }
+            else if (event.type == SDL_WINDOWEVENT)
+            {
+                if (event.window.event == SDL_WINDOWEVENT_RESIZED)
+                {
+                    std::cout << "Window resized to " << event.window.data1 << "x" << event.window.data2 << std::endl;
+                }
+                else if (event.window.event == SDL_WINDOWEVENT_EXPOSED && texture)
+                {
+                    // Between sessions nobody presents; redraw the last frame
+                    present();
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * The texture keeps the original resolution,
+     * the renderer scales it to window size
+     */
+    bool upload(const uint8_t *frame, uint32_t frame_id)
+    {
+        (void)frame_id;
+        return SDL_UpdateTexture(texture, NULL, frame, frame_width * BYTES_PER_PIXEL) == 0;
+    }
+
+    void present()
+    {
+        SDL_RenderClear(renderer);
+        SDL_RenderCopy(renderer, texture, NULL, NULL);
+        SDL_RenderPresent(renderer);
+    }
+
+    /**
+     * The session ended: the window keeps showing its last frame
+     * (and stays responsive through poll()) until the next session
+     */
+    void close() {}
+
+    std::string describe() const { return "display (SDL)"; }
+    bool interactive() const { return true; }
+
+private:
+    /**
+     * Calculate initial window size
+     * Scale down if screen is too large, but maintain aspect ratio
+     */
+    static float windowScale(int width, int height)
+    {
+        if (width <= MAX_DISPLAY_WIDTH && height <= MAX_DISPLAY_HEIGHT)
+            return 1.0f;
+        return std::min((float)MAX_DISPLAY_WIDTH / width, (float)MAX_DISPLAY_HEIGHT / height);
+    }
+    static int windowWidth(int width, int height) { return (int)(width * windowScale(width, height)); }
+    static int windowHeight(int width, int height) { return (int)(height * windowScale(width, height)); }
+
+    bool createWindow(int width, int height)
+    {
+        // Initialize SDL with video support
+        if (SDL_Init(SDL_INIT_VIDEO) < 0)
+        {
+            std::cerr << "❌ SDL initialization failed: " << SDL_GetError() << std::endl;
+            std::cerr << "   Use --headless on machines without a display." << std::endl;
+            return false;
+        }
+
+        // Create main window
+        window = SDL_CreateWindow("RGM Receiver",
+                                  SDL_WINDOWPOS_CENTERED,
+                                  SDL_WINDOWPOS_CENTERED,
+                                  windowWidth(width, height),
+                                  windowHeight(width, height),
+                                  SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
+
+        if (!window)
+        {
+            std::cerr << "❌ Window creation failed: " << SDL_GetError() << std::endl;
+            shutdown();
+            return false;
+        }
+
+        /**
+         * Create hardware-accelerated renderer
+         */
+        renderer = SDL_CreateRenderer(window, -1,
+                                      SDL_RENDERER_ACCELERATED |
+                                          SDL_RENDERER_PRESENTVSYNC);
+
+        if (!renderer)
+        {
+            std::cerr << "❌ Renderer creation failed: " << SDL_GetError() << std::endl;
+            shutdown();
+            return false;
+        }
+
+        // Enable linear filtering for smooth scaling
+        SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
+
+        std::cout << "✅ SDL initialized successfully" << std::endl;
+        return true;
+    }
+
+    // Receiver exit: tear everything down
+    void shutdown()
+    {
+        if (texture)
+            SDL_DestroyTexture(texture);
+        if (renderer)
+            SDL_DestroyRenderer(renderer);
+        if (window)
+            SDL_DestroyWindow(window);
+        if (SDL_WasInit(SDL_INIT_VIDEO))
+            SDL_Quit();
+        texture = NULL;
+        renderer = NULL;
+        window = NULL;
+        frame_width = frame_height = 0;
+    }
+
+    SDL_Window *window;
+    SDL_Renderer *renderer;
+    SDL_Texture *texture;
+    int frame_width, frame_height;
+};
+#endif
+
+// ============================================================================
+// HEADLESS SINKS
+// ============================================================================
+
+/**
+ * Decode and drop, for measuring the receive and decode path alone
+ */
+class DiscardSink : public FrameSink
+{
+public:
+    bool open(int width, int height)
+    {
+        (void)width;
+        (void)height;
+        return true;
+    }
+    bool upload(const uint8_t *frame, uint32_t frame_id)
+    {
+        (void)frame;
+        (void)frame_id;
+        return true;
+    }
+    std::string describe() const { return "discard"; }
+};
+
+/**
+ * Hash every frame, e.g. to check that a codec change is lossless by
+ * comparing the digests of two runs over the same synthetic source
+ */
+class HashSink : public FrameSink
+{
+public:
+    explicit HashSink(const std::string &path)
+        : path(path), width(0), height(0), digest(0), frames(0)
+    {
+    }
+
+    bool open(int w, int h)
+    {
+        width = w;
+        height = h;
+        digest = 0;
+        frames = 0;
+        if (!path.empty() && !out.is_open())
+        {
+            out.open(path.c_str());
+            if (!out)
+            {
+                std::cerr << "❌ Could not write frame hashes to " << path << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // The digest covers the whole session, whatever its resolutions
+    bool resize(int w, int h)
+    {
+        width = w;
+        height = h;
+        return true;
+    }
+
+    bool upload(const uint8_t *frame, uint32_t frame_id)
+    {
+        uint64_t hash = hashTile(frame, (size_t)width * BYTES_PER_PIXEL, width, height);
+        digest = (digest ^ hash) * 0x100000001B3ULL + frame_id;
+        frames++;
+        if (out.is_open())
+            out << frame_id << " " << std::hex << std::setw(16) << std::setfill('0') << hash
+                << std::dec << "\n";
+        return true;
+    }
+
+    void close()
+    {
+        if (frames == 0)
+            return;
+        std::ostringstream text;
+        text << std::hex << std::setw(16) << std::setfill('0') << digest;
+        std::cout << "🔑 Session digest: " << text.str() << " (" << frames << " frames)" << std::endl;
+        if (out.is_open())
+            out.flush();
+    }
+
+    std::string describe() const { return path.empty() ? "hash" : "hash (" + path + ")"; }
+
+private:
+    std::string path;
+    std::ofstream out;
+    int width, height;
+    uint64_t digest;
+    uint64_t frames;
+};
+
+/**
+ * Append raw RGB24 frames to a file or FIFO, e.g. for ffmpeg:
+ *   ffmpeg -f rawvideo -pixel_format rgb24 -video_size WxH -i <file> ...
+ */
+class RawFileSink : public FrameSink
+{
+public:
+    explicit RawFileSink(const std::string &path) : path(path), frame_size(0) {}
+
+    bool open(int width, int height)
+    {
+        frame_size = (size_t)width * height * BYTES_PER_PIXEL;
+        if (!out.is_open())
+        {
+            out.open(path.c_str(), std::ios::binary | std::ios::app);
+            if (!out)
+            {
+                std::cerr << "❌ Could not open " << path << " for frames" << std::endl;
+                return false;
+            }
+        }
+        std::cout << "💾 Writing rgb24 " << width << "x" << height << " frames to " << path << std::endl;
+        return true;
+    }
+
+    bool upload(const uint8_t *frame, uint32_t frame_id)
+    {
+        (void)frame_id;
+        out.write((const char *)frame, frame_size);
+        return out.good();
+    }
+
+    void close() { out.flush(); }
+
+    std::string describe() const { return "raw (" + path + ")"; }
+
+private:
+    std::string path;
+    std::ofstream out;
+    size_t frame_size;
+};
+
+std::unique_ptr<FrameSink> createFrameSink(const std::string &spec)
+{
+    if (spec == "display")
+    {
+#ifdef RGM_NO_SDL
+        std::cerr << "❌ This receiver was built without SDL; use --headless" << std::endl;
+        return std::unique_ptr<FrameSink>();
+#else
+        return std::unique_ptr<FrameSink>(new DisplaySink());
+#endif
+    }
+    if (spec == "discard")
+        return std::unique_ptr<FrameSink>(new DiscardSink());
+    if (spec == "hash")
+        return std::unique_ptr<FrameSink>(new HashSink(""));
+    if (spec.compare(0, 5, "hash:") == 0 && spec.size() > 5)
+        return std::unique_ptr<FrameSink>(new HashSink(spec.substr(5)));
+    if (spec.compare(0, 4, "raw:") == 0 && spec.size() > 4)
+        return std::unique_ptr<FrameSink>(new RawFileSink(spec.substr(4)));
+
+    std::cerr << "❌ Unknown sink '" << spec << "' (display, discard, hash[:file], raw:<file>)" << std::endl;
+    return std::unique_ptr<FrameSink>();
+}
+
+// ============================================================================
+// MOSAIC
+// ============================================================================
+
+#define MOSAIC_PIP_INSET 4 // Inset cells are this fraction of the canvas width
+
+/**
+ * One session's picture. The session thread writes it under `mutex`, the
+ * output thread reads it; the cell belongs to the mosaic's lock.
+ */
+class FrameMosaic::Slot : public FrameSink
+{
+public:
+    Slot(FrameMosaic &owner, const std::string &label)
+        : owner(owner), label(label), width(0), height(0), dirty(false), attached(false),
+          cell_x(0), cell_y(0), cell_w(0), cell_h(0) {}
+    ~Slot() { close(); }
+
+    bool open(int w, int h)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            width = w;
+            height = h;
+            pixels.assign((size_t)w * h * BYTES_PER_PIXEL, 0);
+            dirty = false;
+        }
+        if (!attached)
+            owner.attach(this);
+        attached = true;
+        return true;
+    }
+
+    // The picture's letterboxing changes, so its cell is drawn from scratch
+    bool resize(int w, int h)
+    {
+        open(w, h);
+        std::lock_guard<std::mutex> lock(owner.mutex);
+        owner.relayout = true;
+        return true;
+    }
+
+    bool poll() { return !owner.quit; }
+
+    bool upload(const uint8_t *frame, uint32_t frame_id)
+    {
+        (void)frame_id;
+        std::lock_guard<std::mutex> lock(mutex);
+        memcpy(pixels.data(), frame, pixels.size());
+        dirty = true;
+        return true;
+    }
+
+    void close()
+    {
+        if (attached)
+            owner.detach(this);
+        attached = false;
+    }
+
+    std::string describe() const { return "mosaic (" + label + ")"; }
+
+    FrameMosaic &owner;
+    std::string label;
+    std::mutex mutex;
+    std::vector<uint8_t> pixels;
+    int width, height;
+    bool dirty;
+    bool attached;
+    int cell_x, cell_y, cell_w, cell_h;
+};
+
+FrameMosaic::FrameMosaic(FrameSink &output, int width, int height, MosaicLayout layout)
+    : output(output), width(width), height(height), layout(layout), relayout(false), opened(false),
+      quit(false), frames(0)
+{
+    canvas.assign((size_t)width * height * BYTES_PER_PIXEL, 0);
+}
+
+FrameMosaic::~FrameMosaic()
+{
+    close();
+}
+
+std::unique_ptr<FrameSink> FrameMosaic::slot(const std::string &label)
+{
+    return std::unique_ptr<FrameSink>(new Slot(*this, label));
+}
+
+void FrameMosaic::attach(Slot *slot)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    slots.push_back(slot);
+    layoutCells();
+    std::cout << "🧩 " << slot->label << " joined the mosaic (" << slots.size() << " sessions)" << std::endl;
+}
+
+void FrameMosaic::detach(Slot *slot)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    slots.erase(std::remove(slots.begin(), slots.end(), slot), slots.end());
+    layoutCells();
+    std::cout << "🧩 " << slot->label << " left the mosaic (" << slots.size() << " sessions)" << std::endl;
+}
+
+// Called with `mutex` held
+void FrameMosaic::layoutCells()
+{
+    relayout = true;
+    size_t count = slots.size();
+    if (count == 0)
+        return;
+
+    if (layout == MOSAIC_PIP)
+    {
+        int inset_w = width / MOSAIC_PIP_INSET;
+        int inset_h = height / MOSAIC_PIP_INSET;
+        for (size_t i = 0; i < count; i++)
+        {
+            Slot *slot = slots[i];
+            if (i == 0)
+            {
+                slot->cell_x = slot->cell_y = 0;
+                slot->cell_w = width;
+                slot->cell_h = height;
+                continue;
+            }
+            // Right to left along the bottom edge, further insets wrap upwards
+            int per_row = std::max(1, MOSAIC_PIP_INSET - 1);
+            int column = (int)(i - 1) % per_row;
+            int row = (int)(i - 1) / per_row;
+            slot->cell_w = inset_w;
+            slot->cell_h = inset_h;
+            slot->cell_x = width - (column + 1) * inset_w;
+            slot->cell_y = std::max(0, height - (row + 1) * inset_h);
+        }
+        return;
+    }
+
+    int cols = 1;
+    while ((size_t)(cols * cols) < count)
+        cols++;
+    int rows = (int)((count + cols - 1) / cols);
+    for (size_t i = 0; i < count; i++)
+    {
+        Slot *slot = slots[i];
+        slot->cell_w = width / cols;
+        slot->cell_h = height / rows;
+        slot->cell_x = (int)(i % cols) * slot->cell_w;
+        slot->cell_y = (int)(i / cols) * slot->cell_h;
+    }
+}
+
+/**
+ * Scale a slot into its cell, keeping the aspect ratio (letterboxed).
+ * Called with `mutex` and the slot's mutex held.
+ */
+void FrameMosaic::draw(Slot *slot)
+{
+    if (slot->width <= 0 || slot->height <= 0 || slot->cell_w <= 0 || slot->cell_h <= 0)
+        return;
+
+    double scale = std::min((double)slot->cell_w / slot->width, (double)slot->cell_h / slot->height);
+    int out_w = std::max(1, (int)(slot->width * scale));
+    int out_h = std::max(1, (int)(slot->height * scale));
+    int out_x = slot->cell_x + (slot->cell_w - out_w) / 2;
+    int out_y = slot->cell_y + (slot->cell_h - out_h) / 2;
+
+    columns.resize(out_w);
+    for (int x = 0; x < out_w; x++)
+        columns[x] = (size_t)((int64_t)x * slot->width / out_w) * BYTES_PER_PIXEL;
+
+    size_t src_stride = (size_t)slot->width * BYTES_PER_PIXEL;
+    size_t dst_stride = (size_t)width * BYTES_PER_PIXEL;
+    for (int y = 0; y < out_h; y++)
+    {
+        const uint8_t *src = slot->pixels.data() + (size_t)((int64_t)y * slot->height / out_h) * src_stride;
+        uint8_t *dst = canvas.data() + (size_t)(out_y + y) * dst_stride + (size_t)out_x * BYTES_PER_PIXEL;
+        for (int x = 0; x < out_w; x++, dst += BYTES_PER_PIXEL)
+        {
+            const uint8_t *pixel = src + columns[x];
+            dst[0] = pixel[0];
+            dst[1] = pixel[1];
+            dst[2] = pixel[2];
+        }
+    }
+}
+
+bool FrameMosaic::poll()
+{
+    if (opened && !output.poll())
+        quit = true;
+    return !quit;
+}
+
+bool FrameMosaic::compose()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!opened)
+    {
+        // The output (window) appears with the first session
+        if (slots.empty())
+            return true;
+        if (!output.open(width, height))
+            return false;
+        opened = true;
+        std::cout << "🧩 Mosaic " << width << "x" << height << " on " << output.describe() << std::endl;
+    }
+
+    // Insets overlap the main picture, so picture-in-picture redraws everything
+    bool changed = relayout;
+    for (size_t i = 0; i < slots.size() && !changed; i++)
+    {
+        std::lock_guard<std::mutex> slot_lock(slots[i]->mutex);
+        changed = slots[i]->dirty;
+    }
+    if (!changed)
+        return true;
+
+    bool all = relayout || layout == MOSAIC_PIP;
+    if (relayout)
+        std::fill(canvas.begin(), canvas.end(), 0);
+    relayout = false;
+    for (size_t i = 0; i < slots.size(); i++)
+    {
+        Slot *slot = slots[i];
+        std::lock_guard<std::mutex> slot_lock(slot->mutex);
+        if (all || slot->dirty)
+            draw(slot);
+        slot->dirty = false;
+    }
+
+    if (!output.upload(canvas.data(), frames++))
+        return false;
+    output.present();
+    return true;
+}
+
+void FrameMosaic::close()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (opened)
+        output.close();
+    opened = false;
+}
+
+std::string FrameMosaic::describe() const
+{
+    return std::string(layout == MOSAIC_PIP ? "picture-in-picture" : "grid") + " mosaic on " + output.describe();
+}
@@ -0,0 +1,114 @@
+/**
+ * SINK.H - WHERE THE RECEIVER PUTS DECODED FRAMES
+ *
+ * The receiver runs the protocol and decoder, then hands every frame to a
+ * FrameSink. The display sink is the SDL window; the others need no display
+ * at all, so the receiver can run on servers, in CI and under benchmarks:
+ *   display      - SDL window (default, unavailable in RGM_NO_SDL builds)
+ *   discard      - drop frames after decoding
+ *   hash         - hash every frame and print a session digest
+ *   hash:<file>  - same, plus one "frame_id hash" line per frame
+ *   raw:<file>   - append packed RGB24 frames to a file or FIFO
+ */
+#ifndef SINK_H
+#define SINK_H
+
+#include <cstdint>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <atomic>
+
+class FrameSink
+{
+public:
+    virtual ~FrameSink() {}
+
+    // A session starts; width x height packed RGB24 frames follow. Sessions may follow one another
+    virtual bool open(int width, int height) = 0;
+
+    // The session switched resolution mid-stream; width x height frames follow
+    virtual bool resize(int width, int height) { return open(width, height); }
+
+    // Called between frames; false means the user asked to quit the receiver
+    virtual bool poll() { return true; }
+
+    // Take a decoded frame (texture upload, hashing, writing). Timed as "upload"
+    virtual bool upload(const uint8_t *frame, uint32_t frame_id) = 0;
+
+    // Make the last uploaded frame visible. Timed as "present"
+    virtual void present() {}
+
+    // The session ended. Resources that outlive sessions (the window) go with the sink
+    virtual void close() {}
+
+    virtual std::string describe() const = 0;
+
+    // True if the sink needs a display (and SDL)
+    virtual bool interactive() const { return false; }
+};
+
+/**
+ * Create a sink from a command line spec (see above).
+ * Returns nullptr (after printing why) when the spec is unknown.
+ */
+std::unique_ptr<FrameSink> createFrameSink(const std::string &spec);
+
+enum MosaicLayout
+{
+    MOSAIC_GRID, // Equal cells, as many columns as rows or one more
+    MOSAIC_PIP,  // First session fills the canvas, the others are insets along the bottom
+};
+
+/**
+ * Composites concurrent sessions onto one sink (receiver --sessions).
+ *
+ * Each session decodes into its own slot() on its own thread; upload()
+ * copies the picture into the slot. The thread that owns the output sink
+ * (SDL wants the main thread) calls compose(), which scales the slots that
+ * changed into their cells with nearest-neighbour sampling and presents
+ * the canvas. Cells are laid out again whenever a session starts or ends.
+ */
+class FrameMosaic
+{
+public:
+    FrameMosaic(FrameSink &output, int width, int height, MosaicLayout layout);
+    ~FrameMosaic();
+
+    // A sink for one session, used from the session's thread
+    std::unique_ptr<FrameSink> slot(const std::string &label);
+
+    // Output thread: window events; false once the user asked to quit
+    bool poll();
+
+    // Output thread: draw what changed and present; false if the output failed
+    bool compose();
+
+    // Output thread: close the output sink
+    void close();
+
+    std::string describe() const;
+
+private:
+    class Slot;
+
+    void attach(Slot *slot);
+    void detach(Slot *slot);
+    void layoutCells();
+    void draw(Slot *slot);
+
+    FrameSink &output;
+    int width, height;
+    MosaicLayout layout;
+    std::mutex mutex;          // Guards slots, cells and relayout
+    std::vector<Slot *> slots; // Open sessions, oldest first
+    bool relayout;
+    bool opened;
+    std::atomic<bool> quit;
+    std::vector<uint8_t> canvas;
+    std::vector<size_t> columns; // Scaling scratch: source offset per output column
+    uint32_t frames;
+};
+
+#endif
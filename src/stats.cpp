@@ -0,0 +1,341 @@
+/**
+ * STATS.CPP - LATENCY HISTOGRAMS AND PIPELINE STAGE COUNTERS
+ */
+#include "stats.h"
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <mutex>
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+/**
+ * Values below 2 * SUB_BUCKETS map 1:1, larger values keep their top
+ * HISTOGRAM_SUB_BITS significant bits.
+ */
+int LatencyHistogram::bucketIndex(uint64_t value)
+{
+    if (value < 2 * HISTOGRAM_SUB_BUCKETS)
+        return (int)value;
+
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - (HISTOGRAM_SUB_BITS - 1);
+    if (shift > HISTOGRAM_MAX_SHIFT)
+        return HISTOGRAM_BUCKETS - 1;
+
+    return (shift + 1) * HISTOGRAM_SUB_BUCKETS + (int)((value >> shift) - HISTOGRAM_SUB_BUCKETS);
+}
+
+/**
+ * Midpoint of a bucket, used when reporting percentiles
+ */
+uint64_t LatencyHistogram::bucketValue(int index)
+{
+    if (index < 2 * HISTOGRAM_SUB_BUCKETS)
+        return index;
+
+    int shift = index / HISTOGRAM_SUB_BUCKETS - 1;
+    uint64_t low = (uint64_t)(index % HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BUCKETS) << shift;
+    return low + ((1ULL << shift) >> 1);
+}
+
+void LatencyHistogram::record(uint64_t value_us)
+{
+    buckets[bucketIndex(value_us)]++;
+    total++;
+    sum += value_us;
+    if (value_us > max_value)
+        max_value = value_us;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other)
+{
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+        buckets[i] += other.buckets[i];
+    total += other.total;
+    sum += other.sum;
+    if (other.max_value > max_value)
+        max_value = other.max_value;
+}
+
+void LatencyHistogram::subtract(const LatencyHistogram &earlier)
+{
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+        buckets[i] -= earlier.buckets[i];
+    total -= earlier.total;
+    sum -= earlier.sum;
+}
+
+void LatencyHistogram::reset()
+{
+    memset(buckets, 0, sizeof(buckets));
+    total = 0;
+    sum = 0;
+    max_value = 0;
+}
+
+double LatencyHistogram::mean() const
+{
+    return total ? (double)sum / total : 0.0;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const
+{
+    if (total == 0)
+        return 0;
+
+    uint64_t rank = (uint64_t)(p / 100.0 * total + 0.5);
+    if (rank < 1)
+        rank = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        seen += buckets[i];
+        if (seen >= rank)
+        {
+            uint64_t value = bucketValue(i);
+            return value < max_value ? value : max_value;
+        }
+    }
+    return max_value;
+}
+
+std::string LatencyHistogram::summary() const
+{
+    if (total == 0)
+        return "n/a";
+
+    return "p50 " + formatMicros(percentile(50)) +
+           " p95 " + formatMicros(percentile(95)) +
+           " p99 " + formatMicros(percentile(99));
+}
+
+static const char *STAGE_NAMES[STAGE_COUNT] = {
+    "capture", "convert", "encode", "send", "recv", "decode", "upload", "present"};
+
+static const char *COUNTER_NAMES[COUNTER_COUNT] = {
+    "frames", "bytes", "dropped"};
+
+const char *stageName(int stage)
+{
+    return (stage >= 0 && stage < STAGE_COUNT) ? STAGE_NAMES[stage] : "unknown";
+}
+
+const char *counterName(int counter)
+{
+    return (counter >= 0 && counter < COUNTER_COUNT) ? COUNTER_NAMES[counter] : "unknown";
+}
+
+/**
+ * Only the owning thread writes, so load + store is enough and avoids
+ * locked instructions on the hot path
+ */
+static inline void bump(std::atomic<uint64_t> &value, uint64_t amount)
+{
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+StageHistogram::StageHistogram()
+{
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+        buckets[i].store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    max_value.store(0, std::memory_order_relaxed);
+}
+
+void StageHistogram::record(uint64_t value_us)
+{
+    bump(buckets[LatencyHistogram::bucketIndex(value_us)], 1);
+    bump(sum, value_us);
+    if (value_us > max_value.load(std::memory_order_relaxed))
+        max_value.store(value_us, std::memory_order_relaxed);
+}
+
+/**
+ * Add this histogram to `out`. The total is rebuilt from the buckets so a
+ * snapshot taken mid-record stays self-consistent.
+ */
+void StageHistogram::snapshot(LatencyHistogram &out) const
+{
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        uint64_t n = buckets[i].load(std::memory_order_relaxed);
+        out.buckets[i] += n;
+        out.total += n;
+    }
+    out.sum += sum.load(std::memory_order_relaxed);
+    uint64_t m = max_value.load(std::memory_order_relaxed);
+    if (m > out.max_value)
+        out.max_value = m;
+}
+
+/**
+ * Everything one thread records. Blocks are registered on first use and
+ * kept for the life of the process so exited threads still show up in the
+ * final report.
+ */
+struct ThreadStats
+{
+    StageHistogram stages[STAGE_COUNT];
+    std::atomic<uint64_t> counters[COUNTER_COUNT];
+
+    ThreadStats()
+    {
+        for (int i = 0; i < COUNTER_COUNT; i++)
+            counters[i].store(0, std::memory_order_relaxed);
+    }
+};
+
+static std::mutex g_stats_mutex;
+static std::vector<ThreadStats *> g_thread_stats;
+
+static ThreadStats &threadStats()
+{
+    static thread_local ThreadStats *local = nullptr;
+    if (!local)
+    {
+        local = new ThreadStats();
+        std::lock_guard<std::mutex> lock(g_stats_mutex);
+        g_thread_stats.push_back(local);
+    }
+    return *local;
+}
+
+void recordStage(PipelineStage stage, uint64_t duration_us)
+{
+    threadStats().stages[stage].record(duration_us);
+}
+
+void addCounter(PipelineCounter counter, uint64_t amount)
+{
+    bump(threadStats().counters[counter], amount);
+}
+
+void snapshotStages(LatencyHistogram (&out)[STAGE_COUNT])
+{
+    for (int s = 0; s < STAGE_COUNT; s++)
+        out[s].reset();
+
+    std::lock_guard<std::mutex> lock(g_stats_mutex);
+    for (size_t t = 0; t < g_thread_stats.size(); t++)
+    {
+        for (int s = 0; s < STAGE_COUNT; s++)
+            g_thread_stats[t]->stages[s].snapshot(out[s]);
+    }
+}
+
+void snapshotCounters(uint64_t (&out)[COUNTER_COUNT])
+{
+    for (int c = 0; c < COUNTER_COUNT; c++)
+        out[c] = 0;
+
+    std::lock_guard<std::mutex> lock(g_stats_mutex);
+    for (size_t t = 0; t < g_thread_stats.size(); t++)
+    {
+        for (int c = 0; c < COUNTER_COUNT; c++)
+            out[c] += g_thread_stats[t]->counters[c].load(std::memory_order_relaxed);
+    }
+}
+
+void StageWindow::advance(LatencyHistogram (&window)[STAGE_COUNT])
+{
+    snapshotStages(window);
+    for (int s = 0; s < STAGE_COUNT; s++)
+    {
+        LatencyHistogram current = window[s];
+        window[s].subtract(previous[s]);
+        previous[s] = current;
+    }
+}
+
+void showStages(const LatencyHistogram (&stages)[STAGE_COUNT])
+{
+    for (int s = 0; s < STAGE_COUNT; s++)
+    {
+        if (stages[s].count() == 0)
+            continue;
+
+        std::string name = stageName(s);
+        name.resize(8, ' ');
+        std::cout << "   ⏲️  " << name << " " << stages[s].summary()
+                  << " (mean " << formatMicros((uint64_t)stages[s].mean()) << ")" << std::endl;
+    }
+}
+
+static void writeHistogramJson(std::ofstream &out, const LatencyHistogram &histogram)
+{
+    out << "{\"count\": " << histogram.count()
+        << ", \"mean_us\": " << (uint64_t)histogram.mean()
+        << ", \"p50_us\": " << histogram.percentile(50)
+        << ", \"p95_us\": " << histogram.percentile(95)
+        << ", \"p99_us\": " << histogram.percentile(99)
+        << ", \"max_us\": " << histogram.max() << "}";
+}
+
+/**
+ * Dump stage histograms, counters and the caller's extra figures as JSON
+ */
+bool writeStatsJson(const std::string &path, const StatsReport &report)
+{
+    std::ofstream out(path.c_str());
+    if (!out)
+    {
+        std::cerr << "❌ Could not write stats to " << path << std::endl;
+        return false;
+    }
+
+    LatencyHistogram stages[STAGE_COUNT];
+    uint64_t counters[COUNTER_COUNT];
+    snapshotStages(stages);
+    snapshotCounters(counters);
+
+    out.precision(12);
+    out << "{\n  \"role\": \"" << report.role << "\"";
+    for (size_t i = 0; i < report.values.size(); i++)
+        out << ",\n  \"" << report.values[i].first << "\": " << report.values[i].second;
+
+    out << ",\n  \"counters\": {";
+    for (int c = 0; c < COUNTER_COUNT; c++)
+        out << (c ? ", " : "") << "\"" << counterName(c) << "\": " << counters[c];
+    out << "}";
+
+    out << ",\n  \"stages\": {";
+    bool first = true;
+    for (int s = 0; s < STAGE_COUNT; s++)
+    {
+        if (stages[s].count() == 0)
+            continue;
+        out << (first ? "\n" : ",\n") << "    \"" << stageName(s) << "\": ";
+        writeHistogramJson(out, stages[s]);
+        first = false;
+    }
+    out << "\n  }";
+
+    out << ",\n  \"latency\": {";
+    for (size_t i = 0; i < report.latencies.size(); i++)
+    {
+        out << (i ? ",\n" : "\n") << "    \"" << report.latencies[i].first << "\": ";
+        writeHistogramJson(out, report.latencies[i].second);
+    }
+    out << "\n  }\n}\n";
+
+    std::cout << "💾 Stats written to " << path << std::endl;
+    return out.good();
+}
+
+std::string formatMicros(uint64_t us)
+{
+    char text[32];
+    if (us < 1000)
+        snprintf(text, sizeof(text), "%lluus", (unsigned long long)us);
+    else if (us < 1000000)
+        snprintf(text, sizeof(text), "%.1fms", us / 1000.0);
+    else
+        snprintf(text, sizeof(text), "%.2fs", us / 1000000.0);
+    return text;
+}
@@ -0,0 +1,144 @@
+/**
+ * STATS.H - LATENCY HISTOGRAMS AND PIPELINE STAGE COUNTERS
+ *
+ * Log-linear (HDR-style) histogram of microsecond latencies. Each power of two
+ * is split into HISTOGRAM_SUB_BUCKETS linear buckets, so percentiles are
+ * accurate to about 3% at any magnitude with a fixed memory footprint.
+ *
+ * Pipeline stages are recorded into per-thread histograms that only their
+ * owning thread writes (relaxed atomic stores, no locks or read-modify-write
+ * instructions). The stats printer snapshots all threads concurrently.
+ */
+#ifndef STATS_H
+#define STATS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+#include <atomic>
+
+#define HISTOGRAM_SUB_BITS 6                                // 64 buckets below 64us, then 32 per octave
+#define HISTOGRAM_SUB_BUCKETS (1 << (HISTOGRAM_SUB_BITS - 1)) // Linear buckets per power of two
+#define HISTOGRAM_MAX_SHIFT 36                              // Values are clamped to ~2^42us
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_SHIFT + 2) * HISTOGRAM_SUB_BUCKETS)
+
+class StageHistogram;
+
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void record(uint64_t value_us);
+    void merge(const LatencyHistogram &other);
+    // Remove an earlier snapshot of the same histogram (max stays cumulative)
+    void subtract(const LatencyHistogram &earlier);
+    void reset();
+
+    uint64_t count() const { return total; }
+    uint64_t max() const { return max_value; }
+    double mean() const;
+    uint64_t percentile(double p) const;
+
+    // "p50 1.2ms p95 3.4ms p99 8.0ms" for the stats blocks
+    std::string summary() const;
+
+    static int bucketIndex(uint64_t value);
+
+private:
+    friend class StageHistogram;
+    static uint64_t bucketValue(int index);
+
+    uint64_t buckets[HISTOGRAM_BUCKETS];
+    uint64_t total;
+    uint64_t sum;
+    uint64_t max_value;
+};
+
+/**
+ * Pipeline stages timed on the sender and the receiver
+ */
+enum PipelineStage
+{
+    STAGE_CAPTURE, // Sender: grab pixels from the display
+    STAGE_CONVERT, // Sender: convert to the wire pixel format
+    STAGE_ENCODE,  // Sender: build the frame message
+    STAGE_SEND,    // Sender: hand the frame to the socket
+    STAGE_RECV,    // Receiver: header to last payload byte
+    STAGE_DECODE,  // Receiver: payload to displayable pixels
+    STAGE_UPLOAD,  // Receiver: SDL_UpdateTexture
+    STAGE_PRESENT, // Receiver: render copy and present
+    STAGE_COUNT
+};
+
+/**
+ * Monotonic event counters, summed over all threads
+ */
+enum PipelineCounter
+{
+    COUNTER_FRAMES,  // Frames completed by this process
+    COUNTER_BYTES,   // Bytes sent or received on the stream
+    COUNTER_DROPPED, // Frames skipped or discarded
+    COUNTER_COUNT
+};
+
+const char *stageName(int stage);
+const char *counterName(int counter);
+
+/**
+ * Single-writer histogram that other threads may read at any time
+ */
+class StageHistogram
+{
+public:
+    StageHistogram();
+    void record(uint64_t value_us);
+    void snapshot(LatencyHistogram &out) const;
+
+private:
+    std::atomic<uint64_t> buckets[HISTOGRAM_BUCKETS];
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> max_value;
+};
+
+// Hot path: record into the calling thread's histograms
+void recordStage(PipelineStage stage, uint64_t duration_us);
+void addCounter(PipelineCounter counter, uint64_t amount = 1);
+
+// Aggregate all threads (cumulative since process start)
+void snapshotStages(LatencyHistogram (&out)[STAGE_COUNT]);
+void snapshotCounters(uint64_t (&out)[COUNTER_COUNT]);
+
+/**
+ * Per-interval view for the periodic stats block: each call returns what
+ * was recorded since the previous call
+ */
+class StageWindow
+{
+public:
+    void advance(LatencyHistogram (&window)[STAGE_COUNT]);
+
+private:
+    LatencyHistogram previous[STAGE_COUNT];
+};
+
+// Print one line per stage that has samples
+void showStages(const LatencyHistogram (&stages)[STAGE_COUNT]);
+
+/**
+ * Content of the JSON dump written at exit (--stats-json)
+ */
+struct StatsReport
+{
+    std::string role;                                              // "sender" or "receiver"
+    std::vector<std::pair<std::string, double> > values;           // Top-level numbers
+    std::vector<std::pair<std::string, LatencyHistogram> > latencies; // Extra distributions
+};
+
+bool writeStatsJson(const std::string &path, const StatsReport &report);
+
+// Human readable duration: "850us", "12.3ms", "1.20s"
+std::string formatMicros(uint64_t us);
+
+#endif
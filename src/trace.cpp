@@ -0,0 +1,153 @@
+/**
+ * TRACE.CPP - FRAME LIFECYCLE TIMELINE (CHROME TRACE EVENTS)
+ */
+#include "trace.h"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <utility>
+
+struct TraceEvent
+{
+    uint64_t start_us;
+    uint32_t duration_us;
+    uint32_t frame_id;
+    uint16_t stage;
+    uint16_t thread;
+};
+
+static std::vector<TraceEvent> g_trace_events;
+static std::atomic<uint64_t> g_trace_next{0};
+static std::atomic<bool> g_trace_enabled{false};
+static std::atomic<int64_t> g_trace_offset_us{0};
+static std::atomic<int> g_trace_thread_count{0};
+
+static std::mutex g_trace_names_mutex;
+static std::vector<std::pair<int, std::string> > g_trace_thread_names;
+
+struct TraceThread
+{
+    int id;
+    uint32_t frame_id;
+    TraceThread() : id(g_trace_thread_count++), frame_id(0) {}
+};
+
+static TraceThread &traceThread()
+{
+    static thread_local TraceThread thread;
+    return thread;
+}
+
+void enableTracing(size_t capacity)
+{
+    g_trace_events.assign(capacity, TraceEvent());
+    g_trace_next = 0;
+    g_trace_enabled = true;
+    std::cout << "🧵 Tracing enabled (" << capacity << " event ring buffer)" << std::endl;
+}
+
+bool tracingEnabled()
+{
+    return g_trace_enabled.load(std::memory_order_relaxed);
+}
+
+void setTraceClockOffset(int64_t offset_us)
+{
+    g_trace_offset_us = offset_us;
+}
+
+void setTraceThreadName(const char *name)
+{
+    std::lock_guard<std::mutex> lock(g_trace_names_mutex);
+    g_trace_thread_names.push_back(std::make_pair(traceThread().id, std::string(name)));
+}
+
+void setTraceFrame(uint32_t frame_id)
+{
+    traceThread().frame_id = frame_id;
+}
+
+void recordSpan(PipelineStage stage, uint64_t start_us, uint64_t end_us)
+{
+    recordStage(stage, end_us - start_us);
+
+    if (!tracingEnabled())
+        return;
+
+    TraceThread &thread = traceThread();
+    uint64_t slot = g_trace_next.fetch_add(1, std::memory_order_relaxed);
+    TraceEvent &event = g_trace_events[slot % g_trace_events.size()];
+    event.start_us = start_us;
+    event.duration_us = (uint32_t)(end_us - start_us);
+    event.frame_id = thread.frame_id;
+    event.stage = (uint16_t)stage;
+    event.thread = (uint16_t)thread.id;
+}
+
+/**
+ * Write the ring buffer oldest-first as Chrome trace JSON
+ *
+ * Each span becomes a complete ("X") event carrying its frame id. The send
+ * and recv stages additionally emit flow events keyed by frame id, so a
+ * merged sender + receiver trace draws an arrow across the network hop.
+ * Spans still being written by other threads may come out torn; dumps are
+ * meant for exit or an explicit signal, not for continuous polling.
+ */
+bool writeTrace(const std::string &path, const char *process_name, int pid)
+{
+    if (!tracingEnabled())
+        return false;
+
+    std::ofstream out(path.c_str());
+    if (!out)
+    {
+        std::cerr << "❌ Could not write trace to " << path << std::endl;
+        return false;
+    }
+
+    uint64_t written = g_trace_next.load();
+    uint64_t capacity = g_trace_events.size();
+    uint64_t first = written > capacity ? written - capacity : 0;
+    int64_t offset_us = g_trace_offset_us.load();
+
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    out << "{\"ph\": \"M\", \"name\": \"process_name\", \"pid\": " << pid
+        << ", \"args\": {\"name\": \"" << process_name << "\"}}";
+
+    {
+        std::lock_guard<std::mutex> lock(g_trace_names_mutex);
+        for (size_t i = 0; i < g_trace_thread_names.size(); i++)
+        {
+            out << ",\n{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": " << pid
+                << ", \"tid\": " << g_trace_thread_names[i].first
+                << ", \"args\": {\"name\": \"" << g_trace_thread_names[i].second << "\"}}";
+        }
+    }
+
+    for (uint64_t i = first; i < written; i++)
+    {
+        const TraceEvent &event = g_trace_events[i % capacity];
+        int64_t ts = (int64_t)event.start_us + offset_us;
+
+        out << ",\n{\"ph\": \"X\", \"name\": \"" << stageName(event.stage)
+            << "\", \"cat\": \"stage\", \"pid\": " << pid << ", \"tid\": " << event.thread
+            << ", \"ts\": " << ts << ", \"dur\": " << event.duration_us
+            << ", \"args\": {\"frame\": " << event.frame_id << "}}";
+
+        if (event.stage == STAGE_SEND || event.stage == STAGE_RECV)
+        {
+            bool start = event.stage == STAGE_SEND;
+            out << ",\n{\"ph\": \"" << (start ? "s" : "f") << "\""
+                << (start ? "" : ", \"bp\": \"e\"")
+                << ", \"name\": \"frame\", \"cat\": \"frame\", \"id\": " << event.frame_id
+                << ", \"pid\": " << pid << ", \"tid\": " << event.thread
+                << ", \"ts\": " << ts << "}";
+        }
+    }
+    out << "\n]}\n";
+
+    std::cout << "🧵 Trace with " << (written - first) << " spans written to " << path << std::endl;
+    return out.good();
+}
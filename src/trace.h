@@ -0,0 +1,43 @@
+/**
+ * TRACE.H - FRAME LIFECYCLE TIMELINE (CHROME TRACE EVENTS)
+ *
+ * Opt-in recorder for pipeline stage spans. Spans go into a ring buffer
+ * allocated once by enableTracing(), so recording never allocates and the
+ * newest events win when it wraps. writeTrace() emits Chrome trace-event
+ * JSON that Perfetto (ui.perfetto.dev) and chrome://tracing can open.
+ */
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <string>
+#include "stats.h"
+
+#define TRACE_DEFAULT_EVENTS (1 << 18) // ~9 minutes of spans at 60 FPS
+
+// Trace process ids, distinct so sender and receiver files can be merged
+#define TRACE_PID_SENDER 1
+#define TRACE_PID_RECEIVER 2
+
+void enableTracing(size_t capacity = TRACE_DEFAULT_EVENTS);
+bool tracingEnabled();
+
+// Timeline offset: timestamps are written as local_us + offset_us so both
+// sides share the receiver's clock (the sender passes its clock offset)
+void setTraceClockOffset(int64_t offset_us);
+
+// Label the calling thread in the timeline
+void setTraceThreadName(const char *name);
+
+// Frame the calling thread is currently working on
+void setTraceFrame(uint32_t frame_id);
+
+/**
+ * Record a finished pipeline stage: always into the stage histograms,
+ * and onto the timeline when tracing is enabled
+ */
+void recordSpan(PipelineStage stage, uint64_t start_us, uint64_t end_us);
+
+bool writeTrace(const std::string &path, const char *process_name, int pid);
+
+#endif